@@ -36,9 +36,12 @@
 #include "m64p_config.h"
 #include "m64p_frontend.h"
 #include "m64p_types.h"
+#include "backends/file_storage.h"
 #include "main/cheat.h"
 #include "main/eventloop.h"
 #include "main/main.h"
+#include "main/pacer.h"
+#include "main/rewind.h"
 #include "main/rom.h"
 #include "main/savestates.h"
 #include "main/util.h"
@@ -85,6 +88,7 @@ EXPORT m64p_error CALL CoreStartup(int APIVersion, const char *ConfigPath, const
     plugin_connect(M64PLUGIN_CORE, NULL);
 
     savestates_init();
+    pacer_startup();
 
     /* next, start up the configuration handling code by loading and parsing the config file */
     if (ConfigInit(ConfigPath, DataPath) != M64ERR_SUCCESS)
@@ -108,6 +112,10 @@ EXPORT m64p_error CALL CoreStartup(int APIVersion, const char *ConfigPath, const
 
     workqueue_init();
 
+    if (file_storage_deferred_init() != 0) {
+        DebugMessage(M64MSG_WARNING, "Couldn't initialize deferred saves, saves will be written immediately");
+    }
+
     l_CoreInit = 1;
     return M64ERR_SUCCESS;
 }
@@ -120,8 +128,10 @@ EXPORT m64p_error CALL CoreShutdown(void)
     /* close down some core sub-systems */
     romdatabase_close();
     ConfigShutdown();
+    file_storage_deferred_shutdown();
     workqueue_shutdown();
     savestates_deinit();
+    pacer_shutdown();
 
     /* if the calling code is using SDL, don't shut it down */
     if (!l_CallerUsingSDL)
@@ -370,6 +380,22 @@ EXPORT m64p_error CALL CoreDoCommand(m64p_command Command, int ParamInt, void *P
                 return M64ERR_INCOMPATIBLE;
         case M64CMD_NETPLAY_CLOSE:
             return netplay_stop();
+        case M64CMD_REWIND_STEP_BACK:
+            if (!g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            if (ParamInt < 1)
+                return M64ERR_INPUT_INVALID;
+            if (!rewind_step_back((unsigned int) ParamInt))
+                return M64ERR_INVALID_STATE;
+            return M64ERR_SUCCESS;
+        case M64CMD_REWIND_GET_AVAILABLE:
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_INVALID;
+            *(int*)ParamPtr = (int) rewind_get_available();
+            return M64ERR_SUCCESS;
+        case M64CMD_FLUSH_SAVES:
+            file_storage_request_flush(1);
+            return M64ERR_SUCCESS;
         default:
             return M64ERR_INPUT_INVALID;
     }
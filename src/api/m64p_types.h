@@ -139,6 +139,10 @@ typedef enum {
   M64CORE_STATE_LOADCOMPLETE,
   M64CORE_STATE_SAVECOMPLETE,
   M64CORE_SCREENSHOT_CAPTURED,
+  M64CORE_FASTFORWARD_FRAMESKIP,
+  M64CORE_FRAME_TIME_P50,
+  M64CORE_FRAME_TIME_P99,
+  M64CORE_FRAME_TIME_MAX,
 } m64p_core_param;
 
 typedef enum {
@@ -171,7 +175,10 @@ typedef enum {
   M64CMD_PIF_OPEN,
   M64CMD_ROM_SET_SETTINGS,
   M64CMD_DISK_OPEN,
-  M64CMD_DISK_CLOSE
+  M64CMD_DISK_CLOSE,
+  M64CMD_REWIND_STEP_BACK,
+  M64CMD_REWIND_GET_AVAILABLE,
+  M64CMD_FLUSH_SAVES
 } m64p_command;
 
 typedef struct {
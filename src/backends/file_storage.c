@@ -21,7 +21,10 @@
 
 #include "file_storage.h"
 
+#include <SDL.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
@@ -29,6 +32,10 @@
 #include "device/dd/dd_controller.h"
 #include "main/util.h"
 #include "main/netplay.h"
+#include "main/workqueue.h"
+#include "osal/files.h"
+
+static void deferred_close(struct file_storage* fstorage);
 
 int open_file_storage(struct file_storage* fstorage, size_t size, const char* filename)
 {
@@ -36,6 +43,8 @@ int open_file_storage(struct file_storage* fstorage, size_t size, const char* fi
     fstorage->filename = filename;
     fstorage->size = size;
     fstorage->first_access = 1;
+    fstorage->mapped = 0;
+    fstorage->dirty = 0;
 
     /* allocate memory for holding data */
     fstorage->data = malloc(fstorage->size);
@@ -60,6 +69,8 @@ int open_rom_file_storage(struct file_storage* fstorage, const char* filename)
     fstorage->size = 0;
     fstorage->filename = NULL;
     fstorage->first_access = 1;
+    fstorage->mapped = 0;
+    fstorage->dirty = 0;
 
     file_status_t err = load_file(filename, (void**)&fstorage->data, &fstorage->size);
 
@@ -71,9 +82,37 @@ int open_rom_file_storage(struct file_storage* fstorage, const char* filename)
     return err;
 }
 
+/* Same as open_rom_file_storage, but the file is mapped copy-on-write instead of
+ * being read into memory: untouched pages are shared with other processes through
+ * the page cache, and writes to data never reach the file.
+ * Falls back to open_rom_file_storage if the file can't be mapped. */
+int open_mapped_file_storage(struct file_storage* fstorage, const char* filename)
+{
+    fstorage->data = (uint8_t*)osal_file_map_copy(filename, &fstorage->size);
+    if (fstorage->data == NULL) {
+        return open_rom_file_storage(fstorage, filename);
+    }
+
+    /* ! take ownsership of filename ! */
+    fstorage->filename = filename;
+    fstorage->first_access = 1;
+    fstorage->mapped = 1;
+    fstorage->dirty = 0;
+
+    return file_ok;
+}
+
 void close_file_storage(struct file_storage* fstorage)
 {
-    free((void*)fstorage->data);
+    /* write pending changes before the data goes away */
+    deferred_close(fstorage);
+
+    if (fstorage->mapped) {
+        osal_file_unmap(fstorage->data, fstorage->size);
+    }
+    else {
+        free((void*)fstorage->data);
+    }
     free((void*)fstorage->filename);
 }
 
@@ -128,6 +167,347 @@ static void file_storage_parent_save(void* storage, size_t start, size_t size)
     file_storage_save(fstorage, start, size);
 }
 
+/* Deferred saves.
+ * Games which write their save memory byte by byte would otherwise cause one file
+ * operation per byte on the emulation thread. Instead, save notifications put the
+ * storage on the dirty list, and a flush snapshots every dirty storage and writes
+ * each one in full on the workqueue with replace_file, so that a crash leaves either
+ * the previous or the new content on disk. Only one flush is in flight at a time.
+ * While emulating, snapshots are only taken on the emulation thread, so other
+ * threads request a flush which the next tick serves. */
+enum { DEFERRED_STORAGES_MAX = 16 };
+
+struct deferred_file
+{
+    struct file_storage* storage;
+    char* filename;
+    uint8_t* data;
+    size_t size;
+    file_status_t err;
+};
+
+struct deferred_flush
+{
+    struct work_struct work;
+    struct deferred_file files[DEFERRED_STORAGES_MAX];
+    size_t count;
+    unsigned int ticket;
+};
+
+static SDL_mutex* l_deferred_lock = NULL;
+static SDL_cond* l_deferred_done = NULL;
+static struct file_storage* l_dirty[DEFERRED_STORAGES_MAX];
+static size_t l_dirty_count = 0;
+static uint32_t l_dirty_since = 0;
+static unsigned int l_deferred_delay = 0;
+static struct deferred_flush l_flush;
+static int l_flush_busy = 0;
+static int l_emulating = 0;
+static unsigned long l_emulation_thread; /* SDL_threadID, which SDL 1.2 lacks */
+static unsigned int l_flush_requested = 0;
+static unsigned int l_flush_completed = 0;
+
+/* Records that every request up to ticket was served.
+ * Called with l_deferred_lock held. */
+static void deferred_complete(unsigned int ticket)
+{
+    if ((int)(ticket - l_flush_completed) > 0) {
+        l_flush_completed = ticket;
+    }
+    SDL_CondBroadcast(l_deferred_done);
+}
+
+static void deferred_flush_work(struct work_struct* work)
+{
+    struct deferred_flush* flush = container_of(work, struct deferred_flush, work);
+    size_t i;
+
+    for (i = 0; i < flush->count; ++i) {
+        flush->files[i].err = replace_file(flush->files[i].filename, flush->files[i].data, flush->files[i].size);
+    }
+
+    SDL_LockMutex(l_deferred_lock);
+    l_flush_busy = 0;
+    deferred_complete(flush->ticket);
+    SDL_UnlockMutex(l_deferred_lock);
+}
+
+/* Puts a storage on the dirty list. Called with l_deferred_lock held. */
+static int deferred_mark_dirty(struct file_storage* fstorage)
+{
+    if (fstorage->dirty) {
+        return 0;
+    }
+    if (l_dirty_count == DEFERRED_STORAGES_MAX) {
+        return -1;
+    }
+
+    if (l_dirty_count == 0) {
+        l_dirty_since = SDL_GetTicks();
+    }
+    fstorage->dirty = 1;
+    l_dirty[l_dirty_count++] = fstorage;
+    return 0;
+}
+
+/* Logs the outcome of the previous flush and releases its buffers. Storages
+ * which couldn't be written are marked dirty again so the next flush retries.
+ * Called with l_deferred_lock held and no flush in flight. */
+static void deferred_flush_release(void)
+{
+    size_t i;
+
+    for (i = 0; i < l_flush.count; ++i) {
+        struct deferred_file* file = &l_flush.files[i];
+
+        if (file->err != file_ok) {
+            DebugMessage(M64MSG_ERROR, "failed to write storage file '%s'", file->filename);
+            if (file->storage != NULL && deferred_mark_dirty(file->storage) != 0) {
+                DebugMessage(M64MSG_ERROR, "too many pending storage writes, '%s' won't be retried", file->filename);
+            }
+        }
+        free(file->filename);
+        free(file->data);
+    }
+    l_flush.count = 0;
+}
+
+/* Writes the pending changes of a storage which is about to be closed and
+ * forgets about it, so that a failed write doesn't keep a dangling pointer. */
+static void deferred_close(struct file_storage* fstorage)
+{
+    size_t i;
+
+    if (l_deferred_lock == NULL) {
+        return;
+    }
+
+    if (fstorage->dirty) {
+        file_storage_flush_deferred(1);
+    }
+
+    SDL_LockMutex(l_deferred_lock);
+
+    while (l_flush_busy) {
+        SDL_CondWait(l_deferred_done, l_deferred_lock);
+    }
+
+    for (i = 0; i < l_flush.count; ++i) {
+        if (l_flush.files[i].storage == fstorage) {
+            l_flush.files[i].storage = NULL;
+        }
+    }
+    for (i = 0; i < l_dirty_count; ++i) {
+        if (l_dirty[i] == fstorage) {
+            l_dirty[i] = l_dirty[--l_dirty_count];
+            break;
+        }
+    }
+    fstorage->dirty = 0;
+
+    SDL_UnlockMutex(l_deferred_lock);
+}
+
+int file_storage_deferred_init(void)
+{
+    l_deferred_lock = SDL_CreateMutex();
+    l_deferred_done = SDL_CreateCond();
+    if (l_deferred_lock == NULL || l_deferred_done == NULL) {
+        file_storage_deferred_shutdown();
+        return -1;
+    }
+
+    init_work(&l_flush.work, deferred_flush_work);
+    return 0;
+}
+
+void file_storage_deferred_shutdown(void)
+{
+    if (l_deferred_lock != NULL && l_deferred_done != NULL) {
+        file_storage_flush_deferred(1);
+    }
+
+    if (l_deferred_done != NULL) {
+        SDL_DestroyCond(l_deferred_done);
+        l_deferred_done = NULL;
+    }
+    if (l_deferred_lock != NULL) {
+        SDL_DestroyMutex(l_deferred_lock);
+        l_deferred_lock = NULL;
+    }
+}
+
+void file_storage_deferred_set_delay(unsigned int delay_ms)
+{
+    l_deferred_delay = delay_ms;
+}
+
+void file_storage_deferred_set_emulating(int emulating)
+{
+    if (l_deferred_lock == NULL) {
+        return;
+    }
+
+    SDL_LockMutex(l_deferred_lock);
+    l_emulating = emulating;
+    l_emulation_thread = SDL_ThreadID();
+    SDL_CondBroadcast(l_deferred_done);
+    SDL_UnlockMutex(l_deferred_lock);
+}
+
+/* Starts a flush once the oldest change is delay_ms old, or when another thread
+ * requested one. Called on every VI and while paused, on the emulation thread. */
+void file_storage_deferred_tick(void)
+{
+    int due;
+
+    if (l_deferred_lock == NULL) {
+        return;
+    }
+
+    SDL_LockMutex(l_deferred_lock);
+    due = (l_dirty_count != 0 && (uint32_t)(SDL_GetTicks() - l_dirty_since) >= l_deferred_delay)
+       || l_flush_requested != l_flush_completed;
+    SDL_UnlockMutex(l_deferred_lock);
+
+    if (due) {
+        file_storage_flush_deferred(0);
+    }
+}
+
+void file_storage_request_flush(int wait)
+{
+    unsigned int ticket;
+
+    if (l_deferred_lock == NULL) {
+        return;
+    }
+
+    SDL_LockMutex(l_deferred_lock);
+
+    /* e.g. from a frame callback */
+    if (SDL_ThreadID() == l_emulation_thread) {
+        SDL_UnlockMutex(l_deferred_lock);
+        file_storage_flush_deferred(wait);
+        return;
+    }
+
+    ticket = ++l_flush_requested;
+    while (wait && l_emulating && (int)(l_flush_completed - ticket) < 0) {
+        SDL_CondWait(l_deferred_done, l_deferred_lock);
+    }
+
+    if (l_emulating || (int)(l_flush_completed - ticket) >= 0) {
+        SDL_UnlockMutex(l_deferred_lock);
+        return;
+    }
+
+    /* nothing writes to the storages anymore, flush from this thread */
+    SDL_UnlockMutex(l_deferred_lock);
+    file_storage_flush_deferred(wait);
+}
+
+/* Writes all dirty storages. Without wait, nothing is done if a flush is already
+ * in flight (the next tick retries). With wait, returns once everything which was
+ * dirty on entry is on disk. */
+void file_storage_flush_deferred(int wait)
+{
+    size_t i;
+    unsigned int ticket;
+
+    if (l_deferred_lock == NULL) {
+        return;
+    }
+
+    SDL_LockMutex(l_deferred_lock);
+
+    while (wait && l_flush_busy) {
+        SDL_CondWait(l_deferred_done, l_deferred_lock);
+    }
+
+    if (l_flush_busy) {
+        SDL_UnlockMutex(l_deferred_lock);
+        return;
+    }
+
+    ticket = l_flush_requested;
+    if (l_dirty_count == 0) {
+        deferred_complete(ticket);
+        SDL_UnlockMutex(l_deferred_lock);
+        return;
+    }
+
+    deferred_flush_release();
+
+    /* the emulation thread may keep writing to the storages, but every
+     * write made after a snapshot marks the storage dirty again */
+    for (i = 0; i < l_dirty_count; ++i) {
+        struct file_storage* fstorage = l_dirty[i];
+        struct deferred_file* file = &l_flush.files[l_flush.count];
+
+        fstorage->dirty = 0;
+
+        file->storage = fstorage;
+        file->filename = strdup(fstorage->filename);
+        file->data = malloc(fstorage->size);
+        file->size = fstorage->size;
+        if (file->filename == NULL || file->data == NULL) {
+            DebugMessage(M64MSG_WARNING, "couldn't allocate memory to write storage file '%s'", fstorage->filename);
+            free(file->filename);
+            free(file->data);
+            continue;
+        }
+
+        memcpy(file->data, fstorage->data, file->size);
+        ++l_flush.count;
+    }
+    l_dirty_count = 0;
+
+    l_flush.ticket = ticket;
+    l_flush_busy = 1;
+    SDL_UnlockMutex(l_deferred_lock);
+
+    queue_work(&l_flush.work);
+
+    if (wait) {
+        SDL_LockMutex(l_deferred_lock);
+        while (l_flush_busy) {
+            SDL_CondWait(l_deferred_done, l_deferred_lock);
+        }
+        deferred_flush_release();
+        SDL_UnlockMutex(l_deferred_lock);
+    }
+}
+
+static void file_storage_deferred_save(void* storage, size_t start, size_t size)
+{
+    if (netplay_is_init() && netplay_get_controller(0) == -1)
+        return;
+
+    struct file_storage* fstorage = (struct file_storage*)storage;
+
+    if (l_deferred_lock == NULL) {
+        file_storage_save(storage, start, size);
+        return;
+    }
+
+    SDL_LockMutex(l_deferred_lock);
+
+    if (deferred_mark_dirty(fstorage) != 0) {
+        SDL_UnlockMutex(l_deferred_lock);
+        file_storage_save(storage, start, size);
+        return;
+    }
+
+    SDL_UnlockMutex(l_deferred_lock);
+}
+
+static void file_storage_parent_deferred_save(void* storage, size_t start, size_t size)
+{
+    struct file_storage* fstorage = (struct file_storage*)((struct file_storage*)storage)->filename;
+    file_storage_deferred_save(fstorage, start, size);
+}
+
 static void dummy_save(void* storage, size_t start, size_t size)
 {
     /* do nothing */
@@ -155,3 +535,17 @@ const struct storage_backend_interface g_isubfile_storage =
     file_storage_size,
     file_storage_parent_save
 };
+
+const struct storage_backend_interface g_ifile_storage_deferred =
+{
+    file_storage_data,
+    file_storage_size,
+    file_storage_deferred_save
+};
+
+const struct storage_backend_interface g_isubfile_storage_deferred =
+{
+    file_storage_data,
+    file_storage_size,
+    file_storage_parent_deferred_save
+};
@@ -31,15 +31,33 @@ struct file_storage
     size_t size;
     const char* filename;
     int first_access;
+    int mapped;
+    int dirty;
 };
 
 
 int open_file_storage(struct file_storage* storage, size_t size, const char* filename);
 int open_rom_file_storage(struct file_storage* storage, const char* filename);
+int open_mapped_file_storage(struct file_storage* storage, const char* filename);
 void close_file_storage(struct file_storage* storage);
 
+/* Deferred saves: g_ifile_storage_deferred and g_isubfile_storage_deferred only mark
+ * storages dirty. Dirty storages are written in full, replacing the previous files,
+ * on the workqueue once delay_ms have passed since their first change.
+ * file_storage_flush_deferred and file_storage_deferred_tick must be called from
+ * the emulation thread while emulating, other threads use file_storage_request_flush. */
+int file_storage_deferred_init(void);
+void file_storage_deferred_shutdown(void);
+void file_storage_deferred_set_delay(unsigned int delay_ms);
+void file_storage_deferred_set_emulating(int emulating);
+void file_storage_deferred_tick(void);
+void file_storage_flush_deferred(int wait);
+void file_storage_request_flush(int wait);
+
 extern const struct storage_backend_interface g_ifile_storage;
 extern const struct storage_backend_interface g_ifile_storage_ro;
 extern const struct storage_backend_interface g_isubfile_storage;
+extern const struct storage_backend_interface g_ifile_storage_deferred;
+extern const struct storage_backend_interface g_isubfile_storage_deferred;
 
 #endif
@@ -26,6 +26,7 @@
 #include "device/rcp/ri/ri_controller.h"
 #include "device/rcp/vi/vi_controller.h"
 #include "device/rdram/rdram.h"
+#include "main/benchmark.h"
 #include "main/rom.h"
 #include "plugin/plugin.h"
 
@@ -36,7 +37,9 @@ static void audio_plugin_set_frequency(void* aout, unsigned int frequency)
 
     ai->regs[AI_DACRATE_REG] = ai->vi->clock / frequency - 1;
 
+    benchmark_section_start(BENCHMARK_SECTION_AUDIO);
     audio.aiDacrateChanged(ROM_PARAMS.systemtype);
+    benchmark_section_end(BENCHMARK_SECTION_AUDIO);
 
     ai->regs[AI_DACRATE_REG] = saved_ai_dacrate;
 }
@@ -52,7 +55,9 @@ static void audio_plugin_push_samples(void* aout, const void* buffer, size_t siz
     ai->regs[AI_DRAM_ADDR_REG] = (uint32_t)((uint8_t*)buffer - (uint8_t*)ai->ri->rdram->dram);
     ai->regs[AI_LEN_REG] = (uint32_t)size;
 
+    benchmark_section_start(BENCHMARK_SECTION_AUDIO);
     audio.aiLenChanged();
+    benchmark_section_end(BENCHMARK_SECTION_AUDIO);
 
     ai->regs[AI_LEN_REG] = saved_ai_length;
     ai->regs[AI_DRAM_ADDR_REG] = saved_ai_dram;
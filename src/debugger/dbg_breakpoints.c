@@ -21,6 +21,8 @@
 
 #include <SDL.h>
 #include <SDL_thread.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
@@ -33,6 +35,184 @@
 int g_NumBreakpoints=0;
 m64p_breakpoint g_Breakpoints[BREAKPOINTS_MAX_NUMBER];
 
+/* Enabled breakpoints are indexed by access kind in static interval trees,
+ * rebuilt whenever a breakpoint changes. Execute breakpoints are also
+ * tracked in a bitmap of 4KB pages, so that the per-instruction check
+ * is a single bit test when no breakpoint is near. */
+enum { BPT_PAGE_SHIFT = 12 };
+enum { BPT_INDEX_EXEC, BPT_INDEX_READ, BPT_INDEX_WRITE, BPT_INDEX_COUNT };
+
+struct bpt_interval {
+    uint32_t start;
+    uint32_t end;
+    uint32_t max_end; /* largest end in the subtree rooted at this node */
+    int bpt;
+};
+
+/* implicit balanced tree over intervals sorted by start:
+ * the root of nodes [lo, hi) is at (lo + hi) / 2 */
+struct bpt_tree {
+    struct bpt_interval nodes[2 * BREAKPOINTS_MAX_NUMBER];
+    int count;
+};
+
+static const uint32_t l_index_flags[BPT_INDEX_COUNT] = {
+    M64P_BKP_FLAG_ENABLED | M64P_BKP_FLAG_EXEC,
+    M64P_BKP_FLAG_ENABLED | M64P_BKP_FLAG_READ,
+    M64P_BKP_FLAG_ENABLED | M64P_BKP_FLAG_WRITE
+};
+
+static struct bpt_tree l_trees[BPT_INDEX_COUNT];
+static struct bpt_tree l_old_exec_tree;
+static uint32_t l_exec_pages[(UINT32_C(1) << (32 - BPT_PAGE_SHIFT)) / 32];
+
+static int compare_intervals(const void* a, const void* b)
+{
+    const struct bpt_interval* x = (const struct bpt_interval*)a;
+    const struct bpt_interval* y = (const struct bpt_interval*)b;
+
+    if (x->start != y->start)
+        return (x->start < y->start) ? -1 : 1;
+    return x->bpt - y->bpt;
+}
+
+static uint32_t build_max_end(struct bpt_interval* nodes, int lo, int hi)
+{
+    int mid;
+    uint32_t max_end, sub;
+
+    if (lo >= hi)
+        return 0;
+
+    mid = lo + (hi - lo) / 2;
+    max_end = nodes[mid].end;
+
+    sub = build_max_end(nodes, lo, mid);
+    if (sub > max_end)
+        max_end = sub;
+    sub = build_max_end(nodes, mid + 1, hi);
+    if (sub > max_end)
+        max_end = sub;
+
+    nodes[mid].max_end = max_end;
+    return max_end;
+}
+
+static void add_interval(struct bpt_tree* tree, uint32_t start, uint32_t end, int bpt)
+{
+    tree->nodes[tree->count].start = start;
+    tree->nodes[tree->count].end = end;
+    tree->nodes[tree->count].bpt = bpt;
+    ++tree->count;
+}
+
+static void set_exec_pages(uint32_t start, uint32_t end)
+{
+    uint32_t page;
+
+    for (page = start >> BPT_PAGE_SHIFT; page <= (end >> BPT_PAGE_SHIFT); ++page)
+        l_exec_pages[page >> 5] |= UINT32_C(1) << (page & 31);
+}
+
+static int has_interval(const struct bpt_tree* tree, uint32_t start, uint32_t end)
+{
+    int i;
+
+    for (i = 0; i < tree->count; ++i)
+    {
+        if (tree->nodes[i].start == start && tree->nodes[i].end == end)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Recompiled code only checks execute breakpoints where they were set at
+ * compile time, so invalidate the ranges that were added or removed */
+static void invalidate_changed_exec_ranges(const struct bpt_tree* old_tree, const struct bpt_tree* new_tree)
+{
+    int i;
+
+    for (i = 0; i < old_tree->count; ++i)
+    {
+        if (!has_interval(new_tree, old_tree->nodes[i].start, old_tree->nodes[i].end))
+            debugger_invalidate_code(old_tree->nodes[i].start, old_tree->nodes[i].end);
+    }
+
+    for (i = 0; i < new_tree->count; ++i)
+    {
+        if (!has_interval(old_tree, new_tree->nodes[i].start, new_tree->nodes[i].end))
+            debugger_invalidate_code(new_tree->nodes[i].start, new_tree->nodes[i].end);
+    }
+}
+
+static void update_breakpoint_index(void)
+{
+    int i, k;
+
+    l_old_exec_tree = l_trees[BPT_INDEX_EXEC];
+    memset(l_exec_pages, 0, sizeof(l_exec_pages));
+
+    for (k = 0; k < BPT_INDEX_COUNT; ++k)
+    {
+        struct bpt_tree* tree = &l_trees[k];
+        tree->count = 0;
+
+        for (i = 0; i < g_NumBreakpoints; ++i)
+        {
+            const m64p_breakpoint* bpt = &g_Breakpoints[i];
+
+            if ((bpt->flags & l_index_flags[k]) != l_index_flags[k])
+                continue;
+
+            /* wrapping ranges are split at the end of the address space */
+            if (bpt->endaddr < bpt->address)
+            {
+                add_interval(tree, bpt->address, UINT32_C(0xFFFFFFFF), i);
+                add_interval(tree, 0, bpt->endaddr, i);
+            }
+            else
+            {
+                add_interval(tree, bpt->address, bpt->endaddr, i);
+            }
+        }
+
+        qsort(tree->nodes, tree->count, sizeof(tree->nodes[0]), compare_intervals);
+        build_max_end(tree->nodes, 0, tree->count);
+    }
+
+    for (i = 0; i < l_trees[BPT_INDEX_EXEC].count; ++i)
+        set_exec_pages(l_trees[BPT_INDEX_EXEC].nodes[i].start, l_trees[BPT_INDEX_EXEC].nodes[i].end);
+
+    invalidate_changed_exec_ranges(&l_old_exec_tree, &l_trees[BPT_INDEX_EXEC]);
+}
+
+/* Returns the lowest breakpoint number overlapping [start, end], or best */
+static int query_tree(const struct bpt_interval* nodes, int lo, int hi, uint32_t start, uint32_t end, int best)
+{
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        /* no interval of this subtree reaches start */
+        if (nodes[mid].max_end < start)
+            break;
+
+        best = query_tree(nodes, lo, mid, start, end, best);
+
+        /* this node and its right subtree begin after end */
+        if (nodes[mid].start > end)
+            break;
+
+        if (nodes[mid].end >= start && (best == -1 || nodes[mid].bpt < best))
+            best = nodes[mid].bpt;
+
+        lo = mid + 1;
+    }
+
+    return best;
+}
+
 int add_breakpoint(struct memory* mem, uint32_t address)
 {
     if (g_NumBreakpoints == BREAKPOINTS_MAX_NUMBER) {
@@ -45,7 +225,10 @@ int add_breakpoint(struct memory* mem, uint32_t address)
 
     enable_breakpoint(mem, g_NumBreakpoints);
 
-    return g_NumBreakpoints++;
+    g_NumBreakpoints++;
+    update_breakpoint_index();
+
+    return g_NumBreakpoints - 1;
 }
 
 int add_breakpoint_struct(struct memory* mem, m64p_breakpoint *newbp)
@@ -62,7 +245,10 @@ int add_breakpoint_struct(struct memory* mem, m64p_breakpoint *newbp)
         enable_breakpoint(mem, g_NumBreakpoints);
     }
 
-    return g_NumBreakpoints++;
+    g_NumBreakpoints++;
+    update_breakpoint_index();
+
+    return g_NumBreakpoints - 1;
 }
 
 void enable_breakpoint(struct memory* mem, int bpt)
@@ -83,6 +269,7 @@ void enable_breakpoint(struct memory* mem, int bpt)
     }
 
     BPT_SET_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED);
+    update_breakpoint_index();
 }
 
 void disable_breakpoint(struct memory* mem, int bpt)
@@ -91,6 +278,7 @@ void disable_breakpoint(struct memory* mem, int bpt)
     uint64_t bptAddr;
 
     BPT_CLEAR_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED);
+    update_breakpoint_index();
 
     if (BPT_CHECK_FLAG((*curBpt), M64P_BKP_FLAG_READ)) {
         for (bptAddr = curBpt->address; bptAddr <= ((unsigned long)(curBpt->endaddr | 0xFFFF)); bptAddr+=0x10000)
@@ -118,6 +306,7 @@ void remove_breakpoint_by_num(struct memory* mem, int bpt)
         g_Breakpoints[curBpt-1]=g_Breakpoints[curBpt];
 
     g_NumBreakpoints--;
+    update_breakpoint_index();
 }
 
 void remove_breakpoint_by_address(struct memory* mem, uint32_t address)
@@ -142,9 +331,11 @@ void replace_breakpoint_num(struct memory* mem, int bpt, m64p_breakpoint *copyof
         BPT_CLEAR_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED);
         enable_breakpoint(mem, bpt);
     }
+
+    update_breakpoint_index();
 }
 
-int lookup_breakpoint(uint32_t address, uint32_t size, uint32_t flags)
+static int lookup_breakpoint_linear(uint32_t address, uint32_t size, uint32_t flags)
 {
     int i;
     uint64_t endaddr = ((uint64_t)address) + ((uint64_t)size) - 1;
@@ -170,11 +361,43 @@ int lookup_breakpoint(uint32_t address, uint32_t size, uint32_t flags)
     return -1;
 }
 
+int lookup_breakpoint(uint32_t address, uint32_t size, uint32_t flags)
+{
+    int k;
+    uint64_t endaddr = ((uint64_t)address) + ((uint64_t)size) - 1;
+
+    for (k = 0; k < BPT_INDEX_COUNT; ++k)
+    {
+        if (flags == l_index_flags[k] && size != 0)
+        {
+            if (endaddr > UINT32_C(0xFFFFFFFF))
+                endaddr = UINT32_C(0xFFFFFFFF);
+
+            return query_tree(l_trees[k].nodes, 0, l_trees[k].count, address, (uint32_t)endaddr, -1);
+        }
+    }
+
+    /* other flag combinations are not indexed */
+    return lookup_breakpoint_linear(address, size, flags);
+}
+
 int check_breakpoints(uint32_t address)
 {
+    uint32_t page = address >> BPT_PAGE_SHIFT;
+
+    if (!(l_exec_pages[page >> 5] & (UINT32_C(1) << (page & 31))))
+        return -1;
+
     return lookup_breakpoint(address, 1, M64P_BKP_FLAG_ENABLED | M64P_BKP_FLAG_EXEC);
 }
 
+int check_breakpoints_in_page(uint32_t address)
+{
+    uint32_t page = address >> BPT_PAGE_SHIFT;
+
+    return (l_exec_pages[page >> 5] >> (page & 31)) & 1;
+}
+
 
 int check_breakpoints_on_mem_access(uint32_t pc, uint32_t address, uint32_t size, uint32_t flags)
 {
@@ -27,6 +27,8 @@
 #include "dbg_breakpoints.h"
 #include "dbg_debugger.h"
 #include "dbg_memory.h"
+#include "device/device.h"
+#include "main/main.h"
 
 #ifdef DBG
 
@@ -106,4 +108,25 @@ void debugger_step()
     SDL_SemPost(sem_pending_steps);
 }
 
+void debugger_invalidate_code(uint32_t start, uint32_t end)
+// Drop recompiled code covering [start, end] so that the dynarecs
+// insert (or remove) their execute breakpoint traps on next use.
+{
+    uint64_t size;
+
+    if (!g_DebuggerActive)
+        return;
+
+    start &= ~UINT32_C(0xfff);
+    size = (uint64_t)(end | UINT32_C(0xfff)) - start + 1;
+
+    /* unchanged code must not be revived without its traps */
+    ++g_dev.r4300.cached_interp.hash_seed;
+
+    if (size > UINT32_C(0x800000))
+        invalidate_r4300_cached_code(&g_dev.r4300, 0, 0);
+    else
+        invalidate_r4300_cached_code(&g_dev.r4300, start, (size_t)size);
+}
+
 #endif
@@ -23,6 +23,8 @@
 #ifndef __DBG_DEBUGGER_H__
 #define __DBG_DEBUGGER_H__
 
+#include <stdint.h>
+
 #include "api/m64p_types.h"
 
 extern int g_DebuggerActive;  /* True if the debugger is running */
@@ -38,6 +40,7 @@ void init_debugger(void);
 void update_debugger(uint32_t pc);
 void destroy_debugger(void);
 void debugger_step(void);
+void debugger_invalidate_code(uint32_t start, uint32_t end);
 
 #endif /* __DBG_DEBUGGER_H__ */
 
@@ -25,6 +25,7 @@
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
 
+#include "device/memory/dma_copy.h"
 #include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
 #include "device/rcp/pi/pi_controller.h"
@@ -101,9 +102,7 @@ unsigned int cart_rom_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr,
 
     if (cart_addr + length < cart_rom->rom_size)
     {
-        for(i = 0; i < length; ++i) {
-            dram[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
-        }
+        dma_copy(dram, dram_addr, mem, cart_addr, length);
     }
     else
     {
@@ -111,10 +110,8 @@ unsigned int cart_rom_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr,
             ? 0
             : cart_rom->rom_size - cart_addr;
 
-        for (i = 0; i < diff; ++i) {
-            dram[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
-        }
-        for (; i < length; ++i) {
+        dma_copy(dram, dram_addr, mem, cart_addr, diff);
+        for (i = diff; i < length; ++i) {
             dram[(dram_addr+i)^S8] = 0;
         }
     }
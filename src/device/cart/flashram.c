@@ -27,6 +27,7 @@
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
 #include "backends/api/storage_backend.h"
+#include "device/memory/dma_copy.h"
 #include "device/memory/memory.h"
 
 #define __STDC_FORMAT_MACROS
@@ -183,7 +184,6 @@ void write_flashram(void* opaque, uint32_t address, uint32_t value, uint32_t mas
 
 unsigned int flashram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
 {
-    size_t i;
     struct flashram* flashram = (struct flashram*)opaque;
     const uint8_t* mem = flashram->istorage->data(flashram->storage);
 
@@ -207,9 +207,7 @@ unsigned int flashram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr,
         }
 
         /* do actual DMA */
-        for(i = 0; i < length; ++i) {
-            dram[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
-        }
+        dma_copy(dram, dram_addr, mem, cart_addr, length);
     }
     else {
         /* other accesses are not implemented */
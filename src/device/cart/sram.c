@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "backends/api/storage_backend.h"
+#include "device/memory/dma_copy.h"
 #include "device/memory/memory.h"
 
 #define SRAM_ADDR_MASK UINT32_C(0x0000ffff)
@@ -44,15 +45,12 @@ void init_sram(struct sram* sram,
 
 unsigned int sram_dma_read(void* opaque, const uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
 {
-    size_t i;
     struct sram* sram = (struct sram*)opaque;
     uint8_t* mem = sram->istorage->data(sram->storage);
 
     cart_addr &= SRAM_ADDR_MASK;
 
-    for (i = 0; i < length; ++i) {
-        mem[(cart_addr+i)^S8] = dram[(dram_addr+i)^S8];
-    }
+    dma_copy(mem, cart_addr, dram, dram_addr, length);
 
     sram->istorage->save(sram->storage, cart_addr, length);
 
@@ -61,15 +59,12 @@ unsigned int sram_dma_read(void* opaque, const uint8_t* dram, uint32_t dram_addr
 
 unsigned int sram_dma_write(void* opaque, uint8_t* dram, uint32_t dram_addr, uint32_t cart_addr, uint32_t length)
 {
-    size_t i;
     struct sram* sram = (struct sram*)opaque;
     const uint8_t* mem = sram->istorage->data(sram->storage);
 
     cart_addr &= SRAM_ADDR_MASK;
 
-    for (i = 0; i < length; ++i) {
-        dram[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
-    }
+    dma_copy(dram, dram_addr, mem, cart_addr, length);
 
     return /* length / 8 */0x1000;
 }
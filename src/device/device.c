@@ -185,6 +185,13 @@ void init_device(struct device* dev,
             emumode, count_per_op, count_per_op_denom_pot, no_compiled_jump, randomize_interrupt, start_address);
     init_rdp(&dev->dp, &dev->sp, &dev->mi, &dev->mem, &dev->rdram, &dev->r4300);
     init_rsp(&dev->sp, mem_base_u32(base, MM_RSP_MEM), &dev->mi, &dev->dp, &dev->ri);
+
+    /* memories which interpreters can access without going through their handlers */
+    map_direct_range(&dev->mem, MM_RDRAM_DRAM, MM_RDRAM_DRAM + (uint32_t)dram_size - 1,
+                     mem_base_u32(base, MM_RDRAM_DRAM), UINT32_C(0xffffffff), &mappings[1].handler);
+    map_direct_range(&dev->mem, MM_RSP_MEM, MM_RSP_MEM + 0xffff,
+                     mem_base_u32(base, MM_RSP_MEM), SP_MEM_SIZE - 1, &mappings[3].handler);
+
     init_ai(&dev->ai, &dev->mi, &dev->ri, &dev->vi, aout, iaout, dma_modifier);
     init_mi(&dev->mi, &dev->r4300);
     init_pi(&dev->pi,
@@ -0,0 +1,130 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - dma_copy.c                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "dma_copy.h"
+
+#include <string.h>
+
+#include "osal/preproc.h"
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define DMA_COPY_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define DMA_COPY_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #include <arm_neon.h>
+  #define DMA_COPY_NEON
+#endif
+
+/* Fills count words of dst, each made of the last 4-shift bytes of a
+ * source word followed by the first shift bytes of the next one.
+ * Source words are read as host integers, which holds their big endian
+ * value, so the bytes move with plain shifts. */
+static void copy_shifted_words(uint32_t* dst, const uint32_t* src, size_t count, unsigned int shift)
+{
+    const unsigned int left = 8 * shift;
+    const unsigned int right = 32 - left;
+    size_t i = 0;
+
+#if defined(DMA_COPY_AVX2)
+    {
+        const __m128i l = _mm_cvtsi32_si128((int)left);
+        const __m128i r = _mm_cvtsi32_si128((int)right);
+
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i v0 = _mm256_loadu_si256((const __m256i*)(src + i));
+            __m256i v1 = _mm256_loadu_si256((const __m256i*)(src + i + 1));
+            _mm256_storeu_si256((__m256i*)(dst + i),
+                _mm256_or_si256(_mm256_sll_epi32(v0, l), _mm256_srl_epi32(v1, r)));
+        }
+    }
+#elif defined(DMA_COPY_SSE2)
+    {
+        const __m128i l = _mm_cvtsi32_si128((int)left);
+        const __m128i r = _mm_cvtsi32_si128((int)right);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i v0 = _mm_loadu_si128((const __m128i*)(src + i));
+            __m128i v1 = _mm_loadu_si128((const __m128i*)(src + i + 1));
+            _mm_storeu_si128((__m128i*)(dst + i),
+                _mm_or_si128(_mm_sll_epi32(v0, l), _mm_srl_epi32(v1, r)));
+        }
+    }
+#elif defined(DMA_COPY_NEON)
+    {
+        const int32x4_t l = vdupq_n_s32((int32_t)left);
+        const int32x4_t r = vdupq_n_s32(-(int32_t)right);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            uint32x4_t v0 = vld1q_u32(src + i);
+            uint32x4_t v1 = vld1q_u32(src + i + 1);
+            vst1q_u32(dst + i, vorrq_u32(vshlq_u32(v0, l), vshlq_u32(v1, r)));
+        }
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        dst[i] = (src[i] << left) | (src[i + 1] >> right);
+    }
+}
+
+void dma_copy(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr, size_t length)
+{
+#if S8 == 0
+    memcpy(dst + dst_addr, src + src_addr, length);
+#else
+    size_t i = 0;
+
+    /* bytes up to the first whole destination word */
+    for (; i < length && ((dst_addr + i) & 3) != 0; ++i) {
+        dst[(dst_addr+i)^S8] = src[(src_addr+i)^S8];
+    }
+
+    size_t words = (length - i) / 4;
+
+    if (words != 0)
+    {
+        uint32_t d = dst_addr + (uint32_t)i;
+        uint32_t s = src_addr + (uint32_t)i;
+
+        if ((s & 3) == 0) {
+            /* same alignment: the word layout is the same on both sides */
+            memcpy(dst + d, src + s, words * 4);
+        }
+        else {
+            copy_shifted_words((uint32_t*)(dst + d), (const uint32_t*)(src + (s & ~UINT32_C(3))), words, s & 3);
+        }
+
+        i += words * 4;
+    }
+
+    /* remaining bytes of the last destination word */
+    for (; i < length; ++i) {
+        dst[(dst_addr+i)^S8] = src[(src_addr+i)^S8];
+    }
+#endif
+}
@@ -1,7 +1,7 @@
 /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
- *   Mupen64plus - instr_counters.h                                        *
+ *   Mupen64plus - dma_copy.h                                              *
  *   Mupen64Plus homepage: https://mupen64plus.org/                        *
- *   Copyright (C) 2002 Hacktarux                                          *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
  *                                                                         *
  *   This program is free software; you can redistribute it and/or modify  *
  *   it under the terms of the GNU General Public License as published by  *
@@ -19,11 +19,20 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-#ifndef M64P_DEVICE_R4300_INSTR_COUNTERS_H
-#define M64P_DEVICE_R4300_INSTR_COUNTERS_H
+#ifndef M64P_DEVICE_MEMORY_DMA_COPY_H
+#define M64P_DEVICE_MEMORY_DMA_COPY_H
 
-extern unsigned int instr_count[132];
+#include <stddef.h>
+#include <stdint.h>
 
-void instr_counters_print(void);
+/* Copies length bytes between two memories holding big endian data as
+ * host order 32-bit words, like RDRAM, SP memory and the cart ROM.
+ * This is the same as
+ *
+ *   dst[(dst_addr+i)^S8] = src[(src_addr+i)^S8]   for i in [0, length)
+ *
+ * but whole words are moved at once, with the bytes shifted across words
+ * when the two addresses are not equally aligned. */
+void dma_copy(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr, size_t length);
 
-#endif /* M64P_DEVICE_R4300_INSTR_COUNTERS_H */
+#endif
@@ -27,6 +27,7 @@
 #include "device/device.h"
 #include "device/rcp/rsp/rsp_core.h"
 #include "device/pif/pif.h"
+#include "osal/files.h"
 
 #ifdef DBG
 #include <string.h>
@@ -46,6 +47,8 @@
 #include <malloc.h>
 #endif
 
+static void update_fast_region(struct memory* mem, uint16_t region);
+
 #ifdef DBG
 enum
 {
@@ -93,6 +96,7 @@ void activate_memory_break_read(struct memory* mem, uint32_t address)
     if (!(*bp_check & (BP_CHECK_READ | BP_CHECK_WRITE))) {
         *saved_handler = *handler;
         *handler = *dbg_handler;
+        update_fast_region(mem, region);
     }
 
     /* activate bp read */
@@ -112,6 +116,7 @@ void deactivate_memory_break_read(struct memory* mem, uint32_t address)
     /* if neither read nor write bp is active, restore handler */
     if (!(*bp_check & (BP_CHECK_READ | BP_CHECK_WRITE))) {
         *handler = *saved_handler;
+        update_fast_region(mem, region);
     }
 }
 
@@ -127,6 +132,7 @@ void activate_memory_break_write(struct memory* mem, uint32_t address)
     if (!(*bp_check & (BP_CHECK_READ | BP_CHECK_WRITE))) {
         *saved_handler = *handler;
         *handler = *dbg_handler;
+        update_fast_region(mem, region);
     }
 
     /* activate bp write */
@@ -146,6 +152,7 @@ void deactivate_memory_break_write(struct memory* mem, uint32_t address)
     /* if neither read nor write bp is active, restore handler */
     if (!(*bp_check & (BP_CHECK_READ | BP_CHECK_WRITE))) {
         *handler = *saved_handler;
+        update_fast_region(mem, region);
     }
 }
 
@@ -176,6 +183,7 @@ void init_memory(struct memory* mem,
 #endif
 
     mem->base = base;
+    mem->direct_count = 0;
 
     for(m = 0; m < mappings_count; ++m) {
         apply_mem_mapping(mem, &mappings[m]);
@@ -204,6 +212,8 @@ static void map_region(struct memory* mem,
         (void)type;
         mem->handlers[region] = *handler;
     }
+
+    update_fast_region(mem, region);
 }
 
 void apply_mem_mapping(struct memory* mem, const struct mem_mapping* mapping)
@@ -217,6 +227,83 @@ void apply_mem_mapping(struct memory* mem, const struct mem_mapping* mapping)
     }
 }
 
+static int same_handler(const struct mem_handler* h1, const struct mem_handler* h2)
+{
+    return h1->opaque == h2->opaque
+        && h1->read32 == h2->read32
+        && h1->write32 == h2->write32;
+}
+
+/* A region is accessed directly only if it is entirely covered by
+ * a direct range and still served by the handler of that range */
+static void update_fast_region(struct memory* mem, uint16_t region)
+{
+    size_t i;
+    uint32_t begin = (uint32_t)region << 16;
+    uint32_t end = begin + 0xffff;
+
+    if (region >= MEM_FAST_REGIONS) {
+        return;
+    }
+
+    mem->fast[region].mem = NULL;
+    mem->fast[region].mask = 0;
+
+    for (i = 0; i < mem->direct_count; ++i) {
+        const struct mem_direct_range* range = &mem->direct[i];
+
+        if (begin < range->begin || end > range->end
+         || !same_handler(&mem->handlers[region], &range->handler)) {
+            continue;
+        }
+
+        mem->fast[region].mem = range->mem + (((begin - range->begin) & range->mirror_mask) >> 2);
+        mem->fast[region].mask = range->mirror_mask & 0xffff;
+        break;
+    }
+}
+
+void map_direct_range(struct memory* mem, uint32_t begin, uint32_t end,
+                      uint32_t* host_mem, uint32_t mirror_mask,
+                      const struct mem_handler* handler)
+{
+    size_t i;
+    struct mem_direct_range* range;
+
+    if (mem->direct_count >= MEM_DIRECT_RANGES_MAX) {
+        DebugMessage(M64MSG_WARNING, "Too many direct memory ranges, %08x-%08x will use slow path", begin, end);
+        return;
+    }
+
+    range = &mem->direct[mem->direct_count++];
+    range->begin = begin;
+    range->end = end;
+    range->mem = host_mem;
+    range->mirror_mask = mirror_mask;
+    range->handler = *handler;
+
+    for (i = begin >> 16; i <= (end >> 16); ++i) {
+        update_fast_region(mem, (uint16_t)i);
+    }
+}
+
+void unmap_direct_range(struct memory* mem, uint32_t begin, uint32_t end)
+{
+    size_t i, j;
+
+    for (i = 0, j = 0; i < mem->direct_count; ++i) {
+        if (mem->direct[i].begin == begin && mem->direct[i].end == end) {
+            continue;
+        }
+        mem->direct[j++] = mem->direct[i];
+    }
+    mem->direct_count = j;
+
+    for (i = begin >> 16; i <= (end >> 16); ++i) {
+        update_fast_region(mem, (uint16_t)i);
+    }
+}
+
 /* For paraLLEl-RDP which needs to import RDRAM as a host pointer with potentially 64k of alignment. */
 enum { MB_RDRAM_DRAM_ALIGNMENT_REQUIREMENT = 64 * 1024 };
 
@@ -241,16 +328,21 @@ void* init_mem_base(void)
 {
     void* mem_base;
 
-    /* First try the full mem base alloc */
+    /* First try the full mem base alloc.
+     * Outside of Windows the mem base is a mapping owned by the core,
+     * so that the cartridge ROM can be replaced by a file mapping. */
 #ifdef _WIN32
     mem_base = _aligned_malloc(MB_MAX_SIZE_FULL, MB_RDRAM_DRAM_ALIGNMENT_REQUIREMENT);
 #else
-    if (posix_memalign(&mem_base, MB_RDRAM_DRAM_ALIGNMENT_REQUIREMENT, MB_MAX_SIZE_FULL) != 0)
-        mem_base = NULL;
+    mem_base = osal_mem_map(MB_MAX_SIZE_FULL, MB_RDRAM_DRAM_ALIGNMENT_REQUIREMENT);
 #endif
     if (mem_base == NULL) {
         /* if it failed, try the compressed mem base alloc */
+#ifdef _WIN32
         mem_base = malloc(MB_MAX_SIZE);
+#else
+        mem_base = osal_mem_map(MB_MAX_SIZE, MB_RDRAM_DRAM_ALIGNMENT_REQUIREMENT);
+#endif
         if (mem_base != NULL) {
             /* Compressed mem base mode has LSB = 1 */
             assert(MEM_BASE_MODE(mem_base) == 0);
@@ -273,8 +365,10 @@ void release_mem_base(void* mem_base)
     if (MEM_BASE_MODE(mem_base) == 0)
         _aligned_free(MEM_BASE_PTR(mem_base));
     else
-#endif
         free(MEM_BASE_PTR(mem_base));
+#else
+    osal_mem_unmap(MEM_BASE_PTR(mem_base), (MEM_BASE_MODE(mem_base) == 0) ? MB_MAX_SIZE_FULL : MB_MAX_SIZE);
+#endif
 }
 
 uint32_t* mem_base_u32(void* mem_base, uint32_t address)
@@ -49,11 +49,38 @@ struct mem_mapping
     struct mem_handler handler;
 };
 
+/* Fast path for regions directly backed by host memory.
+ * Physical memory is split in 64KiB regions, each one pointing either to
+ * the host memory backing it or to NULL when accesses must go through the
+ * region handler. mask selects the offset within the region so that small
+ * mirrored memories (SP DMEM/IMEM) can be mapped too. */
+enum { MEM_FAST_REGIONS = 0x2000 };
+enum { MEM_DIRECT_RANGES_MAX = 4 };
+
+struct mem_fast_region
+{
+    uint32_t* mem;
+    uint32_t mask;
+};
+
+struct mem_direct_range
+{
+    uint32_t begin;
+    uint32_t end;       /* inclusive */
+    uint32_t* mem;
+    uint32_t mirror_mask;
+    struct mem_handler handler;
+};
+
 struct memory
 {
     struct mem_handler handlers[0x10000];
     void* base;
 
+    struct mem_fast_region fast[MEM_FAST_REGIONS];
+    struct mem_direct_range direct[MEM_DIRECT_RANGES_MAX];
+    size_t direct_count;
+
 #ifdef DBG
     int memtype[0x10000];
     unsigned char bp_checks[0x10000];
@@ -87,8 +114,37 @@ static osal_inline void mem_write32(const struct mem_handler* handler, uint32_t
     handler->write32(handler->opaque, address, value, mask);
 }
 
+/* Returns the host memory backing a physical address,
+ * or NULL if the access must go through the region handler */
+static osal_inline uint32_t* mem_fast_ptr(const struct memory* mem, uint32_t address)
+{
+    const struct mem_fast_region* region;
+
+    if (address >= ((uint32_t)MEM_FAST_REGIONS << 16)) {
+        return NULL;
+    }
+
+    region = &mem->fast[address >> 16];
+    if (region->mem == NULL) {
+        return NULL;
+    }
+
+    return region->mem + ((address & region->mask) >> 2);
+}
+
 void apply_mem_mapping(struct memory* mem, const struct mem_mapping* mapping);
 
+/* Declare [begin, end] as backed by host memory while it is served by handler.
+ * Regions are only accessed directly as long as handler stays mapped there,
+ * so remapping (framebuffer protection, debugger breakpoints, ...) falls back
+ * to the slow path automatically. */
+void map_direct_range(struct memory* mem, uint32_t begin, uint32_t end,
+                      uint32_t* host_mem, uint32_t mirror_mask,
+                      const struct mem_handler* handler);
+
+/* Send accesses to [begin, end] through the handlers again */
+void unmap_direct_range(struct memory* mem, uint32_t begin, uint32_t end);
+
 void* init_mem_base(void);
 void release_mem_base(void* mem_base);
 uint32_t* mem_base_u32(void* mem_base, uint32_t address);
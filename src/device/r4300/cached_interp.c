@@ -29,12 +29,17 @@
 #include <inttypes.h>
 #include <string.h>
 
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
 #include "api/callbacks.h"
 #include "api/debugger.h"
 #include "api/m64p_types.h"
 #include "device/r4300/r4300_core.h"
 #include "device/r4300/idec.h"
+#include "main/benchmark.h"
 #include "main/main.h"
+#include "main/rsp_thread.h"
 #include "osal/preproc.h"
 
 #ifdef DBG
@@ -747,6 +752,62 @@ size_t get_block_memsize(const struct precomp_block *block)
     return ((length+1)+(length>>2)) * sizeof(struct precomp_instr);
 }
 
+/* Hash of the words the translations of a page may be decoded from,
+ * including the ones read past its end. Returns 0 for pages mapped
+ * through the TLB, which can change without being written. */
+uint64_t get_block_hash(struct r4300_core* r4300, const struct precomp_block* block)
+{
+    if ((block->start & UINT32_C(0xc0000000)) != UINT32_C(0x80000000)) {
+        return 0;
+    }
+
+    const uint32_t* iw = fast_mem_access(r4300, block->start);
+    if (iw == NULL) {
+        return 0;
+    }
+
+    int length = get_block_length(block);
+    uint64_t hash = XXH3_64bits_withSeed(iw, (length + (length >> 2)) * sizeof(*iw), r4300->cached_interp.hash_seed);
+
+    return (hash != 0) ? hash : 1;
+}
+
+/* Marks an invalidated page valid again, keeping its translation, if it
+ * still holds the code it was translated from. Returns 0 if the
+ * translation has to be reset instead. */
+int revive_block(struct r4300_core* r4300, struct precomp_block* block)
+{
+    struct cached_interp* const cinterp = &r4300->cached_interp;
+
+    if (block->block == NULL || block->xxhash == 0 || block->xxhash != get_block_hash(r4300, block)) {
+        return 0;
+    }
+
+    if (cinterp->invalid_code[block->start >> 12]) {
+        cinterp->invalid_code[block->start >> 12] = 0;
+        ++cinterp->revived_pages;
+    }
+
+    uint32_t alt_addr = block->start ^ UINT32_C(0x20000000);
+
+    if (cinterp->invalid_code[alt_addr >> 12]) {
+        cinterp->init_block(r4300, alt_addr);
+    }
+
+    return 1;
+}
+
+void report_block_reuse(const struct cached_interp* cinterp)
+{
+    DebugMessage(M64MSG_INFO, "Invalidated pages: %u revived unchanged, %u recompiled",
+        cinterp->revived_pages, cinterp->recompiled_pages);
+
+    if (g_benchmark.enabled) {
+        benchmark_set_counter("pages_revived", cinterp->revived_pages);
+        benchmark_set_counter("pages_recompiled", cinterp->recompiled_pages);
+    }
+}
+
 void cached_interp_init_block(struct r4300_core* r4300, uint32_t address)
 {
     int i, length;
@@ -759,10 +820,15 @@ void cached_interp_init_block(struct r4300_core* r4300, uint32_t address)
         (*block)->block = NULL;
         (*block)->start = address & ~UINT32_C(0xfff);
         (*block)->end = (address & ~UINT32_C(0xfff)) + 0x1000;
+        (*block)->xxhash = 0;
     }
 
     struct precomp_block* b = *block;
 
+    if (revive_block(r4300, b)) {
+        return;
+    }
+
     length = get_block_length(b);
 
 #ifdef DBG
@@ -781,6 +847,12 @@ void cached_interp_init_block(struct r4300_core* r4300, uint32_t address)
 
         memset(b->block, 0, memsize);
     }
+    else
+    {
+        ++r4300->cached_interp.recompiled_pages;
+    }
+
+    b->xxhash = get_block_hash(r4300, b);
 
     /* reset block instructions (addr + ops) */
     for (i = 0; i < length; ++i)
@@ -836,12 +908,15 @@ void cached_interp_recompile_block(struct r4300_core* r4300, const uint32_t* iw,
     int block_start_in_tlb = ((block->start & UINT32_C(0xc0000000)) != UINT32_C(0x80000000));
     int block_not_in_tlb = (block->start >= UINT32_C(0xc0000000) || block->end < UINT32_C(0x80000000));
 
+    benchmark_section_start(BENCHMARK_SECTION_COMPILER);
+
     length = get_block_length(block);
     length2 = length - 2 + (length >> 2);
 
-    /* reset xxhash */
-    block->xxhash = 0;
-
+    /* code decoded from words changed since the page was reset can't be revived */
+    if (block->xxhash != 0 && block->xxhash != get_block_hash(r4300, block)) {
+        block->xxhash = 0;
+    }
 
     for (i = (func & 0xFFF) / 4, finished = 0; finished != 2; ++i)
     {
@@ -894,6 +969,8 @@ void cached_interp_recompile_block(struct r4300_core* r4300, const uint32_t* iw,
 #ifdef DBG
     DebugMessage(M64MSG_INFO, "block recompiled (%" PRIX32 "-%" PRIX32 ")", func, block->start+i*4);
 #endif
+
+    benchmark_section_end(BENCHMARK_SECTION_COMPILER);
 }
 
 void cached_interpreter_jump_to(struct r4300_core* r4300, uint32_t address)
@@ -927,6 +1004,9 @@ void init_blocks(struct cached_interp* cinterp)
         cinterp->invalid_code[i] = 1;
         cinterp->blocks[i] = NULL;
     }
+
+    cinterp->revived_pages = 0;
+    cinterp->recompiled_pages = 0;
 }
 
 void free_blocks(struct cached_interp* cinterp)
@@ -38,6 +38,10 @@ enum r4300_opcode r4300_decode(struct precomp_instr* inst, struct r4300_core* r4
 int get_block_length(const struct precomp_block *block);
 size_t get_block_memsize(const struct precomp_block *block);
 
+uint64_t get_block_hash(struct r4300_core* r4300, const struct precomp_block* block);
+int revive_block(struct r4300_core* r4300, struct precomp_block* block);
+void report_block_reuse(const struct cached_interp* cinterp);
+
 void cached_interp_init_block(struct r4300_core* r4300, uint32_t address);
 void cached_interp_free_block(struct precomp_block* block);
 
@@ -140,31 +140,27 @@ enum r4300_cp0_registers
 
 
 
-enum { INTERRUPT_NODES_POOL_CAPACITY = 16 };
+/* One deadline slot per event type (types are single bit flags) */
+enum { INTERRUPT_EVENT_SLOTS_COUNT = 16 };
+enum { INTERRUPT_SLOT_NONE = -1 };
 
-struct interrupt_event
+struct interrupt_slot
 {
     int type;
     unsigned int count;
 };
 
-struct node
-{
-    struct interrupt_event data;
-    struct node *next;
-};
-
-struct pool
-{
-    struct node nodes [INTERRUPT_NODES_POOL_CAPACITY];
-    struct node* stack[INTERRUPT_NODES_POOL_CAPACITY];
-    size_t index;
-};
-
+/* Pending events are kept in their own type slot, so lookup by type is O(1).
+ * The pending slot indices are also kept sorted by deadline in order, latest
+ * first: insertion is a binary search plus a short move of the earlier
+ * events, and the earliest event (cached in first) is popped from the end. */
 struct interrupt_queue
 {
-    struct pool pool;
-    struct node* first;
+    struct interrupt_slot slots[INTERRUPT_EVENT_SLOTS_COUNT];
+    int8_t order[INTERRUPT_EVENT_SLOTS_COUNT];
+    uint32_t pending;
+    int size;
+    int first;
 };
 
 struct interrupt_handler
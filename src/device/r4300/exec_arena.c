@@ -0,0 +1,466 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - exec_arena.c                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "exec_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+
+#if defined(WIN32)
+#include <windows.h>
+#elif defined(__GNUC__)
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#ifndef MAP_ANONYMOUS
+#ifdef MAP_ANON
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+#endif
+
+static size_t round_to_granule(size_t size)
+{
+    return (size + EXEC_ARENA_GRANULE - 1) & ~(size_t)(EXEC_ARENA_GRANULE - 1);
+}
+
+/**********************************************************************
+ ************************* chunk mapping ******************************
+ **********************************************************************/
+static int map_dual_view(struct exec_arena* arena, struct exec_arena_chunk* chunk)
+{
+#if defined(WIN32)
+    HANDLE mapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_EXECUTE_READWRITE,
+        (DWORD)((uint64_t)chunk->size >> 32), (DWORD)chunk->size, NULL);
+    arena->stats.syscalls += 4;
+    if (mapping == NULL) {
+        return -1;
+    }
+
+    chunk->write = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, chunk->size);
+    chunk->exec = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_EXECUTE, 0, 0, chunk->size);
+    /* the views keep the mapping alive */
+    CloseHandle(mapping);
+
+    if (chunk->write == NULL || chunk->exec == NULL) {
+        if (chunk->write != NULL) { UnmapViewOfFile(chunk->write); }
+        if (chunk->exec != NULL) { UnmapViewOfFile(chunk->exec); }
+        return -1;
+    }
+
+    return 0;
+#elif defined(__linux__) && defined(SYS_memfd_create)
+    int fd = (int)syscall(SYS_memfd_create, "mupen64plus-dynarec", 1 /* MFD_CLOEXEC */);
+    arena->stats.syscalls += 5;
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (ftruncate(fd, (off_t)chunk->size) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    chunk->write = mmap(NULL, chunk->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    chunk->exec = mmap(NULL, chunk->size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (chunk->write == MAP_FAILED || chunk->exec == MAP_FAILED) {
+        if (chunk->write != MAP_FAILED) { munmap(chunk->write, chunk->size); }
+        if (chunk->exec != MAP_FAILED) { munmap(chunk->exec, chunk->size); }
+        return -1;
+    }
+
+    return 0;
+#else
+    (void)arena;
+    (void)chunk;
+    return -1;
+#endif
+}
+
+static int map_single_view(struct exec_arena* arena, struct exec_arena_chunk* chunk)
+{
+    ++arena->stats.syscalls;
+#if defined(WIN32)
+    chunk->exec = VirtualAlloc(NULL, chunk->size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+    if (chunk->exec == NULL) {
+        return -1;
+    }
+#elif defined(__GNUC__)
+    chunk->exec = mmap(NULL, chunk->size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk->exec == MAP_FAILED) {
+        return -1;
+    }
+#else
+    chunk->exec = malloc(chunk->size);
+    if (chunk->exec == NULL) {
+        return -1;
+    }
+#endif
+    chunk->write = chunk->exec;
+    return 0;
+}
+
+static int map_chunk(struct exec_arena* arena, struct exec_arena_chunk* chunk)
+{
+    if (arena->dual_view) {
+        if (map_dual_view(arena, chunk) == 0) {
+            return 0;
+        }
+
+        DebugMessage(M64MSG_WARNING, "Couldn't map dual view dynarec code memory, falling back to writable and executable memory");
+        arena->dual_view = 0;
+    }
+
+    if (map_single_view(arena, chunk) != 0) {
+        DebugMessage(M64MSG_ERROR, "Memory error: couldn't allocate %zu byte block of executable memory.", chunk->size);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void unmap_chunk(struct exec_arena* arena, struct exec_arena_chunk* chunk)
+{
+    ++arena->stats.syscalls;
+#if defined(WIN32)
+    if (chunk->write != chunk->exec) {
+        UnmapViewOfFile(chunk->write);
+        UnmapViewOfFile(chunk->exec);
+        ++arena->stats.syscalls;
+    }
+    else {
+        VirtualFree(chunk->exec, 0, MEM_RELEASE);
+    }
+#elif defined(__GNUC__)
+    if (chunk->write != chunk->exec) {
+        munmap(chunk->write, chunk->size);
+        ++arena->stats.syscalls;
+    }
+    munmap(chunk->exec, chunk->size);
+#else
+    free(chunk->exec);
+#endif
+
+    free(chunk->free_list);
+    arena->stats.bytes_reserved -= chunk->size;
+}
+
+/**********************************************************************
+ ************************* free extents *******************************
+ **********************************************************************/
+
+/* index of the first free extent at or after offset */
+static size_t find_extent(const struct exec_arena_chunk* chunk, size_t offset)
+{
+    size_t lo = 0;
+    size_t hi = chunk->free_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (chunk->free_list[mid].offset < offset) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+static void remove_extent(struct exec_arena_chunk* chunk, size_t i)
+{
+    memmove(&chunk->free_list[i], &chunk->free_list[i + 1],
+        (chunk->free_count - i - 1) * sizeof(chunk->free_list[0]));
+    --chunk->free_count;
+}
+
+/* take size bytes from the start of extent i */
+static size_t take_extent(struct exec_arena_chunk* chunk, size_t i, size_t size)
+{
+    size_t offset = chunk->free_list[i].offset;
+
+    chunk->free_list[i].offset += size;
+    chunk->free_list[i].size -= size;
+    chunk->free_bytes -= size;
+
+    if (chunk->free_list[i].size == 0) {
+        remove_extent(chunk, i);
+    }
+
+    return offset;
+}
+
+/* return [offset, offset+size) to the chunk, merging it with its neighbours */
+static int release_extent(struct exec_arena_chunk* chunk, size_t offset, size_t size)
+{
+    size_t i = find_extent(chunk, offset);
+    int merge_prev = (i > 0 && chunk->free_list[i - 1].offset + chunk->free_list[i - 1].size == offset);
+    int merge_next = (i < chunk->free_count && offset + size == chunk->free_list[i].offset);
+
+    if (merge_prev && merge_next) {
+        chunk->free_list[i - 1].size += size + chunk->free_list[i].size;
+        remove_extent(chunk, i);
+    }
+    else if (merge_prev) {
+        chunk->free_list[i - 1].size += size;
+    }
+    else if (merge_next) {
+        chunk->free_list[i].offset = offset;
+        chunk->free_list[i].size += size;
+    }
+    else {
+        if (chunk->free_count == chunk->free_capacity) {
+            size_t capacity = (chunk->free_capacity == 0) ? 64 : 2 * chunk->free_capacity;
+            struct exec_arena_extent* free_list = realloc(chunk->free_list, capacity * sizeof(*free_list));
+            if (free_list == NULL) {
+                /* the range is leaked until the arena is released */
+                return -1;
+            }
+            chunk->free_list = free_list;
+            chunk->free_capacity = capacity;
+        }
+
+        memmove(&chunk->free_list[i + 1], &chunk->free_list[i],
+            (chunk->free_count - i) * sizeof(chunk->free_list[0]));
+        chunk->free_list[i].offset = offset;
+        chunk->free_list[i].size = size;
+        ++chunk->free_count;
+    }
+
+    chunk->free_bytes += size;
+    return 0;
+}
+
+static struct exec_arena_chunk* find_chunk(const struct exec_arena* arena, const void* ptr)
+{
+    size_t i;
+    const unsigned char* p = (const unsigned char*)ptr;
+
+    for (i = 0; i < arena->chunks_count; ++i) {
+        struct exec_arena_chunk* chunk = &arena->chunks[i];
+        if (p >= chunk->exec && p < chunk->exec + chunk->size) {
+            return chunk;
+        }
+    }
+
+    return NULL;
+}
+
+static struct exec_arena_chunk* add_chunk(struct exec_arena* arena, size_t size)
+{
+    struct exec_arena_chunk* chunk;
+
+    if (arena->chunks_count == arena->chunks_capacity) {
+        size_t capacity = (arena->chunks_capacity == 0) ? 8 : 2 * arena->chunks_capacity;
+        struct exec_arena_chunk* chunks = realloc(arena->chunks, capacity * sizeof(*chunks));
+        if (chunks == NULL) {
+            return NULL;
+        }
+        arena->chunks = chunks;
+        arena->chunks_capacity = capacity;
+    }
+
+    chunk = &arena->chunks[arena->chunks_count];
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->size = (size > EXEC_ARENA_CHUNK_SIZE) ? size : EXEC_ARENA_CHUNK_SIZE;
+
+    if (map_chunk(arena, chunk) != 0) {
+        return NULL;
+    }
+    arena->stats.bytes_reserved += chunk->size;
+
+    if (release_extent(chunk, 0, chunk->size) != 0) {
+        unmap_chunk(arena, chunk);
+        return NULL;
+    }
+
+    ++arena->chunks_count;
+    return chunk;
+}
+
+/**********************************************************************
+ ****************************** API ***********************************
+ **********************************************************************/
+void exec_arena_init(struct exec_arena* arena)
+{
+    arena->chunks = NULL;
+    arena->chunks_count = 0;
+    arena->chunks_capacity = 0;
+    memset(&arena->stats, 0, sizeof(arena->stats));
+}
+
+void exec_arena_release(struct exec_arena* arena)
+{
+    size_t i;
+
+    for (i = 0; i < arena->chunks_count; ++i) {
+        unmap_chunk(arena, &arena->chunks[i]);
+    }
+
+    free(arena->chunks);
+    arena->chunks = NULL;
+    arena->chunks_count = 0;
+    arena->chunks_capacity = 0;
+    arena->stats.bytes_live = 0;
+}
+
+void* exec_arena_alloc(struct exec_arena* arena, size_t size)
+{
+    size_t i, j;
+    struct exec_arena_chunk* chunk;
+
+    size = round_to_granule(size);
+
+    /* first fit */
+    for (i = 0; i < arena->chunks_count; ++i) {
+        chunk = &arena->chunks[i];
+        if (chunk->free_bytes < size) {
+            continue;
+        }
+
+        for (j = 0; j < chunk->free_count; ++j) {
+            if (chunk->free_list[j].size >= size) {
+                goto found;
+            }
+        }
+    }
+
+    chunk = add_chunk(arena, size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    j = 0;
+
+found:
+    ++arena->stats.allocations;
+    arena->stats.bytes_live += size;
+    if (arena->stats.bytes_live > arena->stats.bytes_peak) {
+        arena->stats.bytes_peak = arena->stats.bytes_live;
+    }
+
+    return chunk->exec + take_extent(chunk, j, size);
+}
+
+void exec_arena_free(struct exec_arena* arena, void* ptr, size_t size)
+{
+    struct exec_arena_chunk* chunk = find_chunk(arena, ptr);
+
+    if (chunk == NULL) {
+        DebugMessage(M64MSG_ERROR, "Freeing unknown dynarec code memory %p", ptr);
+        return;
+    }
+
+    size = round_to_granule(size);
+    release_extent(chunk, (size_t)((unsigned char*)ptr - chunk->exec), size);
+    arena->stats.bytes_live -= size;
+
+    /* give empty chunks back to the system, but keep the first one
+     * to avoid remapping it when a single page is invalidated */
+    if (chunk->free_bytes == chunk->size && chunk != &arena->chunks[0]) {
+        unmap_chunk(arena, chunk);
+        *chunk = arena->chunks[--arena->chunks_count];
+    }
+}
+
+void* exec_arena_realloc(struct exec_arena* arena, void* ptr, size_t old_size, size_t new_size)
+{
+    struct exec_arena_chunk* chunk = find_chunk(arena, ptr);
+    size_t offset;
+    size_t i;
+    void* block;
+
+    if (chunk == NULL) {
+        return exec_arena_alloc(arena, new_size);
+    }
+
+    old_size = round_to_granule(old_size);
+    new_size = round_to_granule(new_size);
+    offset = (size_t)((unsigned char*)ptr - chunk->exec);
+
+    if (new_size <= old_size) {
+        if (new_size < old_size) {
+            release_extent(chunk, offset + new_size, old_size - new_size);
+            arena->stats.bytes_live -= old_size - new_size;
+        }
+        return ptr;
+    }
+
+    /* grow in place if the following range is free */
+    i = find_extent(chunk, offset + old_size);
+    if (i < chunk->free_count
+     && chunk->free_list[i].offset == offset + old_size
+     && chunk->free_list[i].size >= new_size - old_size) {
+        take_extent(chunk, i, new_size - old_size);
+        ++arena->stats.grown_in_place;
+        arena->stats.bytes_live += new_size - old_size;
+        if (arena->stats.bytes_live > arena->stats.bytes_peak) {
+            arena->stats.bytes_peak = arena->stats.bytes_live;
+        }
+        return ptr;
+    }
+
+    /* chunk may move when a new one is added */
+    block = exec_arena_alloc(arena, new_size);
+    if (block != NULL) {
+        memcpy((unsigned char*)block + exec_arena_write_offset(arena, block),
+            (unsigned char*)ptr + exec_arena_write_offset(arena, ptr), old_size);
+        ++arena->stats.moves;
+    }
+    exec_arena_free(arena, ptr, old_size);
+
+    return block;
+}
+
+ptrdiff_t exec_arena_write_offset(const struct exec_arena* arena, const void* ptr)
+{
+    const struct exec_arena_chunk* chunk = find_chunk(arena, ptr);
+
+    return (chunk != NULL) ? chunk->write - chunk->exec : 0;
+}
+
+void exec_arena_get_stats(const struct exec_arena* arena, struct exec_arena_stats* stats)
+{
+    size_t i, j;
+
+    *stats = arena->stats;
+    stats->bytes_free = 0;
+    stats->largest_free = 0;
+
+    for (i = 0; i < arena->chunks_count; ++i) {
+        const struct exec_arena_chunk* chunk = &arena->chunks[i];
+        stats->bytes_free += chunk->free_bytes;
+        for (j = 0; j < chunk->free_count; ++j) {
+            if (chunk->free_list[j].size > stats->largest_free) {
+                stats->largest_free = chunk->free_list[j].size;
+            }
+        }
+    }
+}
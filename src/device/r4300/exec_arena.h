@@ -0,0 +1,100 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - exec_arena.h                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_DEVICE_R4300_EXEC_ARENA_H
+#define M64P_DEVICE_R4300_EXEC_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Executable memory for the dynamic recompiler, carved out of large
+ * chunks instead of one mapping per buffer. Allocations are rounded to
+ * EXEC_ARENA_GRANULE bytes and freed ranges are coalesced, so that a
+ * buffer can often grow in place. Chunks which become empty are
+ * unmapped, except the first one.
+ *
+ * With dual_view, each chunk is mapped twice: a read/write view where
+ * code is emitted and a read/execute view where it runs, so that no page
+ * is both writable and executable. Pointers returned by the arena are
+ * always in the executable view; add exec_arena_write_offset() to get
+ * the writable alias. */
+
+enum { EXEC_ARENA_GRANULE = 4096 };
+enum { EXEC_ARENA_CHUNK_SIZE = 16 * 1024 * 1024 };
+
+struct exec_arena_extent
+{
+    size_t offset;
+    size_t size;
+};
+
+struct exec_arena_chunk
+{
+    unsigned char* exec;
+    unsigned char* write;
+    size_t size;
+
+    /* free ranges sorted by offset, never adjacent */
+    struct exec_arena_extent* free_list;
+    size_t free_count;
+    size_t free_capacity;
+    size_t free_bytes;
+};
+
+struct exec_arena_stats
+{
+    size_t bytes_live;
+    size_t bytes_peak;
+    size_t bytes_reserved;
+    size_t bytes_free;
+    size_t largest_free;
+    uint64_t syscalls;
+    uint64_t allocations;
+    uint64_t grown_in_place;
+    uint64_t moves;
+};
+
+struct exec_arena
+{
+    /* configuration, kept across exec_arena_init */
+    int dual_view;
+
+    struct exec_arena_chunk* chunks;
+    size_t chunks_count;
+    size_t chunks_capacity;
+
+    struct exec_arena_stats stats;
+};
+
+void exec_arena_init(struct exec_arena* arena);
+void exec_arena_release(struct exec_arena* arena);
+
+void* exec_arena_alloc(struct exec_arena* arena, size_t size);
+void* exec_arena_realloc(struct exec_arena* arena, void* ptr, size_t old_size, size_t new_size);
+void exec_arena_free(struct exec_arena* arena, void* ptr, size_t size);
+
+ptrdiff_t exec_arena_write_offset(const struct exec_arena* arena, const void* ptr);
+
+/* fills in bytes_free and largest_free */
+void exec_arena_get_stats(const struct exec_arena* arena, struct exec_arena_stats* stats);
+
+#endif /* M64P_DEVICE_R4300_EXEC_ARENA_H */
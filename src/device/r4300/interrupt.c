@@ -43,62 +43,93 @@
 #include "device/r4300/recomp.h"
 #include "device/rcp/ai/ai_controller.h"
 #include "device/rcp/vi/vi_controller.h"
+#include "main/benchmark.h"
+#include "main/guest_profiler.h"
 #include "main/main.h"
+#include "main/rewind.h"
 #include "main/savestates.h"
+#include "osal/preproc.h"
 
 
 /***************************************************************************
- * Pool of Single Linked List Nodes
+ * Interrupt Queue
  **************************************************************************/
 
-static struct node* alloc_node(struct pool* p);
-static void free_node(struct pool* p, struct node* node);
-static void clear_pool(struct pool* p);
-
-
-/* node allocation/deallocation on a given pool */
-static struct node* alloc_node(struct pool* p)
+/* map an event type to its deadline slot (bit position of the type flag) */
+static int event_slot(int type)
 {
-    /* return NULL if pool is too small */
-    if (p->index >= INTERRUPT_NODES_POOL_CAPACITY) {
-        return NULL;
+    switch (type)
+    {
+    case VI_INT:      return 0;
+    case COMPARE_INT: return 1;
+    case CHECK_INT:   return 2;
+    case SI_INT:      return 3;
+    case PI_INT:      return 4;
+    case SPECIAL_INT: return 5;
+    case AI_INT:      return 6;
+    case SP_INT:      return 7;
+    case DP_INT:      return 8;
+    case HW2_INT:     return 9;
+    case NMI_INT:     return 10;
+    case RSP_DMA_EVT: return 11;
+    case DD_MC_INT:   return 12;
+    case DD_BM_INT:   return 13;
+    case DD_DV_INT:   return 14;
+    case PROFILE_EVT: return 15;
+    default:          return INTERRUPT_SLOT_NONE;
     }
-
-    return p->stack[p->index++];
 }
 
-static void free_node(struct pool* p, struct node* node)
+static void clear_queue(struct interrupt_queue* q)
 {
-    if (p->index == 0 || node == NULL) {
-        return;
+    size_t i;
+
+    for (i = 0; i < INTERRUPT_EVENT_SLOTS_COUNT; ++i) {
+        q->slots[i].type = 0;
+        q->slots[i].count = 0;
+        q->order[i] = INTERRUPT_SLOT_NONE;
     }
 
-    p->stack[--p->index] = node;
+    q->pending = 0;
+    q->size = 0;
+    q->first = INTERRUPT_SLOT_NONE;
 }
 
-/* release all nodes */
-static void clear_pool(struct pool* p)
+/* insert slot s at index i of order (latest event first) */
+static void link_slot(struct interrupt_queue* q, int s, int i)
 {
-    size_t i;
+    int j;
 
-    for (i = 0; i < INTERRUPT_NODES_POOL_CAPACITY; ++i) {
-        p->stack[i] = &p->nodes[i];
+    for (j = q->size; j > i; --j) {
+        q->order[j] = q->order[j - 1];
     }
 
-    p->index = 0;
-}
+    q->order[i] = (int8_t)s;
+    ++q->size;
 
-/***************************************************************************
- * Interrupt Queue
- **************************************************************************/
+    q->first = q->order[q->size - 1];
+    q->pending |= (uint32_t)q->slots[s].type;
+}
 
-static void clear_queue(struct interrupt_queue* q)
+static void unlink_slot(struct interrupt_queue* q, int s)
 {
-    q->first = NULL;
-    clear_pool(&q->pool);
+    int i;
+
+    for (i = q->size - 1; q->order[i] != s; --i);
+
+    --q->size;
+    for (; i < q->size; ++i) {
+        q->order[i] = q->order[i + 1];
+    }
+    q->order[q->size] = INTERRUPT_SLOT_NONE;
+
+    q->first = (q->size == 0) ? INTERRUPT_SLOT_NONE : q->order[q->size - 1];
+    q->pending &= ~(uint32_t)q->slots[s].type;
 }
 
-static int before_event(const struct cp0* cp0, unsigned int evt1, unsigned int evt2, int type2)
+/* reference count used to order events: events are compared by their
+ * distance to it, so the CP0 registers are read once per insertion */
+static uint32_t event_base_count(const struct cp0* cp0)
 {
     const uint32_t* cp0_regs = r4300_cp0_regs((struct cp0*)cp0); /* OK to cast away const qualifier */
     uint32_t count = cp0_regs[CP0_COUNT_REG];
@@ -108,8 +139,28 @@ static int before_event(const struct cp0* cp0, unsigned int evt1, unsigned int e
     if (*cp0_cycle_count > 0)
         count -= *cp0_cycle_count;
 
-    if ((evt1 - count) < (evt2 - count)) return 1;
-    else return 0;
+    return count;
+}
+
+static osal_inline int before_event(uint32_t base, unsigned int evt1, unsigned int evt2)
+{
+    return (evt1 - base) < (evt2 - base);
+}
+
+static void update_next_interrupt(struct cp0* cp0)
+{
+    const uint32_t* cp0_regs = r4300_cp0_regs(cp0);
+    unsigned int* cp0_next_interrupt = r4300_cp0_next_interrupt(cp0);
+    int* cp0_cycle_count = r4300_cp0_cycle_count(cp0);
+
+    if (cp0->q.first != INTERRUPT_SLOT_NONE) {
+        *cp0_next_interrupt = cp0->q.slots[cp0->q.first].count;
+        *cp0_cycle_count = cp0_regs[CP0_COUNT_REG] - *cp0_next_interrupt;
+    }
+    else {
+        *cp0_next_interrupt = 0;
+        *cp0_cycle_count = 0;
+    }
 }
 
 unsigned int add_random_interrupt_time(struct r4300_core* r4300)
@@ -134,145 +185,90 @@ void add_interrupt_event(struct cp0* cp0, int type, unsigned int delay)
 
 void add_interrupt_event_count(struct cp0* cp0, int type, unsigned int count)
 {
-    struct node* event;
-    struct node* e;
-    const uint32_t* cp0_regs = r4300_cp0_regs(cp0);
-    unsigned int* cp0_next_interrupt = r4300_cp0_next_interrupt(cp0);
-    int* cp0_cycle_count = r4300_cp0_cycle_count(cp0);
+    struct interrupt_queue* q = &cp0->q;
+    int s = event_slot(type);
+    int lo, hi;
+    uint32_t base;
 
-    if (get_event(&cp0->q, type)) {
-        DebugMessage(M64MSG_WARNING, "two events of type 0x%x in interrupt queue", type);
-    }
-
-    event = alloc_node(&cp0->q.pool);
-    if (event == NULL)
+    if (s == INTERRUPT_SLOT_NONE)
     {
-        DebugMessage(M64MSG_ERROR, "Failed to allocate node for new interrupt event");
+        DebugMessage(M64MSG_ERROR, "Unknown interrupt event type 0x%x", type);
         return;
     }
 
-    event->data.count = count;
-    event->data.type = type;
-
-    if (cp0->q.first == NULL)
-    {
-        cp0->q.first = event;
-        event->next = NULL;
-    }
-    else if (before_event(cp0, count, cp0->q.first->data.count, cp0->q.first->data.type))
-    {
-        event->next = cp0->q.first;
-        cp0->q.first = event;
+    if (q->pending & (uint32_t)type) {
+        DebugMessage(M64MSG_WARNING, "two events of type 0x%x in interrupt queue", type);
+        unlink_slot(q, s);
     }
-    else
-    {
-        for (e = cp0->q.first;
-            e->next != NULL &&
-            (!before_event(cp0, count, e->next->data.count, e->next->data.type));
-            e = e->next);
 
-        if (e->next == NULL)
-        {
-            e->next = event;
-            event->next = NULL;
-        }
-        else
-        {
-            for(; e->next != NULL && e->next->data.count == count; e = e->next);
+    q->slots[s].type = type;
+    q->slots[s].count = count;
+
+    base = event_base_count(cp0);
+
+    /* skip the events firing strictly after this one, so that
+     * events with the same count fire in insertion order */
+    lo = 0;
+    hi = q->size;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
 
-            event->next = e->next;
-            e->next = event;
+        if (before_event(base, count, q->slots[q->order[mid]].count)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
         }
     }
-    *cp0_next_interrupt = cp0->q.first->data.count;
-    *cp0_cycle_count = cp0_regs[CP0_COUNT_REG] - cp0->q.first->data.count;
+
+    link_slot(q, s, lo);
+
+    update_next_interrupt(cp0);
 }
 
 void remove_interrupt_event(struct cp0* cp0)
 {
-    struct node* e;
-    const uint32_t* cp0_regs = r4300_cp0_regs(cp0);
-    unsigned int* cp0_next_interrupt = r4300_cp0_next_interrupt(cp0);
-    int* cp0_cycle_count = r4300_cp0_cycle_count(cp0);
-
-    e = cp0->q.first;
-    cp0->q.first = e->next;
-    free_node(&cp0->q.pool, e);
-
-    *cp0_next_interrupt = (cp0->q.first != NULL)
-        ? cp0->q.first->data.count
-        : 0;
-
-    *cp0_cycle_count = (cp0->q.first != NULL)
-        ? (cp0_regs[CP0_COUNT_REG] - cp0->q.first->data.count)
-        : 0;
+    unlink_slot(&cp0->q, cp0->q.first);
+    update_next_interrupt(cp0);
 }
 
 unsigned int* get_event(const struct interrupt_queue* q, int type)
 {
-    struct node* e = q->first;
-
-    if (e == NULL) {
+    if (!(q->pending & (uint32_t)type)) {
         return NULL;
     }
 
-    if (e->data.type == type) {
-        return &e->data.count;
-    }
-
-    for (; e->next != NULL && e->next->data.type != type; e = e->next);
-
-    return (e->next != NULL)
-        ? &e->next->data.count
-        : NULL;
+    /* OK to cast away const qualifier */
+    return &((struct interrupt_queue*)q)->slots[event_slot(type)].count;
 }
 
 int get_next_event_type(const struct interrupt_queue* q)
 {
-    return (q->first == NULL)
+    return (q->first == INTERRUPT_SLOT_NONE)
         ? 0
-        : q->first->data.type;
+        : q->slots[q->first].type;
 }
 
 void remove_event(struct interrupt_queue* q, int type)
 {
-    struct node* to_del;
-    struct node* e = q->first;
-
-    if (e == NULL) {
-        return;
-    }
-
-    if (e->data.type == type)
-    {
-        q->first = e->next;
-        free_node(&q->pool, e);
-    }
-    else
-    {
-        for (; e->next != NULL && e->next->data.type != type; e = e->next);
-
-        if (e->next != NULL)
-        {
-            to_del = e->next;
-            e->next = to_del->next;
-            free_node(&q->pool, to_del);
-        }
+    if (q->pending & (uint32_t)type) {
+        unlink_slot(q, event_slot(type));
     }
 }
 
 void translate_event_queue(struct cp0* cp0, unsigned int base)
 {
-    struct node* e;
+    int i;
     uint32_t* cp0_regs = r4300_cp0_regs(cp0);
     int* cp0_cycle_count = r4300_cp0_cycle_count(cp0);
 
     remove_event(&cp0->q, COMPARE_INT);
     remove_event(&cp0->q, SPECIAL_INT);
 
-    for (e = cp0->q.first; e != NULL; e = e->next)
+    for (i = 0; i < cp0->q.size; ++i)
     {
-        e->data.count = (e->data.count - cp0_regs[CP0_COUNT_REG]) + base;
+        int e = cp0->q.order[i];
+        cp0->q.slots[e].count = (cp0->q.slots[e].count - cp0_regs[CP0_COUNT_REG]) + base;
     }
 
     cp0_regs[CP0_COUNT_REG] = base;
@@ -285,20 +281,27 @@ void translate_event_queue(struct cp0* cp0, unsigned int base)
     cp0_regs[CP0_COUNT_REG] -= cp0->count_per_op;
 
     /* Update next interrupt in case first event is COMPARE_INT */
-    *cp0_cycle_count = cp0_regs[CP0_COUNT_REG] - cp0->q.first->data.count;
+    *cp0_cycle_count = cp0_regs[CP0_COUNT_REG] - cp0->q.slots[cp0->q.first].count;
 }
 
 int save_eventqueue_infos(const struct cp0* cp0, char *buf)
 {
     int len;
-    struct node* e;
+    int i;
 
     len = 0;
 
-    for (e = cp0->q.first; e != NULL; e = e->next)
+    for (i = cp0->q.size - 1; i >= 0; --i)
     {
-        memcpy(buf + len    , &e->data.type , 4);
-        memcpy(buf + len + 4, &e->data.count, 4);
+        int e = cp0->q.order[i];
+
+        /* profiler samples are not part of the emulated machine state */
+        if (cp0->q.slots[e].type == PROFILE_EVT) {
+            continue;
+        }
+
+        memcpy(buf + len    , &cp0->q.slots[e].type , 4);
+        memcpy(buf + len + 4, &cp0->q.slots[e].count, 4);
         len += 8;
     }
 
@@ -317,12 +320,18 @@ void load_eventqueue_infos(struct cp0* cp0, const char *buf)
     {
         int type = *((const unsigned int*)&buf[len]);
         unsigned int count = *((const unsigned int*)&buf[len+4]);
-        add_interrupt_event_count(cp0, type, count);
+        if (type != PROFILE_EVT) {
+            add_interrupt_event_count(cp0, type, count);
+        }
         len += 8;
     }
 
     remove_event(&cp0->q, SPECIAL_INT);
     add_interrupt_event_count(cp0, SPECIAL_INT, ((cp0_regs[CP0_COUNT_REG] & UINT32_C(0x80000000)) ^ UINT32_C(0x80000000)));
+
+    if (g_guest_profiler_interval != 0) {
+        add_interrupt_event(cp0, PROFILE_EVT, g_guest_profiler_interval);
+    }
 }
 
 void init_interrupt(struct cp0* cp0)
@@ -330,11 +339,14 @@ void init_interrupt(struct cp0* cp0)
     clear_queue(&cp0->q);
     add_interrupt_event_count(cp0, SPECIAL_INT, 0x80000000);
     add_interrupt_event_count(cp0, COMPARE_INT, 0);
+
+    if (g_guest_profiler_interval != 0) {
+        add_interrupt_event(cp0, PROFILE_EVT, g_guest_profiler_interval);
+    }
 }
 
 void r4300_check_interrupt(struct r4300_core* r4300, uint32_t cause_ip, int set_cause)
 {
-    struct node* event;
     uint32_t* cp0_regs = r4300_cp0_regs(&r4300->cp0);
     unsigned int* cp0_next_interrupt = r4300_cp0_next_interrupt(&r4300->cp0);
     int* cp0_cycle_count = r4300_cp0_cycle_count(&r4300->cp0);
@@ -351,29 +363,19 @@ void r4300_check_interrupt(struct r4300_core* r4300, uint32_t cause_ip, int set_
     }
     if (cp0_regs[CP0_STATUS_REG] & cp0_regs[CP0_CAUSE_REG] & UINT32_C(0xFF00))
     {
-        event = alloc_node(&r4300->cp0.q.pool);
+        struct interrupt_queue* q = &r4300->cp0.q;
+        int s = event_slot(CHECK_INT);
 
-        if (event == NULL)
-        {
-            DebugMessage(M64MSG_ERROR, "Failed to allocate node for new interrupt event");
-            return;
+        /* CHECK_INT always goes in front of the queue */
+        if (q->pending & CHECK_INT) {
+            unlink_slot(q, s);
         }
 
-        event->data.count = *cp0_next_interrupt = cp0_regs[CP0_COUNT_REG];
-        event->data.type = CHECK_INT;
+        q->slots[s].type = CHECK_INT;
+        q->slots[s].count = *cp0_next_interrupt = cp0_regs[CP0_COUNT_REG];
         *cp0_cycle_count = 0;
 
-        if (r4300->cp0.q.first == NULL)
-        {
-            r4300->cp0.q.first = event;
-            event->next = NULL;
-        }
-        else
-        {
-            event->next = r4300->cp0.q.first;
-            r4300->cp0.q.first = event;
-
-        }
+        link_slot(q, s, q->size);
     }
 }
 
@@ -406,7 +408,7 @@ void compare_int_handler(void* opaque)
     cp0_regs[CP0_COUNT_REG] -= r4300->cp0.count_per_op;
 
     /* Update next interrupt in case first event is COMPARE_INT */
-    *cp0_cycle_count = cp0_regs[CP0_COUNT_REG] - r4300->cp0.q.first->data.count;
+    *cp0_cycle_count = cp0_regs[CP0_COUNT_REG] - r4300->cp0.q.slots[r4300->cp0.q.first].count;
 
     raise_maskable_interrupt(r4300, CP0_CAUSE_IP7);
 }
@@ -532,12 +534,8 @@ static void call_interrupt_handler(const struct cp0* cp0, size_t index)
     handler->callback(handler->opaque);
 }
 
-void gen_interrupt(struct r4300_core* r4300)
+static void do_gen_interrupt(struct r4300_core* r4300)
 {
-    uint32_t* cp0_regs = r4300_cp0_regs(&r4300->cp0);
-    unsigned int* cp0_next_interrupt = r4300_cp0_next_interrupt(&r4300->cp0);
-    int* cp0_cycle_count = r4300_cp0_cycle_count(&r4300->cp0);
-
     if (*r4300_stop(r4300) == 1)
     {
         g_gs_vi_counter = 0; // debug
@@ -556,6 +554,12 @@ void gen_interrupt(struct r4300_core* r4300)
             return;
         }
 
+        if (rewind_load_pending())
+        {
+            rewind_load();
+            return;
+        }
+
         if (r4300->reset_hard_job)
         {
             call_interrupt_handler(&r4300->cp0, 11);
@@ -568,20 +572,14 @@ void gen_interrupt(struct r4300_core* r4300)
         uint32_t dest = r4300->skip_jump;
         r4300->skip_jump = 0;
 
-        *cp0_next_interrupt = (r4300->cp0.q.first != NULL)
-            ? r4300->cp0.q.first->data.count
-            : 0;
-
-        *cp0_cycle_count = (r4300->cp0.q.first != NULL)
-            ? (cp0_regs[CP0_COUNT_REG] - r4300->cp0.q.first->data.count)
-            : 0;
+        update_next_interrupt(&r4300->cp0);
 
         r4300->cp0.last_addr = dest;
         generic_jump_to(r4300, dest);
         return;
     }
 
-    switch (r4300->cp0.q.first->data.type)
+    switch (get_next_event_type(&r4300->cp0.q))
     {
         case VI_INT:
             call_interrupt_handler(&r4300->cp0, 0);
@@ -656,8 +654,16 @@ void gen_interrupt(struct r4300_core* r4300)
             call_interrupt_handler(&r4300->cp0, 15);
             break;
 
+        case PROFILE_EVT:
+            remove_interrupt_event(&r4300->cp0);
+            guest_profiler_sample(*r4300_pc(r4300));
+            if (g_guest_profiler_interval != 0) {
+                add_interrupt_event(&r4300->cp0, PROFILE_EVT, g_guest_profiler_interval);
+            }
+            break;
+
         default:
-            DebugMessage(M64MSG_ERROR, "Unknown interrupt queue event type %.8X.", r4300->cp0.q.first->data.type);
+            DebugMessage(M64MSG_ERROR, "Unknown interrupt queue event type %.8X.", get_next_event_type(&r4300->cp0.q));
             remove_interrupt_event(&r4300->cp0);
             exception_general(r4300);
             break;
@@ -670,6 +676,17 @@ void gen_interrupt(struct r4300_core* r4300)
             savestates_save();
             return;
         }
+
+        if (rewind_save_pending())
+        {
+            rewind_save();
+        }
     }
 }
 
+void gen_interrupt(struct r4300_core* r4300)
+{
+    benchmark_section_start(BENCHMARK_SECTION_INTERRUPT);
+    do_gen_interrupt(r4300);
+    benchmark_section_end(BENCHMARK_SECTION_INTERRUPT);
+}
@@ -69,5 +69,6 @@ void nmi_int_handler(void* opaque);
 #define DD_MC_INT   0x1000
 #define DD_BM_INT   0x2000
 #define DD_DV_INT   0x4000
+#define PROFILE_EVT 0x8000
 
 #endif /* M64P_DEVICE_R4300_INTERRUPT_H */
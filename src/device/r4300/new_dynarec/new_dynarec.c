@@ -32,13 +32,17 @@
 #include "new_dynarec.h"
 #include "api/m64p_types.h"
 #include "api/callbacks.h"
+#include "main/benchmark.h"
 #include "main/main.h"
+#include "main/perf_jit.h"
+#include "main/rsp_thread.h"
 #include "main/rom.h"
 #include "device/memory/memory.h"
 #include "device/r4300/cached_interp.h"
 #include "device/r4300/cp0.h"
 #include "device/r4300/cp1.h"
 #include "device/r4300/interrupt.h"
+#include "device/r4300/pure_interp.h"
 #include "device/r4300/tlb.h"
 #include "device/r4300/fpu.h"
 #include "device/rcp/mi/mi_controller.h"
@@ -48,6 +52,11 @@
 #include <sys/mman.h>
 #endif
 
+#ifdef DBG
+#include "debugger/dbg_breakpoints.h"
+#include "debugger/dbg_debugger.h"
+#endif
+
 #if defined(RECOMPILER_DEBUG) && !defined(RECOMP_DBG)
 void recomp_dbg_init(void);
 void recomp_dbg_cleanup(void);
@@ -67,6 +76,10 @@ void recomp_dbg_block(int addr);
 #error Unsupported dynarec architecture
 #endif
 
+#if !defined(RECOMP_DBG) && (NEW_DYNAREC == NEW_DYNAREC_X86 || NEW_DYNAREC == NEW_DYNAREC_X64)
+#define NEW_DYNAREC_CODE_CACHE
+#endif
+
 /* debug */
 #define ASSEM_DEBUG 0
 #define INV_DEBUG 0
@@ -223,12 +236,15 @@ void jump_syscall(void);
 void jump_eret(void);
 void dyna_linker(void);
 void dyna_linker_ds(void);
+void jump_interp_tier(void);
 void breakpoint(void);
 
 int new_recompile_block(int addr);
 void invalidate_block(u_int block);
+void *get_addr(u_int vaddr);
 void *get_addr_ht(u_int vaddr);
 void *get_addr_32(u_int vaddr,u_int flags);
+void *new_dynarec_interp_tier(void);
 
 static void load_regs_entry(int t);
 static void inline_readstub(int type,int i,u_int addr_const,char addr,struct regstat *i_regs,int target,int adj,u_int reglist);
@@ -296,6 +312,19 @@ static struct ll_entry *jump_dirty[4096];
 static struct ll_entry *jump_out[4096];
 static unsigned char restore_candidate[512];
 
+// Kinds of absolute host addresses in the generated code, see add_code_reloc
+enum { CODE_RELOC_IMAGE, CODE_RELOC_RDRAM, CODE_RELOC_NONE };
+#ifdef NEW_DYNAREC_CODE_CACHE
+// Relocation sites in emission order, as (position<<1)|kind. Positions keep
+// counting across wrap-arounds of the translation cache, so a site is still
+// live as long as the output pointer hasn't come back over it.
+static uint64_t *code_relocs;
+static u_int code_relocs_first;
+static u_int code_relocs_end;
+static u_int code_relocs_max;
+static uint64_t code_pass_base;
+#endif
+
 #if COUNT_NOTCOMPILEDS
 static int notcompiledCount = 0;
 #endif
@@ -1821,6 +1850,42 @@ static void add_stub(int type,intptr_t addr,intptr_t retaddr,int a,intptr_t b,in
   stubcount++;
 }
 
+#ifdef NEW_DYNAREC_CODE_CACHE
+// Forget the relocation sites which have been overwritten by newer code
+static void trim_code_relocs(void)
+{
+  uint64_t live=code_pass_base+((uintptr_t)out-(uintptr_t)base_addr);
+  while(code_relocs_first<code_relocs_end&&(code_relocs[code_relocs_first]>>1)+(1<<TARGET_SIZE_2)<=live)
+    code_relocs_first++;
+}
+
+static void push_code_reloc(uint64_t position,int kind)
+{
+  if(code_relocs_end==code_relocs_max) {
+    if(code_relocs_first>0&&code_relocs_first>=code_relocs_max/2) {
+      memmove(code_relocs,code_relocs+code_relocs_first,(code_relocs_end-code_relocs_first)*sizeof(code_relocs[0]));
+      code_relocs_end-=code_relocs_first;
+      code_relocs_first=0;
+    }
+    else {
+      code_relocs_max=code_relocs_max?code_relocs_max*2:65536;
+      code_relocs=(uint64_t *)realloc(code_relocs,code_relocs_max*sizeof(code_relocs[0]));
+      assert(code_relocs!=NULL);
+    }
+  }
+  code_relocs[code_relocs_end++]=(position<<1)|kind;
+}
+
+#ifdef HOST_IMM_ADDR32
+// Record an absolute host address stored at ptr, so that the code cache can relocate it
+static void add_code_reloc(void *ptr,int kind)
+{
+  trim_code_relocs();
+  push_code_reloc(code_pass_base+((uintptr_t)ptr-(uintptr_t)base_addr),kind);
+}
+#endif
+#endif
+
 static void remove_hash(u_int vaddr)
 {
   //DebugMessage(M64MSG_VERBOSE, "remove hash: %x",vaddr);
@@ -1871,6 +1936,7 @@ void* ERET_new(void)
     }
     r4300->llbit = 0;
     r4300->delay_slot = 0;
+    rsp_thread_sync();
     r4300_check_interrupt(r4300, CP0_CAUSE_IP2, r4300->mi->regs[MI_INTR_REG] & r4300->mi->regs[MI_INTR_MASK_REG]); // ???
     r4300->cp0.last_addr = state->pcaddr;
     state->pending_exception = 0;
@@ -2065,6 +2131,20 @@ static void MTC0_new(int copr, int count, int pcaddr)
   UPDATE_COUNT_OUT
 }
 
+#ifdef DBG
+// Execute breakpoint trap, called before the instruction at addr
+static void debugger_trap(int addr, int count)
+{
+  UPDATE_COUNT_IN
+  if(g_DebuggerActive) {
+    cp0_update_count(r4300);
+    state->pcaddr = addr;
+    update_debugger(addr);
+  }
+  UPDATE_COUNT_OUT
+}
+#endif
+
 #define BITS_BELOW_MASK32(x) ((UINT32_C(1) << (x)) - 1)
 #define BITS_ABOVE_MASK32(x) (~(BITS_BELOW_MASK32((x))))
 
@@ -2338,6 +2418,11 @@ static void tlb_speed_hacks()
 u_int verify_dirty(struct ll_entry * head)
 {
   void *source;
+#ifdef DBG
+  // Blocks in pages with execute breakpoints may lack their debugger traps
+  if(g_DebuggerActive&&check_breakpoints_in_page(head->vaddr))
+    return head->vaddr;
+#endif
   if((int)head->start>=0xa4000000&&(int)head->start<0xa4001000) {
     source=(void *)((uintptr_t)g_dev.sp.mem+head->start-0xa4000000);
   }else if((int)head->start>=0x80000000&&(int)head->start<0x80800000) {
@@ -2529,6 +2614,225 @@ static struct ll_entry *get_dirty(struct r4300_core* r4300,u_int vaddr,u_int fla
   return NULL;
 }
 
+#if !defined(RECOMP_DBG)
+/* Tiered compilation
+ *
+ * With a non-zero threshold, get_addr and dynamic_linker do not compile a
+ * block the first times its entry point is reached. They return
+ * jump_interp_tier instead, which saves the cycle count and calls
+ * new_dynarec_interp_tier to run the block with the pure interpreter.
+ * Once the entry point has been reached tier_threshold times the block is
+ * compiled as usual.
+ *
+ * Only code that the dynarec state does not need to observe is interpreted:
+ * ALU instructions, RDRAM loads and stores through KSEG0/KSEG1, and
+ * branches that are not idle loops. The block is also never allowed to run
+ * into the next interrupt. Anything else is compiled on first use. */
+#define TIER_COUNTS_SIZE 65536
+#define TIER_NEVER 0xFFFF
+#define TIER_MAX_BLOCK_INSNS 256
+
+enum { TIER_OP_NONE, TIER_OP_ALU, TIER_OP_LOAD, TIER_OP_STORE, TIER_OP_BRANCH };
+
+static u_int tier_threshold;
+static u_short tier_counts[TIER_COUNTS_SIZE];
+static struct new_dynarec_tier_stats tier_stats;
+
+static u_int tier_hash(u_int vaddr)
+{
+  return ((vaddr>>2)^(vaddr>>18))&(TIER_COUNTS_SIZE-1);
+}
+
+static int tier_classify(u_int op)
+{
+  switch(op>>26) {
+    case 0x00: // SPECIAL
+      switch(op&0x3f) {
+        case 0x00: case 0x02: case 0x03: case 0x04: case 0x06: case 0x07: // SLL..SRAV
+        case 0x10: case 0x11: case 0x12: case 0x13: // MFHI..MTLO
+        case 0x14: case 0x16: case 0x17: // DSLLV DSRLV DSRAV
+        case 0x18: case 0x19: case 0x1a: case 0x1b: // MULT..DIVU
+        case 0x1c: case 0x1d: case 0x1e: case 0x1f: // DMULT..DDIVU
+        case 0x20: case 0x21: case 0x22: case 0x23: // ADD..SUBU
+        case 0x24: case 0x25: case 0x26: case 0x27: // AND..NOR
+        case 0x2a: case 0x2b: // SLT SLTU
+        case 0x2c: case 0x2d: case 0x2e: case 0x2f: // DADD..DSUBU
+        case 0x38: case 0x3a: case 0x3b: case 0x3c: case 0x3e: case 0x3f: // DSLL..DSRA32
+          return TIER_OP_ALU;
+        case 0x08: case 0x09: // JR JALR
+          return TIER_OP_BRANCH;
+      }
+      return TIER_OP_NONE;
+    case 0x01: // REGIMM
+      switch((op>>16)&0x1f) {
+        case 0x00: case 0x01: case 0x02: case 0x03: // BLTZ..BGEZL
+        case 0x10: case 0x11: case 0x12: case 0x13: // BLTZAL..BGEZALL
+          return TIER_OP_BRANCH;
+      }
+      return TIER_OP_NONE;
+    case 0x02: case 0x03: // J JAL
+    case 0x04: case 0x05: case 0x06: case 0x07: // BEQ..BGTZ
+    case 0x14: case 0x15: case 0x16: case 0x17: // BEQL..BGTZL
+      return TIER_OP_BRANCH;
+    case 0x08: case 0x09: case 0x0a: case 0x0b: // ADDI..SLTIU
+    case 0x0c: case 0x0d: case 0x0e: case 0x0f: // ANDI..LUI
+    case 0x18: case 0x19: // DADDI DADDIU
+      return TIER_OP_ALU;
+    case 0x20: case 0x21: case 0x22: case 0x23: // LB LH LWL LW
+    case 0x24: case 0x25: case 0x26: case 0x27: // LBU LHU LWR LWU
+    case 0x37: // LD
+      return TIER_OP_LOAD;
+    case 0x28: case 0x29: case 0x2a: case 0x2b: // SB SH SWL SW
+    case 0x2e: case 0x3f: // SWR SD
+      return TIER_OP_STORE;
+  }
+  return TIER_OP_NONE;
+}
+
+static int tier_rdram_addr(u_int addr)
+{
+  return (addr&0xc0000000)==0x80000000&&(addr&0x1fffffff)+8<=g_dev.rdram.dram_size;
+}
+
+static u_int tier_fetch(u_int addr)
+{
+  return g_dev.rdram.dram[(addr&0x1fffffff)>>2];
+}
+
+static int tier_is_idle_loop(u_int addr,u_int op)
+{
+  if(tier_fetch(addr+4)!=0) return 0;
+  if((op>>26)==0x02||(op>>26)==0x03)
+    return (op&0x3ffffff)==((addr&0x0ffffffc)>>2);
+  if((op>>26)==0x00) return 0;
+  return (op&0xffff)==0xffff;
+}
+
+// Effective address of a load or store, checked before any register is modified
+static int tier_mem_op_ok(struct r4300_core* r4300,u_int op)
+{
+  u_int addr=(u_int)r4300->new_dynarec_hot_state.regs[(op>>21)&0x1f]+(u_int)(int)(short)op;
+  return tier_rdram_addr(addr);
+}
+
+static int tier_can_interpret(struct r4300_core* r4300,u_int addr,int left)
+{
+  u_int op,ds;
+  int type,ds_type;
+  if(left<1||!tier_rdram_addr(addr)) return 0;
+#ifdef DBG
+  // Breakpoints are only trapped in compiled code
+  if(g_DebuggerActive&&check_breakpoints(addr)!=-1) return 0;
+#endif
+  op=tier_fetch(addr);
+  type=tier_classify(op);
+  if(type==TIER_OP_ALU) return 1;
+  if(type==TIER_OP_LOAD||type==TIER_OP_STORE) return tier_mem_op_ok(r4300,op);
+  if(type!=TIER_OP_BRANCH||left<2||tier_is_idle_loop(addr,op)) return 0;
+  // The delay slot must be simple and must not use the link register,
+  // which is written before the delay slot executes
+  ds=tier_fetch(addr+4);
+  ds_type=tier_classify(ds);
+  if(ds_type==TIER_OP_ALU) return 1;
+  if(ds_type!=TIER_OP_LOAD&&ds_type!=TIER_OP_STORE) return 0;
+  if(((ds>>21)&0x1f)==31) return 0;
+  if((op>>26)==0x00&&(op&0x3f)==0x09&&((ds>>21)&0x1f)==((op>>11)&0x1f)) return 0; // JALR
+  return tier_mem_op_ok(r4300,ds);
+}
+
+// Returns the interpreter trampoline if the block at vaddr is still cold
+static void *tier_entry(u_int vaddr)
+{
+  u_short *count;
+  if(tier_threshold==0||(vaddr&1)) return NULL;
+  count=&tier_counts[tier_hash(vaddr)];
+  if(*count==TIER_NEVER) return NULL;
+  if(*count>=tier_threshold) {
+    tier_stats.promotions++;
+    *count=TIER_NEVER;
+    return NULL;
+  }
+  (*count)++;
+  g_dev.r4300.new_dynarec_hot_state.pcaddr=vaddr;
+  return (void *)jump_interp_tier;
+}
+
+void *new_dynarec_interp_tier(void)
+{
+  struct r4300_core* r4300 = &g_dev.r4300;
+  u_int vaddr=r4300->new_dynarec_hot_state.pcaddr;
+  int left=TIER_MAX_BLOCK_INSNS;
+  int budget=-r4300->new_dynarec_hot_state.cycle_count/(int)r4300->cp0.count_per_op-2;
+  int n;
+
+  if(budget<left) left=budget;
+  if(!tier_can_interpret(r4300,vaddr,left)) {
+    // Never interpretable (or too close to an interrupt), compile it now
+    tier_counts[tier_hash(vaddr)]=TIER_NEVER;
+    tier_stats.direct_compiles++;
+    return get_addr(vaddr);
+  }
+
+  cp0_update_count(r4300);
+  r4300->emumode=EMUMODE_PURE_INTERPRETER;
+  r4300->new_dynarec_hot_state.pc=&r4300->interp_PC;
+  r4300->interp_PC.addr=vaddr;
+  r4300->cp0.last_addr=vaddr;
+
+  for(n=0;tier_can_interpret(r4300,r4300->interp_PC.addr,left);) {
+    u_int addr=r4300->interp_PC.addr;
+    u_int op=tier_fetch(addr);
+    int type=tier_classify(op);
+    u_int ds=tier_fetch(addr+4);
+    u_int ds_addr=(u_int)r4300->new_dynarec_hot_state.regs[(ds>>21)&0x1f]+(u_int)(int)(short)ds;
+    u_int st_addr=(u_int)r4300->new_dynarec_hot_state.regs[(op>>21)&0x1f]+(u_int)(int)(short)op;
+
+    pure_interpret_opcode(r4300);
+
+    if(type==TIER_OP_STORE) {
+      invalidate_cached_code_new_dynarec(r4300,st_addr&0x9ffffff8,8);
+      invalidate_cached_code_new_dynarec(r4300,(st_addr&0x9ffffff8)|0x20000000,8);
+    }
+    if(type==TIER_OP_BRANCH) {
+      if(tier_classify(ds)==TIER_OP_STORE) {
+        invalidate_cached_code_new_dynarec(r4300,ds_addr&0x9ffffff8,8);
+        invalidate_cached_code_new_dynarec(r4300,(ds_addr&0x9ffffff8)|0x20000000,8);
+      }
+      n+=2;
+      break;
+    }
+    n++;
+    left--;
+  }
+
+  cp0_update_count(r4300);
+  r4300->emumode=EMUMODE_DYNAREC;
+  r4300->new_dynarec_hot_state.pc=&r4300->new_dynarec_hot_state.fake_pc;
+  r4300->new_dynarec_hot_state.pcaddr=r4300->interp_PC.addr;
+
+  tier_stats.interpreted_blocks++;
+  tier_stats.interpreted_instructions+=n;
+
+  return get_addr_ht(r4300->new_dynarec_hot_state.pcaddr);
+}
+
+void new_dynarec_set_tier_threshold(unsigned int threshold)
+{
+  tier_threshold=(threshold<TIER_NEVER)?threshold:TIER_NEVER-1;
+}
+
+void new_dynarec_get_tier_stats(struct new_dynarec_tier_stats* stats)
+{
+  *stats=tier_stats;
+}
+#else
+static void *tier_entry(u_int vaddr)
+{
+  (void)vaddr;
+  return NULL;
+}
+#endif
+
 void *dynamic_linker(void * src, u_int vaddr)
 {
   assert((vaddr&1)==0);
@@ -2578,7 +2882,12 @@ void *dynamic_linker(void * src, u_int vaddr)
     return (void*)(((intptr_t)head->clean_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
+  void *tier=tier_entry(vaddr);
+  if(tier!=NULL) return tier;
+
+  benchmark_section_start(BENCHMARK_SECTION_COMPILER);
   int r=new_recompile_block(vaddr);
+  benchmark_section_end(BENCHMARK_SECTION_COMPILER);
   if(r==0) return dynamic_linker(src,vaddr);
   // Execute in unmapped page, generate pagefault execption
   assert(r4300->cp0.tlb.LUT_r[(vaddr&~1) >> 12] == 0);
@@ -2636,7 +2945,9 @@ void *dynamic_linker_ds(void * src, u_int vaddr)
     return (void*)(((intptr_t)head->clean_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
+  benchmark_section_start(BENCHMARK_SECTION_COMPILER);
   int r=new_recompile_block((vaddr&0xFFFFFFF8)+1);
+  benchmark_section_end(BENCHMARK_SECTION_COMPILER);
   if(r==0) return dynamic_linker_ds(src,vaddr);
   // Execute in unmapped page, generate pagefault execption
   assert(r4300->cp0.tlb.LUT_r[(vaddr&~1) >> 12] == 0);
@@ -2674,7 +2985,12 @@ void *get_addr(u_int vaddr)
     return (void*)(((intptr_t)head->clean_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
+  void *tier=tier_entry(vaddr);
+  if(tier!=NULL) return tier;
+
+  benchmark_section_start(BENCHMARK_SECTION_COMPILER);
   int r=new_recompile_block(vaddr);
+  benchmark_section_end(BENCHMARK_SECTION_COMPILER);
   if(r==0) return get_addr(vaddr);
   // Execute in unmapped page, generate pagefault execption
   assert(r4300->cp0.tlb.LUT_r[(vaddr&~1) >> 12] == 0);
@@ -2725,7 +3041,9 @@ void *get_addr_32(u_int vaddr,u_int flags)
     return (void*)(((intptr_t)head->clean_addr-(intptr_t)base_addr)+(intptr_t)base_addr_rx);
   }
 
+  benchmark_section_start(BENCHMARK_SECTION_COMPILER);
   int r=new_recompile_block(vaddr);
+  benchmark_section_end(BENCHMARK_SECTION_COMPILER);
   if(r==0) return get_addr(vaddr);
   // Execute in unmapped page, generate pagefault execption
   assert(r4300->cp0.tlb.LUT_r[(vaddr&~1) >> 12] == 0);
@@ -6936,6 +7254,35 @@ static void syscall_assemble(int i,struct regstat *i_regs)
   emit_jmp((intptr_t)jump_syscall);
 }
 
+#ifdef DBG
+// Call the debugger on entry to instruction i. This is emitted at the
+// branch target entry point, so internal branches hit the trap as well.
+// Delay slots are not trapped.
+static void debugger_trap_assemble(int i)
+{
+  u_int hr,reglist=0;
+  for(hr=0;hr<HOST_REGS;hr++) {
+    if(regs[i].regmap_entry[hr]>=0) reglist|=1<<hr;
+  }
+  int cc=get_reg(regs[i].regmap_entry,CCREG);
+  if(cc>=0) {
+    emit_storereg(CCREG,cc);
+  }
+  save_regs(reglist);
+#if NEW_DYNAREC == NEW_DYNAREC_X86
+  emit_pushimm(CLOCK_DIVIDER*ccadj[i]);
+  emit_pushimm(start+i*4);
+  emit_call((intptr_t)debugger_trap);
+  emit_addimm(ESP,8,ESP);
+#else
+  emit_movimm(start+i*4,ARG1_REG);
+  emit_movimm(CLOCK_DIVIDER*ccadj[i],ARG2_REG);
+  emit_call((intptr_t)debugger_trap);
+#endif
+  restore_regs(reglist);
+}
+#endif
+
 static void ds_assemble(int i,struct regstat *i_regs)
 {
   is_delayslot=1;
@@ -8697,6 +9044,10 @@ void new_dynarec_init(void)
 
   assert(((uintptr_t)g_dev.rdram.dram&7)==0); //8 bytes aligned
   out=(u_char *)base_addr;
+#ifdef NEW_DYNAREC_CODE_CACHE
+  code_relocs_first=code_relocs_end=0;
+  code_pass_base=0;
+#endif
 
   g_dev.r4300.new_dynarec_hot_state.pc = &g_dev.r4300.new_dynarec_hot_state.fake_pc;
   g_dev.r4300.new_dynarec_hot_state.fake_pc.f.r.rs = &g_dev.r4300.new_dynarec_hot_state.rs;
@@ -8729,6 +9080,10 @@ void new_dynarec_init(void)
 
   tlb_speed_hacks();
   arch_init();
+#if !defined(RECOMP_DBG)
+  memset(tier_counts,0,sizeof(tier_counts));
+  memset(&tier_stats,0,sizeof(tier_stats));
+#endif
 }
 
 void new_dynarec_cleanup(void)
@@ -8742,6 +9097,12 @@ void new_dynarec_cleanup(void)
   for(n=0;n<4096;n++) ll_clear(jump_out+n);
   for(n=0;n<4096;n++) ll_clear(jump_dirty+n);
   assert(copy_size==0);
+#if !defined(RECOMP_DBG)
+  if(tier_threshold!=0)
+    DebugMessage(M64MSG_INFO, "Dynarec tiering: %llu blocks (%llu instructions) interpreted, %llu promoted, %llu compiled directly",
+      (unsigned long long)tier_stats.interpreted_blocks, (unsigned long long)tier_stats.interpreted_instructions,
+      (unsigned long long)tier_stats.promotions, (unsigned long long)tier_stats.direct_compiles);
+#endif
 #if !defined(RECOMP_DBG)
   #if defined(WIN32)
     VirtualFree(base_addr, 0, MEM_RELEASE);
@@ -8754,7 +9115,333 @@ void new_dynarec_cleanup(void)
 #ifdef ROM_COPY
   if (munmap (ROM_COPY, 67108864) < 0) {DebugMessage(M64MSG_ERROR, "munmap() failed");}
 #endif
+#ifdef NEW_DYNAREC_CODE_CACHE
+  free(code_relocs);
+  code_relocs=NULL;
+  code_relocs_first=code_relocs_end=code_relocs_max=0;
+#endif
+}
+
+#if !defined(RECOMP_DBG)
+/* Persistent code cache
+ *
+ * The translation cache is saved when emulation stops and reloaded on the
+ * next boot of the same ROM. Restored blocks are only put in jump_dirty, so
+ * each one is checked against RDRAM by verify_dirty before get_addr links it
+ * into hash_table, and clean_blocks moves it to jump_in as usual.
+ * Links between blocks are removed on load and recreated by dynamic_linker.
+ *
+ * Absolute host addresses embedded in the generated code are recorded by
+ * add_code_reloc and saved with the cache, so they can be patched when the
+ * core or RDRAM is loaded at a different address (ASLR, PIE). References
+ * relative to the instruction pointer don't need it: the translation cache
+ * lives in g_dev and moves together with the rest of the core image. */
+
+static char *code_cache_path;
+
+#ifdef NEW_DYNAREC_CODE_CACHE
+#define CODE_CACHE_MAGIC "M64PNDC"
+#define CODE_CACHE_VERSION 3
+
+struct code_cache_header
+{
+  char magic[8];
+  uint32_t version;
+  uint64_t build_id;
+  char rom_md5[36];
+  uint64_t image_base;
+  uint64_t rdram_base;
+  uint32_t rdram_size;
+  uint32_t count_per_op;
+  uint32_t count_per_op_denom_pot;
+  uint32_t using_tlb;
+  uint32_t code_size;
+  uint32_t out;
+  uint32_t expirep;
+  uint32_t entry_count;
+  uint32_t link_count;
+  uint32_t reloc_count;
+};
+
+struct code_cache_entry
+{
+  uint32_t page;
+  uint32_t vaddr;
+  uint32_t reg32;
+  uint32_t start;
+  uint32_t length;
+  uint32_t addr;
+  uint32_t clean_addr;
+};
+
+// FNV-1a hash identifying the build of the core. The generated code is
+// produced by this file (compiled at build_time) and calls into the code of
+// this file, the assembly linkage and the cached interpreter, so each of them
+// must be at the same place relative to g_dev for the cache to be reused.
+static uint64_t code_cache_build_id(void)
+{
+  static const char build_time[]=__DATE__ " " __TIME__;
+  const uintptr_t image=(uintptr_t)&g_dev;
+  const uint64_t layout[]={
+    NEW_DYNAREC,
+    TARGET_SIZE_2,
+    MAX_OUTPUT_BLOCK_SIZE,
+    sizeof(g_dev),
+    (uintptr_t)base_addr-image,
+    (uintptr_t)hash_table-image,
+    (uintptr_t)new_recompile_block-image,
+    (uintptr_t)get_addr_ht-image,
+    (uintptr_t)invalidate_block-image,
+    (uintptr_t)verify_code-image,
+    (uintptr_t)dyna_linker-image,
+    (uintptr_t)cc_interrupt-image,
+    (uintptr_t)do_interrupt-image,
+    (uintptr_t)fp_exception-image,
+    (uintptr_t)jump_syscall-image,
+    (uintptr_t)jump_eret-image,
+    (uintptr_t)cached_interp_DIV-image,
+    (uintptr_t)cached_interp_TLBP-image,
+  };
+  const unsigned char *p=(const unsigned char *)layout;
+  uint64_t hash=UINT64_C(0xcbf29ce484222325);
+  size_t n;
+  for(n=0;n<sizeof(layout);n++)
+    hash=(hash^p[n])*UINT64_C(0x100000001b3);
+  for(n=0;n<sizeof(build_time)-1;n++)
+    hash=(hash^(unsigned char)build_time[n])*UINT64_C(0x100000001b3);
+  return hash;
+}
+
+static void code_cache_init_header(struct code_cache_header *header)
+{
+  memset(header,0,sizeof(*header));
+  memcpy(header->magic,CODE_CACHE_MAGIC,sizeof(CODE_CACHE_MAGIC));
+  header->version=CODE_CACHE_VERSION;
+  header->build_id=code_cache_build_id();
+  strncpy(header->rom_md5,ROM_SETTINGS.MD5,sizeof(header->rom_md5)-1);
+  header->image_base=(uintptr_t)&g_dev;
+  header->rdram_base=(uintptr_t)g_dev.rdram.dram;
+  // 4 or 8 MB depending on DisableExtraMem, it decides which constant addresses are RDRAM
+  header->rdram_size=g_dev.rdram.dram_size;
+  header->count_per_op=g_dev.r4300.cp0.count_per_op;
+  header->count_per_op_denom_pot=g_dev.r4300.cp0.count_per_op_denom_pot;
+}
+
+// Only blocks from KSEG0 RDRAM are cached; mapped and SP DMEM/IMEM code is recompiled
+static int code_cache_keep(const struct ll_entry *head,u_int code_size)
+{
+  return (signed int)head->vaddr>=(signed int)0x80000000&&(signed int)head->vaddr<(signed int)0x80800000
+      && head->start>=0x80000000&&head->start+head->length<=0x80800000
+      && (uintptr_t)head->addr-(uintptr_t)base_addr<code_size
+      && (uintptr_t)head->clean_addr-(uintptr_t)base_addr<code_size
+      // Don't save blocks which are about to expire from the cache
+      && (((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2));
+}
+#endif /* NEW_DYNAREC_CODE_CACHE */
+
+void new_dynarec_set_code_cache_path(const char *path)
+{
+  free(code_cache_path);
+  code_cache_path=(path!=NULL)?strdup(path):NULL;
+}
+
+void new_dynarec_save_code_cache(void)
+{
+#ifdef NEW_DYNAREC_CODE_CACHE
+  struct code_cache_header header;
+  struct code_cache_entry entry;
+  struct ll_entry *head;
+  u_int code_size;
+  u_int i;
+  int n;
+  FILE *f;
+
+  if(code_cache_path==NULL) return;
+
+  // Blocks may extend up to MAX_OUTPUT_BLOCK_SIZE past their entry points
+  code_size=(uintptr_t)out-(uintptr_t)base_addr;
+  for(n=0;n<4096;n++) {
+    for(head=jump_dirty[n];head!=NULL;head=head->next) {
+      u_int end=(uintptr_t)head->addr-(uintptr_t)base_addr+MAX_OUTPUT_BLOCK_SIZE;
+      if(end>code_size) code_size=end;
+    }
+  }
+  if(code_size>(1<<TARGET_SIZE_2)) code_size=1<<TARGET_SIZE_2;
+
+  code_cache_init_header(&header);
+  header.using_tlb=using_tlb;
+  header.code_size=code_size;
+  header.out=(uintptr_t)out-(uintptr_t)base_addr;
+  header.expirep=expirep;
+  trim_code_relocs();
+  for(i=code_relocs_first;i<code_relocs_end;i++)
+    if(((code_relocs[i]>>1)&((1<<TARGET_SIZE_2)-1))<code_size) header.reloc_count++;
+  for(n=0;n<4096;n++) {
+    for(head=jump_dirty[n];head!=NULL;head=head->next)
+      if(code_cache_keep(head,code_size)) header.entry_count++;
+    for(head=jump_out[n];head!=NULL;head=head->next)
+      if((uintptr_t)head->addr-(uintptr_t)base_addr<code_size) header.link_count++;
+  }
+
+  if(header.entry_count==0) return;
+
+  f=fopen(code_cache_path,"wb");
+  if(f==NULL) {
+    DebugMessage(M64MSG_WARNING, "Couldn't open dynarec code cache for writing: %s", code_cache_path);
+    return;
+  }
+
+  fwrite(&header,sizeof(header),1,f);
+  fwrite(base_addr,1,code_size,f);
+  for(n=0;n<4096;n++) {
+    for(head=jump_dirty[n];head!=NULL;head=head->next) {
+      if(!code_cache_keep(head,code_size)) continue;
+      entry.page=n;
+      entry.vaddr=head->vaddr;
+      entry.reg32=head->reg32;
+      entry.start=head->start;
+      entry.length=head->length;
+      entry.addr=(uintptr_t)head->addr-(uintptr_t)base_addr;
+      entry.clean_addr=(uintptr_t)head->clean_addr-(uintptr_t)base_addr;
+      fwrite(&entry,sizeof(entry),1,f);
+      fwrite(head->copy,1,head->length,f);
+    }
+  }
+  for(n=0;n<4096;n++) {
+    for(head=jump_out[n];head!=NULL;head=head->next) {
+      uint32_t link=(uintptr_t)head->addr-(uintptr_t)base_addr;
+      if(link<code_size) fwrite(&link,sizeof(link),1,f);
+    }
+  }
+  // Relocations are stored as (offset<<1)|kind, oldest first
+  for(i=code_relocs_first;i<code_relocs_end;i++) {
+    uint32_t reloc=(uint32_t)(((code_relocs[i]>>1)&((1<<TARGET_SIZE_2)-1))<<1)|(code_relocs[i]&1);
+    if((reloc>>1)<code_size) fwrite(&reloc,sizeof(reloc),1,f);
+  }
+
+  if(ferror(f))
+    DebugMessage(M64MSG_WARNING, "Failed to write dynarec code cache: %s", code_cache_path);
+  else
+    DebugMessage(M64MSG_INFO, "Saved %u blocks (%u KB) to dynarec code cache", header.entry_count, code_size>>10);
+  fclose(f);
+#endif
+}
+
+void new_dynarec_load_code_cache(void)
+{
+#ifdef NEW_DYNAREC_CODE_CACHE
+  struct code_cache_header header;
+  struct code_cache_header expected;
+  struct code_cache_entry entry;
+  u_int i;
+  FILE *f;
+
+  if(code_cache_path==NULL) return;
+
+  f=fopen(code_cache_path,"rb");
+  if(f==NULL) return;
+
+  code_cache_init_header(&expected);
+  if(fread(&header,sizeof(header),1,f)!=1
+   ||memcmp(header.magic,expected.magic,sizeof(header.magic))!=0
+   ||header.version!=expected.version
+   ||header.build_id!=expected.build_id
+   ||strncmp(header.rom_md5,expected.rom_md5,sizeof(header.rom_md5))!=0
+   ||header.rdram_size!=expected.rdram_size
+   ||header.count_per_op!=expected.count_per_op
+   ||header.count_per_op_denom_pot!=expected.count_per_op_denom_pot
+   // Blocks compiled without TLB lookups are wrong once the TLB maps memory
+   ||(using_tlb&&!header.using_tlb)
+   ||header.code_size>(1<<TARGET_SIZE_2)
+   ||header.out>=header.code_size
+   ||header.link_count>header.code_size
+   ||header.reloc_count>header.code_size) {
+    DebugMessage(M64MSG_INFO, "Dynarec code cache is stale, ignoring it");
+    fclose(f);
+    return;
+  }
+  if(fread(base_addr,1,header.code_size,f)!=header.code_size) {
+    DebugMessage(M64MSG_WARNING, "Dynarec code cache is truncated, ignoring it");
+    fclose(f);
+    return;
+  }
+
+  out=(u_char *)base_addr+header.out;
+  expirep=header.expirep;
+
+  for(i=0;i<header.entry_count;i++) {
+    if(fread(&entry,sizeof(entry),1,f)!=1||entry.page>=4096||(entry.length&3)!=0
+     ||entry.length>MAXBLOCK*4||entry.addr>=header.code_size||entry.clean_addr>=header.code_size)
+      break;
+    u_int *copy_ptr=(u_int *)malloc(entry.length+4);
+    assert(copy_ptr!=NULL);
+    if(fread(copy_ptr,1,entry.length,f)!=entry.length) {
+      free(copy_ptr);
+      break;
+    }
+    copy_ptr[entry.length>>2]=1;
+    copy_size+=entry.length+4;
+    struct ll_entry *head=ll_add_32(jump_dirty+entry.page,entry.vaddr,entry.reg32,
+      (u_char *)base_addr+entry.addr,(u_char *)base_addr+entry.clean_addr,entry.start,copy_ptr,entry.length);
+    set_dirty_stub_head(head->addr,head);
+  }
+
+  // The link sites follow the blocks, but the stubs they point to may hold
+  // absolute addresses, so they are unlinked after the code is relocated
+  uint32_t *links=(uint32_t *)malloc((header.link_count+1)*sizeof(uint32_t));
+  assert(links!=NULL);
+  int valid=i==header.entry_count
+    &&fread(links,sizeof(uint32_t),header.link_count,f)==header.link_count;
+
+  // Move the absolute addresses to where the core and RDRAM are now.
+  // Sites past the output pointer were written before the cache wrapped around.
+  code_pass_base=1<<TARGET_SIZE_2;
+  for(i=0;valid&&i<header.reloc_count;i++) {
+    uint32_t reloc;
+    uintptr_t delta;
+    if(fread(&reloc,sizeof(reloc),1,f)!=1||(reloc>>1)+sizeof(uintptr_t)>header.code_size) {
+      valid=0;
+      break;
+    }
+    if((reloc&1)==CODE_RELOC_RDRAM)
+      delta=(uintptr_t)(expected.rdram_base-header.rdram_base);
+    else
+      delta=(uintptr_t)(expected.image_base-header.image_base);
+    *(uintptr_t *)((u_char *)base_addr+(reloc>>1))+=delta;
+    push_code_reloc((reloc>>1)+((reloc>>1)<header.out?code_pass_base:0),reloc&1);
+  }
+
+  // Unlink the blocks, links will be made again once the targets are verified
+  for(i=0;valid&&i<header.link_count;i++) {
+    if(links[i]>=header.code_size) {
+      valid=0;
+      break;
+    }
+    (void)kill_pointer((u_char *)base_addr+links[i]);
+  }
+  free(links);
+
+  if(!valid) {
+    DebugMessage(M64MSG_WARNING, "Dynarec code cache is corrupted, discarding it");
+    fclose(f);
+    for(i=0;i<4096;i++) ll_clear(jump_dirty+i);
+    out=(u_char *)base_addr;
+    expirep=16384;
+    code_relocs_first=code_relocs_end=0;
+    code_pass_base=0;
+    return;
+  }
+
+  fclose(f);
+  DebugMessage(M64MSG_INFO, "Loaded %u blocks from dynarec code cache", header.entry_count);
+  if(perf_jit_enabled())
+    perf_jit_code_load(base_addr_rx,header.out,"new_dynarec code cache",0,0);
+#else
+  if(code_cache_path!=NULL)
+    DebugMessage(M64MSG_WARNING, "Dynarec code cache is not supported on this architecture");
+#endif
 }
+#endif /* !RECOMP_DBG */
 
 int new_recompile_block(int addr)
 {
@@ -11532,6 +12219,10 @@ int new_recompile_block(int addr)
       // branch target entry point
       instr_addr[i]=(uintptr_t)out;
       assem_debug("<->");
+#ifdef DBG
+      if(g_DebuggerActive&&check_breakpoints(start+i*4)!=-1)
+        debugger_trap_assemble(i);
+#endif
       // load regs
       if(regs[i].regmap_entry[HOST_CCREG]==CCREG&&regs[i].regmap[HOST_CCREG]!=CCREG)
         wb_register(CCREG,regs[i].regmap_entry,regs[i].wasdirty,regs[i].was32);
@@ -11810,10 +12501,20 @@ int new_recompile_block(int addr)
   cache_flush((char *)beginning_rx,(char *)out_rx);
   #endif
 
+  #if !defined(RECOMP_DBG)
+  if(perf_jit_enabled())
+    perf_jit_code_load((u_char *)base_addr_rx+(beginning-(uintptr_t)base_addr),(uintptr_t)out-beginning,
+      "new_dynarec",start,start+slen*4);
+  #endif
+
   // If we're within 256K of the end of the buffer,
   // start over from the beginning. (Is 256K enough?)
-  if(out > (u_char *)((u_char *)base_addr+(1<<TARGET_SIZE_2)-MAX_OUTPUT_BLOCK_SIZE-JUMP_TABLE_SIZE))
+  if(out > (u_char *)((u_char *)base_addr+(1<<TARGET_SIZE_2)-MAX_OUTPUT_BLOCK_SIZE-JUMP_TABLE_SIZE)) {
     out=(u_char *)base_addr;
+#ifdef NEW_DYNAREC_CODE_CACHE
+    code_pass_base+=1<<TARGET_SIZE_2;
+#endif
+  }
 
   // Trap writes to any of the pages we compiled
   for(i=start>>12;i<=(int)((start+slen*4-4)>>12);i++) {
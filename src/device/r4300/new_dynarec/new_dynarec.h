@@ -94,4 +94,22 @@ void new_dynarec_init(void);
 void new_dyna_start(void);
 void new_dynarec_cleanup(void);
 
+/* Tiered compilation counters, reset by new_dynarec_init */
+struct new_dynarec_tier_stats
+{
+    uint64_t interpreted_blocks;
+    uint64_t interpreted_instructions;
+    uint64_t promotions;
+    uint64_t direct_compiles;
+};
+
+/* Interpret block entries until they are reached threshold times (0 disables tiering) */
+void new_dynarec_set_tier_threshold(unsigned int threshold);
+void new_dynarec_get_tier_stats(struct new_dynarec_tier_stats* stats);
+
+/* Persistent code cache (NULL path disables it) */
+void new_dynarec_set_code_cache_path(const char* path);
+void new_dynarec_load_code_cache(void);
+void new_dynarec_save_code_cache(void);
+
 #endif /* M64P_DEVICE_R4300_NEW_DYNAREC_H */
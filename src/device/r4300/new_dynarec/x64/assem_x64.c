@@ -3053,6 +3053,15 @@ static void do_dirty_stub_ds(struct ll_entry *head)
   emit_call((intptr_t)verify_code);
 }
 
+// Point the dirty stub of a block restored from the code cache to its new ll_entry
+static void set_dirty_stub_head(void *stub, struct ll_entry *head)
+{
+  u_char *ptr=(u_char *)stub;
+  assert((ptr[0]&0xf8)==0x48); // rex.w
+  assert((ptr[1]&0xf8)==0xb8); // mov imm64
+  *((uint64_t *)(ptr+2))=(uintptr_t)head;
+}
+
 /* TLB */
 
 static int do_tlb_r(int s,int ar,int map,int cache,int x,int c,u_int addr)
@@ -99,6 +99,7 @@ cglobal invalidate_block_edi
 cglobal breakpoint
 cglobal dyna_linker
 cglobal dyna_linker_ds
+cglobal jump_interp_tier
 
 cextern base_addr
 cextern new_recompile_block
@@ -115,6 +116,7 @@ cextern cop1_unusable
 cextern SYSCALL_new
 cextern dynamic_linker
 cextern dynamic_linker_ds
+cextern new_dynarec_interp_tier
 
 section .bss
 align 4
@@ -248,6 +250,12 @@ dyna_linker_ds:
     call    dynamic_linker_ds
     jmp     rax
 
+jump_interp_tier:
+    mov     DWORD[rel g_dev_r4300_new_dynarec_hot_state_cycle_count],    CCREG
+    call    new_dynarec_interp_tier
+    mov     CCREG,    DWORD[rel g_dev_r4300_new_dynarec_hot_state_cycle_count]
+    jmp     rax
+
 new_dyna_start:
     ;we must push an even # of registers to keep stack 16-byte aligned
 %ifdef WIN64
@@ -735,6 +735,17 @@ static void output_w32(u_int word)
   *((u_int *)out)=word;
   out+=4;
 }
+// Output a host address. Absolute addresses into the core image or RDRAM
+// are recorded with their kind, so that the code cache can relocate them,
+// and displacements from a register are output with CODE_RELOC_NONE.
+static void output_w32_addr(u_int addr,int reloc)
+{
+#ifdef NEW_DYNAREC_CODE_CACHE
+  if(reloc!=CODE_RELOC_NONE)
+    add_code_reloc(out,reloc);
+#endif
+  output_w32(addr);
+}
 
 static void emit_mov(int rs,int rt)
 {
@@ -877,7 +888,7 @@ static void emit_loadreg(int r, int hr)
     assem_debug("mov %x+%d,%%%s",addr,r,regname[hr]);
     output_byte(0x8B);
     output_modrm(0,5,hr);
-    output_w32(addr);
+    output_w32_addr(addr,CODE_RELOC_IMAGE);
   }
 }
 static void emit_storereg(int r, int hr)
@@ -893,7 +904,7 @@ static void emit_storereg(int r, int hr)
   assem_debug("mov %%%s,%x+%d",regname[hr],addr,r);
   output_byte(0x89);
   output_modrm(0,5,hr);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
 }
 
 static void emit_test(int rs, int rt)
@@ -1396,7 +1407,7 @@ static void emit_cmovne(const u_int *addr,int rt)
   output_byte(0x0F);
   output_byte(0x45);
   output_modrm(0,5,rt);
-  output_w32((int)addr);
+  output_w32_addr((int)addr,CODE_RELOC_IMAGE);
 }
 static void emit_cmovl(const u_int *addr,int rt)
 {
@@ -1407,7 +1418,7 @@ static void emit_cmovl(const u_int *addr,int rt)
   output_byte(0x0F);
   output_byte(0x4C);
   output_modrm(0,5,rt);
-  output_w32((int)addr);
+  output_w32_addr((int)addr,CODE_RELOC_IMAGE);
 }
 static void emit_cmovs(const u_int *addr,int rt)
 {
@@ -1418,7 +1429,7 @@ static void emit_cmovs(const u_int *addr,int rt)
   output_byte(0x0F);
   output_byte(0x48);
   output_modrm(0,5,rt);
-  output_w32((int)addr);
+  output_w32_addr((int)addr,CODE_RELOC_IMAGE);
 }
 static void emit_cmovne_reg(int rs,int rt)
 {
@@ -1700,12 +1711,18 @@ static void emit_pushimm(int imm)
   output_byte(0x68);
   output_w32(imm);
 }
+static void emit_pushaddr(int addr)
+{
+  assem_debug("push $%x",addr);
+  output_byte(0x68);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
+}
 static void emit_pushmem(int addr)
 {
   assem_debug("push *%x",addr);
   output_byte(0xFF);
   output_modrm(0,5,6);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
 }
 static void emit_pusha(void)
 {
@@ -1749,17 +1766,21 @@ static void emit_jmpmem_indexed(u_int addr,u_int r)
   assert(r<8);
   output_byte(0xFF);
   output_modrm(2,r,4);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
 }
 
-static void emit_readword(int addr, int rt)
+static void emit_readword_reloc(int addr, int rt, int reloc)
 {
   assem_debug("mov %x,%%%s",addr,regname[rt]);
   output_byte(0x8B);
   output_modrm(0,5,rt);
-  output_w32(addr);
+  output_w32_addr(addr,reloc);
 }
-static void emit_readword_indexed(int addr, int rs, int rt)
+static void emit_readword(int addr, int rt)
+{
+  emit_readword_reloc(addr,rt,CODE_RELOC_IMAGE);
+}
+static void emit_readword_indexed_reloc(int addr, int rs, int rt, int reloc)
 {
   assem_debug("mov %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
   output_byte(0x8B);
@@ -1772,12 +1793,16 @@ static void emit_readword_indexed(int addr, int rs, int rt)
   {
     output_modrm(2,rs,rt);
     if(rs==ESP) output_sib(0,4,4);
-    output_w32(addr);
+    output_w32_addr(addr,reloc);
   }
 }
+static void emit_readword_indexed(int addr, int rs, int rt)
+{
+  emit_readword_indexed_reloc(addr,rs,rt,CODE_RELOC_NONE);
+}
 static void emit_readword_tlb(int addr, int map, int rt)
 {
-  if(map<0) emit_readword(addr+(int)g_dev.rdram.dram-0x80000000, rt);
+  if(map<0) emit_readword_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rt, CODE_RELOC_RDRAM);
   else
   {
     assem_debug("mov (%x,%%%s,4),%%%s",addr,regname[map],regname[rt]);
@@ -1789,7 +1814,7 @@ static void emit_readword_tlb(int addr, int map, int rt)
 }
 static void emit_readword_indexed_tlb(int addr, int rs, int map, int rt)
 {
-  if(map<0) emit_readword_indexed(addr+(int)g_dev.rdram.dram-0x80000000, rs, rt);
+  if(map<0) emit_readword_indexed_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rs, rt, CODE_RELOC_RDRAM);
   else {
     assem_debug("mov %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
@@ -1815,23 +1840,23 @@ static void emit_readptr(int addr, int rt)
 {
   emit_readword(addr,rt);
 }
-static void emit_movmem_indexedx4(int addr, int rs, int rt)
+static void emit_movmem_indexedx4(int addr, int rs, int rt, int reloc)
 {
   assem_debug("mov (%x,%%%s,4),%%%s",addr,regname[rs],regname[rt]);
   output_byte(0x8B);
   output_modrm(0,4,rt);
   output_sib(2,rs,5);
-  output_w32(addr);
+  output_w32_addr(addr,reloc);
 }
 static void emit_readdword_tlb(int addr, int map, int rh, int rl)
 {
   if(map<0) {
-    if(rh>=0) emit_readword(addr+(int)g_dev.rdram.dram-0x80000000, rh);
-    emit_readword(addr+(int)g_dev.rdram.dram-0x7FFFFFFC, rl);
+    if(rh>=0) emit_readword_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rh, CODE_RELOC_RDRAM);
+    emit_readword_reloc(addr+(int)g_dev.rdram.dram-0x7FFFFFFC, rl, CODE_RELOC_RDRAM);
   }
   else {
-    if(rh>=0) emit_movmem_indexedx4(addr, map, rh);
-    emit_movmem_indexedx4(addr+4, map, rl);
+    if(rh>=0) emit_movmem_indexedx4(addr, map, rh, CODE_RELOC_NONE);
+    emit_movmem_indexedx4(addr+4, map, rl, CODE_RELOC_NONE);
   }
 }
 static void emit_readdword_indexed_tlb(int addr, int rs, int map, int rh, int rl)
@@ -1840,25 +1865,33 @@ static void emit_readdword_indexed_tlb(int addr, int rs, int map, int rh, int rl
   if(rh>=0) emit_readword_indexed_tlb(addr, rs, map, rh);
   emit_readword_indexed_tlb(addr+4, rs, map, rl);
 }
-static void emit_movsbl(int addr, int rt)
+static void emit_movsbl_reloc(int addr, int rt, int reloc)
 {
   assem_debug("movsbl %x,%%%s",addr,regname[rt]);
   output_byte(0x0F);
   output_byte(0xBE);
   output_modrm(0,5,rt);
-  output_w32(addr);
+  output_w32_addr(addr,reloc);
 }
-static void emit_movsbl_indexed(int addr, int rs, int rt)
+static void emit_movsbl(int addr, int rt)
+{
+  emit_movsbl_reloc(addr,rt,CODE_RELOC_IMAGE);
+}
+static void emit_movsbl_indexed_reloc(int addr, int rs, int rt, int reloc)
 {
   assem_debug("movsbl %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
   output_byte(0x0F);
   output_byte(0xBE);
   output_modrm(2,rs,rt);
-  output_w32(addr);
+  output_w32_addr(addr,reloc);
+}
+static void emit_movsbl_indexed(int addr, int rs, int rt)
+{
+  emit_movsbl_indexed_reloc(addr,rs,rt,CODE_RELOC_NONE);
 }
 static void emit_movsbl_tlb(int addr, int map, int rt)
 {
-  if(map<0) emit_movsbl(addr+(int)g_dev.rdram.dram-0x80000000, rt);
+  if(map<0) emit_movsbl_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rt, CODE_RELOC_RDRAM);
   else
   {
     assem_debug("movsbl (%x,%%%s,4),%%%s",addr,regname[map],regname[rt]);
@@ -1871,7 +1904,7 @@ static void emit_movsbl_tlb(int addr, int map, int rt)
 }
 static void emit_movsbl_indexed_tlb(int addr, int rs, int map, int rt)
 {
-  if(map<0) emit_movsbl_indexed(addr+(int)g_dev.rdram.dram-0x80000000, rs, rt);
+  if(map<0) emit_movsbl_indexed_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rs, rt, CODE_RELOC_RDRAM);
   else {
     assem_debug("movsbl %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
@@ -1894,25 +1927,33 @@ static void emit_movsbl_indexed_tlb(int addr, int rs, int map, int rt)
     }
   }
 }
-static void emit_movswl(int addr, int rt)
+static void emit_movswl_reloc(int addr, int rt, int reloc)
 {
   assem_debug("movswl %x,%%%s",addr,regname[rt]);
   output_byte(0x0F);
   output_byte(0xBF);
   output_modrm(0,5,rt);
-  output_w32(addr);
+  output_w32_addr(addr,reloc);
 }
-static void emit_movswl_indexed(int addr, int rs, int rt)
+static void emit_movswl(int addr, int rt)
+{
+  emit_movswl_reloc(addr,rt,CODE_RELOC_IMAGE);
+}
+static void emit_movswl_indexed_reloc(int addr, int rs, int rt, int reloc)
 {
   assem_debug("movswl %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
   output_byte(0x0F);
   output_byte(0xBF);
   output_modrm(2,rs,rt);
-  output_w32(addr);
+  output_w32_addr(addr,reloc);
+}
+static void emit_movswl_indexed(int addr, int rs, int rt)
+{
+  emit_movswl_indexed_reloc(addr,rs,rt,CODE_RELOC_NONE);
 }
 static void emit_movswl_tlb(int addr, int map, int rt)
 {
-  if(map<0) emit_movswl(addr+(int)g_dev.rdram.dram-0x80000000, rt);
+  if(map<0) emit_movswl_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rt, CODE_RELOC_RDRAM);
   else
   {
     assem_debug("movswl (%x,%%%s,4),%%%s",addr,regname[map],regname[rt]);
@@ -1925,7 +1966,7 @@ static void emit_movswl_tlb(int addr, int map, int rt)
 }
 static void emit_movswl_indexed_tlb(int addr, int rs, int map, int rt)
 {
-  if(map<0) emit_movswl_indexed(addr+(int)g_dev.rdram.dram-0x80000000, rs, rt);
+  if(map<0) emit_movswl_indexed_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rs, rt, CODE_RELOC_RDRAM);
   else {
     assem_debug("movswl %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
@@ -1948,25 +1989,33 @@ static void emit_movswl_indexed_tlb(int addr, int rs, int map, int rt)
     }
   }
 }
-static void emit_movzbl(int addr, int rt)
+static void emit_movzbl_reloc(int addr, int rt, int reloc)
 {
   assem_debug("movzbl %x,%%%s",addr,regname[rt]);
   output_byte(0x0F);
   output_byte(0xB6);
   output_modrm(0,5,rt);
-  output_w32(addr);
+  output_w32_addr(addr,reloc);
 }
-static void emit_movzbl_indexed(int addr, int rs, int rt)
+static void emit_movzbl(int addr, int rt)
+{
+  emit_movzbl_reloc(addr,rt,CODE_RELOC_IMAGE);
+}
+static void emit_movzbl_indexed_reloc(int addr, int rs, int rt, int reloc)
 {
   assem_debug("movzbl %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
   output_byte(0x0F);
   output_byte(0xB6);
   output_modrm(2,rs,rt);
-  output_w32(addr);
+  output_w32_addr(addr,reloc);
+}
+static void emit_movzbl_indexed(int addr, int rs, int rt)
+{
+  emit_movzbl_indexed_reloc(addr,rs,rt,CODE_RELOC_NONE);
 }
 static void emit_movzbl_tlb(int addr, int map, int rt)
 {
-  if(map<0) emit_movzbl(addr+(int)g_dev.rdram.dram-0x80000000, rt);
+  if(map<0) emit_movzbl_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rt, CODE_RELOC_RDRAM);
   else
   {
     assem_debug("movzbl (%x,%%%s,4),%%%s",addr,regname[map],regname[rt]);
@@ -1979,7 +2028,7 @@ static void emit_movzbl_tlb(int addr, int map, int rt)
 }
 static void emit_movzbl_indexed_tlb(int addr, int rs, int map, int rt)
 {
-  if(map<0) emit_movzbl_indexed(addr+(int)g_dev.rdram.dram-0x80000000, rs, rt);
+  if(map<0) emit_movzbl_indexed_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rs, rt, CODE_RELOC_RDRAM);
   else {
     assem_debug("movzbl %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
@@ -2002,25 +2051,33 @@ static void emit_movzbl_indexed_tlb(int addr, int rs, int map, int rt)
     }
   }
 }
-static void emit_movzwl(int addr, int rt)
+static void emit_movzwl_reloc(int addr, int rt, int reloc)
 {
   assem_debug("movzwl %x,%%%s",addr,regname[rt]);
   output_byte(0x0F);
   output_byte(0xB7);
   output_modrm(0,5,rt);
-  output_w32(addr);
+  output_w32_addr(addr,reloc);
 }
-static void emit_movzwl_indexed(int addr, int rs, int rt)
+static void emit_movzwl(int addr, int rt)
+{
+  emit_movzwl_reloc(addr,rt,CODE_RELOC_IMAGE);
+}
+static void emit_movzwl_indexed_reloc(int addr, int rs, int rt, int reloc)
 {
   assem_debug("movzwl %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
   output_byte(0x0F);
   output_byte(0xB7);
   output_modrm(2,rs,rt);
-  output_w32(addr);
+  output_w32_addr(addr,reloc);
+}
+static void emit_movzwl_indexed(int addr, int rs, int rt)
+{
+  emit_movzwl_indexed_reloc(addr,rs,rt,CODE_RELOC_NONE);
 }
 static void emit_movzwl_tlb(int addr, int map, int rt)
 {
-  if(map<0) emit_movzwl(addr+(int)g_dev.rdram.dram-0x80000000, rt);
+  if(map<0) emit_movzwl_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rt, CODE_RELOC_RDRAM);
   else
   {
     assem_debug("movzwl (%x,%%%s,4),%%%s",addr,regname[map],regname[rt]);
@@ -2033,7 +2090,7 @@ static void emit_movzwl_tlb(int addr, int map, int rt)
 }
 static void emit_movzwl_indexed_tlb(int addr, int rs, int map, int rt)
 {
-  if(map<0) emit_movzwl_indexed(addr+(int)g_dev.rdram.dram-0x80000000, rs, rt);
+  if(map<0) emit_movzwl_indexed_reloc(addr+(int)g_dev.rdram.dram-0x80000000, rs, rt, CODE_RELOC_RDRAM);
   else {
     assem_debug("movzwl %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map],regname[rt]);
     assert(rs!=ESP);
@@ -2082,9 +2139,9 @@ static void emit_writeword(int rt, int addr)
   assem_debug("movl %%%s,%x",regname[rt],addr);
   output_byte(0x89);
   output_modrm(0,5,rt);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
 }
-static void emit_writeword_indexed(int rt, int addr, int rs)
+static void emit_writeword_indexed_reloc(int rt, int addr, int rs, int reloc)
 {
   assem_debug("mov %%%s,%x+%%%s",regname[rt],addr,regname[rs]);
   output_byte(0x89);
@@ -2097,12 +2154,16 @@ static void emit_writeword_indexed(int rt, int addr, int rs)
   {
     output_modrm(2,rs,rt);
     if(rs==ESP) output_sib(0,4,4);
-    output_w32(addr);
+    output_w32_addr(addr,reloc);
   }
 }
+static void emit_writeword_indexed(int rt, int addr, int rs)
+{
+  emit_writeword_indexed_reloc(rt,addr,rs,CODE_RELOC_NONE);
+}
 static void emit_writeword_indexed_tlb(int rt, int addr, int rs, int map)
 {
-  if(map<0) emit_writeword_indexed(rt, addr+(int)g_dev.rdram.dram-0x80000000, rs);
+  if(map<0) emit_writeword_indexed_reloc(rt, addr+(int)g_dev.rdram.dram-0x80000000, rs, CODE_RELOC_RDRAM);
   else {
     assem_debug("mov %%%s,%x(%%%s,%%%s,1)",regname[rt],addr,regname[rs],regname[map]);
     assert(rs!=ESP);
@@ -2136,9 +2197,9 @@ static void emit_writehword(int rt, int addr)
   output_byte(0x66);
   output_byte(0x89);
   output_modrm(0,5,rt);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
 }
-static void emit_writehword_indexed(int rt, int addr, int rs)
+static void emit_writehword_indexed_reloc(int rt, int addr, int rs, int reloc)
 {
   assem_debug("movw %%%s,%x+%%%s",regname[rt]+1,addr,regname[rs]);
   output_byte(0x66);
@@ -2150,12 +2211,16 @@ static void emit_writehword_indexed(int rt, int addr, int rs)
   else
   {
     output_modrm(2,rs,rt);
-    output_w32(addr);
+    output_w32_addr(addr,reloc);
   }
 }
+static void emit_writehword_indexed(int rt, int addr, int rs)
+{
+  emit_writehword_indexed_reloc(rt,addr,rs,CODE_RELOC_NONE);
+}
 static void emit_writehword_indexed_tlb(int rt, int addr, int rs, int map)
 {
-  if(map<0) emit_writehword_indexed(rt, addr+(int)g_dev.rdram.dram-0x80000000, rs);
+  if(map<0) emit_writehword_indexed_reloc(rt, addr+(int)g_dev.rdram.dram-0x80000000, rs, CODE_RELOC_RDRAM);
   else {
     assem_debug("movw %%%s,%x(%%%s,%%%s,1)",regname[rt]+1,addr,regname[rs],regname[map]);
     assert(rs!=ESP);
@@ -2184,7 +2249,7 @@ static void emit_writebyte(int rt, int addr)
     assem_debug("movb %%%cl,%x",regname[rt][1],addr);
     output_byte(0x88);
     output_modrm(0,5,rt);
-    output_w32(addr);
+    output_w32_addr(addr,CODE_RELOC_IMAGE);
   }
   else
   {
@@ -2193,7 +2258,7 @@ static void emit_writebyte(int rt, int addr)
     emit_xchg(EAX,rt);
   }
 }
-static void emit_writebyte_indexed(int rt, int addr, int rs)
+static void emit_writebyte_indexed_reloc(int rt, int addr, int rs, int reloc)
 {
   if(rt<4) {
     assem_debug("movb %%%cl,%x+%%%s",regname[rt][1],addr,regname[rs]);
@@ -2205,19 +2270,23 @@ static void emit_writebyte_indexed(int rt, int addr, int rs)
     else
     {
       output_modrm(2,rs,rt);
-      output_w32(addr);
+      output_w32_addr(addr,reloc);
     }
   }
   else
   {
     emit_xchg(EAX,rt);
-    emit_writebyte_indexed(EAX,addr,rs==EAX?rt:rs);
+    emit_writebyte_indexed_reloc(EAX,addr,rs==EAX?rt:rs,reloc);
     emit_xchg(EAX,rt);
   }
 }
+static void emit_writebyte_indexed(int rt, int addr, int rs)
+{
+  emit_writebyte_indexed_reloc(rt,addr,rs,CODE_RELOC_NONE);
+}
 static void emit_writebyte_indexed_tlb(int rt, int addr, int rs, int map)
 {
-  if(map<0) emit_writebyte_indexed(rt, addr+(int)g_dev.rdram.dram-0x80000000, rs);
+  if(map<0) emit_writebyte_indexed_reloc(rt, addr+(int)g_dev.rdram.dram-0x80000000, rs, CODE_RELOC_RDRAM);
   else
   if(rt<4) {
     assem_debug("movb %%%cl,%x(%%%s,%%%s,1)",regname[rt][1],addr,regname[rs],regname[map]);
@@ -2251,7 +2320,7 @@ static void emit_writeword_imm(int imm, int addr)
   assem_debug("movl $%x,%x",imm,addr);
   output_byte(0xC7);
   output_modrm(0,5,0);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
   output_w32(imm);
 }
 static void emit_writeword_imm_esp(int imm, int addr)
@@ -2270,7 +2339,7 @@ static void emit_writebyte_imm(int imm, int addr)
   assert(imm>=-128&&imm<128);
   output_byte(0xC6);
   output_modrm(0,5,0);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
   output_byte(imm);
 }
 
@@ -2319,7 +2388,7 @@ static void emit_cmpmem_imm(int addr, int imm)
   assem_debug("cmp $%d,%x",imm,addr);
   output_byte(0x83);
   output_modrm(0,5,7);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
   output_byte(imm);
 }
 
@@ -2332,7 +2401,7 @@ static void emit_cmpmem_indexedsr12_imm(int addr,int r,int imm)
   assem_debug("cmp $%d,%x+%%%s",imm,addr,regname[r]);
   output_byte(0x80);
   output_modrm(2,r,7);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
   output_byte(imm);
 }
 
@@ -2344,7 +2413,7 @@ static void emit_cmpmem_indexed(int addr,int rs,int rt)
   assem_debug("cmp %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
   output_byte(0x39);
   output_modrm(2,rs,rt);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
 }
 
 // Used to preload hash table entries
@@ -2355,7 +2424,7 @@ static void emit_prefetch(void *addr)
   output_byte(0x0F);
   output_byte(0x18);
   output_modrm(0,5,1);
-  output_w32((int)addr);
+  output_w32_addr((int)addr,CODE_RELOC_IMAGE);
 }
 #endif
 
@@ -2365,7 +2434,7 @@ static void emit_prefetch(void *addr)
   assem_debug("sub %x,%%%s",addr,regname[r]);
   output_byte(0x2B);
   output_modrm(0,5,r);
-  output_w32((int)addr);
+  output_w32_addr((int)addr,CODE_RELOC_IMAGE);
 }
 static void emit_subfrommem(int addr,int r)
 {
@@ -2373,7 +2442,7 @@ static void emit_subfrommem(int addr,int r)
   assem_debug("sub %%%s,%x",regname[r],addr);
   output_byte(0x29);
   output_modrm(0,5,r);
-  output_w32((int)addr);
+  output_w32_addr((int)addr,CODE_RELOC_IMAGE);
 }*/
 
 static void emit_flds(int r)
@@ -2564,14 +2633,14 @@ static void emit_fldcw_indexed(int addr,int r)
   output_byte(0xd9);
   output_modrm(0,4,5);
   output_sib(2,r,5);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
 }
 static void emit_fldcw(int addr)
 {
   assem_debug("fldcw %x",addr);
   output_byte(0xd9);
   output_modrm(0,5,5);
-  output_w32(addr);
+  output_w32_addr(addr,CODE_RELOC_IMAGE);
 }
 #ifdef __SSE__
 static void emit_movss_load(u_int addr,u_int ssereg)
@@ -2654,7 +2723,7 @@ static void emit_extjump2(int addr, int target, int linker)
     addr++;
   }
   emit_pushimm(target);
-  emit_pushimm(addr);
+  emit_pushaddr(addr);
   emit_jmp(linker);
 }
 
@@ -2684,6 +2753,14 @@ static void do_dirty_stub_ds(struct ll_entry * head)
   emit_call((int)&verify_code);
 }
 
+// Point the dirty stub of a block restored from the code cache to its new ll_entry
+static void set_dirty_stub_head(void *stub, struct ll_entry *head)
+{
+  u_char *ptr=(u_char *)stub;
+  assert(ptr[0]==0xb8); // mov imm32,%eax
+  *((u_int *)(ptr+1))=(u_int)head;
+}
+
 /* TLB */
 
 static int do_tlb_r(int s,int ar,int map,int cache,int x,int c,u_int addr)
@@ -2700,7 +2777,7 @@ static int do_tlb_r(int s,int ar,int map,int cache,int x,int c,u_int addr)
     emit_shrimm(map,12,map);
     // Schedule this while we wait on the load
     //if(x) emit_xorimm(addr,x,addr);
-    emit_movmem_indexedx4((int)g_dev.r4300.new_dynarec_hot_state.memory_map,map,map);
+    emit_movmem_indexedx4((int)g_dev.r4300.new_dynarec_hot_state.memory_map,map,map,CODE_RELOC_IMAGE);
   }
   return map;
 }
@@ -2729,7 +2806,7 @@ static int do_tlb_w(int s,int ar,int map,int cache,int x,int c,u_int addr)
     emit_shrimm(map,12,map);
     // Schedule this while we wait on the load
     //if(x) emit_xorimm(s,x,addr);
-    emit_movmem_indexedx4((int)g_dev.r4300.new_dynarec_hot_state.memory_map,map,map);
+    emit_movmem_indexedx4((int)g_dev.r4300.new_dynarec_hot_state.memory_map,map,map,CODE_RELOC_IMAGE);
   }
   emit_shlimm(map,2,map);
   return map;
@@ -3196,7 +3273,7 @@ static void fconv_assemble_x86(int i,struct regstat *i_regs)
   if(opcode2[i]==0x14&&(source[i]&0x3f)==0x20) {
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>> 6)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     emit_call((int)cvt_s_w);
     emit_addimm(ESP,12,ESP);
   }
@@ -3209,14 +3286,14 @@ static void fconv_assemble_x86(int i,struct regstat *i_regs)
   if(opcode2[i]==0x15&&(source[i]&0x3f)==0x20) {
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>> 6)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     emit_call((int)cvt_s_l);
     emit_addimm(ESP,12,ESP);
   }
   if(opcode2[i]==0x15&&(source[i]&0x3f)==0x21) {
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>> 6)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     emit_call((int)cvt_d_l);
     emit_addimm(ESP,12,ESP);
   }
@@ -3230,14 +3307,14 @@ static void fconv_assemble_x86(int i,struct regstat *i_regs)
   if(opcode2[i]==0x10&&(source[i]&0x3f)==0x24) {
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>> 6)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     emit_call((int)cvt_w_s);
     emit_addimm(ESP,12,ESP);
   }
   if(opcode2[i]==0x10&&(source[i]&0x3f)==0x25) {
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>> 6)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     emit_call((int)cvt_l_s);
     emit_addimm(ESP,12,ESP);
   }
@@ -3245,21 +3322,21 @@ static void fconv_assemble_x86(int i,struct regstat *i_regs)
   if(opcode2[i]==0x11&&(source[i]&0x3f)==0x20) {
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>> 6)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     emit_call((int)cvt_s_d);
     emit_addimm(ESP,12,ESP);
   }
   if(opcode2[i]==0x11&&(source[i]&0x3f)==0x24) {
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>> 6)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     emit_call((int)cvt_w_d);
     emit_addimm(ESP,12,ESP);
   }
   if(opcode2[i]==0x11&&(source[i]&0x3f)==0x25) {
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>> 6)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     emit_call((int)cvt_l_d);
     emit_addimm(ESP,12,ESP);
   }
@@ -3453,7 +3530,7 @@ static void fcomp_assemble(int i,struct regstat *i_regs)
   if(opcode2[i]==0x10) {
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>>16)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     if((source[i]&0x3f)==0x30) emit_call((int)c_f_s);
     if((source[i]&0x3f)==0x31) emit_call((int)c_un_s);
     if((source[i]&0x3f)==0x32) emit_call((int)c_eq_s);
@@ -3474,7 +3551,7 @@ static void fcomp_assemble(int i,struct regstat *i_regs)
   if(opcode2[i]==0x11) {
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>>16)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     if((source[i]&0x3f)==0x30) emit_call((int)c_f_d);
     if((source[i]&0x3f)==0x31) emit_call((int)c_un_d);
     if((source[i]&0x3f)==0x32) emit_call((int)c_eq_d);
@@ -3618,7 +3695,7 @@ static void float_assemble(int i,struct regstat *i_regs)
     if((source[i]&0x3f)<4)
       emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>>16)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_simple[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     switch(source[i]&0x3f)
     {
       case 0x00:
@@ -3662,7 +3739,7 @@ static void float_assemble(int i,struct regstat *i_regs)
     if((source[i]&0x3f)<4)
       emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>>16)&0x1f]);
     emit_pushmem((intptr_t)&g_dev.r4300.new_dynarec_hot_state.cp1_regs_double[(source[i]>>11)&0x1f]);
-    emit_pushimm((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
+    emit_pushaddr((int)&g_dev.r4300.new_dynarec_hot_state.cp1_fcr31);
     switch(source[i]&0x3f)
     {
       case 0x00:
@@ -3960,6 +4037,10 @@ static void do_miniht_insert(int return_address,int rt,int temp) {
   emit_writeword(rt,(int)&g_dev.r4300.new_dynarec_hot_state.mini_ht[(return_address&0xFF)>>3][0]);
   add_to_linker((int)out,return_address,1);
   emit_writeword_imm(0,(int)&g_dev.r4300.new_dynarec_hot_state.mini_ht[(return_address&0xFF)>>3][1]);
+#ifdef NEW_DYNAREC_CODE_CACHE
+  // The immediate is set to the host address of the return point by the linker
+  add_code_reloc(out-4,CODE_RELOC_IMAGE);
+#endif
 }
 
 // We don't need this for x86
@@ -93,6 +93,7 @@ cglobal invalidate_block_edi
 cglobal breakpoint
 cglobal dyna_linker
 cglobal dyna_linker_ds
+cglobal jump_interp_tier
 
 cextern base_addr
 cextern new_recompile_block
@@ -109,6 +110,7 @@ cextern cop1_unusable
 cextern SYSCALL_new
 cextern dynamic_linker
 cextern dynamic_linker_ds
+cextern new_dynarec_interp_tier
 
 %ifdef PIC
 cextern _GLOBAL_OFFSET_TABLE_
@@ -242,6 +244,13 @@ dyna_linker_ds:
     add     esp,    8
     jmp     eax
 
+jump_interp_tier:
+    get_got_address
+    mov     [find_local_data(g_dev_r4300_new_dynarec_hot_state_cycle_count)],    esi
+    call    new_dynarec_interp_tier
+    mov     esi,    [find_local_data(g_dev_r4300_new_dynarec_hot_state_cycle_count)]
+    jmp     eax
+
 new_dyna_start:
     push    ebp
     push    ebx
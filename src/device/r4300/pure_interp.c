@@ -30,6 +30,7 @@
 #include "api/debugger.h"
 #include "api/m64p_types.h"
 #include "device/r4300/r4300_core.h"
+#include "main/rsp_thread.h"
 #include "osal/preproc.h"
 
 #ifdef DBG
@@ -743,6 +744,11 @@ void InterpretOpcode(struct r4300_core* r4300)
 	} /* switch ((op >> 26) & 0x3F) */
 }
 
+void pure_interpret_opcode(struct r4300_core* r4300)
+{
+   InterpretOpcode(r4300);
+}
+
 void run_pure_interpreter(struct r4300_core* r4300)
 {
    *r4300_stop(r4300) = 0;
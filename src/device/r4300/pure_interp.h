@@ -26,4 +26,7 @@ struct r4300_core;
 
 void run_pure_interpreter(struct r4300_core* r4300);
 
+/* Executes the single instruction at interp_PC (used by the new dynarec tiering) */
+void pure_interpret_opcode(struct r4300_core* r4300);
+
 #endif /* M64P_DEVICE_R4300_PURE_INTERP_H */
@@ -21,9 +21,6 @@
 
 #include "r4300_core.h"
 #include "cached_interp.h"
-#if defined(COUNT_INSTR)
-#include "instr_counters.h"
-#endif
 #include "new_dynarec/new_dynarec.h"
 #include "pure_interp.h"
 #include "recomp.h"
@@ -34,6 +31,7 @@
 #ifdef DBG
 #include "debugger/dbg_debugger.h"
 #endif
+#include "main/benchmark.h"
 #include "main/main.h"
 
 #include <stdlib.h>
@@ -124,6 +122,22 @@ void poweron_r4300(struct r4300_core* r4300)
 }
 
 
+#ifdef NEW_DYNAREC
+static void report_tier_stats(void)
+{
+    struct new_dynarec_tier_stats stats;
+
+    if (!g_benchmark.enabled)
+        return;
+
+    new_dynarec_get_tier_stats(&stats);
+    benchmark_set_counter("dynarec_tier_interpreted_blocks", stats.interpreted_blocks);
+    benchmark_set_counter("dynarec_tier_interpreted_instructions", stats.interpreted_instructions);
+    benchmark_set_counter("dynarec_tier_promotions", stats.promotions);
+    benchmark_set_counter("dynarec_tier_direct_compiles", stats.direct_compiles);
+}
+#endif
+
 void run_r4300(struct r4300_core* r4300)
 {
 #ifdef OSAL_SSE
@@ -136,11 +150,6 @@ void run_r4300(struct r4300_core* r4300)
     *r4300_stop(r4300) = 0;
     g_rom_pause = 0;
 
-    /* clear instruction counters */
-#if defined(COUNT_INSTR)
-    memset(instr_count, 0, 131*sizeof(instr_count[0]));
-#endif
-
     if (r4300->emumode == EMUMODE_PURE_INTERPRETER)
     {
         DebugMessage(M64MSG_INFO, "Starting R4300 emulator: Pure Interpreter");
@@ -155,7 +164,10 @@ void run_r4300(struct r4300_core* r4300)
         init_blocks(&r4300->cached_interp);
 #ifdef NEW_DYNAREC
         new_dynarec_init();
+        new_dynarec_load_code_cache();
         new_dyna_start();
+        new_dynarec_save_code_cache();
+        report_tier_stats();
         new_dynarec_cleanup();
 #else
         r4300->cached_interp.fin_block = dynarec_fin_block;
@@ -165,14 +177,16 @@ void run_r4300(struct r4300_core* r4300)
         r4300->cached_interp.free_block = dynarec_free_block;
         r4300->cached_interp.recompile_block = dynarec_recompile_block;
 
-
+        dynarec_init_exec_memory(r4300);
         dyna_start(dynarec_setup_code);
         (*r4300_pc_struct(r4300))++;
-#if defined(PROFILE_R4300)
-        profile_write_end_of_code_blocks(r4300);
-#endif
+        dynarec_report_exec_memory(r4300);
+        report_block_reuse(&r4300->cached_interp);
 #endif
         free_blocks(&r4300->cached_interp);
+#ifndef NEW_DYNAREC
+        dynarec_release_exec_memory(r4300);
+#endif
     }
 #endif
     else /* if (r4300->emumode == EMUMODE_INTERPRETER) */
@@ -197,17 +211,13 @@ void run_r4300(struct r4300_core* r4300)
         r4300->cp0.last_addr = *r4300_pc(r4300);
 
         run_cached_interpreter(r4300);
+        report_block_reuse(&r4300->cached_interp);
 
         free_blocks(&r4300->cached_interp);
     }
 
     DebugMessage(M64MSG_INFO, "R4300 emulator finished.");
 
-    /* print instruction counts */
-#if defined(COUNT_INSTR)
-    if (r4300->emumode == EMUMODE_DYNAREC)
-        instr_counters_print();
-#endif
 #ifdef OSAL_SSE
     //Restore FTZ/DAZ mode
     _MM_SET_DENORMALS_ZERO_MODE(daz);
@@ -312,6 +322,12 @@ int r4300_read_aligned_word(struct r4300_core* r4300, uint32_t address, uint32_t
 
     address &= UINT32_C(0x1ffffffc);
 
+    const uint32_t* mem = mem_fast_ptr(r4300->mem, address);
+    if (mem != NULL) {
+        *value = *mem;
+        return 1;
+    }
+
     mem_read32(mem_get_handler(r4300->mem, address), address & ~UINT32_C(3), value);
 
     return 1;
@@ -338,9 +354,17 @@ int r4300_read_aligned_dword(struct r4300_core* r4300, uint32_t address, uint64_
 
     address &= UINT32_C(0x1ffffffc);
 
-    const struct mem_handler* handler = mem_get_handler(r4300->mem, address);
-    mem_read32(handler, address + 0, &w[0]);
-    mem_read32(handler, address + 4, &w[1]);
+    const uint32_t* mem = mem_fast_ptr(r4300->mem, address);
+    const uint32_t* mem2 = mem_fast_ptr(r4300->mem, address + 4);
+    if (mem != NULL && mem2 != NULL) {
+        w[0] = *mem;
+        w[1] = *mem2;
+    }
+    else {
+        const struct mem_handler* handler = mem_get_handler(r4300->mem, address);
+        mem_read32(handler, address + 0, &w[0]);
+        mem_read32(handler, address + 4, &w[1]);
+    }
 
     *value = ((uint64_t)w[0] << 32) | w[1];
 
@@ -368,6 +392,12 @@ int r4300_write_aligned_word(struct r4300_core* r4300, uint32_t address, uint32_
 
     address &= UINT32_C(0x1ffffffc);
 
+    uint32_t* mem = mem_fast_ptr(r4300->mem, address);
+    if (mem != NULL) {
+        masked_write(mem, value, mask);
+        return 1;
+    }
+
     mem_write32(mem_get_handler(r4300->mem, address), address & ~UINT32_C(3), value, mask);
 
     return 1;
@@ -398,9 +428,17 @@ int r4300_write_aligned_dword(struct r4300_core* r4300, uint32_t address, uint64
 
     address &= UINT32_C(0x1ffffffc);
 
-    const struct mem_handler* handler = mem_get_handler(r4300->mem, address);
-    mem_write32(handler, address + 0, value >> 32,      mask >> 32);
-    mem_write32(handler, address + 4, (uint32_t) value, (uint32_t) mask      );
+    uint32_t* mem = mem_fast_ptr(r4300->mem, address);
+    uint32_t* mem2 = mem_fast_ptr(r4300->mem, address + 4);
+    if (mem != NULL && mem2 != NULL) {
+        masked_write(mem, value >> 32, mask >> 32);
+        masked_write(mem2, (uint32_t) value, (uint32_t) mask);
+    }
+    else {
+        const struct mem_handler* handler = mem_get_handler(r4300->mem, address);
+        mem_write32(handler, address + 0, value >> 32,      mask >> 32);
+        mem_write32(handler, address + 4, (uint32_t) value, (uint32_t) mask      );
+    }
 
     return 1;
 }
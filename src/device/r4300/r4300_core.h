@@ -25,14 +25,11 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#if defined(PROFILE_R4300)
-#include <stdio.h>
-#endif
-
 #include "cp0.h"
 #include "cp1.h"
 #include "cp2.h"
 
+#include "exec_arena.h"
 #include "recomp_types.h" /* for precomp_instr, regcache_state */
 
 #include "new_dynarec/new_dynarec.h"
@@ -59,6 +56,12 @@ struct cached_interp
 
     void (*recompile_block)(struct r4300_core* r4300,
         const uint32_t* source, struct precomp_block* block, uint32_t func);
+
+    /* changed when unmodified code must be translated anew */
+    uint64_t hash_seed;
+
+    unsigned int revived_pages;
+    unsigned int recompiled_pages;
 };
 
 enum {
@@ -154,6 +157,9 @@ struct r4300_core
 #endif
         unsigned char **inst_pointer;                   /* output buffer for recompiled code */
         int max_code_length;                            /* current recompiled code's buffer length */
+        ptrdiff_t code_write_offset;                    /* from the output buffer to its writable view */
+        struct exec_arena code_arena;                   /* recompiled code buffers */
+        struct exec_arena block_arena;                  /* precomp_instr tables, which hold jump wrappers */
         int fast_memory;
         int no_compiled_jump;                           /* use cached interpreter instead of recompiler for jumps */
         uint32_t jump_to_address;
@@ -166,10 +172,6 @@ struct r4300_core
         unsigned int shift;
 #endif
 
-#if defined(PROFILE_R4300)
-        FILE* pfProfile;
-#endif
-
         /* Memory accesses variables */
         uint64_t* rdword;
         uint32_t wmask;
@@ -22,39 +22,41 @@
 #include "recomp.h"
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
-#if defined(__GNUC__)
-#include <unistd.h>
-#ifndef __MINGW32__
-#include <sys/mman.h>
-#endif
-#endif
-
 #include "api/callbacks.h"
 #include "api/m64p_types.h"
 #include "device/r4300/cached_interp.h"
 #include "device/r4300/cp0.h"
+#include "device/r4300/exec_arena.h"
 #include "device/r4300/idec.h"
 #include "device/r4300/recomp_types.h"
 #include "device/r4300/tlb.h"
+#include "main/benchmark.h"
 #include "main/main.h"
+#include "main/perf_jit.h"
 #if defined(PROFILE)
 #include "main/profile.h"
 #endif
 
+#ifdef DBG
+#include "debugger/dbg_breakpoints.h"
+#include "debugger/dbg_debugger.h"
+#endif
+
 #if defined(__x86_64__)
   #include "x86_64/regcache.h"
 #else
   #include "x86/regcache.h"
 #endif
 
-static void *malloc_exec(size_t size);
-static void free_exec(void *ptr, size_t length);
+/* initial size of the code buffer of a page */
+enum { DYNAREC_CODE_BUFFER_SIZE = 32768 };
 
 /* defined in <arch>/assemble.c */
 void init_assembler(struct r4300_core* r4300, void *block_jumps_table, int block_jumps_number, void *block_riprel_table, int block_riprel_number);
@@ -69,6 +71,9 @@ void genfin_block(struct r4300_core* r4300);
 #ifdef COMPARE_CORE
 void gendebug(struct r4300_core* r4300);
 #endif
+#ifdef DBG
+void gendebugger_trap(struct r4300_core* r4300);
+#endif
 
 void gen_RESERVED(struct r4300_core* r4300);
 
@@ -458,6 +463,7 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
 #if defined(PROFILE)
     timed_section_start(TIMED_SECTION_COMPILER);
 #endif
+    benchmark_section_start(BENCHMARK_SECTION_COMPILER);
 
     struct precomp_block** block = &r4300->cached_interp.blocks[address >> 12];
 
@@ -470,10 +476,19 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
         (*block)->code = NULL;
         (*block)->jumps_table = NULL;
         (*block)->riprel_table = NULL;
+        (*block)->xxhash = 0;
     }
 
     struct precomp_block* b = *block;
 
+    if (revive_block(r4300, b)) {
+        benchmark_section_end(BENCHMARK_SECTION_COMPILER);
+#if defined(PROFILE)
+        timed_section_end(TIMED_SECTION_COMPILER);
+#endif
+        return;
+    }
+
     length = get_block_length(b);
 
 #ifdef DBG
@@ -484,25 +499,27 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
     if (!b->block)
     {
         size_t memsize = get_block_memsize(b);
-        b->block = (struct precomp_instr *) malloc_exec(memsize);
+        b->block = (struct precomp_instr *) exec_arena_alloc(&r4300->recomp.block_arena, memsize);
         if (!b->block) {
             DebugMessage(M64MSG_ERROR, "Memory error: couldn't allocate executable memory for dynamic recompiler. Try to use an interpreter mode.");
+            benchmark_section_end(BENCHMARK_SECTION_COMPILER);
             return;
         }
 
         memset(b->block, 0, memsize);
         already_exist = 0;
     }
+    else
+    {
+        ++r4300->cached_interp.recompiled_pages;
+    }
+
+    b->xxhash = get_block_hash(r4300, b);
 
     if (!b->code)
     {
-#if defined(PROFILE_R4300)
-        r4300->recomp.max_code_length = 524288; /* allocate so much code space that we'll never have to realloc(), because this may */
-        /* cause instruction locations to move, and break our profiling data                */
-#else
-        r4300->recomp.max_code_length = 32768;
-#endif
-        b->code = (unsigned char *) malloc_exec(r4300->recomp.max_code_length);
+        r4300->recomp.max_code_length = DYNAREC_CODE_BUFFER_SIZE;
+        b->code = (unsigned char *) exec_arena_alloc(&r4300->recomp.code_arena, r4300->recomp.max_code_length);
     }
     else
     {
@@ -511,6 +528,7 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
 
     r4300->recomp.code_length = 0;
     r4300->recomp.inst_pointer = &b->code;
+    r4300->recomp.code_write_offset = exec_arena_write_offset(&r4300->recomp.code_arena, b->code);
 
     if (b->jumps_table)
     {
@@ -527,14 +545,6 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
 
     if (!already_exist)
     {
-#if defined(PROFILE_R4300)
-        r4300->recomp.pfProfile = osal_file_open("instructionaddrs.dat", "ab");
-        long x86addr = (long) b->code;
-        int mipsop = -2; /* -2 == NOTCOMPILED block at beginning of x86 code */
-        if (fwrite(&mipsop, 1, 4, r4300->recomp.pfProfile) != 4 || // write 4-byte MIPS opcode
-                fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile) != sizeof(char *)) // write pointer to dynamically generated x86 code for this MIPS instruction
-            DebugMessage(M64MSG_ERROR, "Error writing R4300 instruction address profiling data");
-#endif
         for (i=0; i<length; i++)
         {
             r4300->recomp.dst = b->block + i;
@@ -547,19 +557,11 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
             r4300->recomp.dst->ops = dynarec_notcompiled;
             gennotcompiled(r4300);
         }
-#if defined(PROFILE_R4300)
-        fclose(r4300->recomp.pfProfile);
-        r4300->recomp.pfProfile = NULL;
-#endif
         r4300->recomp.init_length = r4300->recomp.code_length;
     }
     else
     {
-#if defined(PROFILE_R4300)
-        r4300->recomp.code_length = b->code_length; /* leave old instructions in their place */
-#else
         r4300->recomp.code_length = r4300->recomp.init_length; /* recompile everything, overwrite old recompiled instructions */
-#endif
         for (i=0; i<length; i++)
         {
             r4300->recomp.dst = b->block + i;
@@ -576,6 +578,10 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
     b->max_code_length = r4300->recomp.max_code_length;
     free_assembler(r4300, &b->jumps_table, &b->jumps_number, &b->riprel_table, &b->riprel_number);
 
+    if (!already_exist && perf_jit_enabled()) {
+        perf_jit_code_load(b->code, b->code_length, "r4300 not compiled", b->start, b->start + length * 4);
+    }
+
     /* here we're marking the block as a valid code even if it's not compiled
      * yet as the game should have already set up the code correctly.
      */
@@ -600,6 +606,7 @@ void dynarec_init_block(struct r4300_core* r4300, uint32_t address)
             dynarec_init_block(r4300, alt_addr);
         }
     }
+    benchmark_section_end(BENCHMARK_SECTION_COMPILER);
 #if defined(PROFILE)
     timed_section_end(TIMED_SECTION_COMPILER);
 #endif
@@ -609,8 +616,10 @@ void dynarec_free_block(struct precomp_block* block)
 {
     size_t memsize = get_block_memsize(block);
 
-    if (block->block) { free_exec(block->block, memsize); block->block = NULL; }
-    if (block->code) { free_exec(block->code, block->max_code_length); block->code = NULL; }
+    struct r4300_core* r4300 = &g_dev.r4300;
+
+    if (block->block) { exec_arena_free(&r4300->recomp.block_arena, block->block, memsize); block->block = NULL; }
+    if (block->code) { exec_arena_free(&r4300->recomp.code_arena, block->code, block->max_code_length); block->code = NULL; }
     if (block->jumps_table) { free(block->jumps_table); block->jumps_table = NULL; }
     if (block->riprel_table) { free(block->riprel_table); block->riprel_table = NULL; }
 }
@@ -622,6 +631,10 @@ void dynarec_recompile_block(struct r4300_core* r4300, const uint32_t* iw, struc
 {
     int i, length, length2, finished;
     enum r4300_opcode opcode;
+#ifdef DBG
+    int trap;
+    unsigned int trap_addr = 0;
+#endif
 
     /* ??? not sure why we need these 2 different tests */
     int block_start_in_tlb = ((block->start & UINT32_C(0xc0000000)) != UINT32_C(0x80000000));
@@ -630,24 +643,38 @@ void dynarec_recompile_block(struct r4300_core* r4300, const uint32_t* iw, struc
 #if defined(PROFILE)
     timed_section_start(TIMED_SECTION_COMPILER);
 #endif
+    benchmark_section_start(BENCHMARK_SECTION_COMPILER);
 
     length = get_block_length(block);
     length2 = length - 2 + (length >> 2);
 
-    /* reset xxhash */
-    block->xxhash = 0;
+    /* code decoded from words changed since the page was reset can't be revived */
+    if (block->xxhash != 0 && block->xxhash != get_block_hash(r4300, block)) {
+        block->xxhash = 0;
+    }
+
+    /* Code compiled before the page was last invalidated is dead,
+     * give the space it grew into back to the arena. */
+    if (block->code_length == (unsigned int)r4300->recomp.init_length
+     && block->max_code_length > DYNAREC_CODE_BUFFER_SIZE)
+    {
+        block->code = (unsigned char *) exec_arena_realloc(&r4300->recomp.code_arena,
+            block->code, block->max_code_length, DYNAREC_CODE_BUFFER_SIZE);
+        block->max_code_length = DYNAREC_CODE_BUFFER_SIZE;
+    }
+
+    /* the code buffer of the page may be moved while it grows */
+    const unsigned char* old_code = block->code;
+    size_t code_start = block->code_length;
 
     r4300->recomp.dst_block = block;
     r4300->recomp.code_length = block->code_length;
     r4300->recomp.max_code_length = block->max_code_length;
     r4300->recomp.inst_pointer = &block->code;
+    r4300->recomp.code_write_offset = exec_arena_write_offset(&r4300->recomp.code_arena, block->code);
     init_assembler(r4300, block->jumps_table, block->jumps_number, block->riprel_table, block->riprel_number);
     init_cache(r4300, block->block + (func & 0xFFF) / 4);
 
-#if defined(PROFILE_R4300)
-    r4300->recomp.pfProfile = osal_file_open("instructionaddrs.dat", "ab");
-#endif
-
     for (i = (func & 0xFFF) / 4, finished = 0; finished != 2; ++i)
     {
         r4300->recomp.SRC = iw + i;
@@ -668,14 +695,14 @@ void dynarec_recompile_block(struct r4300_core* r4300, const uint32_t* iw, struc
 #ifdef COMPARE_CORE
         gendebug(r4300);
 #endif
-#if defined(PROFILE_R4300)
-        long x86addr = (long) (block->code + block->block[i].local_addr);
-
-        /* write 4-byte MIPS opcode, followed by a pointer to dynamically generated x86 code for
-         * this MIPS instruction. */
-        if (fwrite(iw + i, 1, 4, r4300->recomp.pfProfile) != 4
-        || fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile) != sizeof(char *)) {
-            DebugMessage(M64MSG_ERROR, "Error writing R4300 instruction address profiling data");
+
+#ifdef DBG
+        /* execute breakpoints get a call to the debugger in front of the
+         * instruction; blocks are invalidated when breakpoints change */
+        trap = g_DebuggerActive && check_breakpoints(r4300->recomp.dst->addr) != -1;
+        if (trap) {
+            gendebugger_trap(r4300);
+            trap_addr = r4300->recomp.dst->local_addr;
         }
 #endif
 
@@ -683,6 +710,14 @@ void dynarec_recompile_block(struct r4300_core* r4300, const uint32_t* iw, struc
         opcode = r4300_decode(r4300->recomp.dst, r4300, r4300_get_idec(iw[i]), iw[i], iw[i+1], block);
         recomp_funcs[opcode](r4300);
 
+#ifdef DBG
+        /* the instruction may have moved its entry point past the trap,
+         * registers are all flushed at the trap so it is a valid entry */
+        if (trap) {
+            r4300->recomp.dst->local_addr = trap_addr;
+        }
+#endif
+
         if (r4300->recomp.delay_slot_compiled)
         {
             r4300->recomp.delay_slot_compiled--;
@@ -704,17 +739,6 @@ void dynarec_recompile_block(struct r4300_core* r4300, const uint32_t* iw, struc
         }
     }
 
-#if defined(PROFILE_R4300)
-    long x86addr = (long) (block->code + r4300->recomp.code_length);
-    int mipsop = -3; /* -3 == block-postfix */
-    /* write 4-byte MIPS opcode, followed by a pointer to dynamically generated x86 code for
-     * this MIPS instruction. */
-    if (fwrite(&mipsop, 1, 4, r4300->recomp.pfProfile) != 4
-    || fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile) != sizeof(char *)) {
-        DebugMessage(M64MSG_ERROR, "Error writing R4300 instruction address profiling data");
-    }
-#endif
-
     if (i >= length)
     {
         r4300->recomp.dst = block->block + i;
@@ -749,14 +773,21 @@ void dynarec_recompile_block(struct r4300_core* r4300, const uint32_t* iw, struc
     block->max_code_length = r4300->recomp.max_code_length;
     free_assembler(r4300, &block->jumps_table, &block->jumps_number, &block->riprel_table, &block->riprel_number);
 
+    if (perf_jit_enabled()) {
+        /* after a move, the previously compiled code of the page is only
+         * known as a whole */
+        if (block->code != old_code) {
+            perf_jit_code_load(block->code, code_start, "r4300 page", block->start, block->start + length * 4);
+        }
+        perf_jit_code_load(block->code + code_start, block->code_length - code_start, "r4300",
+            block->start + (func & 0xFFF), block->start + ((i < length) ? i : length) * 4);
+    }
+
 #ifdef DBG
     DebugMessage(M64MSG_INFO, "block recompiled (%" PRIX32 "-%" PRIX32 ")", func, block->start+i*4);
 #endif
-#if defined(PROFILE_R4300)
-    fclose(r4300->recomp.pfProfile);
-    r4300->recomp.pfProfile = NULL;
-#endif
 
+    benchmark_section_end(BENCHMARK_SECTION_COMPILER);
 #if defined(PROFILE)
     timed_section_end(TIMED_SECTION_COMPILER);
 #endif
@@ -821,16 +852,6 @@ void recompile_opcode(struct r4300_core* r4300)
         break;
 
     default: {
-#if defined(PROFILE_R4300)
-        long x86addr = (long) ((*r4300->recomp.inst_pointer) + r4300->recomp.code_length);
-
-        /* write 4-byte MIPS opcode, followed by a pointer to dynamically generated x86 code for
-         * this MIPS instruction. */
-        if (fwrite(&r4300->recomp.src, 1, 4, r4300->recomp.pfProfile) != 4
-        || fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile) != sizeof(char *)) {
-            DebugMessage(M64MSG_ERROR, "Error writing R4300 instruction address profiling data");
-        }
-#endif
         recomp_funcs[opcode](r4300);
     }
     }
@@ -838,32 +859,6 @@ void recompile_opcode(struct r4300_core* r4300)
     r4300->recomp.delay_slot_compiled = 2;
 }
 
-#if defined(PROFILE_R4300)
-void profile_write_end_of_code_blocks(struct r4300_core* r4300)
-{
-    size_t i;
-
-    r4300->recomp.pfProfile = osal_file_open("instructionaddrs.dat", "ab");
-
-    for (i = 0; i < 0x100000; ++i) {
-        if (r4300->cached_interp.invalid_code[i] == 0 && r4300->cached_interp.blocks[i] != NULL && r4300->cached_interp.blocks[i]->code != NULL && r4300->cached_interp.blocks[i]->block != NULL)
-        {
-            unsigned char *x86addr;
-            int mipsop;
-            // store final code length for this block
-            mipsop = -1; /* -1 == end of x86 code block */
-            x86addr = r4300->cached_interp.blocks[i]->code + r4300->cached_interp.blocks[i]->code_length;
-            if (fwrite(&mipsop, 1, 4, r4300->recomp.pfProfile) != 4 ||
-                    fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile) != sizeof(char *))
-                DebugMessage(M64MSG_ERROR, "Error writing R4300 instruction address profiling data");
-        }
-    }
-
-    fclose(r4300->recomp.pfProfile);
-    r4300->recomp.pfProfile = NULL;
-}
-#endif
-
 /* Jumps to the given address. This is for the dynarec. */
 void dynarec_jump_to(struct r4300_core* r4300, uint32_t address)
 {
@@ -917,6 +912,17 @@ void dynarec_exception_general(void)
     exception_general(&g_dev.r4300);
 }
 
+#ifdef DBG
+/* Called by the code generated by gendebugger_trap. */
+void dynarec_debugger_trap(void)
+{
+    struct r4300_core* r4300 = &g_dev.r4300;
+
+    if (g_DebuggerActive)
+        update_debugger((*r4300_pc_struct(r4300))->addr);
+}
+#endif
+
 /* Parameterless version of check_cop1_unusable to ease usage in dynarec. */
 int dynarec_check_cop1_unusable(void)
 {
@@ -990,58 +996,65 @@ int dynarec_write_aligned_dword(void)
 
 
 /**********************************************************************
- ************** allocate memory with executable bit set ***************
+ ******************* memory with executable bit set *******************
  **********************************************************************/
-static void *malloc_exec(size_t size)
+void dynarec_init_exec_memory(struct r4300_core* r4300)
 {
-#if defined(WIN32)
-    return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
-#elif defined(__GNUC__)
+    /* instruction tables hold the jump wrappers next to data updated
+     * by C code, so only the code buffers can have a separate writable view */
+    r4300->recomp.block_arena.dual_view = 0;
 
-#ifndef  MAP_ANONYMOUS
-#ifdef MAP_ANON
-#define MAP_ANONYMOUS MAP_ANON
-#endif
-#endif
+    exec_arena_init(&r4300->recomp.code_arena);
+    exec_arena_init(&r4300->recomp.block_arena);
+}
 
-    void *block = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (block == MAP_FAILED)
-    { DebugMessage(M64MSG_ERROR, "Memory error: couldn't allocate %zi byte block of aligned RWX memory.", size); return NULL; }
+static void report_exec_arena(const char* name, const struct exec_arena* arena)
+{
+    struct exec_arena_stats stats;
+    unsigned int fragmentation;
+
+    exec_arena_get_stats(arena, &stats);
+    fragmentation = (stats.bytes_free != 0)
+        ? (unsigned int)(100 - (100 * (uint64_t)stats.largest_free) / stats.bytes_free)
+        : 0;
+
+    DebugMessage(M64MSG_INFO, "Dynarec %s memory: %zu KB live (peak %zu KB), %zu KB reserved, %u%% fragmentation, "
+        "%" PRIu64 " allocations, %" PRIu64 " grown in place, %" PRIu64 " moved, %" PRIu64 " syscalls",
+        name, stats.bytes_live >> 10, stats.bytes_peak >> 10, stats.bytes_reserved >> 10, fragmentation,
+        stats.allocations, stats.grown_in_place, stats.moves, stats.syscalls);
+
+    if (g_benchmark.enabled) {
+        char counter[64];
+        snprintf(counter, sizeof(counter), "dynarec_%s_bytes_live", name);
+        benchmark_set_counter(counter, stats.bytes_live);
+        snprintf(counter, sizeof(counter), "dynarec_%s_bytes_peak", name);
+        benchmark_set_counter(counter, stats.bytes_peak);
+        snprintf(counter, sizeof(counter), "dynarec_%s_bytes_reserved", name);
+        benchmark_set_counter(counter, stats.bytes_reserved);
+        snprintf(counter, sizeof(counter), "dynarec_%s_fragmentation_pct", name);
+        benchmark_set_counter(counter, fragmentation);
+        snprintf(counter, sizeof(counter), "dynarec_%s_syscalls", name);
+        benchmark_set_counter(counter, stats.syscalls);
+    }
+}
 
-    return block;
-#else
-    return malloc(size);
-#endif
+void dynarec_report_exec_memory(struct r4300_core* r4300)
+{
+    report_exec_arena("code", &r4300->recomp.code_arena);
+    report_exec_arena("table", &r4300->recomp.block_arena);
 }
 
-/**********************************************************************
- ************* reallocate memory with executable bit set **************
- **********************************************************************/
-void *realloc_exec(void *ptr, size_t oldsize, size_t newsize)
+void dynarec_release_exec_memory(struct r4300_core* r4300)
 {
-    void* block = malloc_exec(newsize);
-    if (block != NULL)
-    {
-        size_t copysize;
-        copysize = (oldsize < newsize)
-            ? oldsize
-            : newsize;
-        memcpy(block, ptr, copysize);
-    }
-    free_exec(ptr, oldsize);
-    return block;
+    exec_arena_release(&r4300->recomp.code_arena);
+    exec_arena_release(&r4300->recomp.block_arena);
 }
 
-/**********************************************************************
- **************** frees memory with executable bit set ****************
- **********************************************************************/
-static void free_exec(void *ptr, size_t length)
+/* Grows the code buffer being assembled, which may move it */
+void dynarec_grow_code_buffer(struct r4300_core* r4300, size_t extra)
 {
-#if defined(WIN32)
-    VirtualFree(ptr, 0, MEM_RELEASE);
-#elif defined(__GNUC__)
-    munmap(ptr, length);
-#else
-    free(ptr);
-#endif
+    *r4300->recomp.inst_pointer = exec_arena_realloc(&r4300->recomp.code_arena,
+        *r4300->recomp.inst_pointer, r4300->recomp.max_code_length, r4300->recomp.max_code_length + extra);
+    r4300->recomp.max_code_length += extra;
+    r4300->recomp.code_write_offset = exec_arena_write_offset(&r4300->recomp.code_arena, *r4300->recomp.inst_pointer);
 }
@@ -35,7 +35,11 @@ void recompile_opcode(struct r4300_core* r4300);
 void dyna_jump(void);
 void dyna_start(void (*code)(void));
 void dyna_stop(struct r4300_core* r4300);
-void *realloc_exec(void *ptr, size_t oldsize, size_t newsize);
+void dynarec_grow_code_buffer(struct r4300_core* r4300, size_t extra);
+
+void dynarec_init_exec_memory(struct r4300_core* r4300);
+void dynarec_report_exec_memory(struct r4300_core* r4300);
+void dynarec_release_exec_memory(struct r4300_core* r4300);
 
 void dynarec_jump_to(struct r4300_core* r4300, uint32_t address);
 
@@ -46,6 +50,9 @@ void dynarec_setup_code(void);
 void dynarec_jump_to_recomp_address(void);
 void dynarec_exception_general(void);
 int dynarec_check_cop1_unusable(void);
+#ifdef DBG
+void dynarec_debugger_trap(void);
+#endif
 void dynarec_cp0_update_count(void);
 void dynarec_gen_interrupt(void);
 int dynarec_read_aligned_word(void);
@@ -54,9 +61,5 @@ int dynarec_read_aligned_dword(void);
 int dynarec_write_aligned_dword(void);
 
 
-#if defined(PROFILE_R4300)
-void profile_write_end_of_code_blocks(struct r4300_core* r4300);
-#endif
-
 #endif /* M64P_DEVICE_R4300_RECOMP_H */
 
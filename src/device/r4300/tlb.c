@@ -34,6 +34,7 @@ void poweron_tlb(struct tlb* tlb)
     memset(tlb->entries, 0, 32 * sizeof(tlb->entries[0]));
     memset(tlb->LUT_r, 0, 0x100000 * sizeof(tlb->LUT_r[0]));
     memset(tlb->LUT_w, 0, 0x100000 * sizeof(tlb->LUT_w[0]));
+    ++tlb->lut_generation;
 }
 
 void tlb_unmap(struct tlb* tlb, size_t entry)
@@ -43,6 +44,7 @@ void tlb_unmap(struct tlb* tlb, size_t entry)
 
     assert(entry < 32);
     e = &tlb->entries[entry];
+    ++tlb->lut_generation;
 
     if (e->v_even)
     {
@@ -70,6 +72,7 @@ void tlb_map(struct tlb* tlb, size_t entry)
 
     assert(entry < 32);
     e = &tlb->entries[entry];
+    ++tlb->lut_generation;
 
     if (e->v_even)
     {
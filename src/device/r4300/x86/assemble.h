@@ -70,12 +70,11 @@ static osal_inline void put8(unsigned char octet)
 {
     struct r4300_core* r4300 = &g_dev.r4300;
 
-    (*r4300->recomp.inst_pointer)[r4300->recomp.code_length] = octet;
+    (*r4300->recomp.inst_pointer + r4300->recomp.code_write_offset)[r4300->recomp.code_length] = octet;
     r4300->recomp.code_length++;
     if (r4300->recomp.code_length == r4300->recomp.max_code_length)
     {
-        *r4300->recomp.inst_pointer = (unsigned char *) realloc_exec(*r4300->recomp.inst_pointer, r4300->recomp.max_code_length, r4300->recomp.max_code_length+8192);
-        r4300->recomp.max_code_length += 8192;
+        dynarec_grow_code_buffer(r4300, 8192);
     }
 }
 
@@ -85,10 +84,9 @@ static osal_inline void put32(unsigned int dword)
 
     if ((r4300->recomp.code_length+4) >= r4300->recomp.max_code_length)
     {
-        *r4300->recomp.inst_pointer = (unsigned char *) realloc_exec(*r4300->recomp.inst_pointer, r4300->recomp.max_code_length, r4300->recomp.max_code_length+8192);
-        r4300->recomp.max_code_length += 8192;
+        dynarec_grow_code_buffer(r4300, 8192);
     }
-    *((unsigned int *)(&(*r4300->recomp.inst_pointer)[r4300->recomp.code_length])) = dword;
+    *((unsigned int *)(&(*r4300->recomp.inst_pointer + r4300->recomp.code_write_offset)[r4300->recomp.code_length])) = dword;
     r4300->recomp.code_length+=4;
 }
 
@@ -217,6 +217,13 @@ void gendebug(struct r4300_core* r4300)
 }
 #endif
 
+#ifdef DBG
+void gendebugger_trap(struct r4300_core* r4300)
+{
+    gencallinterp(r4300, (unsigned int)dynarec_debugger_trap, 0);
+}
+#endif
+
 void genni(struct r4300_core* r4300)
 {
     gencallinterp(r4300, (unsigned int)cached_interp_NI, 0);
@@ -40,17 +40,9 @@ void init_cache(struct r4300_core* r4300, struct precomp_instr* start)
 
 void free_all_registers(struct r4300_core* r4300)
 {
-#if defined(PROFILE_R4300)
-    int freestart = r4300->recomp.code_length;
-    int flushed = 0;
-#endif
-
     int i;
     for (i=0; i<8; i++)
     {
-#if defined(PROFILE_R4300)
-        if (r4300->recomp.regcache_state.last_access[i] && r4300->recomp.regcache_state.dirty[i]) flushed = 1;
-#endif
         if (r4300->recomp.regcache_state.last_access[i]) free_register(r4300, i);
         else
         {
@@ -61,19 +53,6 @@ void free_all_registers(struct r4300_core* r4300)
             }
         }
     }
-
-#if defined(PROFILE_R4300)
-    if (flushed == 1)
-    {
-        long x86addr = (long) ((*r4300->recomp.inst_pointer) + freestart);
-        int mipsop = -5;
-        fwrite(&mipsop, 1, 4, r4300->recomp.pfProfile); /* -5 = regcache flushing */
-        fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile); // write pointer to start of register cache flushing instructions
-        x86addr = (long) ((*r4300->recomp.inst_pointer) + r4300->recomp.code_length);
-        fwrite(&r4300->recomp.src, 1, 4, r4300->recomp.pfProfile); // write 4-byte MIPS opcode for current instruction
-        fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile); // write pointer to dynamically generated x86 code for this MIPS instruction
-    }
-#endif
 }
 
 // this function frees a specific X86 GPR
@@ -749,13 +728,6 @@ static void build_wrapper(struct r4300_core* r4300, struct precomp_instr *instr,
     int i;
     int j=0;
 
-#if defined(PROFILE_R4300)
-    long x86addr = (long) code;
-    int mipsop = -4;
-    fwrite(&mipsop, 1, 4, r4300->recomp.pfProfile); // write 4-byte MIPS opcode
-    fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile); // write pointer to dynamically generated x86 code for this MIPS instruction
-#endif
-
     code[j++] = 0x81;
     code[j++] = 0xEC;
     code[j++] = 0x04;
@@ -37,10 +37,6 @@
 #include "device/rdram/rdram.h"
 #include "main/main.h"
 
-#if defined(COUNT_INSTR)
-#include "device/r4300/instr_counters.h"
-#endif
-
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -334,11 +330,15 @@ void gendebug(struct r4300_core* r4300)
 }
 #endif
 
-void genni(struct r4300_core* r4300)
+#ifdef DBG
+void gendebugger_trap(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[1]);
+    gencallinterp(r4300, (unsigned long long)dynarec_debugger_trap, 0);
+}
 #endif
+
+void genni(struct r4300_core* r4300)
+{
     gencallinterp(r4300, (unsigned long long)cached_interp_NI, 0);
 }
 
@@ -367,9 +367,6 @@ void genfin_block(struct r4300_core* r4300)
 
 void gen_RESERVED(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[0]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_RESERVED, 0);
 }
 
@@ -378,9 +375,6 @@ void gen_RESERVED(struct r4300_core* r4300)
 void gen_LB(struct r4300_core* r4300)
 {
     int gpr1, gpr2, base1, base2;
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[24]);
-#endif
 #ifdef INTERPRET_LB
     gencallinterp(r4300, (unsigned long long)cached_interp_LB, 0);
 #else
@@ -451,9 +445,6 @@ void gen_LB(struct r4300_core* r4300)
 void gen_LBU(struct r4300_core* r4300)
 {
     int gpr1, gpr2, base1, base2;
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[28]);
-#endif
 #ifdef INTERPRET_LBU
     gencallinterp(r4300, (unsigned long long)cached_interp_LBU, 0);
 #else
@@ -524,9 +515,6 @@ void gen_LBU(struct r4300_core* r4300)
 void gen_LH(struct r4300_core* r4300)
 {
     int gpr1, gpr2, base1, base2;
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[25]);
-#endif
 #ifdef INTERPRET_LH
     gencallinterp(r4300, (unsigned long long)cached_interp_LH, 0);
 #else
@@ -596,9 +584,6 @@ void gen_LH(struct r4300_core* r4300)
 void gen_LHU(struct r4300_core* r4300)
 {
     int gpr1, gpr2, base1, base2;
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[29]);
-#endif
 #ifdef INTERPRET_LHU
     gencallinterp(r4300, (unsigned long long)cached_interp_LHU, 0);
 #else
@@ -667,18 +652,12 @@ void gen_LHU(struct r4300_core* r4300)
 
 void gen_LL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[42]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_LL, 0);
 }
 
 void gen_LW(struct r4300_core* r4300)
 {
     int gpr1, gpr2, base1, base2 = 0;
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[26]);
-#endif
 #ifdef INTERPRET_LW
     gencallinterp(r4300, (unsigned long long)cached_interp_LW, 0);
 #else
@@ -733,9 +712,6 @@ void gen_LW(struct r4300_core* r4300)
 void gen_LWU(struct r4300_core* r4300)
 {
     int gpr1, gpr2, base1, base2 = 0;
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[30]);
-#endif
 #ifdef INTERPRET_LWU
     gencallinterp(r4300, (unsigned long long)cached_interp_LWU, 0);
 #else
@@ -788,25 +764,16 @@ void gen_LWU(struct r4300_core* r4300)
 
 void gen_LWL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[27]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_LWL, 0);
 }
 
 void gen_LWR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[31]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_LWR, 0);
 }
 
 void gen_LD(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[41]);
-#endif
 #ifdef INTERPRET_LD
     gencallinterp(r4300, (unsigned long long)cached_interp_LD, 0);
 #else
@@ -862,17 +829,11 @@ void gen_LD(struct r4300_core* r4300)
 
 void gen_LDL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[22]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_LDL, 0);
 }
 
 void gen_LDR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[23]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_LDR, 0);
 }
 
@@ -880,9 +841,6 @@ void gen_LDR(struct r4300_core* r4300)
 
 void gen_SB(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[32]);
-#endif
 #ifdef INTERPRET_SB
     gencallinterp(r4300, (unsigned long long)cached_interp_SB, 0);
 #else
@@ -969,9 +927,6 @@ void gen_SB(struct r4300_core* r4300)
 
 void gen_SH(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[33]);
-#endif
 #ifdef INTERPRET_SH
     gencallinterp(r4300, (unsigned long long)cached_interp_SH, 0);
 #else
@@ -1058,17 +1013,11 @@ void gen_SH(struct r4300_core* r4300)
 
 void gen_SC(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[46]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_SC, 0);
 }
 
 void gen_SW(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[34]);
-#endif
 #ifdef INTERPRET_SW
     gencallinterp(r4300, (unsigned long long)cached_interp_SW, 0);
 #else
@@ -1141,25 +1090,16 @@ void gen_SW(struct r4300_core* r4300)
 
 void gen_SWL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[35]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_SWL, 0);
 }
 
 void gen_SWR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[36]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_SWR, 0);
 }
 
 void gen_SD(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[45]);
-#endif
 #ifdef INTERPRET_SD
     gencallinterp(r4300, (unsigned long long)cached_interp_SD, 0);
 #else
@@ -1234,17 +1174,11 @@ void gen_SD(struct r4300_core* r4300)
 
 void gen_SDL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[37]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_SDL, 0);
 }
 
 void gen_SDR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[38]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_SDR, 0);
 }
 
@@ -1252,9 +1186,6 @@ void gen_SDR(struct r4300_core* r4300)
 
 void gen_ADD(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[79]);
-#endif
 #ifdef INTERPRET_ADD
     gencallinterp(r4300, (unsigned long long)cached_interp_ADD, 0);
 #else
@@ -1278,9 +1209,6 @@ void gen_ADD(struct r4300_core* r4300)
 
 void gen_ADDU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[80]);
-#endif
 #ifdef INTERPRET_ADDU
     gencallinterp(r4300, (unsigned long long)cached_interp_ADDU, 0);
 #else
@@ -1304,9 +1232,6 @@ void gen_ADDU(struct r4300_core* r4300)
 
 void gen_ADDI(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[8]);
-#endif
 #ifdef INTERPRET_ADDI
     gencallinterp(r4300, (unsigned long long)cached_interp_ADDI, 0);
 #else
@@ -1320,9 +1245,6 @@ void gen_ADDI(struct r4300_core* r4300)
 
 void gen_ADDIU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[9]);
-#endif
 #ifdef INTERPRET_ADDIU
     gencallinterp(r4300, (unsigned long long)cached_interp_ADDIU, 0);
 #else
@@ -1336,9 +1258,6 @@ void gen_ADDIU(struct r4300_core* r4300)
 
 void gen_DADD(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[89]);
-#endif
 #ifdef INTERPRET_DADD
     gencallinterp(r4300, (unsigned long long)cached_interp_DADD, 0);
 #else
@@ -1362,9 +1281,6 @@ void gen_DADD(struct r4300_core* r4300)
 
 void gen_DADDU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[90]);
-#endif
 #ifdef INTERPRET_DADDU
     gencallinterp(r4300, (unsigned long long)cached_interp_DADDU, 0);
 #else
@@ -1388,9 +1304,6 @@ void gen_DADDU(struct r4300_core* r4300)
 
 void gen_DADDI(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[20]);
-#endif
 #ifdef INTERPRET_DADDI
     gencallinterp(r4300, (unsigned long long)cached_interp_DADDI, 0);
 #else
@@ -1417,9 +1330,6 @@ void gen_DADDIU(struct r4300_core* r4300)
 
 void gen_SUB(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[81]);
-#endif
 #ifdef INTERPRET_SUB
     gencallinterp(r4300, (unsigned long long)cached_interp_SUB, 0);
 #else
@@ -1445,9 +1355,6 @@ void gen_SUB(struct r4300_core* r4300)
 
 void gen_SUBU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[82]);
-#endif
 #ifdef INTERPRET_SUBU
     gencallinterp(r4300, (unsigned long long)cached_interp_SUBU, 0);
 #else
@@ -1473,9 +1380,6 @@ void gen_SUBU(struct r4300_core* r4300)
 
 void gen_DSUB(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[91]);
-#endif
 #ifdef INTERPRET_DSUB
     gencallinterp(r4300, (unsigned long long)cached_interp_DSUB, 0);
 #else
@@ -1501,9 +1405,6 @@ void gen_DSUB(struct r4300_core* r4300)
 
 void gen_DSUBU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[92]);
-#endif
 #ifdef INTERPRET_DSUBU
     gencallinterp(r4300, (unsigned long long)cached_interp_DSUBU, 0);
 #else
@@ -1529,9 +1430,6 @@ void gen_DSUBU(struct r4300_core* r4300)
 
 void gen_SLT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[87]);
-#endif
 #ifdef INTERPRET_SLT
     gencallinterp(r4300, (unsigned long long)cached_interp_SLT, 0);
 #else
@@ -1547,9 +1445,6 @@ void gen_SLT(struct r4300_core* r4300)
 
 void gen_SLTU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[88]);
-#endif
 #ifdef INTERPRET_SLTU
     gencallinterp(r4300, (unsigned long long)cached_interp_SLTU, 0);
 #else
@@ -1565,9 +1460,6 @@ void gen_SLTU(struct r4300_core* r4300)
 
 void gen_SLTI(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[10]);
-#endif
 #ifdef INTERPRET_SLTI
     gencallinterp(r4300, (unsigned long long)cached_interp_SLTI, 0);
 #else
@@ -1583,9 +1475,6 @@ void gen_SLTI(struct r4300_core* r4300)
 
 void gen_SLTIU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[11]);
-#endif
 #ifdef INTERPRET_SLTIU
     gencallinterp(r4300, (unsigned long long)cached_interp_SLTIU, 0);
 #else
@@ -1601,9 +1490,6 @@ void gen_SLTIU(struct r4300_core* r4300)
 
 void gen_AND(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[83]);
-#endif
 #ifdef INTERPRET_AND
     gencallinterp(r4300, (unsigned long long)cached_interp_AND, 0);
 #else
@@ -1627,9 +1513,6 @@ void gen_AND(struct r4300_core* r4300)
 
 void gen_ANDI(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[12]);
-#endif
 #ifdef INTERPRET_ANDI
     gencallinterp(r4300, (unsigned long long)cached_interp_ANDI, 0);
 #else
@@ -1643,9 +1526,6 @@ void gen_ANDI(struct r4300_core* r4300)
 
 void gen_OR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[84]);
-#endif
 #ifdef INTERPRET_OR
     gencallinterp(r4300, (unsigned long long)cached_interp_OR, 0);
 #else
@@ -1669,9 +1549,6 @@ void gen_OR(struct r4300_core* r4300)
 
 void gen_ORI(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[13]);
-#endif
 #ifdef INTERPRET_ORI
     gencallinterp(r4300, (unsigned long long)cached_interp_ORI, 0);
 #else
@@ -1685,9 +1562,6 @@ void gen_ORI(struct r4300_core* r4300)
 
 void gen_XOR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[85]);
-#endif
 #ifdef INTERPRET_XOR
     gencallinterp(r4300, (unsigned long long)cached_interp_XOR, 0);
 #else
@@ -1711,9 +1585,6 @@ void gen_XOR(struct r4300_core* r4300)
 
 void gen_XORI(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[14]);
-#endif
 #ifdef INTERPRET_XORI
     gencallinterp(r4300, (unsigned long long)cached_interp_XORI, 0);
 #else
@@ -1727,9 +1598,6 @@ void gen_XORI(struct r4300_core* r4300)
 
 void gen_NOR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[86]);
-#endif
 #ifdef INTERPRET_NOR
     gencallinterp(r4300, (unsigned long long)cached_interp_NOR, 0);
 #else
@@ -1758,9 +1626,6 @@ void gen_NOR(struct r4300_core* r4300)
 
 void gen_LUI(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[15]);
-#endif
 #ifdef INTERPRET_LUI
     gencallinterp(r4300, (unsigned long long)cached_interp_LUI, 0);
 #else
@@ -1778,9 +1643,6 @@ void gen_NOP(struct r4300_core* r4300)
 
 void gen_SLL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[55]);
-#endif
 #ifdef INTERPRET_SLL
     gencallinterp(r4300, (unsigned long long)cached_interp_SLL, 0);
 #else
@@ -1794,9 +1656,6 @@ void gen_SLL(struct r4300_core* r4300)
 
 void gen_SLLV(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[58]);
-#endif
 #ifdef INTERPRET_SLLV
     gencallinterp(r4300, (unsigned long long)cached_interp_SLLV, 0);
 #else
@@ -1824,9 +1683,6 @@ void gen_SLLV(struct r4300_core* r4300)
 
 void gen_DSLL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[93]);
-#endif
 #ifdef INTERPRET_DSLL
     gencallinterp(r4300, (unsigned long long)cached_interp_DSLL, 0);
 #else
@@ -1840,9 +1696,6 @@ void gen_DSLL(struct r4300_core* r4300)
 
 void gen_DSLLV(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[68]);
-#endif
 #ifdef INTERPRET_DSLLV
     gencallinterp(r4300, (unsigned long long)cached_interp_DSLLV, 0);
 #else
@@ -1872,9 +1725,6 @@ void gen_DSLLV(struct r4300_core* r4300)
 
 void gen_DSLL32(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[97]);
-#endif
 #ifdef INTERPRET_DSLL32
     gencallinterp(r4300, (unsigned long long)cached_interp_DSLL32, 0);
 #else
@@ -1888,9 +1738,6 @@ void gen_DSLL32(struct r4300_core* r4300)
 
 void gen_SRL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[56]);
-#endif
 #ifdef INTERPRET_SRL
     gencallinterp(r4300, (unsigned long long)cached_interp_SRL, 0);
 #else
@@ -1904,9 +1751,6 @@ void gen_SRL(struct r4300_core* r4300)
 
 void gen_SRLV(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[59]);
-#endif
 #ifdef INTERPRET_SRLV
     gencallinterp(r4300, (unsigned long long)cached_interp_SRLV, 0);
 #else
@@ -1934,9 +1778,6 @@ void gen_SRLV(struct r4300_core* r4300)
 
 void gen_DSRL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[94]);
-#endif
 #ifdef INTERPRET_DSRL
     gencallinterp(r4300, (unsigned long long)cached_interp_DSRL, 0);
 #else
@@ -1950,9 +1791,6 @@ void gen_DSRL(struct r4300_core* r4300)
 
 void gen_DSRLV(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[69]);
-#endif
 #ifdef INTERPRET_DSRLV
     gencallinterp(r4300, (unsigned long long)cached_interp_DSRLV, 0);
 #else
@@ -1982,9 +1820,6 @@ void gen_DSRLV(struct r4300_core* r4300)
 
 void gen_DSRL32(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[98]);
-#endif
 #ifdef INTERPRET_DSRL32
     gencallinterp(r4300, (unsigned long long)cached_interp_DSRL32, 0);
 #else
@@ -1998,9 +1833,6 @@ void gen_DSRL32(struct r4300_core* r4300)
 
 void gen_SRA(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[57]);
-#endif
 #ifdef INTERPRET_SRA
     gencallinterp(r4300, (unsigned long long)cached_interp_SRA, 0);
 #else
@@ -2014,9 +1846,6 @@ void gen_SRA(struct r4300_core* r4300)
 
 void gen_SRAV(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[60]);
-#endif
 #ifdef INTERPRET_SRAV
     gencallinterp(r4300, (unsigned long long)cached_interp_SRAV, 0);
 #else
@@ -2044,9 +1873,6 @@ void gen_SRAV(struct r4300_core* r4300)
 
 void gen_DSRA(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[95]);
-#endif
 #ifdef INTERPRET_DSRA
     gencallinterp(r4300, (unsigned long long)cached_interp_DSRA, 0);
 #else
@@ -2060,9 +1886,6 @@ void gen_DSRA(struct r4300_core* r4300)
 
 void gen_DSRAV(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[70]);
-#endif
 #ifdef INTERPRET_DSRAV
     gencallinterp(r4300, (unsigned long long)cached_interp_DSRAV, 0);
 #else
@@ -2092,9 +1915,6 @@ void gen_DSRAV(struct r4300_core* r4300)
 
 void gen_DSRA32(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[99]);
-#endif
 #ifdef INTERPRET_DSRA32
     gencallinterp(r4300, (unsigned long long)cached_interp_DSRA32, 0);
 #else
@@ -2110,9 +1930,6 @@ void gen_DSRA32(struct r4300_core* r4300)
 
 void gen_MULT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[71]);
-#endif
 #ifdef INTERPRET_MULT
     gencallinterp(r4300, (unsigned long long)cached_interp_MULT, 0);
 #else
@@ -2128,9 +1945,6 @@ void gen_MULT(struct r4300_core* r4300)
 
 void gen_MULTU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[72]);
-#endif
 #ifdef INTERPRET_MULTU
     gencallinterp(r4300, (unsigned long long)cached_interp_MULTU, 0);
 #else
@@ -2146,17 +1960,11 @@ void gen_MULTU(struct r4300_core* r4300)
 
 void gen_DMULT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[75]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_DMULT, 0);
 }
 
 void gen_DMULTU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[76]);
-#endif
 #ifdef INTERPRET_DMULTU
     gencallinterp(r4300, (unsigned long long)cached_interp_DMULTU, 0);
 #else
@@ -2172,9 +1980,6 @@ void gen_DMULTU(struct r4300_core* r4300)
 
 void gen_DIV(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[73]);
-#endif
 #ifdef INTERPRET_DIV
     gencallinterp(r4300, (unsigned long long)cached_interp_DIV, 0);
 #else
@@ -2193,9 +1998,6 @@ void gen_DIV(struct r4300_core* r4300)
 
 void gen_DIVU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[74]);
-#endif
 #ifdef INTERPRET_DIVU
     gencallinterp(r4300, (unsigned long long)cached_interp_DIVU, 0);
 #else
@@ -2214,25 +2016,16 @@ void gen_DIVU(struct r4300_core* r4300)
 
 void gen_DDIV(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[77]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_DDIV, 0);
 }
 
 void gen_DDIVU(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[78]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_DDIVU, 0);
 }
 
 void gen_MFHI(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[64]);
-#endif
 #ifdef INTERPRET_MFHI
     gencallinterp(r4300, (unsigned long long)cached_interp_MFHI, 0);
 #else
@@ -2245,9 +2038,6 @@ void gen_MFHI(struct r4300_core* r4300)
 
 void gen_MTHI(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[65]);
-#endif
 #ifdef INTERPRET_MTHI
     gencallinterp(r4300, (unsigned long long)cached_interp_MTHI, 0);
 #else
@@ -2260,9 +2050,6 @@ void gen_MTHI(struct r4300_core* r4300)
 
 void gen_MFLO(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[66]);
-#endif
 #ifdef INTERPRET_MFLO
     gencallinterp(r4300, (unsigned long long)cached_interp_MFLO, 0);
 #else
@@ -2275,9 +2062,6 @@ void gen_MFLO(struct r4300_core* r4300)
 
 void gen_MTLO(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[67]);
-#endif
 #ifdef INTERPRET_MTLO
     gencallinterp(r4300, (unsigned long long)cached_interp_MTLO, 0);
 #else
@@ -2424,9 +2208,6 @@ static void genbranchlink(struct r4300_core* r4300)
 
 void gen_J(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[2]);
-#endif
 #ifdef INTERPRET_J
     gencallinterp(r4300, (unsigned long long)cached_interp_J, 1);
 #else
@@ -2450,9 +2231,6 @@ void gen_J(struct r4300_core* r4300)
 
 void gen_J_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[2]);
-#endif
 #ifdef INTERPRET_J_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_J_OUT, 1);
 #else
@@ -2480,9 +2258,6 @@ void gen_J_OUT(struct r4300_core* r4300)
 
 void gen_J_IDLE(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[2]);
-#endif
 #ifdef INTERPRET_J_IDLE
     gencallinterp(r4300, (unsigned long long)cached_interp_J_IDLE, 1);
 #else
@@ -2506,9 +2281,6 @@ void gen_J_IDLE(struct r4300_core* r4300)
 
 void gen_JAL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[3]);
-#endif
 #ifdef INTERPRET_JAL
     gencallinterp(r4300, (unsigned long long)cached_interp_JAL, 1);
 #else
@@ -2541,9 +2313,6 @@ void gen_JAL(struct r4300_core* r4300)
 
 void gen_JAL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[3]);
-#endif
 #ifdef INTERPRET_JAL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_JAL_OUT, 1);
 #else
@@ -2580,9 +2349,6 @@ void gen_JAL_OUT(struct r4300_core* r4300)
 
 void gen_JAL_IDLE(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[3]);
-#endif
 #ifdef INTERPRET_JAL_IDLE
     gencallinterp(r4300, (unsigned long long)cached_interp_JAL_IDLE, 1);
 #else
@@ -2606,9 +2372,6 @@ void gen_JAL_IDLE(struct r4300_core* r4300)
 
 void gen_JR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[61]);
-#endif
 #ifdef INTERPRET_JR
     gencallinterp(r4300, (unsigned long long)cached_interp_JR_OUT, 1);
 #else
@@ -2674,9 +2437,6 @@ void gen_JR(struct r4300_core* r4300)
 
 void gen_JALR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[62]);
-#endif
 #ifdef INTERPRET_JALR
     gencallinterp(r4300, (unsigned long long)cached_interp_JALR_OUT, 0);
 #else
@@ -2786,9 +2546,6 @@ static void genbeq_test(struct r4300_core* r4300)
 
 void gen_BEQ(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[4]);
-#endif
 #ifdef INTERPRET_BEQ
     gencallinterp(r4300, (unsigned long long)cached_interp_BEQ, 1);
 #else
@@ -2807,9 +2564,6 @@ void gen_BEQ(struct r4300_core* r4300)
 
 void gen_BEQ_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[4]);
-#endif
 #ifdef INTERPRET_BEQ_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BEQ_OUT, 1);
 #else
@@ -2846,9 +2600,6 @@ void gen_BEQ_IDLE(struct r4300_core* r4300)
 
 void gen_BEQL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[16]);
-#endif
 #ifdef INTERPRET_BEQL
     gencallinterp(r4300, (unsigned long long)cached_interp_BEQL, 1);
 #else
@@ -2867,9 +2618,6 @@ void gen_BEQL(struct r4300_core* r4300)
 
 void gen_BEQL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[16]);
-#endif
 #ifdef INTERPRET_BEQL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BEQL_OUT, 1);
 #else
@@ -2943,9 +2691,6 @@ static void genbne_test(struct r4300_core* r4300)
 
 void gen_BNE(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[5]);
-#endif
 #ifdef INTERPRET_BNE
     gencallinterp(r4300, (unsigned long long)cached_interp_BNE, 1);
 #else
@@ -2964,9 +2709,6 @@ void gen_BNE(struct r4300_core* r4300)
 
 void gen_BNE_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[5]);
-#endif
 #ifdef INTERPRET_BNE_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BNE_OUT, 1);
 #else
@@ -3003,9 +2745,6 @@ void gen_BNE_IDLE(struct r4300_core* r4300)
 
 void gen_BNEL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[17]);
-#endif
 #ifdef INTERPRET_BNEL
     gencallinterp(r4300, (unsigned long long)cached_interp_BNEL, 1);
 #else
@@ -3024,9 +2763,6 @@ void gen_BNEL(struct r4300_core* r4300)
 
 void gen_BNEL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[17]);
-#endif
 #ifdef INTERPRET_BNEL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BNEL_OUT, 1);
 #else
@@ -3083,9 +2819,6 @@ static void genblez_test(struct r4300_core* r4300)
 
 void gen_BLEZ(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[6]);
-#endif
 #ifdef INTERPRET_BLEZ
     gencallinterp(r4300, (unsigned long long)cached_interp_BLEZ, 1);
 #else
@@ -3104,9 +2837,6 @@ void gen_BLEZ(struct r4300_core* r4300)
 
 void gen_BLEZ_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[6]);
-#endif
 #ifdef INTERPRET_BLEZ_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BLEZ_OUT, 1);
 #else
@@ -3143,9 +2873,6 @@ void gen_BLEZ_IDLE(struct r4300_core* r4300)
 
 void gen_BLEZL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[18]);
-#endif
 #ifdef INTERPRET_BLEZL
     gencallinterp(r4300, (unsigned long long)cached_interp_BLEZL, 1);
 #else
@@ -3164,9 +2891,6 @@ void gen_BLEZL(struct r4300_core* r4300)
 
 void gen_BLEZL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[18]);
-#endif
 #ifdef INTERPRET_BLEZL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BLEZL_OUT, 1);
 #else
@@ -3223,9 +2947,6 @@ static void genbgtz_test(struct r4300_core* r4300)
 
 void gen_BGTZ(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[7]);
-#endif
 #ifdef INTERPRET_BGTZ
     gencallinterp(r4300, (unsigned long long)cached_interp_BGTZ, 1);
 #else
@@ -3244,9 +2965,6 @@ void gen_BGTZ(struct r4300_core* r4300)
 
 void gen_BGTZ_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[7]);
-#endif
 #ifdef INTERPRET_BGTZ_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BGTZ_OUT, 1);
 #else
@@ -3283,9 +3001,6 @@ void gen_BGTZ_IDLE(struct r4300_core* r4300)
 
 void gen_BGTZL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[19]);
-#endif
 #ifdef INTERPRET_BGTZL
     gencallinterp(r4300, (unsigned long long)cached_interp_BGTZL, 1);
 #else
@@ -3304,9 +3019,6 @@ void gen_BGTZL(struct r4300_core* r4300)
 
 void gen_BGTZL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[19]);
-#endif
 #ifdef INTERPRET_BGTZL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BGTZL_OUT, 1);
 #else
@@ -3368,9 +3080,6 @@ static void genbltz_test(struct r4300_core* r4300)
 
 void gen_BLTZ(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[47]);
-#endif
 #ifdef INTERPRET_BLTZ
     gencallinterp(r4300, (unsigned long long)cached_interp_BLTZ, 1);
 #else
@@ -3389,9 +3098,6 @@ void gen_BLTZ(struct r4300_core* r4300)
 
 void gen_BLTZ_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[47]);
-#endif
 #ifdef INTERPRET_BLTZ_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BLTZ_OUT, 1);
 #else
@@ -3428,9 +3134,6 @@ void gen_BLTZ_IDLE(struct r4300_core* r4300)
 
 void gen_BLTZAL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[51]);
-#endif
 #ifdef INTERPRET_BLTZAL
     gencallinterp(r4300, (unsigned long long)cached_interp_BLTZAL, 1);
 #else
@@ -3450,9 +3153,6 @@ void gen_BLTZAL(struct r4300_core* r4300)
 
 void gen_BLTZAL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[51]);
-#endif
 #ifdef INTERPRET_BLTZAL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BLTZAL_OUT, 1);
 #else
@@ -3491,9 +3191,6 @@ void gen_BLTZAL_IDLE(struct r4300_core* r4300)
 
 void gen_BLTZL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[49]);
-#endif
 #ifdef INTERPRET_BLTZL
     gencallinterp(r4300, (unsigned long long)cached_interp_BLTZL, 1);
 #else
@@ -3512,9 +3209,6 @@ void gen_BLTZL(struct r4300_core* r4300)
 
 void gen_BLTZL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[49]);
-#endif
 #ifdef INTERPRET_BLTZL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BLTZL_OUT, 1);
 #else
@@ -3551,9 +3245,6 @@ void gen_BLTZL_IDLE(struct r4300_core* r4300)
 
 void gen_BLTZALL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[53]);
-#endif
 #ifdef INTERPRET_BLTZALL
     gencallinterp(r4300, (unsigned long long)cached_interp_BLTZALL, 1);
 #else
@@ -3573,9 +3264,6 @@ void gen_BLTZALL(struct r4300_core* r4300)
 
 void gen_BLTZALL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[53]);
-#endif
 #ifdef INTERPRET_BLTZALL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BLTZALL_OUT, 1);
 #else
@@ -3637,9 +3325,6 @@ static void genbgez_test(struct r4300_core* r4300)
 
 void gen_BGEZ(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[48]);
-#endif
 #ifdef INTERPRET_BGEZ
     gencallinterp(r4300, (unsigned long long)cached_interp_BGEZ, 1);
 #else
@@ -3658,9 +3343,6 @@ void gen_BGEZ(struct r4300_core* r4300)
 
 void gen_BGEZ_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[48]);
-#endif
 #ifdef INTERPRET_BGEZ_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BGEZ_OUT, 1);
 #else
@@ -3697,9 +3379,6 @@ void gen_BGEZ_IDLE(struct r4300_core* r4300)
 
 void gen_BGEZAL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[52]);
-#endif
 #ifdef INTERPRET_BGEZAL
     gencallinterp(r4300, (unsigned long long)cached_interp_BGEZAL, 1);
 #else
@@ -3719,9 +3398,6 @@ void gen_BGEZAL(struct r4300_core* r4300)
 
 void gen_BGEZAL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[52]);
-#endif
 #ifdef INTERPRET_BGEZAL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BGEZAL_OUT, 1);
 #else
@@ -3760,9 +3436,6 @@ void gen_BGEZAL_IDLE(struct r4300_core* r4300)
 
 void gen_BGEZL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[50]);
-#endif
 #ifdef INTERPRET_BGEZL
     gencallinterp(r4300, (unsigned long long)cached_interp_BGEZL, 1);
 #else
@@ -3781,9 +3454,6 @@ void gen_BGEZL(struct r4300_core* r4300)
 
 void gen_BGEZL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[50]);
-#endif
 #ifdef INTERPRET_BGEZL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BGEZL_OUT, 1);
 #else
@@ -3820,9 +3490,6 @@ void gen_BGEZL_IDLE(struct r4300_core* r4300)
 
 void gen_BGEZALL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[54]);
-#endif
 #ifdef INTERPRET_BGEZALL
     gencallinterp(r4300, (unsigned long long)cached_interp_BGEZALL, 1);
 #else
@@ -3842,9 +3509,6 @@ void gen_BGEZALL(struct r4300_core* r4300)
 
 void gen_BGEZALL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[54]);
-#endif
 #ifdef INTERPRET_BGEZALL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BGEZALL_OUT, 1);
 #else
@@ -3889,9 +3553,6 @@ static void genbc1f_test(struct r4300_core* r4300)
 
 void gen_BC1F(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[100]);
-#endif
 #ifdef INTERPRET_BC1F
     gencallinterp(r4300, (unsigned long long)cached_interp_BC1F, 1);
 #else
@@ -3911,9 +3572,6 @@ void gen_BC1F(struct r4300_core* r4300)
 
 void gen_BC1F_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[100]);
-#endif
 #ifdef INTERPRET_BC1F_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BC1F_OUT, 1);
 #else
@@ -3952,9 +3610,6 @@ void gen_BC1F_IDLE(struct r4300_core* r4300)
 
 void gen_BC1FL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[102]);
-#endif
 #ifdef INTERPRET_BC1FL
     gencallinterp(r4300, (unsigned long long)cached_interp_BC1FL, 1);
 #else
@@ -3974,9 +3629,6 @@ void gen_BC1FL(struct r4300_core* r4300)
 
 void gen_BC1FL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[102]);
-#endif
 #ifdef INTERPRET_BC1FL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BC1FL_OUT, 1);
 #else
@@ -4021,9 +3673,6 @@ static void genbc1t_test(struct r4300_core* r4300)
 
 void gen_BC1T(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[101]);
-#endif
 #ifdef INTERPRET_BC1T
     gencallinterp(r4300, (unsigned long long)cached_interp_BC1T, 1);
 #else
@@ -4043,9 +3692,6 @@ void gen_BC1T(struct r4300_core* r4300)
 
 void gen_BC1T_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[101]);
-#endif
 #ifdef INTERPRET_BC1T_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BC1T_OUT, 1);
 #else
@@ -4084,9 +3730,6 @@ void gen_BC1T_IDLE(struct r4300_core* r4300)
 
 void gen_BC1TL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[103]);
-#endif
 #ifdef INTERPRET_BC1TL
     gencallinterp(r4300, (unsigned long long)cached_interp_BC1TL, 1);
 #else
@@ -4106,9 +3749,6 @@ void gen_BC1TL(struct r4300_core* r4300)
 
 void gen_BC1TL_OUT(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[103]);
-#endif
 #ifdef INTERPRET_BC1TL_OUT
     gencallinterp(r4300, (unsigned long long)cached_interp_BC1TL_OUT, 1);
 #else
@@ -4153,9 +3793,6 @@ void gen_CACHE(struct r4300_core* r4300)
 
 void gen_ERET(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[108]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_ERET, 1);
 #if 0
     dst->local_addr = code_length;
@@ -4174,9 +3811,6 @@ void gen_SYNC(struct r4300_core* r4300)
 
 void gen_SYSCALL(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[63]);
-#endif
 #ifdef INTERPRET_SYSCALL
     gencallinterp(r4300, (unsigned long long)cached_interp_SYSCALL, 0);
 #else
@@ -4231,9 +3865,6 @@ void gen_TLTIU(struct r4300_core* r4300)
 
 void gen_TEQ(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[96]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_TEQ, 0);
 }
 
@@ -4256,9 +3887,6 @@ void gen_TNEI(struct r4300_core* r4300)
 
 void gen_TLBP(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[105]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_TLBP, 0);
 #if 0
     dst->local_addr = code_length;
@@ -4271,9 +3899,6 @@ void gen_TLBP(struct r4300_core* r4300)
 
 void gen_TLBR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[106]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_TLBR, 0);
 #if 0
     dst->local_addr = code_length;
@@ -4286,17 +3911,11 @@ void gen_TLBR(struct r4300_core* r4300)
 
 void gen_TLBWR(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[107]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_TLBWR, 0);
 }
 
 void gen_TLBWI(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[104]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_TLBWI, 0);
 #if 0
     dst->local_addr = code_length;
@@ -4311,17 +3930,11 @@ void gen_TLBWI(struct r4300_core* r4300)
 
 void gen_MFC0(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[109]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_MFC0, 0);
 }
 
 void gen_MTC0(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[110]);
-#endif
     gencallinterp(r4300, (unsigned long long)cached_interp_MTC0, 0);
 }
 
@@ -4329,9 +3942,6 @@ void gen_MTC0(struct r4300_core* r4300)
 
 void gen_LWC1(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[39]);
-#endif
 #ifdef INTERPRET_LWC1
     gencallinterp(r4300, (unsigned long long)cached_interp_LWC1, 0);
 #else
@@ -4383,9 +3993,6 @@ void gen_LWC1(struct r4300_core* r4300)
 
 void gen_LDC1(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[40]);
-#endif
 #ifdef INTERPRET_LDC1
     gencallinterp(r4300, (unsigned long long)cached_interp_LDC1, 0);
 #else
@@ -4439,9 +4046,6 @@ void gen_LDC1(struct r4300_core* r4300)
 
 void gen_SWC1(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[43]);
-#endif
 #ifdef INTERPRET_SWC1
     gencallinterp(r4300, (unsigned long long)cached_interp_SWC1, 0);
 #else
@@ -4515,9 +4119,6 @@ void gen_SWC1(struct r4300_core* r4300)
 
 void gen_SDC1(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[44]);
-#endif
 #ifdef INTERPRET_SDC1
     gencallinterp(r4300, (unsigned long long)cached_interp_SDC1, 0);
 #else
@@ -4593,9 +4194,6 @@ void gen_SDC1(struct r4300_core* r4300)
 
 void gen_MFC1(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[111]);
-#endif
 #ifdef INTERPRET_MFC1
     gencallinterp(r4300, (unsigned long long)cached_interp_MFC1, 0);
 #else
@@ -4610,9 +4208,6 @@ void gen_MFC1(struct r4300_core* r4300)
 
 void gen_DMFC1(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[112]);
-#endif
 #ifdef INTERPRET_DMFC1
     gencallinterp(r4300, (unsigned long long)cached_interp_DMFC1, 0);
 #else
@@ -4627,9 +4222,6 @@ void gen_DMFC1(struct r4300_core* r4300)
 
 void gen_CFC1(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[113]);
-#endif
 #ifdef INTERPRET_CFC1
     gencallinterp(r4300, (unsigned long long)cached_interp_CFC1, 0);
 #else
@@ -4648,9 +4240,6 @@ void gen_CFC1(struct r4300_core* r4300)
 
 void gen_MTC1(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[114]);
-#endif
 #ifdef INTERPRET_MTC1
     gencallinterp(r4300, (unsigned long long)cached_interp_MTC1, 0);
 #else
@@ -4663,9 +4252,6 @@ void gen_MTC1(struct r4300_core* r4300)
 
 void gen_DMTC1(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[115]);
-#endif
 #ifdef INTERPRET_DMTC1
     gencallinterp(r4300, (unsigned long long)cached_interp_DMTC1, 0);
 #else
@@ -4680,9 +4266,6 @@ void gen_DMTC1(struct r4300_core* r4300)
 
 void gen_CTC1(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[116]);
-#endif
 #ifdef INTERPRET_CTC1
     gencallinterp(r4300, (unsigned long long)cached_interp_CTC1, 0);
 #else
@@ -4720,9 +4303,6 @@ void gen_CTC1(struct r4300_core* r4300)
 
 void gen_CP1_ABS_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[124]);
-#endif
 #ifdef INTERPRET_CP1_ABS_S
     gencallinterp(r4300, (unsigned long long)cached_interp_ABS_S, 0);
 #else
@@ -4737,9 +4317,6 @@ void gen_CP1_ABS_S(struct r4300_core* r4300)
 
 void gen_CP1_ABS_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[124]);
-#endif
 #ifdef INTERPRET_CP1_ABS_D
     gencallinterp(r4300, (unsigned long long)cached_interp_ABS_D, 0);
 #else
@@ -4754,9 +4331,6 @@ void gen_CP1_ABS_D(struct r4300_core* r4300)
 
 void gen_CP1_ADD_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[119]);
-#endif
 #ifdef INTERPRET_CP1_ADD_S
     gencallinterp(r4300, (unsigned long long)cached_interp_ADD_S, 0);
 #else
@@ -4772,9 +4346,6 @@ void gen_CP1_ADD_S(struct r4300_core* r4300)
 
 void gen_CP1_ADD_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[119]);
-#endif
 #ifdef INTERPRET_CP1_ADD_D
     gencallinterp(r4300, (unsigned long long)cached_interp_ADD_D, 0);
 #else
@@ -4790,9 +4361,6 @@ void gen_CP1_ADD_D(struct r4300_core* r4300)
 
 void gen_CP1_DIV_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[122]);
-#endif
 #ifdef INTERPRET_CP1_DIV_S
     gencallinterp(r4300, (unsigned long long)cached_interp_DIV_S, 0);
 #else
@@ -4808,9 +4376,6 @@ void gen_CP1_DIV_S(struct r4300_core* r4300)
 
 void gen_CP1_DIV_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[122]);
-#endif
 #ifdef INTERPRET_CP1_DIV_D
     gencallinterp(r4300, (unsigned long long)cached_interp_DIV_D, 0);
 #else
@@ -4826,9 +4391,6 @@ void gen_CP1_DIV_D(struct r4300_core* r4300)
 
 void gen_CP1_MOV_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[125]);
-#endif
 #ifdef INTERPRET_CP1_MOV_S
     gencallinterp(r4300, (unsigned long long)cached_interp_MOV_S, 0);
 #else
@@ -4842,9 +4404,6 @@ void gen_CP1_MOV_S(struct r4300_core* r4300)
 
 void gen_CP1_MOV_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[125]);
-#endif
 #ifdef INTERPRET_CP1_MOV_D
     gencallinterp(r4300, (unsigned long long)cached_interp_MOV_D, 0);
 #else
@@ -4860,9 +4419,6 @@ void gen_CP1_MOV_D(struct r4300_core* r4300)
 
 void gen_CP1_MUL_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[121]);
-#endif
 #ifdef INTERPRET_CP1_MUL_S
     gencallinterp(r4300, (unsigned long long)cached_interp_MUL_S, 0);
 #else
@@ -4878,9 +4434,6 @@ void gen_CP1_MUL_S(struct r4300_core* r4300)
 
 void gen_CP1_MUL_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[121]);
-#endif
 #ifdef INTERPRET_CP1_MUL_D
     gencallinterp(r4300, (unsigned long long)cached_interp_MUL_D, 0);
 #else
@@ -4896,9 +4449,6 @@ void gen_CP1_MUL_D(struct r4300_core* r4300)
 
 void gen_CP1_NEG_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[126]);
-#endif
 #ifdef INTERPRET_CP1_NEG_S
     gencallinterp(r4300, (unsigned long long)cached_interp_NEG_S, 0);
 #else
@@ -4913,9 +4463,6 @@ void gen_CP1_NEG_S(struct r4300_core* r4300)
 
 void gen_CP1_NEG_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[126]);
-#endif
 #ifdef INTERPRET_CP1_NEG_D
     gencallinterp(r4300, (unsigned long long)cached_interp_NEG_D, 0);
 #else
@@ -4930,9 +4477,6 @@ void gen_CP1_NEG_D(struct r4300_core* r4300)
 
 void gen_CP1_SQRT_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[123]);
-#endif
 #ifdef INTERPRET_CP1_SQRT_S
     gencallinterp(r4300, (unsigned long long)cached_interp_SQRT_S, 0);
 #else
@@ -4947,9 +4491,6 @@ void gen_CP1_SQRT_S(struct r4300_core* r4300)
 
 void gen_CP1_SQRT_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[123]);
-#endif
 #ifdef INTERPRET_CP1_SQRT_D
     gencallinterp(r4300, (unsigned long long)cached_interp_SQRT_D, 0);
 #else
@@ -4964,9 +4505,6 @@ void gen_CP1_SQRT_D(struct r4300_core* r4300)
 
 void gen_CP1_SUB_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[120]);
-#endif
 #ifdef INTERPRET_CP1_SUB_S
     gencallinterp(r4300, (unsigned long long)cached_interp_SUB_S, 0);
 #else
@@ -4982,9 +4520,6 @@ void gen_CP1_SUB_S(struct r4300_core* r4300)
 
 void gen_CP1_SUB_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[120]);
-#endif
 #ifdef INTERPRET_CP1_SUB_D
     gencallinterp(r4300, (unsigned long long)cached_interp_SUB_D, 0);
 #else
@@ -5000,9 +4535,6 @@ void gen_CP1_SUB_D(struct r4300_core* r4300)
 
 void gen_CP1_TRUNC_W_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[128]);
-#endif
 #ifdef INTERPRET_CP1_TRUNC_W_S
     gencallinterp(r4300, (unsigned long long)cached_interp_TRUNC_W_S, 0);
 #else
@@ -5018,9 +4550,6 @@ void gen_CP1_TRUNC_W_S(struct r4300_core* r4300)
 
 void gen_CP1_TRUNC_W_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[128]);
-#endif
 #ifdef INTERPRET_CP1_TRUNC_W_D
     gencallinterp(r4300, (unsigned long long)cached_interp_TRUNC_W_D, 0);
 #else
@@ -5036,9 +4565,6 @@ void gen_CP1_TRUNC_W_D(struct r4300_core* r4300)
 
 void gen_CP1_TRUNC_L_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[128]);
-#endif
 #ifdef INTERPRET_CP1_TRUNC_L_S
     gencallinterp(r4300, (unsigned long long)cached_interp_TRUNC_L_S, 0);
 #else
@@ -5054,9 +4580,6 @@ void gen_CP1_TRUNC_L_S(struct r4300_core* r4300)
 
 void gen_CP1_TRUNC_L_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[128]);
-#endif
 #ifdef INTERPRET_CP1_TRUNC_L_D
     gencallinterp(r4300, (unsigned long long)cached_interp_TRUNC_L_D, 0);
 #else
@@ -5072,9 +4595,6 @@ void gen_CP1_TRUNC_L_D(struct r4300_core* r4300)
 
 void gen_CP1_ROUND_W_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[127]);
-#endif
 #ifdef INTERPRET_CP1_ROUND_W_S
     gencallinterp(r4300, (unsigned long long)cached_interp_ROUND_W_S, 0);
 #else
@@ -5090,9 +4610,6 @@ void gen_CP1_ROUND_W_S(struct r4300_core* r4300)
 
 void gen_CP1_ROUND_W_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[127]);
-#endif
 #ifdef INTERPRET_CP1_ROUND_W_D
     gencallinterp(r4300, (unsigned long long)cached_interp_ROUND_W_D, 0);
 #else
@@ -5108,9 +4625,6 @@ void gen_CP1_ROUND_W_D(struct r4300_core* r4300)
 
 void gen_CP1_ROUND_L_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[127]);
-#endif
 #ifdef INTERPRET_CP1_ROUND_L_S
     gencallinterp(r4300, (unsigned long long)cached_interp_ROUND_L_S, 0);
 #else
@@ -5126,9 +4640,6 @@ void gen_CP1_ROUND_L_S(struct r4300_core* r4300)
 
 void gen_CP1_ROUND_L_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[127]);
-#endif
 #ifdef INTERPRET_CP1_ROUND_L_D
     gencallinterp(r4300, (unsigned long long)cached_interp_ROUND_L_D, 0);
 #else
@@ -5144,9 +4655,6 @@ void gen_CP1_ROUND_L_D(struct r4300_core* r4300)
 
 void gen_CP1_CEIL_W_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[129]);
-#endif
 #ifdef INTERPRET_CP1_CEIL_W_S
     gencallinterp(r4300, (unsigned long long)cached_interp_CEIL_W_S, 0);
 #else
@@ -5162,9 +4670,6 @@ void gen_CP1_CEIL_W_S(struct r4300_core* r4300)
 
 void gen_CP1_CEIL_W_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[129]);
-#endif
 #ifdef INTERPRET_CP1_CEIL_W_D
     gencallinterp(r4300, (unsigned long long)cached_interp_CEIL_W_D, 0);
 #else
@@ -5180,9 +4685,6 @@ void gen_CP1_CEIL_W_D(struct r4300_core* r4300)
 
 void gen_CP1_CEIL_L_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[129]);
-#endif
 #ifdef INTERPRET_CP1_CEIL_L_S
     gencallinterp(r4300, (unsigned long long)cached_interp_CEIL_L_S, 0);
 #else
@@ -5198,9 +4700,6 @@ void gen_CP1_CEIL_L_S(struct r4300_core* r4300)
 
 void gen_CP1_CEIL_L_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[129]);
-#endif
 #ifdef INTERPRET_CP1_CEIL_L_D
     gencallinterp(r4300, (unsigned long long)cached_interp_CEIL_L_D, 0);
 #else
@@ -5216,9 +4715,6 @@ void gen_CP1_CEIL_L_D(struct r4300_core* r4300)
 
 void gen_CP1_FLOOR_W_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[130]);
-#endif
 #ifdef INTERPRET_CP1_FLOOR_W_S
     gencallinterp(r4300, (unsigned long long)cached_interp_FLOOR_W_S, 0);
 #else
@@ -5234,9 +4730,6 @@ void gen_CP1_FLOOR_W_S(struct r4300_core* r4300)
 
 void gen_CP1_FLOOR_W_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[130]);
-#endif
 #ifdef INTERPRET_CP1_FLOOR_W_D
     gencallinterp(r4300, (unsigned long long)cached_interp_FLOOR_W_D, 0);
 #else
@@ -5252,9 +4745,6 @@ void gen_CP1_FLOOR_W_D(struct r4300_core* r4300)
 
 void gen_CP1_FLOOR_L_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[130]);
-#endif
 #ifdef INTERPRET_CP1_FLOOR_L_S
     gencallinterp(r4300, (unsigned long long)cached_interp_FLOOR_L_S, 0);
 #else
@@ -5270,9 +4760,6 @@ void gen_CP1_FLOOR_L_S(struct r4300_core* r4300)
 
 void gen_CP1_FLOOR_L_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[130]);
-#endif
 #ifdef INTERPRET_CP1_FLOOR_L_D
     gencallinterp(r4300, (unsigned long long)cached_interp_FLOOR_L_D, 0);
 #else
@@ -5288,9 +4775,6 @@ void gen_CP1_FLOOR_L_D(struct r4300_core* r4300)
 
 void gen_CP1_CVT_S_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[117]);
-#endif
 #ifdef INTERPRET_CP1_CVT_S_D
     gencallinterp(r4300, (unsigned long long)cached_interp_CVT_S_D, 0);
 #else
@@ -5304,9 +4788,6 @@ void gen_CP1_CVT_S_D(struct r4300_core* r4300)
 
 void gen_CP1_CVT_S_W(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[117]);
-#endif
 #ifdef INTERPRET_CP1_CVT_S_W
     gencallinterp(r4300, (unsigned long long)cached_interp_CVT_S_W, 0);
 #else
@@ -5320,9 +4801,6 @@ void gen_CP1_CVT_S_W(struct r4300_core* r4300)
 
 void gen_CP1_CVT_S_L(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[117]);
-#endif
 #ifdef INTERPRET_CP1_CVT_S_L
     gencallinterp(r4300, (unsigned long long)cached_interp_CVT_S_L, 0);
 #else
@@ -5336,9 +4814,6 @@ void gen_CP1_CVT_S_L(struct r4300_core* r4300)
 
 void gen_CP1_CVT_D_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[117]);
-#endif
 #ifdef INTERPRET_CP1_CVT_D_S
     gencallinterp(r4300, (unsigned long long)cached_interp_CVT_D_S, 0);
 #else
@@ -5352,9 +4827,6 @@ void gen_CP1_CVT_D_S(struct r4300_core* r4300)
 
 void gen_CP1_CVT_D_W(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[117]);
-#endif
 #ifdef INTERPRET_CP1_CVT_D_W
     gencallinterp(r4300, (unsigned long long)cached_interp_CVT_D_W, 0);
 #else
@@ -5368,9 +4840,6 @@ void gen_CP1_CVT_D_W(struct r4300_core* r4300)
 
 void gen_CP1_CVT_D_L(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[117]);
-#endif
 #ifdef INTERPRET_CP1_CVT_D_L
     gencallinterp(r4300, (unsigned long long)cached_interp_CVT_D_L, 0);
 #else
@@ -5384,9 +4853,6 @@ void gen_CP1_CVT_D_L(struct r4300_core* r4300)
 
 void gen_CP1_CVT_W_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[117]);
-#endif
 #ifdef INTERPRET_CP1_CVT_W_S
     gencallinterp(r4300, (unsigned long long)cached_interp_CVT_W_S, 0);
 #else
@@ -5400,9 +4866,6 @@ void gen_CP1_CVT_W_S(struct r4300_core* r4300)
 
 void gen_CP1_CVT_W_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[117]);
-#endif
 #ifdef INTERPRET_CP1_CVT_W_D
     gencallinterp(r4300, (unsigned long long)cached_interp_CVT_W_D, 0);
 #else
@@ -5416,9 +4879,6 @@ void gen_CP1_CVT_W_D(struct r4300_core* r4300)
 
 void gen_CP1_CVT_L_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[117]);
-#endif
 #ifdef INTERPRET_CP1_CVT_L_S
     gencallinterp(r4300, (unsigned long long)cached_interp_CVT_L_S, 0);
 #else
@@ -5432,9 +4892,6 @@ void gen_CP1_CVT_L_S(struct r4300_core* r4300)
 
 void gen_CP1_CVT_L_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[117]);
-#endif
 #ifdef INTERPRET_CP1_CVT_L_D
     gencallinterp(r4300, (unsigned long long)cached_interp_CVT_L_D, 0);
 #else
@@ -5450,9 +4907,6 @@ void gen_CP1_CVT_L_D(struct r4300_core* r4300)
 
 void gen_CP1_C_F_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_F_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_F_S, 0);
 #else
@@ -5463,9 +4917,6 @@ void gen_CP1_C_F_S(struct r4300_core* r4300)
 
 void gen_CP1_C_F_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_F_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_F_D, 0);
 #else
@@ -5476,9 +4927,6 @@ void gen_CP1_C_F_D(struct r4300_core* r4300)
 
 void gen_CP1_C_UN_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_UN_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_UN_S, 0);
 #else
@@ -5498,9 +4946,6 @@ void gen_CP1_C_UN_S(struct r4300_core* r4300)
 
 void gen_CP1_C_UN_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_UN_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_UN_D, 0);
 #else
@@ -5520,9 +4965,6 @@ void gen_CP1_C_UN_D(struct r4300_core* r4300)
 
 void gen_CP1_C_EQ_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_EQ_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_EQ_S, 0);
 #else
@@ -5542,9 +4984,6 @@ void gen_CP1_C_EQ_S(struct r4300_core* r4300)
 
 void gen_CP1_C_EQ_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_EQ_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_EQ_D, 0);
 #else
@@ -5564,9 +5003,6 @@ void gen_CP1_C_EQ_D(struct r4300_core* r4300)
 
 void gen_CP1_C_UEQ_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_UEQ_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_UEQ_S, 0);
 #else
@@ -5587,9 +5023,6 @@ void gen_CP1_C_UEQ_S(struct r4300_core* r4300)
 
 void gen_CP1_C_UEQ_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_UEQ_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_UEQ_D, 0);
 #else
@@ -5610,9 +5043,6 @@ void gen_CP1_C_UEQ_D(struct r4300_core* r4300)
 
 void gen_CP1_C_OLT_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_OLT_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_OLT_S, 0);
 #else
@@ -5632,9 +5062,6 @@ void gen_CP1_C_OLT_S(struct r4300_core* r4300)
 
 void gen_CP1_C_OLT_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_OLT_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_OLT_D, 0);
 #else
@@ -5654,9 +5081,6 @@ void gen_CP1_C_OLT_D(struct r4300_core* r4300)
 
 void gen_CP1_C_ULT_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_ULT_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_ULT_S, 0);
 #else
@@ -5677,9 +5101,6 @@ void gen_CP1_C_ULT_S(struct r4300_core* r4300)
 
 void gen_CP1_C_ULT_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_ULT_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_ULT_D, 0);
 #else
@@ -5700,9 +5121,6 @@ void gen_CP1_C_ULT_D(struct r4300_core* r4300)
 
 void gen_CP1_C_OLE_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_OLE_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_OLE_S, 0);
 #else
@@ -5722,9 +5140,6 @@ void gen_CP1_C_OLE_S(struct r4300_core* r4300)
 
 void gen_CP1_C_OLE_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_OLE_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_OLE_D, 0);
 #else
@@ -5744,9 +5159,6 @@ void gen_CP1_C_OLE_D(struct r4300_core* r4300)
 
 void gen_CP1_C_ULE_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_ULE_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_ULE_S, 0);
 #else
@@ -5767,9 +5179,6 @@ void gen_CP1_C_ULE_S(struct r4300_core* r4300)
 
 void gen_CP1_C_ULE_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_ULE_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_ULE_D, 0);
 #else
@@ -5790,9 +5199,6 @@ void gen_CP1_C_ULE_D(struct r4300_core* r4300)
 
 void gen_CP1_C_SF_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_SF_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_SF_S, 0);
 #else
@@ -5809,9 +5215,6 @@ void gen_CP1_C_SF_S(struct r4300_core* r4300)
 
 void gen_CP1_C_SF_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_SF_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_SF_D, 0);
 #else
@@ -5828,9 +5231,6 @@ void gen_CP1_C_SF_D(struct r4300_core* r4300)
 
 void gen_CP1_C_NGLE_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_NGLE_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_NGLE_S, 0);
 #else
@@ -5850,9 +5250,6 @@ void gen_CP1_C_NGLE_S(struct r4300_core* r4300)
 
 void gen_CP1_C_NGLE_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_NGLE_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_NGLE_D, 0);
 #else
@@ -5872,9 +5269,6 @@ void gen_CP1_C_NGLE_D(struct r4300_core* r4300)
 
 void gen_CP1_C_SEQ_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_SEQ_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_SEQ_S, 0);
 #else
@@ -5894,9 +5288,6 @@ void gen_CP1_C_SEQ_S(struct r4300_core* r4300)
 
 void gen_CP1_C_SEQ_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_SEQ_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_SEQ_D, 0);
 #else
@@ -5916,9 +5307,6 @@ void gen_CP1_C_SEQ_D(struct r4300_core* r4300)
 
 void gen_CP1_C_NGL_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_NGL_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_NGL_S, 0);
 #else
@@ -5939,9 +5327,6 @@ void gen_CP1_C_NGL_S(struct r4300_core* r4300)
 
 void gen_CP1_C_NGL_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_NGL_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_NGL_D, 0);
 #else
@@ -5962,9 +5347,6 @@ void gen_CP1_C_NGL_D(struct r4300_core* r4300)
 
 void gen_CP1_C_LT_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_LT_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_LT_S, 0);
 #else
@@ -5984,9 +5366,6 @@ void gen_CP1_C_LT_S(struct r4300_core* r4300)
 
 void gen_CP1_C_LT_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_LT_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_LT_D, 0);
 #else
@@ -6006,9 +5385,6 @@ void gen_CP1_C_LT_D(struct r4300_core* r4300)
 
 void gen_CP1_C_NGE_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_NGE_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_NGE_S, 0);
 #else
@@ -6029,9 +5405,6 @@ void gen_CP1_C_NGE_S(struct r4300_core* r4300)
 
 void gen_CP1_C_NGE_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_NGE_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_NGE_D, 0);
 #else
@@ -6052,9 +5425,6 @@ void gen_CP1_C_NGE_D(struct r4300_core* r4300)
 
 void gen_CP1_C_LE_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_LE_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_LE_S, 0);
 #else
@@ -6074,9 +5444,6 @@ void gen_CP1_C_LE_S(struct r4300_core* r4300)
 
 void gen_CP1_C_LE_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_LE_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_LE_D, 0);
 #else
@@ -6096,9 +5463,6 @@ void gen_CP1_C_LE_D(struct r4300_core* r4300)
 
 void gen_CP1_C_NGT_S(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_NGT_S
     gencallinterp(r4300, (unsigned long long)cached_interp_C_NGT_S, 0);
 #else
@@ -6119,9 +5483,6 @@ void gen_CP1_C_NGT_S(struct r4300_core* r4300)
 
 void gen_CP1_C_NGT_D(struct r4300_core* r4300)
 {
-#if defined(COUNT_INSTR)
-    inc_m32rel(&instr_count[118]);
-#endif
 #ifdef INTERPRET_CP1_C_NGT_D
     gencallinterp(r4300, (unsigned long long)cached_interp_C_NGT_D, 0);
 #else
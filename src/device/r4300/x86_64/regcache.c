@@ -47,17 +47,9 @@ void init_cache(struct r4300_core* r4300, struct precomp_instr* start)
 
 void free_all_registers(struct r4300_core* r4300)
 {
-#if defined(PROFILE_R4300)
-    int freestart = r4300->recomp.code_length;
-    int flushed = 0;
-#endif
-
     int i;
     for (i=0; i<8; i++)
     {
-#if defined(PROFILE_R4300)
-        if (r4300->recomp.regcache_state.last_access[i] && r4300->recomp.regcache_state.dirty[i]) flushed = 1;
-#endif
         if (r4300->recomp.regcache_state.last_access[i])
         {
             free_register(r4300, i);
@@ -71,21 +63,6 @@ void free_all_registers(struct r4300_core* r4300)
             }
         }
     }
-
-#if defined(PROFILE_R4300)
-    if (flushed == 1)
-    {
-        long long x86addr = (long long) ((*r4300->recomp.inst_pointer) + freestart);
-        int mipsop = -5;
-        if (fwrite(&mipsop, 1, 4, r4300->recomp.pfProfile) != 4 || /* -5 = regcache flushing */
-                fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile) != sizeof(char *)) // write pointer to start of register cache flushing instructions
-            DebugMessage(M64MSG_ERROR, "Error writing R4300 instruction address profiling data");
-        x86addr = (long long) ((*r4300->recomp.inst_pointer) + r4300->recomp.code_length);
-        if (fwrite(&r4300->recomp.src, 1, 4, r4300->recomp.pfProfile) != 4 || // write 4-byte MIPS opcode for current instruction
-                fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile) != sizeof(char *)) // write pointer to dynamically generated x86 code for this MIPS instruction
-            DebugMessage(M64MSG_ERROR, "Error writing R4300 instruction address profiling data");
-    }
-#endif
 }
 
 static void simplify_access(struct r4300_core* r4300)
@@ -576,14 +553,6 @@ static void build_wrapper(struct r4300_core* r4300, struct precomp_instr *instr,
 {
     int i;
 
-#if defined(PROFILE_R4300)
-    long long x86addr = (long long) pCode;
-    int mipsop = -4;
-    if (fwrite(&mipsop, 1, 4, r4300->recomp.pfProfile) != 4 || // write 4-byte MIPS opcode
-            fwrite(&x86addr, 1, sizeof(char *), r4300->recomp.pfProfile) != sizeof(char *)) // write pointer to dynamically generated x86 code for this MIPS instruction
-        DebugMessage(M64MSG_ERROR, "Error writing R4300 instruction address profiling data");
-#endif
-
     *pCode++ = 0x48;
     *pCode++ = 0x83;
     *pCode++ = 0xEC;
@@ -26,6 +26,7 @@
 #include "device/r4300/cp0.h"
 #include "device/r4300/interrupt.h"
 #include "device/r4300/r4300_core.h"
+#include "main/rsp_thread.h"
 
 static int update_mi_init_mode(uint32_t* mi_init_mode, uint32_t w)
 {
@@ -83,6 +84,8 @@ void read_mi_regs(void* opaque, uint32_t address, uint32_t* value)
     struct mi_controller* mi = (struct mi_controller*)opaque;
     uint32_t reg = mi_reg(address);
 
+    rsp_thread_sync();
+
     *value = mi->regs[reg];
 }
 
@@ -91,6 +94,8 @@ void write_mi_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
     struct mi_controller* mi = (struct mi_controller*)opaque;
     uint32_t reg = mi_reg(address);
 
+    rsp_thread_sync();
+
     int* cp0_cycle_count = r4300_cp0_cycle_count(&mi->r4300->cp0);
 
     switch(reg)
@@ -117,6 +122,8 @@ void write_mi_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
  */
 void raise_rcp_interrupt(struct mi_controller* mi, uint32_t mi_intr)
 {
+    rsp_thread_sync();
+
     mi->regs[MI_INTR_REG] |= mi_intr;
 
     if (mi->regs[MI_INTR_REG] & mi->regs[MI_INTR_MASK_REG])
@@ -126,12 +133,16 @@ void raise_rcp_interrupt(struct mi_controller* mi, uint32_t mi_intr)
 /* interrupt execution is scheduled (if not masked) */
 void signal_rcp_interrupt(struct mi_controller* mi, uint32_t mi_intr)
 {
+    rsp_thread_sync();
+
     mi->regs[MI_INTR_REG] |= mi_intr;
     r4300_check_interrupt(mi->r4300, CP0_CAUSE_IP2, mi->regs[MI_INTR_REG] & mi->regs[MI_INTR_MASK_REG]);
 }
 
 void clear_rcp_interrupt(struct mi_controller* mi, uint32_t mi_intr)
 {
+    rsp_thread_sync();
+
     mi->regs[MI_INTR_REG] &= ~mi_intr;
     r4300_check_interrupt(mi->r4300, CP0_CAUSE_IP2, mi->regs[MI_INTR_REG] & mi->regs[MI_INTR_MASK_REG]);
 }
@@ -26,9 +26,12 @@
 #include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
 #include "device/rdram/rdram.h"
+#include "main/benchmark.h"
+#include "main/rsp_thread.h"
 #include "osal/preproc.h"
 #include "plugin/plugin.h"
 
+#include <inttypes.h>
 #include <string.h>
 
 static osal_inline size_t fb_buffer_size(const FrameBufferInfo* fb_info)
@@ -36,41 +39,87 @@ static osal_inline size_t fb_buffer_size(const FrameBufferInfo* fb_info)
     return fb_info->width * fb_info->height * fb_info->size;
 }
 
-void pre_framebuffer_read(struct fb* fb, uint32_t address)
+static osal_inline int test_bit(const uint64_t* bits, uint32_t i)
 {
-    if (!fb->infos[0].addr) {
-        return;
-    }
+    return (bits[i / 64] >> (i % 64)) & 1;
+}
 
-    size_t i;
+static osal_inline void set_bit(uint64_t* bits, uint32_t i)
+{
+    bits[i / 64] |= UINT64_C(1) << (i % 64);
+}
 
-    for (i = 0; i < FB_INFOS_COUNT; ++i) {
+static osal_inline void clear_bit(uint64_t* bits, uint32_t i)
+{
+    bits[i / 64] &= ~(UINT64_C(1) << (i % 64));
+}
 
-        /* skip empty fb info */
-        if (fb->infos[i].addr == 0) {
-            continue;
+/* test whether any of the pages [first, last] belongs to a framebuffer */
+static int any_fb_page(const struct fb* fb, uint32_t first, uint32_t last)
+{
+    uint32_t w;
+
+    if (first >= FB_DIRTY_PAGES_COUNT) {
+        return 0;
+    }
+    if (last >= FB_DIRTY_PAGES_COUNT) {
+        last = FB_DIRTY_PAGES_COUNT - 1;
+    }
+
+    for (w = first / 64; w <= last / 64; ++w) {
+        uint64_t mask = ~UINT64_C(0);
+
+        if (w == first / 64) {
+            mask &= ~UINT64_C(0) << (first % 64);
+        }
+        if (w == last / 64) {
+            mask &= ~UINT64_C(0) >> (63 - last % 64);
+        }
+        if (fb->fb_pages[w] & mask) {
+            return 1;
         }
+    }
 
-        /* if address in within a fb and its page is dirty,
-         * notify GFX plugin and mark page as not dirty */
-        uint32_t begin = fb->infos[i].addr;
-        uint32_t end   = fb->infos[i].addr + fb_buffer_size(&fb->infos[i]) - 1;
+    return 0;
+}
+
+void pre_framebuffer_read(struct fb* fb, uint32_t address)
+{
+    size_t i;
+    uint32_t page = address >> 12;
 
-        if ((address >= begin) && (address <= end) && (fb->dirty_page[address >> 12])) {
+    rsp_thread_sync();
+
+    if (page >= FB_DIRTY_PAGES_COUNT || !test_bit(fb->dirty_pages, page)) {
+        return;
+    }
+
+    /* if address in within a fb and its page is dirty,
+     * notify GFX plugin and mark page as not dirty */
+    for (i = 0; i < fb->ranges_count; ++i) {
+        if (address >= fb->ranges[i].begin && address <= fb->ranges[i].end) {
             gfx.fBRead(address);
-            fb->dirty_page[address >> 12] = 0;
+            ++fb->read_callbacks;
+            clear_bit(fb->dirty_pages, page);
+            return;
         }
     }
 }
 
 void post_framebuffer_write(struct fb* fb, uint32_t address, uint32_t length)
 {
-    if (!fb->infos[0].addr) {
+    size_t i;
+    uint32_t j;
+    uint32_t last = address + length - 1;
+    uint32_t size;
+
+    rsp_thread_sync();
+
+    if (length == 0 || !any_fb_page(fb, address >> 12, last >> 12)) {
         return;
     }
 
-    size_t i, j;
-    unsigned char size;
+    /* FBWrite takes the access width, so report the write unit by unit */
     if (length % 4 == 0)
         size = 4;
     else if (length % 2 == 0)
@@ -78,25 +127,41 @@ void post_framebuffer_write(struct fb* fb, uint32_t address, uint32_t length)
     else
         size = 1;
 
-    for (i = 0; i < FB_INFOS_COUNT; ++i) {
+    for (i = 0; i < fb->ranges_count; ++i) {
 
-        /* skip empty fb info */
-        if (fb->infos[i].addr == 0) {
+        /* if address in within a fb notify GFX plugin */
+        if (address > fb->ranges[i].end || last < fb->ranges[i].begin) {
             continue;
         }
 
-        /* if address in within a fb notify GFX plugin */
-        uint32_t begin = fb->infos[i].addr;
-        uint32_t end   = fb->infos[i].addr + fb_buffer_size(&fb->infos[i]) - 1;
+        /* only walk the part of the write which lands in the fb */
+        j = (address >= fb->ranges[i].begin) ? 0 : ((fb->ranges[i].begin - address + size - 1) / size) * size;
 
-        for (j = 0; j < length; j += size) {
-            if ((address + j >= begin) && (address + j <= end)) {
-                gfx.fBWrite(address + j, size);
-            }
+        for (; j < length && address + j <= fb->ranges[i].end; j += size) {
+            gfx.fBWrite(address + j, size);
+            ++fb->write_callbacks;
         }
     }
 }
 
+void report_framebuffer_callbacks(const struct fb* fb, unsigned int frames)
+{
+    if (fb->read_callbacks == 0 && fb->write_callbacks == 0) {
+        return;
+    }
+
+    DebugMessage(M64MSG_INFO, "Framebuffer: %" PRIu64 " reads and %" PRIu64 " writes notified (%.1f per frame), %" PRIu64 " regions remapped",
+        fb->read_callbacks, fb->write_callbacks,
+        (frames != 0) ? (double)(fb->read_callbacks + fb->write_callbacks) / (double)frames : 0.0,
+        fb->remapped_regions);
+
+    if (g_benchmark.enabled) {
+        benchmark_set_counter("fb_read_callbacks", fb->read_callbacks);
+        benchmark_set_counter("fb_write_callbacks", fb->write_callbacks);
+        benchmark_set_counter("fb_remapped_regions", fb->remapped_regions);
+    }
+}
+
 
 void init_fb(struct fb* fb,
              struct memory* mem,
@@ -106,13 +171,28 @@ void init_fb(struct fb* fb,
     fb->mem = mem;
     fb->rdram = rdram;
     fb->r4300 = r4300;
+
+    /* memory handlers are being set up from scratch */
+    memset(fb->mapped_regions, 0, sizeof(fb->mapped_regions));
 }
 
+static void update_fb_mappings(struct fb* fb, const uint64_t* regions);
+
 void poweron_fb(struct fb* fb)
 {
-    memset(fb->dirty_page, 0, FB_DIRTY_PAGES_COUNT*sizeof(fb->dirty_page[0]));
+    static const uint64_t no_regions[FB_REGION_WORDS];
+
+    update_fb_mappings(fb, no_regions);
+
+    memset(fb->fb_pages, 0, sizeof(fb->fb_pages));
+    memset(fb->dirty_pages, 0, sizeof(fb->dirty_pages));
+    fb->ranges_count = 0;
     memset(fb->infos, 0, FB_INFOS_COUNT*sizeof(fb->infos[0]));
     fb->once = 1;
+
+    fb->read_callbacks = 0;
+    fb->write_callbacks = 0;
+    fb->remapped_regions = 0;
 }
 
 void read_rdram_fb(void* opaque, uint32_t address, uint32_t* value)
@@ -189,10 +269,62 @@ void write_rdram_fb(void* opaque, uint32_t address, uint32_t value, uint32_t mas
 #define W(x) write_ ## x
 #define RW(x) R(x), W(x)
 
-void protect_framebuffers(struct fb* fb)
+/* map the fb handlers on regions and restore the RAM handlers elsewhere,
+ * only touching regions whose state changed */
+static void update_fb_mappings(struct fb* fb, const uint64_t* regions)
 {
-    size_t i, j;
+    uint32_t w;
     struct mem_mapping fb_mapping = { 0, 0, M64P_MEM_RDRAM, { fb, RW(rdram_fb) } };
+    struct mem_mapping ram_mapping = { 0, 0, M64P_MEM_RDRAM, { fb->rdram, RW(rdram_dram) } };
+
+    for (w = 0; w < FB_REGION_WORDS; ++w) {
+        uint64_t changed = fb->mapped_regions[w] ^ regions[w];
+
+        while (changed != 0) {
+            uint32_t bit = 0;
+            while (!((changed >> bit) & 1)) {
+                ++bit;
+            }
+            changed &= ~(UINT64_C(1) << bit);
+
+            struct mem_mapping* mapping = ((regions[w] >> bit) & 1) ? &fb_mapping : &ram_mapping;
+            mapping->begin = (w * 64 + bit) << 16;
+            mapping->end   = mapping->begin + 0xffff;
+            apply_mem_mapping(fb->mem, mapping);
+            ++fb->remapped_regions;
+        }
+
+        fb->mapped_regions[w] = regions[w];
+    }
+}
+
+/* insert [begin, end] in the sorted ranges, merging overlapping or adjacent ones */
+static void add_fb_range(struct fb* fb, uint32_t begin, uint32_t end)
+{
+    size_t i, j;
+
+    for (i = 0; i < fb->ranges_count && fb->ranges[i].end + 1 < begin; ++i);
+
+    for (j = i; j < fb->ranges_count && fb->ranges[j].begin <= end + 1; ++j) {
+        if (fb->ranges[j].begin < begin) begin = fb->ranges[j].begin;
+        if (fb->ranges[j].end > end) end = fb->ranges[j].end;
+    }
+
+    /* ranges [i, j) are replaced by the merged one */
+    memmove(&fb->ranges[i + 1], &fb->ranges[j], (fb->ranges_count - j) * sizeof(fb->ranges[0]));
+    fb->ranges_count = fb->ranges_count + 1 - (j - i);
+    fb->ranges[i].begin = begin;
+    fb->ranges[i].end = end;
+}
+
+/* Refresh the framebuffer infos after the gfx plugin ran. Handlers stay
+ * mapped between tasks, only the regions of framebuffers which moved are
+ * remapped. */
+void protect_framebuffers(struct fb* fb)
+{
+    size_t i;
+    uint32_t j;
+    uint64_t regions[FB_REGION_WORDS];
 
     /* check API support */
     if (!(gfx.fBGetFrameBufferInfo && gfx.fBRead && gfx.fBWrite)
@@ -203,61 +335,49 @@ void protect_framebuffers(struct fb* fb)
     /* ask fb info to gfx plugin */
     gfx.fBGetFrameBufferInfo(fb->infos);
 
-    /* return early if not FB info is present */
-    if (fb->infos[0].addr == 0) {
-        return;
-    }
+    memset(fb->fb_pages, 0, sizeof(fb->fb_pages));
+    memset(regions, 0, sizeof(regions));
+    fb->ranges_count = 0;
 
-    for (i = 0; i < FB_INFOS_COUNT; ++i) {
+    /* no fb info is present if the first one is empty */
+    for (i = 0; i < FB_INFOS_COUNT && fb->infos[0].addr != 0; ++i) {
 
         /* skip empty fb info */
-        if (fb->infos[i].addr == 0) {
+        if (fb->infos[i].addr == 0 || fb_buffer_size(&fb->infos[i]) == 0
+         || (fb->infos[i].addr >> 12) >= FB_DIRTY_PAGES_COUNT) {
             continue;
         }
 
-        /* map fb rw handlers */
-        fb_mapping.begin = fb->infos[i].addr;
-        fb_mapping.end   = fb->infos[i].addr + fb_buffer_size(&fb->infos[i]) - 1;
-        apply_mem_mapping(fb->mem, &fb_mapping);
+        uint32_t begin = fb->infos[i].addr;
+        uint32_t end   = fb->infos[i].addr + fb_buffer_size(&fb->infos[i]) - 1;
 
-        /* mark all pages that are within a fb as dirty */
-        for (j = fb_mapping.begin >> 12; j <= (fb_mapping.end >> 12); ++j) {
-            fb->dirty_page[j] = 1;
+        if ((end >> 12) >= FB_DIRTY_PAGES_COUNT) {
+            end = FB_DIRTY_PAGES_COUNT * 0x1000 - 1;
         }
 
-        /* disable dynarec "fast memory" code generation to avoid direct memory accesses */
-        if (fb->once) {
-            fb->once = 0;
-#ifndef NEW_DYNAREC
-            fb->r4300->recomp.fast_memory = 0;
-#endif
+        add_fb_range(fb, begin, end);
 
-            /* also need to invalidate cached code to regen non fast memory code path */
-            invalidate_r4300_cached_code(fb->r4300, 0, 0);
+        /* mark all pages that are within a fb as dirty */
+        for (j = begin >> 12; j <= (end >> 12); ++j) {
+            set_bit(fb->fb_pages, j);
+            set_bit(fb->dirty_pages, j);
+        }
+        for (j = begin >> 16; j <= (end >> 16); ++j) {
+            set_bit(regions, j);
         }
-    }
-}
-
-void unprotect_framebuffers(struct fb* fb)
-{
-    size_t i;
-    struct mem_mapping ram_mapping = { 0, 0, M64P_MEM_RDRAM, { fb->rdram, RW(rdram_dram) } };
-
-    /* return early if FB info is not supported or empty */
-    if (!fb->infos[0].addr) {
-        return;
     }
 
-    for (i = 0; i < FB_INFOS_COUNT; ++i) {
+    update_fb_mappings(fb, regions);
 
-        /* skip empty fb info */
-        if (fb->infos[i].addr == 0) {
-            continue;
-        }
+    /* disable dynarec "fast memory" code generation to avoid direct memory accesses */
+    if (fb->ranges_count != 0 && fb->once) {
+        fb->once = 0;
+#ifndef NEW_DYNAREC
+        fb->r4300->recomp.fast_memory = 0;
+#endif
+        ++fb->r4300->cached_interp.hash_seed;
 
-        /* restore ram rw handlers */
-        ram_mapping.begin = fb->infos[i].addr;
-        ram_mapping.end   = fb->infos[i].addr + fb_buffer_size(&fb->infos[i]) - 1;
-        apply_mem_mapping(fb->mem, &ram_mapping);
+        /* also need to invalidate cached code to regen non fast memory code path */
+        invalidate_r4300_cached_code(fb->r4300, 0, 0);
     }
 }
@@ -22,6 +22,7 @@
 #ifndef M64P_DEVICE_RCP_RDP_FB_H
 #define M64P_DEVICE_RCP_RDP_FB_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "api/m64p_plugin.h"
@@ -31,7 +32,18 @@ struct rdram;
 struct r4300_core;
 
 enum { FB_INFOS_COUNT = 6 };
+/* 4KiB pages tracked, framebuffers beyond the first 8MiB are ignored */
 enum { FB_DIRTY_PAGES_COUNT = 0x800 };
+enum { FB_PAGE_WORDS = FB_DIRTY_PAGES_COUNT / 64 };
+/* 64KiB memory regions served by the fb handlers */
+enum { FB_REGION_WORDS = FB_DIRTY_PAGES_COUNT / 16 / 64 };
+
+/* inclusive address range covered by one or more framebuffers */
+struct fb_range
+{
+    uint32_t begin;
+    uint32_t end;
+};
 
 struct fb
 {
@@ -39,9 +51,22 @@ struct fb
     struct rdram* rdram;
     struct r4300_core* r4300;
 
-    unsigned char dirty_page[FB_DIRTY_PAGES_COUNT];
+    /* bitmaps indexed by page, dirty pages have not been read back yet */
+    uint64_t fb_pages[FB_PAGE_WORDS];
+    uint64_t dirty_pages[FB_PAGE_WORDS];
+    uint64_t mapped_regions[FB_REGION_WORDS];
+
+    /* merged framebuffer ranges sorted by address */
+    struct fb_range ranges[FB_INFOS_COUNT];
+    size_t ranges_count;
+
     FrameBufferInfo infos[FB_INFOS_COUNT];
     unsigned int once;
+
+    /* statistics */
+    uint64_t read_callbacks;
+    uint64_t write_callbacks;
+    uint64_t remapped_regions;
 };
 
 void init_fb(struct fb* fb,
@@ -55,9 +80,10 @@ void read_rdram_fb(void* opaque, uint32_t address, uint32_t* value);
 void write_rdram_fb(void* opaque, uint32_t address, uint32_t value, uint32_t mask);
 
 void protect_framebuffers(struct fb* fb);
-void unprotect_framebuffers(struct fb* fb);
 
 void pre_framebuffer_read(struct fb* fb, uint32_t address);
 void post_framebuffer_write(struct fb* fb, uint32_t address, uint32_t length);
 
+void report_framebuffer_callbacks(const struct fb* fb, unsigned int frames);
+
 #endif
@@ -26,6 +26,9 @@
 #include "device/memory/memory.h"
 #include "device/rcp/mi/mi_controller.h"
 #include "device/rcp/rsp/rsp_core.h"
+#include "main/benchmark.h"
+#include "main/main.h"
+#include "main/rsp_thread.h"
 #include "plugin/plugin.h"
 
 static void update_dpc_status(struct rdp_core* dp, uint32_t w)
@@ -41,8 +44,12 @@ static void update_dpc_status(struct rdp_core* dp, uint32_t w)
 
         if (dp->do_on_unfreeze & DELAY_DP_INT)
             signal_rcp_interrupt(dp->mi, MI_INTR_DP);
-        if (dp->do_on_unfreeze & DELAY_UPDATESCREEN)
+        if ((dp->do_on_unfreeze & DELAY_UPDATESCREEN) && !main_skip_render())
+        {
+            benchmark_section_start(BENCHMARK_SECTION_GFX);
             gfx.updateScreen();
+            benchmark_section_end(BENCHMARK_SECTION_GFX);
+        }
         dp->do_on_unfreeze = 0;
     }
     if (w & DPC_SET_FREEZE) dp->dpc_regs[DPC_STATUS_REG] |= DPC_STATUS_FREEZE;
@@ -86,6 +93,8 @@ void read_dpc_regs(void* opaque, uint32_t address, uint32_t* value)
     struct rdp_core* dp = (struct rdp_core*)opaque;
     uint32_t reg = dpc_reg(address);
 
+    rsp_thread_sync();
+
     *value = dp->dpc_regs[reg];
 }
 
@@ -94,6 +103,8 @@ void write_dpc_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mas
     struct rdp_core* dp = (struct rdp_core*)opaque;
     uint32_t reg = dpc_reg(address);
 
+    rsp_thread_sync();
+
     switch(reg)
     {
     case DPC_STATUS_REG:
@@ -114,7 +125,6 @@ void write_dpc_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mas
         dp->dpc_regs[DPC_CURRENT_REG] = dp->dpc_regs[DPC_START_REG];
         break;
     case DPC_END_REG:
-        unprotect_framebuffers(&dp->fb);
         gfx.processRDPList();
         protect_framebuffers(&dp->fb);
         signal_rcp_interrupt(dp->mi, MI_INTR_DP);
@@ -128,6 +138,8 @@ void read_dps_regs(void* opaque, uint32_t address, uint32_t* value)
     struct rdp_core* dp = (struct rdp_core*)opaque;
     uint32_t reg = dps_reg(address);
 
+    rsp_thread_sync();
+
     *value = dp->dps_regs[reg];
 }
 
@@ -136,6 +148,8 @@ void write_dps_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mas
     struct rdp_core* dp = (struct rdp_core*)opaque;
     uint32_t reg = dps_reg(address);
 
+    rsp_thread_sync();
+
     masked_write(&dp->dps_regs[reg], value, mask);
 }
 
@@ -143,6 +157,8 @@ void rdp_interrupt_event(void* opaque)
 {
     struct rdp_core* dp = (struct rdp_core*)opaque;
 
+    rsp_thread_sync();
+
     raise_rcp_interrupt(dp->mi, MI_INTR_DP);
 }
 
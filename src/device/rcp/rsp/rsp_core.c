@@ -23,13 +23,16 @@
 
 #include <string.h>
 
+#include "device/memory/dma_copy.h"
 #include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
 #include "device/rcp/mi/mi_controller.h"
 #include "device/rcp/rdp/rdp_core.h"
 #include "device/rcp/ri/ri_controller.h"
 #include "device/rdram/rdram.h"
+#include "main/benchmark.h"
 #include "main/main.h"
+#include "main/rsp_thread.h"
 #if defined(PROFILE)
 #include "main/profile.h"
 #endif
@@ -38,7 +41,7 @@
 
 static void do_sp_dma(struct rsp_core* sp, const struct sp_dma* dma)
 {
-    unsigned int i,j;
+    unsigned int j;
 
     unsigned int l = dma->length;
 
@@ -55,14 +58,10 @@ static void do_sp_dma(struct rsp_core* sp, const struct sp_dma* dma)
     if (dma->dir == SP_DMA_READ)
     {
         for(j=0; j<count; j++) {
-            for(i=0; i<length; i++) {
-                dram[dramaddr^S8] = spmem[memaddr^S8];
-                memaddr++;
-                dramaddr++;
-            }
-
-            post_framebuffer_write(&sp->dp->fb, dramaddr - length, length);
-            dramaddr+=skip;
+            dma_copy(dram, dramaddr, spmem, memaddr, length);
+            post_framebuffer_write(&sp->dp->fb, dramaddr, length);
+            memaddr += length;
+            dramaddr += length + skip;
         }
     }
     else
@@ -70,12 +69,9 @@ static void do_sp_dma(struct rsp_core* sp, const struct sp_dma* dma)
         for(j=0; j<count; j++) {
             pre_framebuffer_read(&sp->dp->fb, dramaddr);
 
-            for(i=0; i<length; i++) {
-                spmem[memaddr^S8] = dram[dramaddr^S8];
-                memaddr++;
-                dramaddr++;
-            }
-            dramaddr+=skip;
+            dma_copy(spmem, memaddr, dram, dramaddr, length);
+            memaddr += length;
+            dramaddr += length + skip;
         }
     }
 
@@ -222,6 +218,7 @@ void poweron_rsp(struct rsp_core* sp)
     memset(sp->fifo, 0, SP_DMA_FIFO_SIZE*sizeof(struct sp_dma));
 
     sp->rsp_task_locked = 0;
+    sp->sp_int_suppressed = 0;
     sp->mi->r4300->cp0.interrupt_unsafe_state &= ~INTR_UNSAFE_RSP;
     sp->regs[SP_STATUS_REG] = 1;
 }
@@ -232,6 +229,8 @@ void read_rsp_mem(void* opaque, uint32_t address, uint32_t* value)
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t addr = rsp_mem_address(address);
 
+    rsp_thread_sync();
+
     *value = sp->mem[addr];
 }
 
@@ -240,6 +239,8 @@ void write_rsp_mem(void* opaque, uint32_t address, uint32_t value, uint32_t mask
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t addr = rsp_mem_address(address);
 
+    rsp_thread_sync();
+
     masked_write(&sp->mem[addr], value, mask);
 }
 
@@ -249,6 +250,8 @@ void read_rsp_regs(void* opaque, uint32_t address, uint32_t* value)
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t reg = rsp_reg(address);
 
+    rsp_thread_sync();
+
     *value = sp->regs[reg];
 
     if (reg == SP_SEMAPHORE_REG)
@@ -262,6 +265,8 @@ void write_rsp_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mas
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t reg = rsp_reg(address);
 
+    rsp_thread_sync();
+
     switch(reg)
     {
     case SP_STATUS_REG:
@@ -293,6 +298,8 @@ void read_rsp_regs2(void* opaque, uint32_t address, uint32_t* value)
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t reg = rsp_reg2(address);
 
+    rsp_thread_sync();
+
     *value = sp->regs2[reg];
 }
 
@@ -301,44 +308,126 @@ void write_rsp_regs2(void* opaque, uint32_t address, uint32_t value, uint32_t ma
     struct rsp_core* sp = (struct rsp_core*)opaque;
     uint32_t reg = rsp_reg2(address);
 
+    rsp_thread_sync();
+
     masked_write(&sp->regs2[reg], value, mask);
 }
 
+static void schedule_sp_int(struct rsp_core* sp, unsigned int delay)
+{
+    /* drop the deadline left by a threaded task which did not signal SP */
+    if (sp->sp_int_suppressed)
+    {
+        remove_event(&sp->mi->r4300->cp0.q, SP_INT);
+        sp->sp_int_suppressed = 0;
+    }
+
+    cp0_update_count(sp->mi->r4300);
+    add_interrupt_event(&sp->mi->r4300->cp0, SP_INT, delay);
+}
+
+static void end_gfx_task(struct rsp_core* sp, uint32_t save_pc)
+{
+    sp->regs2[SP_PC_REG] |= save_pc;
+    new_frame();
+
+    if (sp->mi->regs[MI_INTR_REG] & MI_INTR_DP)
+    {
+        sp->mi->regs[MI_INTR_REG] &= ~MI_INTR_DP;
+        if (sp->dp->dpc_regs[DPC_STATUS_REG] & DPC_STATUS_FREEZE) {
+            sp->dp->do_on_unfreeze |= DELAY_DP_INT;
+        } else {
+            cp0_update_count(sp->mi->r4300);
+            add_interrupt_event(&sp->mi->r4300->cp0, DP_INT, 4000);
+        }
+    }
+
+    protect_framebuffers(&sp->dp->fb);
+}
+
+/* sp_int_scheduled is set when SP_INT was queued before the task ran */
+static void end_sp_task(struct rsp_core* sp, uint32_t sp_delay_time, int sp_int_scheduled)
+{
+    sp->rsp_task_locked = 0;
+    sp->mi->r4300->cp0.interrupt_unsafe_state &= ~INTR_UNSAFE_RSP;
+    if ((sp->regs[SP_STATUS_REG] & (SP_STATUS_HALT | SP_STATUS_BROKE)) == 0)
+    {
+        sp->rsp_task_locked = 1;
+        sp->mi->r4300->cp0.interrupt_unsafe_state |= INTR_UNSAFE_RSP;
+        sp->mi->regs[MI_INTR_REG] |= MI_INTR_SP;
+    }
+    if (sp->mi->regs[MI_INTR_REG] & MI_INTR_SP)
+    {
+        if (!sp_int_scheduled) {
+            schedule_sp_int(sp, sp_delay_time);
+        }
+        sp->mi->regs[MI_INTR_REG] &= ~MI_INTR_SP;
+    }
+    else if (sp_int_scheduled)
+    {
+        sp->sp_int_suppressed = 1;
+    }
+
+    sp->regs[SP_STATUS_REG] &=
+        ~(SP_STATUS_TASKDONE | SP_STATUS_BROKE | SP_STATUS_HALT);
+}
+
+static void run_gfx_task(void* opaque)
+{
+    (void)opaque;
+    rsp.doRspCycles(0xffffffff);
+}
+
+static void finish_gfx_task(void* opaque)
+{
+    struct rsp_core* sp = (struct rsp_core*)opaque;
+
+    end_gfx_task(sp, sp->async_save_pc);
+    end_sp_task(sp, 0, 1);
+}
+
+/* Run the display list on the RSP thread. SP_INT is queued at the deadline
+ * right away, and the CPU only waits for the task at the first access to
+ * state it may use, at the latest when SP_INT is due. Framebuffers stay
+ * protected, so CPU accesses to them also wait for the task. */
+static void start_gfx_task(struct rsp_core* sp, uint32_t save_pc)
+{
+    sp->async_save_pc = save_pc;
+    sp->regs2[SP_PC_REG] &= 0xfff;
+
+    sp->mi->r4300->cp0.interrupt_unsafe_state |= INTR_UNSAFE_RSP;
+    schedule_sp_int(sp, sp->async_gfx_delay);
+
+    rsp_thread_run(run_gfx_task, finish_gfx_task, sp);
+}
+
 void do_SP_Task(struct rsp_core* sp)
 {
     uint32_t save_pc = sp->regs2[SP_PC_REG] & ~0xfff;
 
     uint32_t sp_delay_time;
 
-    if (sp->mem[0xfc0/4] == 1)
+    if (sp->mem[0xfc0/4] == 1 && sp->async_gfx_delay != 0)
     {
-        unprotect_framebuffers(&sp->dp->fb);
+        start_gfx_task(sp, save_pc);
+        return;
+    }
 
+    if (sp->mem[0xfc0/4] == 1)
+    {
         //gfx.processDList();
         sp->regs2[SP_PC_REG] &= 0xfff;
 #if defined(PROFILE)
         timed_section_start(TIMED_SECTION_GFX);
 #endif
+        benchmark_section_start(BENCHMARK_SECTION_RSP);
         rsp.doRspCycles(0xffffffff);
+        benchmark_section_end(BENCHMARK_SECTION_RSP);
 #if defined(PROFILE)
         timed_section_end(TIMED_SECTION_GFX);
 #endif
-        sp->regs2[SP_PC_REG] |= save_pc;
-        new_frame();
-
-        if (sp->mi->regs[MI_INTR_REG] & MI_INTR_DP)
-        {
-            sp->mi->regs[MI_INTR_REG] &= ~MI_INTR_DP;
-            if (sp->dp->dpc_regs[DPC_STATUS_REG] & DPC_STATUS_FREEZE) {
-                sp->dp->do_on_unfreeze |= DELAY_DP_INT;
-            } else {
-                cp0_update_count(sp->mi->r4300);
-                add_interrupt_event(&sp->mi->r4300->cp0, DP_INT, 4000);
-            }
-        }
+        end_gfx_task(sp, save_pc);
         sp_delay_time = 1000;
-
-        protect_framebuffers(&sp->dp->fb);
     }
     else if (sp->mem[0xfc0/4] == 2)
     {
@@ -347,7 +436,9 @@ void do_SP_Task(struct rsp_core* sp)
 #if defined(PROFILE)
         timed_section_start(TIMED_SECTION_AUDIO);
 #endif
+        benchmark_section_start(BENCHMARK_SECTION_RSP);
         rsp.doRspCycles(0xffffffff);
+        benchmark_section_end(BENCHMARK_SECTION_RSP);
 #if defined(PROFILE)
         timed_section_end(TIMED_SECTION_AUDIO);
 #endif
@@ -358,35 +449,29 @@ void do_SP_Task(struct rsp_core* sp)
     else
     {
         sp->regs2[SP_PC_REG] &= 0xfff;
+        benchmark_section_start(BENCHMARK_SECTION_RSP);
         rsp.doRspCycles(0xffffffff);
+        benchmark_section_end(BENCHMARK_SECTION_RSP);
         sp->regs2[SP_PC_REG] |= save_pc;
 
         sp_delay_time = 0;
     }
 
-    sp->rsp_task_locked = 0;
-    sp->mi->r4300->cp0.interrupt_unsafe_state &= ~INTR_UNSAFE_RSP;
-    if ((sp->regs[SP_STATUS_REG] & (SP_STATUS_HALT | SP_STATUS_BROKE)) == 0)
-    {
-        sp->rsp_task_locked = 1;
-        sp->mi->r4300->cp0.interrupt_unsafe_state |= INTR_UNSAFE_RSP;
-        sp->mi->regs[MI_INTR_REG] |= MI_INTR_SP;
-    }
-    if (sp->mi->regs[MI_INTR_REG] & MI_INTR_SP)
-    {
-        cp0_update_count(sp->mi->r4300);
-        add_interrupt_event(&sp->mi->r4300->cp0, SP_INT, sp_delay_time);
-        sp->mi->regs[MI_INTR_REG] &= ~MI_INTR_SP;
-    }
-
-    sp->regs[SP_STATUS_REG] &=
-        ~(SP_STATUS_TASKDONE | SP_STATUS_BROKE | SP_STATUS_HALT);
+    end_sp_task(sp, sp_delay_time, 0);
 }
 
 void rsp_interrupt_event(void* opaque)
 {
     struct rsp_core* sp = (struct rsp_core*)opaque;
 
+    rsp_thread_sync();
+
+    if (sp->sp_int_suppressed)
+    {
+        sp->sp_int_suppressed = 0;
+        return;
+    }
+
     if (!sp->rsp_task_locked)
     {
         sp->regs[SP_STATUS_REG] |=
@@ -402,5 +487,7 @@ void rsp_interrupt_event(void* opaque)
 void rsp_end_of_dma_event(void* opaque)
 {
     struct rsp_core* sp = (struct rsp_core*)opaque;
+
+    rsp_thread_sync();
     fifo_pop(sp);
 }
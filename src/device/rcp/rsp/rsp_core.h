@@ -98,6 +98,12 @@ struct rsp_core
     uint32_t regs2[SP_REGS2_COUNT];
     uint32_t rsp_task_locked;
 
+    /* SP_INT delay of graphics tasks run on the RSP thread, 0 to run them inline */
+    uint32_t async_gfx_delay;
+    uint32_t async_save_pc;
+    /* set when a threaded task ended without signaling SP */
+    uint32_t sp_int_suppressed;
+
     struct mi_controller* mi;
     struct rdp_core* dp;
     struct ri_controller* ri;
@@ -27,7 +27,9 @@
 #include "device/memory/memory.h"
 #include "device/r4300/r4300_core.h"
 #include "device/rcp/mi/mi_controller.h"
+#include "main/benchmark.h"
 #include "main/main.h"
+#include "main/rsp_thread.h"
 #include "plugin/plugin.h"
 
 unsigned int vi_clock_from_tv_standard(m64p_system_type tv_standard)
@@ -113,6 +115,8 @@ void write_vi_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
     struct vi_controller* vi = (struct vi_controller*)opaque;
     uint32_t reg = vi_reg(address);
 
+    rsp_thread_sync();
+
     switch(reg)
     {
     case VI_STATUS_REG:
@@ -157,10 +161,17 @@ void write_vi_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
 void vi_vertical_interrupt_event(void* opaque)
 {
     struct vi_controller* vi = (struct vi_controller*)opaque;
+
+    rsp_thread_sync();
+
     if (vi->dp->do_on_unfreeze & DELAY_DP_INT)
         vi->dp->do_on_unfreeze |= DELAY_UPDATESCREEN;
-    else
+    else if (!main_skip_render())
+    {
+        benchmark_section_start(BENCHMARK_SECTION_GFX);
         gfx.updateScreen();
+        benchmark_section_end(BENCHMARK_SECTION_GFX);
+    }
 
     /* allow main module to do things on VI event */
     new_vi();
@@ -118,6 +118,7 @@ static void map_corrupt_rdram(struct rdram* rdram, int corrupt)
     apply_mem_mapping(rdram->r4300->mem, &mapping);
 #ifndef NEW_DYNAREC
     rdram->r4300->recomp.fast_memory = (corrupt) ? 0 : 1;
+    ++rdram->r4300->cached_interp.hash_seed;
     invalidate_r4300_cached_code(rdram->r4300, 0, 0);
 #endif
 }
@@ -0,0 +1,276 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - benchmark.c                                             *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "benchmark.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+
+struct benchmark g_benchmark;
+
+static const char* const l_section_names[BENCHMARK_SECTIONS_COUNT] =
+{
+    "r4300",
+    "compiler",
+    "interrupt",
+    "rsp",
+    "gfx",
+    "audio"
+};
+
+#if defined(WIN32) && !defined(__MINGW32__)
+  #include <windows.h>
+
+  static long long int get_time(void)
+  {
+      LARGE_INTEGER counter;
+      QueryPerformanceCounter(&counter);
+      return counter.QuadPart;
+  }
+  static long long int time_to_nsec(long long int time)
+  {
+      static LARGE_INTEGER freq = { 0 };
+      if (freq.QuadPart == 0)
+          QueryPerformanceFrequency(&freq);
+      return (long long int)((double)time * 1000000000.0 / (double)freq.QuadPart);
+  }
+
+#else  /* Not WIN32 */
+  #include <time.h>
+
+  static long long int get_time(void)
+  {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (long long int)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+  static long long int time_to_nsec(long long int time)
+  {
+      return time;
+  }
+#endif
+
+/* charge elapsed time to the section currently on top of the stack */
+static void charge_current_section(long long int now)
+{
+    enum benchmark_section current = (g_benchmark.depth == 0)
+        ? BENCHMARK_SECTION_R4300
+        : g_benchmark.stack[g_benchmark.depth - 1];
+
+    g_benchmark.time_in_section[current] += now - g_benchmark.last_switch;
+    g_benchmark.last_switch = now;
+}
+
+void benchmark_section_enter(enum benchmark_section section)
+{
+    charge_current_section(get_time());
+
+    ++g_benchmark.calls_in_section[section];
+
+    /* on overflow keep charging the deepest tracked section */
+    if (g_benchmark.depth < BENCHMARK_SECTION_STACK_SIZE) {
+        g_benchmark.stack[g_benchmark.depth] = section;
+    }
+    ++g_benchmark.depth;
+}
+
+void benchmark_section_leave(void)
+{
+    if (g_benchmark.depth == 0) {
+        return;
+    }
+
+    charge_current_section(get_time());
+    --g_benchmark.depth;
+}
+
+void benchmark_set_counter(const char* name, uint64_t value)
+{
+    size_t i;
+
+    for (i = 0; i < g_benchmark.counters_count; ++i) {
+        if (strcmp(g_benchmark.counters[i].name, name) == 0) {
+            break;
+        }
+    }
+
+    if (i == BENCHMARK_COUNTERS_MAX) {
+        return;
+    }
+
+    if (i == g_benchmark.counters_count) {
+        snprintf(g_benchmark.counters[i].name, sizeof(g_benchmark.counters[i].name), "%s", name);
+        ++g_benchmark.counters_count;
+    }
+
+    g_benchmark.counters[i].value = value;
+}
+
+long long int benchmark_clock_ns(void)
+{
+    return time_to_nsec(get_time());
+}
+
+void benchmark_start(uint64_t vi_limit, uint64_t cycle_limit, int render, uint32_t count)
+{
+    memset(&g_benchmark, 0, sizeof(g_benchmark));
+
+    g_benchmark.vi_limit = vi_limit;
+    g_benchmark.cycle_limit = cycle_limit;
+    g_benchmark.render = render;
+    g_benchmark.last_count = count;
+
+    g_benchmark.start_time = get_time();
+    g_benchmark.last_switch = g_benchmark.start_time;
+    g_benchmark.enabled = 1;
+
+    if (vi_limit != 0) {
+        DebugMessage(M64MSG_INFO, "Benchmark: running for %" PRIu64 " VIs", vi_limit);
+    }
+    if (cycle_limit != 0) {
+        DebugMessage(M64MSG_INFO, "Benchmark: running for %" PRIu64 " count cycles", cycle_limit);
+    }
+}
+
+/* Returns 1 once the configured VI or cycle budget is exhausted.
+ * Cycles are accumulated at VI granularity using CP0 Count deltas. */
+int benchmark_new_vi(uint32_t count)
+{
+    if (!g_benchmark.enabled) {
+        return 0;
+    }
+
+    ++g_benchmark.vis;
+    g_benchmark.cycles += (uint32_t)(count - g_benchmark.last_count);
+    g_benchmark.last_count = count;
+
+    return (g_benchmark.vi_limit != 0 && g_benchmark.vis >= g_benchmark.vi_limit)
+        || (g_benchmark.cycle_limit != 0 && g_benchmark.cycles >= g_benchmark.cycle_limit);
+}
+
+void benchmark_stop(void)
+{
+    if (!g_benchmark.enabled) {
+        return;
+    }
+
+    g_benchmark.end_time = get_time();
+    charge_current_section(g_benchmark.end_time);
+    g_benchmark.enabled = 0;
+}
+
+static void write_json_string(FILE* f, const char* s)
+{
+    fputc('"', f);
+    for (; s != NULL && *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', f);
+            fputc(*s, f);
+        }
+        else if ((unsigned char)*s < 0x20) {
+            fprintf(f, "\\u%04x", (unsigned char)*s);
+        }
+        else {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void write_report(FILE* f, const char* rom_name, const char* rom_md5, unsigned int emumode)
+{
+    size_t i;
+    long long int wall_ns = time_to_nsec(g_benchmark.end_time - g_benchmark.start_time);
+    double vis_per_sec = (wall_ns > 0)
+        ? (double)g_benchmark.vis * 1000000000.0 / (double)wall_ns
+        : 0.0;
+
+    fprintf(f, "{\"rom\": ");
+    write_json_string(f, rom_name);
+    fprintf(f, ", \"md5\": ");
+    write_json_string(f, rom_md5);
+    fprintf(f, ", \"emumode\": %u", emumode);
+    fprintf(f, ", \"vis\": %" PRIu64, g_benchmark.vis);
+    fprintf(f, ", \"cycles\": %" PRIu64, g_benchmark.cycles);
+    fprintf(f, ", \"wall_ns\": %lld", wall_ns);
+    fprintf(f, ", \"vis_per_sec\": %.3f", vis_per_sec);
+
+    fprintf(f, ", \"sections_ns\": {");
+    for (i = 0; i < BENCHMARK_SECTIONS_COUNT; ++i) {
+        fprintf(f, "%s\"%s\": %lld", (i == 0) ? "" : ", ",
+            l_section_names[i], time_to_nsec(g_benchmark.time_in_section[i]));
+    }
+    fprintf(f, "}, \"sections_calls\": {");
+    for (i = 0; i < BENCHMARK_SECTIONS_COUNT; ++i) {
+        fprintf(f, "%s\"%s\": %" PRIu64, (i == 0) ? "" : ", ",
+            l_section_names[i], g_benchmark.calls_in_section[i]);
+    }
+    fprintf(f, "}, \"counters\": {");
+    for (i = 0; i < g_benchmark.counters_count; ++i) {
+        fprintf(f, "%s", (i == 0) ? "" : ", ");
+        write_json_string(f, g_benchmark.counters[i].name);
+        fprintf(f, ": %" PRIu64, g_benchmark.counters[i].value);
+    }
+    fprintf(f, "}}\n");
+}
+
+int benchmark_write_report(const char* path, const char* rom_name, const char* rom_md5, unsigned int emumode)
+{
+    size_t i;
+    long long int wall_ns = time_to_nsec(g_benchmark.end_time - g_benchmark.start_time);
+
+    DebugMessage(M64MSG_INFO, "Benchmark: %" PRIu64 " VIs, %" PRIu64 " cycles in %.3f s (%.2f VI/s)",
+        g_benchmark.vis, g_benchmark.cycles, (double)wall_ns / 1000000000.0,
+        (wall_ns > 0) ? (double)g_benchmark.vis * 1000000000.0 / (double)wall_ns : 0.0);
+
+    for (i = 0; i < BENCHMARK_SECTIONS_COUNT; ++i) {
+        long long int ns = time_to_nsec(g_benchmark.time_in_section[i]);
+        DebugMessage(M64MSG_INFO, "Benchmark: %-10s %12lld ns (%5.1f%%) %10" PRIu64 " calls",
+            l_section_names[i], ns,
+            (wall_ns > 0) ? 100.0 * (double)ns / (double)wall_ns : 0.0,
+            g_benchmark.calls_in_section[i]);
+    }
+
+    for (i = 0; i < g_benchmark.counters_count; ++i) {
+        DebugMessage(M64MSG_INFO, "Benchmark: %-32s %" PRIu64,
+            g_benchmark.counters[i].name, g_benchmark.counters[i].value);
+    }
+
+    if (path == NULL || strlen(path) == 0) {
+        return 0;
+    }
+
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        DebugMessage(M64MSG_ERROR, "Couldn't open benchmark report file: %s", path);
+        return -1;
+    }
+
+    write_report(f, rom_name, rom_md5, emumode);
+    fclose(f);
+
+    DebugMessage(M64MSG_INFO, "Benchmark report written to %s", path);
+    return 0;
+}
@@ -0,0 +1,116 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - benchmark.h                                             *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_BENCHMARK_H
+#define M64P_MAIN_BENCHMARK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "osal/preproc.h"
+
+/* Sections are accounted exclusively: entering a nested section pauses
+ * the enclosing one, so that the sum of all sections equals wall time.
+ * Time spent outside of any other section is charged to R4300. */
+enum benchmark_section
+{
+    BENCHMARK_SECTION_R4300,
+    BENCHMARK_SECTION_COMPILER,
+    BENCHMARK_SECTION_INTERRUPT,
+    BENCHMARK_SECTION_RSP,
+    BENCHMARK_SECTION_GFX,
+    BENCHMARK_SECTION_AUDIO,
+    BENCHMARK_SECTIONS_COUNT
+};
+
+enum { BENCHMARK_SECTION_STACK_SIZE = 16 };
+enum { BENCHMARK_COUNTERS_MAX = 16 };
+
+/* named values reported by subsystems, such as allocator statistics */
+struct benchmark_counter
+{
+    char name[48];
+    uint64_t value;
+};
+
+struct benchmark
+{
+    int enabled;
+    int render;
+
+    uint64_t vi_limit;
+    uint64_t cycle_limit;
+
+    uint64_t vis;
+    uint64_t cycles;
+    uint32_t last_count;
+
+    long long int start_time;
+    long long int end_time;
+    long long int last_switch;
+
+    long long int time_in_section[BENCHMARK_SECTIONS_COUNT];
+    uint64_t calls_in_section[BENCHMARK_SECTIONS_COUNT];
+
+    enum benchmark_section stack[BENCHMARK_SECTION_STACK_SIZE];
+    size_t depth;
+
+    struct benchmark_counter counters[BENCHMARK_COUNTERS_MAX];
+    size_t counters_count;
+};
+
+extern struct benchmark g_benchmark;
+
+void benchmark_start(uint64_t vi_limit, uint64_t cycle_limit, int render, uint32_t count);
+int benchmark_new_vi(uint32_t count);
+void benchmark_stop(void);
+int benchmark_write_report(const char* path, const char* rom_name, const char* rom_md5, unsigned int emumode);
+
+void benchmark_set_counter(const char* name, uint64_t value);
+
+/* monotonic clock used for section timings, also usable when benchmarks are off */
+long long int benchmark_clock_ns(void);
+
+void benchmark_section_enter(enum benchmark_section section);
+void benchmark_section_leave(void);
+
+static osal_inline void benchmark_section_start(enum benchmark_section section)
+{
+    if (g_benchmark.enabled) {
+        benchmark_section_enter(section);
+    }
+}
+
+static osal_inline void benchmark_section_end(enum benchmark_section section)
+{
+    (void)section;
+    if (g_benchmark.enabled) {
+        benchmark_section_leave();
+    }
+}
+
+/* Headless benchmark runs skip video plugin presentation */
+static osal_inline int benchmark_skip_render(void)
+{
+    return g_benchmark.enabled && !g_benchmark.render;
+}
+
+#endif
@@ -44,110 +44,505 @@
 #include "osal/preproc.h"
 
 /* local definitions */
-#define CHEAT_CODE_MAGIC_VALUE UINT32_C(0xDEAD0000)
+
+/* longest run of contiguous writes merged into a single op */
+#define CHEAT_MAX_RUN 64
 
 typedef struct cheat_code {
     uint32_t address;
     uint32_t value;
-    uint32_t old_value;
     struct list_head list;
 } cheat_code_t;
 
 typedef struct cheat {
     char *name;
+    unsigned int id;
     int enabled;
-    int was_enabled;
     struct list_head cheat_codes;
     struct list_head list;
 } cheat_t;
 
+/* Compiled cheats
+ *
+ * Whenever the cheat list changes, it is compiled (on the emulation thread)
+ * into a flat array of ops on RDRAM byte offsets:
+ * - conditional codes become tests holding the index of the op to continue
+ *   at when they fail, i.e. past the next non-conditional code;
+ * - writes to contiguous addresses are merged;
+ * - codes which do nothing are dropped.
+ *
+ * Runtime state (saved original values, was_enabled) lives in the program
+ * and is carried over to the next program for cheats that did not change,
+ * which are identified by their id. A cheat gets a new id whenever its
+ * codes are replaced. */
+enum cheat_op_type
+{
+    CHEAT_OP_WRITE,
+    CHEAT_OP_TEST_EQ,
+    CHEAT_OP_TEST_NE
+};
+
+enum cheat_op_flags
+{
+    CHEAT_OP_BOOT = 0x01,       /* only written at boot */
+    CHEAT_OP_GS_BUTTON = 0x02,  /* only when the GameShark button is pressed */
+    CHEAT_OP_SAVE_OLD = 0x04,   /* save original value for restoring */
+    CHEAT_OP_OLD_SAVED = 0x08
+};
+
+struct cheat_op
+{
+    uint8_t type;
+    uint8_t flags;
+    uint16_t len;
+    uint32_t offset;    /* RDRAM byte offset */
+    uint32_t data;      /* pool index: len value bytes then len saved bytes */
+    uint32_t skip;      /* tests: op index to continue at on failure */
+};
+
+struct cheat_record
+{
+    unsigned int id;
+    int enabled;
+    int was_enabled;
+    uint32_t first_op;
+    uint32_t op_count;
+    uint32_t first_data;
+    uint32_t data_size;
+};
+
+struct cheat_program
+{
+    struct cheat_record* records;
+    size_t record_count;
+    struct cheat_op* ops;
+    size_t op_count;
+    uint8_t* pool;
+    size_t pool_size;
+};
+
+struct cheat_dirty_range
+{
+    uint32_t begin;
+    uint32_t end;
+};
+
 /* private functions */
-static uint16_t read_address_16bit(struct r4300_core* r4300, uint32_t address)
+static void free_program(struct cheat_program* prog)
+{
+    if (prog == NULL)
+        return;
+
+    free(prog->records);
+    free(prog->ops);
+    free(prog->pool);
+    free(prog);
+}
+
+static void* grow_array(void* array, size_t count, size_t* capacity, size_t elem_size)
+{
+    if (count < *capacity)
+        return array;
+
+    *capacity = (*capacity == 0) ? 64 : *capacity * 2;
+    return realloc(array, *capacity * elem_size);
+}
+
+struct program_builder
+{
+    struct cheat_program* prog;
+    size_t record_capacity;
+    size_t op_capacity;
+    size_t pool_capacity;
+    size_t dram_size;
+};
+
+static struct cheat_op* new_op(struct program_builder* b, uint8_t type, uint8_t flags, uint32_t offset, uint16_t len)
+{
+    struct cheat_program* prog = b->prog;
+    struct cheat_op* op;
+
+    prog->ops = grow_array(prog->ops, prog->op_count, &b->op_capacity, sizeof(*prog->ops));
+    while (prog->pool_size + 2 * CHEAT_MAX_RUN > b->pool_capacity)
+        prog->pool = grow_array(prog->pool, b->pool_capacity, &b->pool_capacity, 1);
+
+    op = &prog->ops[prog->op_count++];
+    op->type = type;
+    op->flags = flags;
+    op->len = len;
+    op->offset = offset;
+    op->data = (uint32_t)prog->pool_size;
+    op->skip = 0;
+
+    memset(prog->pool + op->data, 0, 2 * len);
+    prog->pool_size += 2 * len;
+
+    return op;
+}
+
+static void store_be(uint8_t* dst, uint32_t value, uint16_t len)
+{
+    if (len == 2) {
+        dst[0] = (uint8_t)(value >> 8);
+        dst[1] = (uint8_t)value;
+    }
+    else {
+        dst[0] = (uint8_t)value;
+    }
+}
+
+/* Appends a write, merging it with the previous op when possible */
+static void compile_write(struct program_builder* b, uint32_t address, uint32_t value, uint16_t len, uint8_t flags, int* mergeable)
+{
+    struct cheat_program* prog = b->prog;
+    struct cheat_op* op;
+    uint32_t offset = address & 0xFFFFFF;
+
+    if (offset + len > b->dram_size) {
+        DebugMessage(M64MSG_WARNING, "Ignoring cheat code write outside of RDRAM: %08" PRIX32, address);
+        *mergeable = 0;
+        return;
+    }
+
+    if (*mergeable)
+    {
+        op = &prog->ops[prog->op_count - 1];
+        if (op->type == CHEAT_OP_WRITE && op->flags == flags
+            && op->offset + op->len == offset && op->len + len <= CHEAT_MAX_RUN)
+        {
+            /* the op owns the end of the pool: move its saved bytes up */
+            uint8_t* data = prog->pool + op->data;
+            store_be(data + op->len, value, len);
+            op->len += len;
+            memset(data + op->len, 0, op->len);
+            prog->pool_size = op->data + 2 * op->len;
+            return;
+        }
+    }
+
+    op = new_op(b, CHEAT_OP_WRITE, flags, offset, len);
+    store_be(prog->pool + op->data, value, len);
+    *mergeable = 1;
+}
+
+static void compile_test(struct program_builder* b, uint32_t address, uint32_t value, uint16_t len, uint8_t type, uint8_t flags)
+{
+    struct cheat_op* op;
+    uint32_t offset = address & 0xFFFFFF;
+
+    if (offset + len > b->dram_size) {
+        DebugMessage(M64MSG_WARNING, "Ignoring cheat code test outside of RDRAM: %08" PRIX32, address);
+        return;
+    }
+
+    op = new_op(b, type, flags, offset, len);
+    store_be(b->prog->pool + op->data, value, len);
+}
+
+static void compile_cheat(struct program_builder* b, const cheat_t* cheat)
+{
+    struct cheat_program* prog = b->prog;
+    const cheat_code_t *code;
+    size_t pending_tests = prog->op_count;
+    size_t i;
+    int mergeable = 0;
+    int guarded;
+
+    list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+        uint32_t type = code->address & 0xFF000000;
+
+        if ((type & 0xF0000000) == 0xD0000000)
+        {
+            uint8_t gs = (type >= 0xD8000000) ? CHEAT_OP_GS_BUTTON : 0;
+
+            switch (type)
+            {
+            case 0xD0000000: case 0xD8000000:
+                compile_test(b, code->address, code->value, 1, CHEAT_OP_TEST_EQ, gs); break;
+            case 0xD1000000: case 0xD9000000:
+                compile_test(b, code->address, code->value, 2, CHEAT_OP_TEST_EQ, gs); break;
+            case 0xD2000000: case 0xDB000000:
+                compile_test(b, code->address, code->value, 1, CHEAT_OP_TEST_NE, gs); break;
+            case 0xD3000000: case 0xDA000000:
+                compile_test(b, code->address, code->value, 2, CHEAT_OP_TEST_NE, gs); break;
+            default:
+                /* other conditional codes always succeed */
+                break;
+            }
+            continue;
+        }
+
+        /* a write guarded by tests is skipped on its own */
+        guarded = (pending_tests != prog->op_count);
+        if (guarded)
+            mergeable = 0;
+
+        switch (type)
+        {
+        case 0x80000000: case 0xA0000000:
+            compile_write(b, code->address, code->value, 1, CHEAT_OP_SAVE_OLD, &mergeable); break;
+        case 0x81000000: case 0xA1000000:
+            compile_write(b, code->address, code->value, 2, CHEAT_OP_SAVE_OLD, &mergeable); break;
+        case 0x88000000: case 0xA8000000:
+            compile_write(b, code->address, code->value, 1, CHEAT_OP_GS_BUTTON, &mergeable); break;
+        case 0x89000000: case 0xA9000000:
+            compile_write(b, code->address, code->value, 2, CHEAT_OP_GS_BUTTON, &mergeable); break;
+        case 0xF0000000:
+            compile_write(b, code->address, code->value, 1, CHEAT_OP_BOOT | CHEAT_OP_SAVE_OLD, &mergeable); break;
+        case 0xF1000000:
+            compile_write(b, code->address, code->value, 2, CHEAT_OP_BOOT | CHEAT_OP_SAVE_OLD, &mergeable); break;
+        case 0xEE000000:
+            /* most likely, this doesnt do anything. */
+            compile_write(b, 0xF1000318, 0x0040, 2, 0, &mergeable);
+            compile_write(b, 0xF100031A, 0x0000, 2, 0, &mergeable);
+            break;
+        default:
+            break;
+        }
+
+        /* failed tests skip everything up to here */
+        for (i = pending_tests; i < prog->op_count; ++i) {
+            if (prog->ops[i].type != CHEAT_OP_WRITE)
+                prog->ops[i].skip = (uint32_t)prog->op_count;
+        }
+        if (guarded)
+            mergeable = 0;
+        pending_tests = prog->op_count;
+    }
+
+    for (i = pending_tests; i < prog->op_count; ++i)
+        prog->ops[i].skip = (uint32_t)prog->op_count;
+}
+
+static int compare_records_by_id(const void* a, const void* b)
+{
+    const struct cheat_record* x = *(const struct cheat_record* const*)a;
+    const struct cheat_record* y = *(const struct cheat_record* const*)b;
+
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+static const struct cheat_record* find_record(const struct cheat_record** sorted, size_t count, unsigned int id)
+{
+    size_t lo = 0, hi = count;
+
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (sorted[mid]->id == id)
+            return sorted[mid];
+        if (sorted[mid]->id < id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return NULL;
+}
+
+/* Copies the ops and runtime state of an unchanged cheat */
+static void copy_record(struct program_builder* b, const struct cheat_program* old, const struct cheat_record* rec)
+{
+    struct cheat_program* prog = b->prog;
+    size_t i;
+
+    while (prog->op_count + rec->op_count > b->op_capacity)
+        prog->ops = grow_array(prog->ops, b->op_capacity, &b->op_capacity, sizeof(*prog->ops));
+    while (prog->pool_size + rec->data_size > b->pool_capacity)
+        prog->pool = grow_array(prog->pool, b->pool_capacity, &b->pool_capacity, 1);
+
+    for (i = 0; i < rec->op_count; ++i)
+    {
+        struct cheat_op* op = &prog->ops[prog->op_count + i];
+        *op = old->ops[rec->first_op + i];
+        op->data = op->data - rec->first_data + (uint32_t)prog->pool_size;
+        op->skip = op->skip - rec->first_op + (uint32_t)prog->op_count;
+    }
+
+    memcpy(prog->pool + prog->pool_size, old->pool + rec->first_data, rec->data_size);
+
+    prog->op_count += rec->op_count;
+    prog->pool_size += rec->data_size;
+}
+
+static struct cheat_program* compile_cheats(struct cheat_ctx* ctx, const struct cheat_program* old, size_t dram_size)
 {
-    return *(uint16_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S16)));
+    struct program_builder b;
+    const struct cheat_record** sorted = NULL;
+    size_t old_count = (old != NULL) ? old->record_count : 0;
+    cheat_t *cheat;
+    size_t i;
+
+    memset(&b, 0, sizeof(b));
+    b.dram_size = dram_size;
+    b.prog = calloc(1, sizeof(*b.prog));
+    if (b.prog == NULL)
+        return NULL;
+
+    if (old_count > 0)
+    {
+        sorted = malloc(old_count * sizeof(*sorted));
+        if (sorted == NULL) {
+            old_count = 0;
+        }
+        else {
+            for (i = 0; i < old_count; ++i)
+                sorted[i] = &old->records[i];
+            qsort(sorted, old_count, sizeof(*sorted), compare_records_by_id);
+        }
+    }
+
+    list_for_each_entry_t(cheat, &ctx->active_cheats, cheat_t, list) {
+        struct cheat_program* prog = b.prog;
+        const struct cheat_record* prev = find_record(sorted, old_count, cheat->id);
+        struct cheat_record* rec;
+
+        prog->records = grow_array(prog->records, prog->record_count, &b.record_capacity, sizeof(*prog->records));
+        rec = &prog->records[prog->record_count++];
+        rec->id = cheat->id;
+        rec->enabled = cheat->enabled;
+        rec->was_enabled = (prev != NULL) ? prev->was_enabled : 0;
+        rec->first_op = (uint32_t)prog->op_count;
+        rec->first_data = (uint32_t)prog->pool_size;
+
+        if (prev != NULL)
+            copy_record(&b, old, prev);
+        else
+            compile_cheat(&b, cheat);
+
+        rec->op_count = (uint32_t)prog->op_count - rec->first_op;
+        rec->data_size = (uint32_t)prog->pool_size - rec->first_data;
+    }
+
+    free(sorted);
+    return b.prog;
 }
 
-static uint8_t read_address_8bit(struct r4300_core* r4300, uint32_t address)
+static void flush_dirty_range(struct r4300_core* r4300, struct cheat_dirty_range* range)
 {
-    return *(uint8_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S8)));
+    if (range->begin == range->end)
+        return;
+
+    invalidate_r4300_cached_code(r4300, R4300_KSEG0 + range->begin, range->end - range->begin);
+    invalidate_r4300_cached_code(r4300, R4300_KSEG1 + range->begin, range->end - range->begin);
+    range->begin = range->end = 0;
 }
 
-static void update_address_16bit(struct r4300_core* r4300, uint32_t address, uint16_t new_value)
+/* Cached code is invalidated in batches of nearby modified bytes */
+static void add_dirty_range(struct r4300_core* r4300, struct cheat_dirty_range* range, uint32_t begin, uint32_t end)
 {
-    *(uint16_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S16))) = new_value;
-    /* mask out bit 24 which is used by GS codes to specify 8/16 bits */
-    address &= 0xfeffffff;
-    invalidate_r4300_cached_code(r4300, address, 2);
+    if (range->begin != range->end)
+    {
+        if (begin <= range->end + 0x1000 && end + 0x1000 >= range->begin)
+        {
+            if (begin < range->begin) range->begin = begin;
+            if (end > range->end) range->end = end;
+            return;
+        }
+        flush_dirty_range(r4300, range);
+    }
+
+    range->begin = begin;
+    range->end = end;
 }
 
-static void update_address_8bit(struct r4300_core* r4300, uint32_t address, uint8_t new_value)
+static void write_bytes(struct r4300_core* r4300, struct cheat_dirty_range* range, uint32_t offset, const uint8_t* src, uint16_t len)
 {
-    *(uint8_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S8))) = new_value;
-    invalidate_r4300_cached_code(r4300, address, 1);
+    uint8_t* dram = (uint8_t*)r4300->rdram->dram;
+    int changed = 0;
+    uint16_t k;
+
+    for (k = 0; k < len; ++k)
+    {
+        uint8_t* dst = dram + ((offset + k) ^ S8);
+        if (*dst != src[k]) {
+            *dst = src[k];
+            changed = 1;
+        }
+    }
+
+    /* memory already holding the value needs no new code */
+    if (changed)
+        add_dirty_range(r4300, range, offset, offset + len);
 }
 
-static int address_equal_to_8bit(struct r4300_core* r4300, uint32_t address, uint8_t value)
+static void execute_write(struct cheat_program* prog, struct cheat_op* op, struct r4300_core* r4300, struct cheat_dirty_range* range)
 {
-    uint8_t value_read;
-    value_read = *(uint8_t*)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S8)));
-    return value_read == value;
+    uint8_t* data = prog->pool + op->data;
+
+    if ((op->flags & (CHEAT_OP_SAVE_OLD | CHEAT_OP_OLD_SAVED)) == CHEAT_OP_SAVE_OLD)
+    {
+        const uint8_t* dram = (const uint8_t*)r4300->rdram->dram;
+        uint16_t k;
+
+        for (k = 0; k < op->len; ++k)
+            data[op->len + k] = dram[(op->offset + k) ^ S8];
+        op->flags |= CHEAT_OP_OLD_SAVED;
+    }
+
+    write_bytes(r4300, range, op->offset, data, op->len);
 }
 
-static int address_equal_to_16bit(struct r4300_core* r4300, uint32_t address, uint16_t value)
+static int execute_test(const struct cheat_program* prog, const struct cheat_op* op, const struct r4300_core* r4300, int gs_active)
 {
-    uint16_t value_read;
-    value_read = *(unsigned short *)(((unsigned char*)r4300->rdram->dram + ((address & 0xFFFFFF)^S16)));
-    return value_read == value;
+    const uint8_t* dram = (const uint8_t*)r4300->rdram->dram;
+    const uint8_t* data = prog->pool + op->data;
+    int equal;
+
+    if ((op->flags & CHEAT_OP_GS_BUTTON) && !gs_active)
+        return 0;
+
+    equal = (dram[op->offset ^ S8] == data[0])
+        && (op->len == 1 || dram[(op->offset + 1) ^ S8] == data[1]);
+
+    return (op->type == CHEAT_OP_TEST_EQ) ? equal : !equal;
 }
 
-/* individual application - returns 0 if we are supposed to skip the next cheat
- * (only really used on conditional codes)
- */
-static int execute_cheat(struct r4300_core* r4300, uint32_t address, uint32_t value, uint32_t* old_value)
+static void run_record(struct cheat_program* prog, struct cheat_record* rec, struct r4300_core* r4300, int entry, int gs_active, struct cheat_dirty_range* range)
 {
-    switch (address & 0xFF000000)
+    uint32_t i = rec->first_op;
+    uint32_t end = rec->first_op + rec->op_count;
+
+    while (i < end)
     {
-    case 0x80000000:
-    case 0x88000000:
-    case 0xA0000000:
-    case 0xA8000000:
-    case 0xF0000000:
-        /* if pointer to old value is valid and uninitialized, write current value to it */
-        if (old_value && (*old_value == CHEAT_CODE_MAGIC_VALUE)) {
-            *old_value = read_address_8bit(r4300, address);
+        struct cheat_op* op = &prog->ops[i];
+
+        if (entry == ENTRY_BOOT)
+        {
+            /* codes should only be written once at boot time */
+            if (op->flags & CHEAT_OP_BOOT)
+                execute_write(prog, op, r4300, range);
+        }
+        else if (op->type != CHEAT_OP_WRITE)
+        {
+            if (!execute_test(prog, op, r4300, gs_active)) {
+                i = op->skip;
+                continue;
+            }
+        }
+        else if (!(op->flags & CHEAT_OP_BOOT)
+            && (!(op->flags & CHEAT_OP_GS_BUTTON) || gs_active))
+        {
+            execute_write(prog, op, r4300, range);
         }
-        update_address_8bit(r4300, address, (uint8_t)value);
-        return 1;
-    case 0x81000000:
-    case 0x89000000:
-    case 0xA1000000:
-    case 0xA9000000:
-    case 0xF1000000:
-        /* if pointer to old value is valid and uninitialized, write current value to it */
-        if (old_value && (*old_value == CHEAT_CODE_MAGIC_VALUE)) {
-            *old_value = read_address_16bit(r4300, address);
+
+        ++i;
+    }
+}
+
+/* set memory back to old values and clear saved copies */
+static void restore_record(struct cheat_program* prog, struct cheat_record* rec, struct r4300_core* r4300, struct cheat_dirty_range* range)
+{
+    uint32_t i;
+
+    for (i = rec->first_op; i < rec->first_op + rec->op_count; ++i)
+    {
+        struct cheat_op* op = &prog->ops[i];
+
+        if (op->flags & CHEAT_OP_OLD_SAVED) {
+            write_bytes(r4300, range, op->offset, prog->pool + op->data + op->len, op->len);
+            op->flags &= ~CHEAT_OP_OLD_SAVED;
         }
-        update_address_16bit(r4300, address, (uint16_t)value);
-        return 1;
-    case 0xD0000000:
-    case 0xD8000000:
-        return address_equal_to_8bit(r4300, address, (uint8_t)value);
-    case 0xD1000000:
-    case 0xD9000000:
-        return address_equal_to_16bit(r4300, address, (uint16_t)value);
-    case 0xD2000000:
-    case 0xDB000000:
-        return !(address_equal_to_8bit(r4300, address, (uint8_t)value));
-    case 0xD3000000:
-    case 0xDA000000:
-        return !(address_equal_to_16bit(r4300, address, (uint16_t)value));
-    case 0xEE000000:
-        /* most likely, this doesnt do anything. */
-        execute_cheat(r4300, 0xF1000318, 0x0040, NULL);
-        execute_cheat(r4300, 0xF100031A, 0x0000, NULL);
-        return 1;
-    default:
-        return 1;
     }
 }
 
@@ -174,18 +569,19 @@ static cheat_t *find_or_create_cheat(struct cheat_ctx* ctx, const char *name)
         }
 
         cheat->enabled = 0;
-        cheat->was_enabled = 0;
     }
     else
     {
         cheat = malloc(sizeof(*cheat));
         cheat->name = strdup(name);
         cheat->enabled = 0;
-        cheat->was_enabled = 0;
         INIT_LIST_HEAD(&cheat->cheat_codes);
         list_add_tail(&cheat->list, &ctx->active_cheats);
     }
 
+    /* new codes start without saved values */
+    cheat->id = ++ctx->next_id;
+
     return cheat;
 }
 
@@ -195,6 +591,9 @@ void cheat_init(struct cheat_ctx* ctx)
 {
     ctx->mutex = SDL_CreateMutex();
     INIT_LIST_HEAD(&ctx->active_cheats);
+    ctx->program = NULL;
+    ctx->program_dirty = 0;
+    ctx->next_id = 0;
 }
 
 void cheat_uninit(struct cheat_ctx* ctx)
@@ -203,16 +602,15 @@ void cheat_uninit(struct cheat_ctx* ctx)
         SDL_DestroyMutex(ctx->mutex);
     }
     ctx->mutex = NULL;
+
+    free_program(ctx->program);
+    ctx->program = NULL;
 }
 
-void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry)
+/* Runs on the emulation thread, which owns the compiled program */
+static void update_program(struct cheat_ctx* ctx, struct r4300_core* r4300)
 {
-    cheat_t *cheat;
-    cheat_code_t *code;
-    int cond_failed;
-
-    if (list_empty(&ctx->active_cheats))
-        return;
+    struct cheat_program* prog;
 
     if (ctx->mutex == NULL || SDL_LockMutex(ctx->mutex) != 0)
     {
@@ -220,100 +618,51 @@ void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int ent
         return;
     }
 
-    list_for_each_entry_t(cheat, &ctx->active_cheats, cheat_t, list) {
-        if (cheat->enabled)
+    prog = compile_cheats(ctx, ctx->program, r4300->rdram->dram_size);
+    if (prog != NULL) {
+        free_program(ctx->program);
+        ctx->program = prog;
+        ctx->program_dirty = 0;
+    }
+
+    SDL_UnlockMutex(ctx->mutex);
+}
+
+void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry)
+{
+    struct cheat_program* prog;
+    struct cheat_dirty_range range = { 0, 0 };
+    int gs_active;
+    size_t i;
+
+    if (ctx->program_dirty)
+        update_program(ctx, r4300);
+
+    prog = ctx->program;
+    if (prog == NULL || prog->record_count == 0)
+        return;
+
+    gs_active = (entry == ENTRY_VI) && event_gameshark_active();
+
+    for (i = 0; i < prog->record_count; ++i)
+    {
+        struct cheat_record* rec = &prog->records[i];
+
+        if (rec->enabled)
         {
-            cheat->was_enabled = 1;
-            switch(entry)
-            {
-            case ENTRY_BOOT:
-                list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
-                    /* code should only be written once at boot time */
-                    if ((code->address & 0xF0000000) == 0xF0000000) {
-                        execute_cheat(r4300, code->address, code->value, &code->old_value);
-                    }
-                }
-                break;
-            case ENTRY_VI:
-                /* a cheat starts without failed preconditions */
-                cond_failed = 0;
-
-                list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
-                    /* conditional cheat codes */
-                    if ((code->address & 0xF0000000) == 0xD0000000)
-                    {
-                        /* if code needs GS button pressed and it's not, skip it */
-                        if (((code->address & 0xFF000000) == 0xD8000000 ||
-                                    (code->address & 0xFF000000) == 0xD9000000 ||
-                                    (code->address & 0xFF000000) == 0xDA000000 ||
-                                    (code->address & 0xFF000000) == 0xDB000000) &&
-                                !event_gameshark_active()) {
-                            /* if condition false, skip next code non-test code */
-                            cond_failed = 1;
-                        }
-
-                        /* if condition false, skip next code non-test code */
-                        if (!execute_cheat(r4300, code->address, code->value, NULL)) {
-                            cond_failed = 1;
-                        }
-                    }
-                    else {
-                        /* preconditions were false for this non-test code
-                         * reset the condition state and skip the cheat
-                         */
-                        if (cond_failed) {
-                            cond_failed = 0;
-                            continue;
-                        }
-
-                        switch (code->address & 0xFF000000) {
-                        /* GS button triggers cheat code */
-                        case 0x88000000:
-                        case 0x89000000:
-                        case 0xA8000000:
-                        case 0xA9000000:
-                            if (event_gameshark_active()) {
-                                execute_cheat(r4300, code->address, code->value, NULL);
-                            }
-                            break;
-                            /* normal cheat code */
-                        default:
-                            /* exclude boot-time cheat codes */
-                            if ((code->address & 0xF0000000) != 0xF0000000) {
-                                execute_cheat(r4300, code->address, code->value, &code->old_value);
-                            }
-                            break;
-                        }
-                    }
-                }
-                break;
-            default:
-                break;
-            }
+            rec->was_enabled = 1;
+            run_record(prog, rec, r4300, entry, gs_active, &range);
         }
         /* if cheat was enabled, but is now disabled, restore old memory values */
-        else if (cheat->was_enabled)
+        else if (rec->was_enabled)
         {
-            cheat->was_enabled = 0;
-            switch(entry)
-            {
-            case ENTRY_VI:
-                list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
-                    /* set memory back to old value and clear saved copy of old value */
-                    if(code->old_value != CHEAT_CODE_MAGIC_VALUE)
-                    {
-                        execute_cheat(r4300, code->address, code->old_value, NULL);
-                        code->old_value = CHEAT_CODE_MAGIC_VALUE;
-                    }
-                }
-                break;
-            default:
-                break;
-            }
+            rec->was_enabled = 0;
+            if (entry == ENTRY_VI)
+                restore_record(prog, rec, r4300, &range);
         }
     }
 
-    SDL_UnlockMutex(ctx->mutex);
+    flush_dirty_range(r4300, &range);
 }
 
 
@@ -341,6 +690,7 @@ void cheat_delete_all(struct cheat_ctx* ctx)
         list_del(&cheat->list);
         free(cheat);
     }
+    ctx->program_dirty = 1;
 
     SDL_UnlockMutex(ctx->mutex);
 }
@@ -362,6 +712,7 @@ int cheat_set_enabled(struct cheat_ctx* ctx, const char* name, int enabled)
         if (strcmp(name, cheat->name) == 0)
         {
             cheat->enabled = enabled;
+            ctx->program_dirty = 1;
             SDL_UnlockMutex(ctx->mutex);
             return 1;
         }
@@ -409,7 +760,6 @@ int cheat_add_new(struct cheat_ctx* ctx, const char* name, m64p_cheat_code* code
                 cheat_code_t *code = malloc(sizeof(*code));
                 code->address = cur_addr;
                 code->value = cur_value;
-                code->old_value = CHEAT_CODE_MAGIC_VALUE;
                 list_add_tail(&code->list, &cheat->cheat_codes);
                 cur_addr += incr_addr;
                 cur_value += incr_value;
@@ -421,11 +771,11 @@ int cheat_add_new(struct cheat_ctx* ctx, const char* name, m64p_cheat_code* code
             cheat_code_t *code = malloc(sizeof(*code));
             code->address = code_list[i].address;
             code->value = code_list[i].value;
-            code->old_value = CHEAT_CODE_MAGIC_VALUE;
             list_add_tail(&code->list, &cheat->cheat_codes);
         }
     }
 
+    ctx->program_dirty = 1;
     SDL_UnlockMutex(ctx->mutex);
     return 1;
 }
@@ -33,11 +33,18 @@
 
 struct SDL_mutex;
 struct r4300_core;
+struct cheat_program;
 
 struct cheat_ctx
 {
     struct SDL_mutex* mutex;
     struct list_head active_cheats;
+
+    /* compiled form of active_cheats, owned by the emulation thread and
+     * rebuilt from the list on next application when program_dirty is set */
+    struct cheat_program* program;
+    volatile int program_dirty;
+    unsigned int next_id;
 };
 
 void cheat_apply_cheats(struct cheat_ctx* ctx, struct r4300_core* r4300, int entry);
@@ -0,0 +1,473 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - guest_profiler.c                                        *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "guest_profiler.h"
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "osal/files.h"
+
+/* address range used to aggregate samples not covered by a symbol */
+#define GUEST_PROFILER_BUCKET_SIZE UINT32_C(0x100)
+#define GUEST_PROFILER_TOP_COUNT 20
+
+struct pc_sample
+{
+    uint32_t pc;
+    uint32_t count;
+};
+
+struct guest_symbol
+{
+    uint32_t start;
+    uint64_t end;
+    char* name;
+};
+
+struct guest_frame
+{
+    const char* name;
+    uint32_t start;
+    uint64_t end;
+    uint64_t count;
+};
+
+unsigned int g_guest_profiler_interval;
+
+/* open addressing hash table of sampled PCs, a zero count marks a free slot */
+static struct pc_sample* l_samples;
+static size_t l_samples_capacity;
+static size_t l_samples_used;
+static uint64_t l_samples_total;
+static uint64_t l_samples_dropped;
+
+static struct guest_symbol* l_symbols;
+static size_t l_symbols_count;
+
+static size_t sample_index(uint32_t pc, size_t capacity)
+{
+    /* Fibonacci hashing, capacity is a power of two */
+    return (size_t)(((uint32_t)(pc >> 2) * UINT32_C(2654435761)) & (capacity - 1));
+}
+
+static struct pc_sample* find_sample(struct pc_sample* samples, size_t capacity, uint32_t pc)
+{
+    size_t i = sample_index(pc, capacity);
+
+    while (samples[i].count != 0 && samples[i].pc != pc) {
+        i = (i + 1) & (capacity - 1);
+    }
+
+    return &samples[i];
+}
+
+static int grow_samples(void)
+{
+    size_t i;
+    size_t capacity = (l_samples_capacity == 0) ? 4096 : 2 * l_samples_capacity;
+    struct pc_sample* samples = calloc(capacity, sizeof(*samples));
+
+    if (samples == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < l_samples_capacity; ++i) {
+        if (l_samples[i].count != 0) {
+            *find_sample(samples, capacity, l_samples[i].pc) = l_samples[i];
+        }
+    }
+
+    free(l_samples);
+    l_samples = samples;
+    l_samples_capacity = capacity;
+    return 0;
+}
+
+static void free_profiler_data(void)
+{
+    size_t i;
+
+    for (i = 0; i < l_symbols_count; ++i) {
+        free(l_symbols[i].name);
+    }
+    free(l_symbols);
+    l_symbols = NULL;
+    l_symbols_count = 0;
+
+    free(l_samples);
+    l_samples = NULL;
+    l_samples_capacity = 0;
+    l_samples_used = 0;
+    l_samples_total = 0;
+    l_samples_dropped = 0;
+}
+
+static int compare_symbols(const void* a, const void* b)
+{
+    const struct guest_symbol* s1 = (const struct guest_symbol*)a;
+    const struct guest_symbol* s2 = (const struct guest_symbol*)b;
+
+    return (s1->start > s2->start) - (s1->start < s2->start);
+}
+
+static int parse_hex(const char* token, uint64_t* value)
+{
+    char* end;
+
+    if (!isxdigit((unsigned char)token[0])) {
+        return 0;
+    }
+
+    *value = strtoull(token, &end, 16);
+    return *end == '\0';
+}
+
+/* Accepts "address [size] name" lines as well as the output of nm and
+ * nm -S, where only text symbols are kept. Addresses may be given as
+ * 64-bit sign extended values. */
+static int parse_symbol_line(char* line, struct guest_symbol* symbol)
+{
+    char* tokens[4];
+    size_t count = 0;
+    size_t i;
+    uint64_t address;
+    uint64_t size = 0;
+    char* token;
+
+    for (token = strtok(line, " \t\r\n"); token != NULL && count < 4; token = strtok(NULL, " \t\r\n")) {
+        tokens[count++] = token;
+    }
+
+    if (count < 2 || tokens[0][0] == '#' || tokens[0][0] == ';') {
+        return 0;
+    }
+
+    if (tokens[0][0] == '0' && (tokens[0][1] == 'x' || tokens[0][1] == 'X')) {
+        tokens[0] += 2;
+    }
+    if (!parse_hex(tokens[0], &address)) {
+        return 0;
+    }
+
+    for (i = 1; i + 1 < count; ++i) {
+        if (tokens[i][1] == '\0') {
+            /* nm symbol type */
+            if (strchr("tTwW", tokens[i][0]) == NULL) {
+                return 0;
+            }
+        }
+        else if (!parse_hex(tokens[i], &size)) {
+            return 0;
+        }
+    }
+
+    symbol->start = (uint32_t)address;
+    symbol->end = (size != 0) ? (uint64_t)symbol->start + size : 0;
+    symbol->name = strdup(tokens[count - 1]);
+
+    return symbol->name != NULL;
+}
+
+static int load_symbols(const char* path)
+{
+    char line[512];
+    size_t capacity = 0;
+    size_t i;
+    FILE* f = osal_file_open(path, "r");
+
+    if (f == NULL) {
+        DebugMessage(M64MSG_ERROR, "Couldn't open guest profiler symbol map: %s", path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        struct guest_symbol symbol;
+
+        if (!parse_symbol_line(line, &symbol)) {
+            continue;
+        }
+
+        if (l_symbols_count == capacity) {
+            size_t new_capacity = (capacity == 0) ? 1024 : 2 * capacity;
+            struct guest_symbol* symbols = realloc(l_symbols, new_capacity * sizeof(*symbols));
+            if (symbols == NULL) {
+                free(symbol.name);
+                break;
+            }
+            l_symbols = symbols;
+            capacity = new_capacity;
+        }
+
+        l_symbols[l_symbols_count++] = symbol;
+    }
+
+    fclose(f);
+
+    qsort(l_symbols, l_symbols_count, sizeof(l_symbols[0]), compare_symbols);
+
+    /* symbols without a size extend to the next one,
+     * or to the end of their 512MB segment */
+    for (i = 0; i < l_symbols_count; ++i) {
+        uint64_t limit = (i + 1 < l_symbols_count)
+            ? l_symbols[i + 1].start
+            : (uint64_t)(l_symbols[i].start & UINT32_C(0xe0000000)) + UINT32_C(0x20000000);
+
+        if (l_symbols[i].end == 0 || l_symbols[i].end > limit) {
+            l_symbols[i].end = limit;
+        }
+    }
+
+    DebugMessage(M64MSG_INFO, "Guest profiler: %u symbols loaded from %s", (unsigned int)l_symbols_count, path);
+    return 0;
+}
+
+/* number of symbols starting at or before pc */
+static size_t symbols_before(uint32_t pc)
+{
+    size_t lo = 0;
+    size_t hi = l_symbols_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (l_symbols[mid].start <= pc) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+int guest_profiler_start(unsigned int interval, const char* symbols_path)
+{
+    free_profiler_data();
+
+    if (interval == 0) {
+        return 0;
+    }
+
+    if (symbols_path != NULL && strlen(symbols_path) != 0) {
+        load_symbols(symbols_path);
+    }
+
+    if (grow_samples() < 0) {
+        DebugMessage(M64MSG_ERROR, "Couldn't allocate guest profiler samples");
+        free_profiler_data();
+        return -1;
+    }
+
+    g_guest_profiler_interval = interval;
+    DebugMessage(M64MSG_INFO, "Guest profiler: sampling PC every %u count cycles", interval);
+    return 0;
+}
+
+void guest_profiler_sample(uint32_t pc)
+{
+    struct pc_sample* sample;
+
+    if (g_guest_profiler_interval == 0) {
+        return;
+    }
+
+    /* keep the load factor below 1/2 */
+    if (2 * (l_samples_used + 1) > l_samples_capacity && grow_samples() < 0) {
+        ++l_samples_dropped;
+        return;
+    }
+
+    sample = find_sample(l_samples, l_samples_capacity, pc);
+    if (sample->count == 0) {
+        sample->pc = pc;
+        ++l_samples_used;
+    }
+    ++sample->count;
+    ++l_samples_total;
+}
+
+void guest_profiler_stop(void)
+{
+    g_guest_profiler_interval = 0;
+}
+
+static int compare_samples_by_pc(const void* a, const void* b)
+{
+    const struct pc_sample* s1 = (const struct pc_sample*)a;
+    const struct pc_sample* s2 = (const struct pc_sample*)b;
+
+    return (s1->pc > s2->pc) - (s1->pc < s2->pc);
+}
+
+static int compare_frames_by_count(const void* a, const void* b)
+{
+    const struct guest_frame* f1 = (const struct guest_frame*)a;
+    const struct guest_frame* f2 = (const struct guest_frame*)b;
+
+    return (f1->count < f2->count) - (f1->count > f2->count);
+}
+
+static const char* segment_name(uint32_t address)
+{
+    if (address < UINT32_C(0x80000000)) { return "kuseg"; }
+    if (address < UINT32_C(0xa0000000)) { return "kseg0"; }
+    if (address < UINT32_C(0xc0000000)) { return "kseg1"; }
+    return "kseg2";
+}
+
+/* ';' separates frames and newlines separate stacks in the collapsed format */
+static void write_frame_name(FILE* f, const char* s)
+{
+    for (; s != NULL && *s != '\0'; ++s) {
+        fputc((*s == ';') ? ':' : ((unsigned char)*s < 0x20) ? ' ' : *s, f);
+    }
+}
+
+static void write_frame(FILE* f, const char* rom_name, const struct guest_frame* frame)
+{
+    write_frame_name(f, (rom_name != NULL && *rom_name != '\0') ? rom_name : "rom");
+    fprintf(f, ";%s;", segment_name(frame->start));
+    if (frame->name != NULL) {
+        write_frame_name(f, frame->name);
+    }
+    else {
+        fprintf(f, "%08" PRIX32 "-%08" PRIX32, frame->start, (uint32_t)(frame->end - 1));
+    }
+    fprintf(f, " %" PRIu64 "\n", frame->count);
+}
+
+/* Merge samples into per symbol (or per bucket) frames. Symbols and
+ * buckets are disjoint address ranges, so sorting the samples by PC
+ * makes the samples of each frame adjacent. */
+static size_t build_frames(struct pc_sample* samples, size_t count, struct guest_frame* frames)
+{
+    size_t i;
+    size_t frames_count = 0;
+
+    qsort(samples, count, sizeof(samples[0]), compare_samples_by_pc);
+
+    for (i = 0; i < count; ++i) {
+        uint32_t pc = samples[i].pc;
+        struct guest_frame* frame = (frames_count > 0) ? &frames[frames_count - 1] : NULL;
+
+        if (frame == NULL || pc < frame->start || pc >= frame->end) {
+            size_t n = symbols_before(pc);
+            frame = &frames[frames_count++];
+            frame->count = 0;
+
+            if (n > 0 && pc < l_symbols[n - 1].end) {
+                frame->name = l_symbols[n - 1].name;
+                frame->start = l_symbols[n - 1].start;
+                frame->end = l_symbols[n - 1].end;
+            }
+            else {
+                /* buckets are clipped to the gap between their neighbouring symbols */
+                frame->name = NULL;
+                frame->start = pc & ~(GUEST_PROFILER_BUCKET_SIZE - 1);
+                frame->end = (uint64_t)frame->start + GUEST_PROFILER_BUCKET_SIZE;
+                if (n > 0 && l_symbols[n - 1].end > frame->start) {
+                    frame->start = (uint32_t)l_symbols[n - 1].end;
+                }
+                if (n < l_symbols_count && l_symbols[n].start < frame->end) {
+                    frame->end = l_symbols[n].start;
+                }
+            }
+        }
+
+        frame->count += samples[i].count;
+    }
+
+    return frames_count;
+}
+
+int guest_profiler_write_report(const char* path, const char* rom_name)
+{
+    size_t i;
+    size_t count = 0;
+    size_t frames_count;
+    struct pc_sample* samples = NULL;
+    struct guest_frame* frames = NULL;
+    FILE* f;
+    int ret = 0;
+
+    if (l_samples_total == 0) {
+        free_profiler_data();
+        return 0;
+    }
+
+    samples = malloc(l_samples_used * sizeof(*samples));
+    frames = malloc(l_samples_used * sizeof(*frames));
+    if (samples == NULL || frames == NULL) {
+        DebugMessage(M64MSG_ERROR, "Couldn't allocate guest profiler report");
+        ret = -1;
+        goto release;
+    }
+
+    for (i = 0; i < l_samples_capacity; ++i) {
+        if (l_samples[i].count != 0) {
+            samples[count++] = l_samples[i];
+        }
+    }
+
+    frames_count = build_frames(samples, count, frames);
+    qsort(frames, frames_count, sizeof(frames[0]), compare_frames_by_count);
+
+    DebugMessage(M64MSG_INFO, "Guest profiler: %" PRIu64 " samples at %u distinct PCs%s",
+        l_samples_total, (unsigned int)l_samples_used, (l_samples_dropped != 0) ? " (some samples were dropped)" : "");
+
+    for (i = 0; i < frames_count && i < GUEST_PROFILER_TOP_COUNT; ++i) {
+        DebugMessage(M64MSG_INFO, "Guest profiler: %5.1f%% %10" PRIu64 "  %08" PRIX32 "-%08" PRIX32 " %s",
+            100.0 * (double)frames[i].count / (double)l_samples_total, frames[i].count,
+            frames[i].start, (uint32_t)(frames[i].end - 1),
+            (frames[i].name != NULL) ? frames[i].name : "");
+    }
+
+    if (path == NULL || strlen(path) == 0) {
+        goto release;
+    }
+
+    f = osal_file_open(path, "w");
+    if (f == NULL) {
+        DebugMessage(M64MSG_ERROR, "Couldn't open guest profiler report file: %s", path);
+        ret = -1;
+        goto release;
+    }
+
+    for (i = 0; i < frames_count; ++i) {
+        write_frame(f, rom_name, &frames[i]);
+    }
+    fclose(f);
+
+    DebugMessage(M64MSG_INFO, "Guest profiler report written to %s", path);
+
+release:
+    free(frames);
+    free(samples);
+    free_profiler_data();
+    return ret;
+}
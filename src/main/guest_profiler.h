@@ -0,0 +1,43 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - guest_profiler.h                                        *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_GUEST_PROFILER_H
+#define M64P_MAIN_GUEST_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Samples the guest PC every g_guest_profiler_interval CP0 Count cycles
+ * from a PROFILE_EVT interrupt queue event, so it works the same way in
+ * every emulation mode. A zero interval means the profiler is stopped. */
+extern unsigned int g_guest_profiler_interval;
+
+int guest_profiler_start(unsigned int interval, const char* symbols_path);
+void guest_profiler_sample(uint32_t pc);
+void guest_profiler_stop(void);
+
+/* Logs the hottest guest functions (or address ranges when no symbol
+ * covers them) and writes all of them to path as collapsed stacks,
+ * ready for flamegraph.pl. */
+int guest_profiler_write_report(const char* path, const char* rom_name);
+
+#endif
@@ -54,6 +54,7 @@
 #include "backends/plugins_compat/plugins_compat.h"
 #include "backends/clock_ctime_plus_delta.h"
 #include "backends/file_storage.h"
+#include "benchmark.h"
 #include "cheat.h"
 #include "device/device.h"
 #include "device/dd/disk.h"
@@ -64,16 +65,22 @@
 #include "device/controllers/paks/transferpak.h"
 #include "device/gb/gb_cart.h"
 #include "device/pif/bootrom_hle.h"
+#include "device/r4300/interrupt.h"
 #include "eventloop.h"
+#include "guest_profiler.h"
 #include "main.h"
 #include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
+#include "pacer.h"
+#include "perf_jit.h"
 #include "plugin/plugin.h"
 #if defined(PROFILE)
 #include "profile.h"
 #endif
+#include "rewind.h"
 #include "rom.h"
+#include "rsp_thread.h"
 #include "savestates.h"
 #include "screenshot.h"
 #include "util.h"
@@ -95,7 +102,7 @@ m64p_handle g_CoreConfig = NULL;
 
 m64p_frame_callback g_FrameCallback = NULL;
 
-int         g_RomWordsLittleEndian = 0; // after loading, ROM words are in native N64 byte order (big endian). We will swap them on x86
+int         g_RomWordsLittleEndian = 0; // set when ROM words are stored in host byte order (open_rom does this on little-endian hosts)
 int         g_EmulatorRunning = 0;      // need separate boolean to tell if emulator is running, since --nogui doesn't use a thread
 
 
@@ -123,6 +130,9 @@ static int   l_TakeScreenshot = 0;       // Tell OSD Rendering callback to take
 static int   l_SpeedFactor = 100;        // percentage of nominal game speed at which emulator is running
 static int   l_FrameAdvance = 0;         // variable to check if we pause on next frame
 static int   l_MainSpeedLimit = 1;       // insert delay during vi_interrupt to keep speed at real-time
+static int   l_FastForward = 0;          // fast-forward is active
+static int   l_FastForwardFrameSkip = 0; // fast-forward turbo: 0 disabled, -1 present at refresh rate, K present every Kth frame
+static int   l_SkipRender = 0;           // the frame ending at the next VI is not presented
 
 static osd_message_t *l_msgVol = NULL;
 static osd_message_t *l_msgFF = NULL;
@@ -138,6 +148,10 @@ static size_t l_pak_type_idx[6];
 /* PRNG state - used for Mempaks ID generation */
 static struct xoshiro256pp_state l_mpk_idgen;
 
+/* storage interfaces of the in-game save files, deferred or not depending on SaveFlushDelay */
+static const struct storage_backend_interface* l_isave_storage = &g_ifile_storage;
+static const struct storage_backend_interface* l_isave_substorage = &g_isubfile_storage;
+
 /*********************************************************************************************************
 * static functions
 */
@@ -431,14 +445,33 @@ int main_set_core_defaults(void)
     ConfigSetDefaultInt(g_CoreConfig, "CurrentStateSlot", 0, "Save state slot (0-9) to use when saving/loading the emulator state");
     ConfigSetDefaultBool(g_CoreConfig, "EnableDebugger", 0, "Activate the R4300 debugger when ROM execution begins, if core was built with Debugger support");
     ConfigSetDefaultString(g_CoreConfig, "ScreenshotPath", "", "Path to directory where screenshots are saved. If this is blank, the default value of ${UserDataPath}/screenshot will be used");
+    ConfigSetDefaultInt(g_CoreConfig, "ScreenshotCompression", 6, "PNG compression level (0-9) of screenshots and frame dumps. Lower levels are faster to encode but produce larger files");
+    ConfigSetDefaultInt(g_CoreConfig, "FrameDumpInterval", 0, "Save every Nth rendered frame as a PNG file in the screenshot directory (0: frame dump disabled)");
     ConfigSetDefaultString(g_CoreConfig, "SaveStatePath", "", "Path to directory where emulator save states (snapshots) are saved. If this is blank, the default value of ${UserDataPath}/save will be used");
     ConfigSetDefaultString(g_CoreConfig, "SaveSRAMPath", "", "Path to directory where SRAM/EEPROM data (in-game saves) are stored. If this is blank, the default value of ${UserDataPath}/save will be used");
     ConfigSetDefaultString(g_CoreConfig, "SharedDataPath", "", "Path to a directory to search when looking for shared data files");
     ConfigSetDefaultBool(g_CoreConfig, "RandomizeInterrupt", 1, "Randomize PI/SI Interrupt Timing");
     ConfigSetDefaultInt(g_CoreConfig, "SiDmaDuration", -1, "Duration of SI DMA (-1: use per game settings)");
     ConfigSetDefaultString(g_CoreConfig, "GbCameraVideoCaptureBackend1", DEFAULT_VIDEO_CAPTURE_BACKEND, "Gameboy Camera Video Capture backend");
+    ConfigSetDefaultInt(g_CoreConfig, "SaveFlushDelay", 1000, "Milliseconds to wait after an in-game save (EEPROM, SRAM, FlashRAM, Memory Pak, Transfer Pak RAM) changes before writing it in the background (0: write every change immediately)");
     ConfigSetDefaultInt(g_CoreConfig, "SaveDiskFormat", 1, "Disk Save Format (0: Full Disk Copy (*.ndr/*.d6r), 1: RAM Area Only (*.ram))");
+    ConfigSetDefaultInt(g_CoreConfig, "SaveStateFormat", 0, "Mupen64Plus Savestate Format (0: GZIP compressed, readable by older versions, 1: Chunked, faster to save and load)");
     ConfigSetDefaultInt(g_CoreConfig, "SaveFilenameFormat", 1, "Save (SRAM/State) Filename Format (0: ROM Header Name, 1: Automatic (including partial MD5 hash))");
+    ConfigSetDefaultInt(g_CoreConfig, "BenchmarkVIs", 0, "Benchmark mode: run without speed limiter for this many VIs, then stop and emit a report (0: disabled)");
+    ConfigSetDefaultInt(g_CoreConfig, "BenchmarkCycles", 0, "Benchmark mode: run for this many million CP0 Count cycles, then stop and emit a report (0: disabled)");
+    ConfigSetDefaultBool(g_CoreConfig, "BenchmarkRender", 0, "Benchmark mode: keep presenting frames through the video plugin if True");
+    ConfigSetDefaultString(g_CoreConfig, "BenchmarkReportPath", "", "Benchmark mode: file where the JSON report is written. If this is blank, the report is only logged");
+    ConfigSetDefaultBool(g_CoreConfig, "RomImageCache", 0, "Keep a copy of each ROM in ${UserCachePath}/rom in the byte order used while emulating, and map it into memory instead of converting the ROM on every load. Instances running the same ROM then share its memory (not supported on Windows)");
+    ConfigSetDefaultBool(g_CoreConfig, "DynarecCodeCache", 0, "Save the new dynamic recompiler translation cache in ${UserCachePath}/dynarec when emulation stops and reuse it on the next run of the same ROM");
+    ConfigSetDefaultInt(g_CoreConfig, "PerfJitSymbols", 0, "Describe the recompiled code to the Linux perf profiler (0: disabled, 1: /tmp/perf-<pid>.map symbols, 2: /tmp/jit-<pid>.dump for perf inject --jit)");
+    ConfigSetDefaultInt(g_CoreConfig, "GuestProfilerInterval", 0, "Record the emulated CPU program counter every this many CP0 Count cycles and report the hottest guest code when emulation stops (0: disabled)");
+    ConfigSetDefaultString(g_CoreConfig, "GuestProfilerSymbols", "", "Guest profiler: symbol map used to name sampled addresses, with \"address [size] name\" lines or nm output. If this is blank, samples are grouped by 256 byte address ranges");
+    ConfigSetDefaultString(g_CoreConfig, "GuestProfilerReportPath", "", "Guest profiler: file where the collapsed stacks for flamegraph.pl are written. If this is blank, ${UserDataPath}/profile/<ROM MD5>.folded is used");
+    ConfigSetDefaultBool(g_CoreConfig, "DynarecDualMapping", 0, "Map the dynamic recompiler code buffers twice, writable and executable, instead of once as writable and executable memory (old x86/x86_64 dynamic recompiler only)");
+    ConfigSetDefaultInt(g_CoreConfig, "DynarecTierThreshold", 0, "Interpret each new dynamic recompiler block this many times before compiling it (0: compile on first use)");
+    ConfigSetDefaultInt(g_CoreConfig, "RewindBufferSize", 0, "Size in MB of the in-memory rewind history (0: rewind disabled)");
+    ConfigSetDefaultInt(g_CoreConfig, "RewindInterval", 10, "Number of VIs between two rewind snapshots");
+    ConfigSetDefaultInt(g_CoreConfig, "AsyncGfxTask", -1, "Run graphics tasks on a separate thread and raise the SP interrupt this many count cycles after the task starts (-1: use per game settings, 0: run graphics tasks on the emulation thread). Requires a video plugin which can render from another thread");
 
     /* handle upgrades */
     if (bUpgrade)
@@ -507,12 +540,11 @@ void main_set_fastforward(int enable)
     if (netplay_is_init())
         return;
 
-    static int ff_state = 0;
     static int SavedSpeedFactor = 100;
 
-    if (enable && !ff_state)
+    if (enable && !l_FastForward)
     {
-        ff_state = 1; /* activate fast-forward */
+        l_FastForward = 1; /* activate fast-forward */
         SavedSpeedFactor = l_SpeedFactor;
         l_SpeedFactor = 250;
         audio.setSpeedFactor(l_SpeedFactor);
@@ -522,9 +554,9 @@ void main_set_fastforward(int enable)
         osd_message_set_static(l_msgFF);
         osd_message_set_user_managed(l_msgFF);
     }
-    else if (!enable && ff_state)
+    else if (!enable && l_FastForward)
     {
-        ff_state = 0; /* de-activate fast-forward */
+        l_FastForward = 0; /* de-activate fast-forward */
         l_SpeedFactor = SavedSpeedFactor;
         audio.setSpeedFactor(l_SpeedFactor);
         StateChanged(M64CORE_SPEED_FACTOR, l_SpeedFactor);
@@ -535,6 +567,58 @@ void main_set_fastforward(int enable)
 
 }
 
+static int main_fastforward_turbo(void)
+{
+    return l_FastForward && l_FastForwardFrameSkip != 0;
+}
+
+/* Decide whether the frame ending at the next VI is presented.
+ * Skipped frames are still emulated and their display lists processed,
+ * gfx.updateScreen is not called and the video plugin is told through
+ * SetFrameSkip that it may skip rasterization. Frames that a pending
+ * screenshot or frame dump needs are always presented. */
+static int main_fastforward_skip_frame(void)
+{
+    static unsigned int skipped = 0;
+    static int64_t next_present = 0;
+    int64_t interval, now;
+
+    if (!main_fastforward_turbo())
+    {
+        skipped = 0;
+        next_present = 0;
+        return 0;
+    }
+
+    if (l_TakeScreenshot != 0 || FrameDumpDue(l_CurrentFrame))
+    {
+        skipped = 0;
+        return 0;
+    }
+
+    if (l_FastForwardFrameSkip > 0)
+    {
+        if (++skipped < (unsigned int)l_FastForwardFrameSkip)
+            return 1;
+        skipped = 0;
+        return 0;
+    }
+
+    /* present at the console refresh rate */
+    interval = (int64_t)(1000000000.0 / g_dev.vi.expected_refresh_rate);
+    now = pacer_time_ns();
+    if (now < next_present)
+        return 1;
+
+    next_present = (now - next_present > interval) ? now + interval : next_present + interval;
+    return 0;
+}
+
+int main_skip_render(void)
+{
+    return l_SkipRender || benchmark_skip_render();
+}
+
 static void main_set_speedlimiter(int enable)
 {
     if (netplay_is_init() && !netplay_lag())
@@ -592,6 +676,7 @@ void main_toggle_pause(void)
             osd_delete_message(l_msgPause);
 
         DebugMessage(M64MSG_STATUS, "Emulation paused.");
+        file_storage_request_flush(0);
         l_msgPause = osd_new_message(OSD_MIDDLE_CENTER, "Paused");
         osd_message_set_static(l_msgPause);
         osd_message_set_user_managed(l_msgPause);
@@ -729,6 +814,18 @@ m64p_error main_core_state_query(m64p_core_param param, int *rval)
         case M64CORE_INPUT_GAMESHARK:
             *rval = event_gameshark_active();
             break;
+        case M64CORE_FASTFORWARD_FRAMESKIP:
+            *rval = l_FastForwardFrameSkip;
+            break;
+        case M64CORE_FRAME_TIME_P50:
+            *rval = pacer_get_stat(PACER_STAT_P50);
+            break;
+        case M64CORE_FRAME_TIME_P99:
+            *rval = pacer_get_stat(PACER_STAT_P99);
+            break;
+        case M64CORE_FRAME_TIME_MAX:
+            *rval = pacer_get_stat(PACER_STAT_MAX);
+            break;
         // these are only used for callbacks; they cannot be queried or set
         case M64CORE_SCREENSHOT_CAPTURED:
         case M64CORE_STATE_LOADCOMPLETE:
@@ -825,6 +922,12 @@ m64p_error main_core_state_set(m64p_core_param param, int val)
                 return M64ERR_INVALID_STATE;
             event_set_gameshark(val);
             return M64ERR_SUCCESS;
+        case M64CORE_FASTFORWARD_FRAMESKIP:
+            if (val < -1)
+                return M64ERR_INPUT_INVALID;
+            l_FastForwardFrameSkip = val;
+            StateChanged(M64CORE_FASTFORWARD_FRAMESKIP, l_FastForwardFrameSkip);
+            return M64ERR_SUCCESS;
         // these are only used for callbacks; they cannot be queried or set
         case M64CORE_STATE_LOADCOMPLETE:
         case M64CORE_STATE_SAVECOMPLETE:
@@ -931,6 +1034,14 @@ static void video_plugin_render_callback(int bScreenRedrawn)
         }
     }
 
+    // continuous frame dump, with the same restriction regarding the OSD
+#ifdef M64P_OSD
+    if (!bOSD || bScreenRedrawn)
+#endif /* M64P_OSD */
+    {
+        DumpFrame(l_CurrentFrame);
+    }
+
 #ifdef M64P_OSD
     // if the OSD is enabled, then draw it now
     if (bOSD)
@@ -963,31 +1074,11 @@ void new_frame(void)
 
 static void apply_speed_limiter(void)
 {
-    static unsigned long totalVIs = 0;
-    static int resetOnce = 0;
-    static int lastSpeedFactor = 100;
-    static unsigned int StartFPSTime = 0;
     static const double defaultSpeedFactor = 100.0;
-    unsigned int CurrentFPSTime = SDL_GetTicks();
 
     // calculate frame duration based upon ROM setting (50/60hz) and mupen64plus speed adjustment
-    const double VILimitMilliseconds = 1000.0 / g_dev.vi.expected_refresh_rate;
+    const double VILimitNanoseconds = 1000000000.0 / g_dev.vi.expected_refresh_rate;
     const double SpeedFactorMultiple = defaultSpeedFactor/l_SpeedFactor;
-    const double AdjustedLimit = VILimitMilliseconds * SpeedFactorMultiple;
-
-    //if this is the first time or we are resuming from pause
-    if(StartFPSTime == 0 || !resetOnce || lastSpeedFactor != l_SpeedFactor)
-    {
-       StartFPSTime = CurrentFPSTime;
-       totalVIs = 0;
-       resetOnce = 1;
-    }
-    else
-    {
-        ++totalVIs;
-    }
-
-    lastSpeedFactor = l_SpeedFactor;
 
 #if defined(PROFILE)
     timed_section_start(TIMED_SECTION_IDLE);
@@ -997,33 +1088,8 @@ static void apply_speed_limiter(void)
     if(g_DebuggerActive) DebuggerCallback(DEBUG_UI_VI, 0);
 #endif
 
-    double totalElapsedGameTime = AdjustedLimit*totalVIs;
-    double elapsedRealTime = CurrentFPSTime - StartFPSTime;
-    double sleepTime = totalElapsedGameTime - elapsedRealTime;
-
-    //Reset if the sleep needed is an unreasonable value
-    static const double minSleepNeeded = -50;
-    static const double maxSleepNeeded = 50;
-    if(sleepTime < minSleepNeeded || sleepTime > (maxSleepNeeded*SpeedFactorMultiple))
-    {
-       resetOnce = 0;
-    }
-
-    if (sleepTime < minSleepNeeded) {
-        totalVIs += (unsigned long)(minSleepNeeded/AdjustedLimit);
-    }
-
-    if(l_MainSpeedLimit && sleepTime > 0 && sleepTime < maxSleepNeeded*SpeedFactorMultiple)
-    {
-        while(sleepTime >= 0) {
-            SDL_Delay((unsigned int) sleepTime);
-
-            CurrentFPSTime = SDL_GetTicks();
-            elapsedRealTime = CurrentFPSTime - StartFPSTime;
-            sleepTime = totalElapsedGameTime - elapsedRealTime;
-        }
-    }
-
+    pacer_wait((int64_t)(VILimitNanoseconds * SpeedFactorMultiple),
+               l_MainSpeedLimit && !main_fastforward_turbo());
 
 #if defined(PROFILE)
     timed_section_end(TIMED_SECTION_IDLE);
@@ -1057,7 +1123,9 @@ static void pause_loop(void)
         {
             SDL_Delay(10);
             main_check_inputs();
+            file_storage_deferred_tick();
         }
+        pacer_reset();
     }
 }
 
@@ -1065,6 +1133,8 @@ static void pause_loop(void)
  * Allow the core to perform various things */
 void new_vi(void)
 {
+    int skip_render;
+
 #if defined(PROFILE)
     timed_sections_refresh();
 #endif
@@ -1074,9 +1144,23 @@ void new_vi(void)
     apply_speed_limiter();
     main_check_inputs();
 
+    skip_render = main_fastforward_skip_frame();
+    if (skip_render != l_SkipRender)
+    {
+        l_SkipRender = skip_render;
+        gfx.setFrameSkip(l_SkipRender);
+    }
+
     pause_loop();
 
     netplay_check_sync(&g_dev.r4300.cp0);
+
+    rewind_new_vi();
+
+    file_storage_deferred_tick();
+
+    if (benchmark_new_vi(r4300_cp0_regs(&g_dev.r4300.cp0)[CP0_COUNT_REG]))
+        main_stop();
 }
 
 static void main_switch_pak(int control_id)
@@ -1283,6 +1367,13 @@ static int load_dd_disk(struct dd_disk* dd_disk, const struct storage_backend_in
         save_format = 0;
     }
 
+    /* Full size dumps are used as is, so they are mapped rather than read in memory.
+     * D64 dumps are expanded, and saved disks are rewritten in place. */
+    int (*open_disk_storage)(struct file_storage*, const char*) =
+        (dd_size == MAME_FORMAT_DUMP_SIZE || dd_size == SDK_FORMAT_DUMP_SIZE)
+        ? open_mapped_file_storage
+        : open_rom_file_storage;
+
     /* Determine save file name */
     char* save_filename = get_dd_disk_save_path(namefrompath(dd_disk_filename), save_format);
     if (save_filename == NULL) {
@@ -1297,7 +1388,7 @@ static int load_dd_disk(struct dd_disk* dd_disk, const struct storage_backend_in
             DebugMessage(M64MSG_WARNING, "Failed to load DD Disk save: %s.", save_filename);
 
             /* Try loading regular disk file */
-            if (open_rom_file_storage(fstorage, dd_disk_filename) != file_ok) {
+            if (open_disk_storage(fstorage, dd_disk_filename) != file_ok) {
                 DebugMessage(M64MSG_ERROR, "Failed to load DD Disk: %s.", dd_disk_filename);
                 goto free_fstorage;
             }
@@ -1306,7 +1397,7 @@ static int load_dd_disk(struct dd_disk* dd_disk, const struct storage_backend_in
     else
     {
         /* Try loading regular disk file */
-        if (open_rom_file_storage(fstorage, dd_disk_filename) != file_ok) {
+        if (open_disk_storage(fstorage, dd_disk_filename) != file_ok) {
             DebugMessage(M64MSG_ERROR, "Failed to load DD Disk: %s.", dd_disk_filename);
             goto free_fstorage;
         }
@@ -1526,7 +1617,7 @@ static void init_gb_ram(void* opaque, size_t ram_size, void** storage, const str
 
     /* init GB RAM storage */
     *storage = &data->ram_fstorage;
-    *istorage = &g_ifile_storage;
+    *istorage = l_isave_storage;
 }
 
 static void release_gb_ram(void* opaque)
@@ -1571,6 +1662,25 @@ void main_change_gb_cart(int control_id)
 }
 
 
+static void write_guest_profiler_report(void)
+{
+    const char* path = ConfigGetParamString(g_CoreConfig, "GuestProfilerReportPath");
+    char* default_path = NULL;
+
+    if (path == NULL || strlen(path) == 0) {
+        char* dir = formatstr("%sprofile%c", ConfigGetUserDataPath(), OSAL_DIR_SEPARATORS[0]);
+        if (dir != NULL) {
+            osal_mkdirp(dir, 0700);
+            default_path = formatstr("%s%s.folded", dir, ROM_SETTINGS.MD5);
+            free(dir);
+        }
+        path = default_path;
+    }
+
+    guest_profiler_write_report(path, ROM_SETTINGS.goodname);
+    free(default_path);
+}
+
 /*********************************************************************************************************
 * emulation thread - runs the core
 */
@@ -1584,6 +1694,9 @@ m64p_error main_run(void)
     uint32_t count_per_op_denom_pot;
     uint32_t emumode;
     uint32_t disable_extra_mem;
+    uint32_t benchmark_vis;
+    uint32_t benchmark_mcycles;
+    int saved_speed_limit;
     int32_t si_dma_duration;
     int32_t no_compiled_jump;
     int32_t randomize_interrupt;
@@ -1625,12 +1738,16 @@ m64p_error main_run(void)
 
     /* set some other core parameters based on the config file values */
     savestates_set_autoinc_slot(ConfigGetParamBool(g_CoreConfig, "AutoStateSlotIncrement"));
+    savestates_set_chunked_format(ConfigGetParamInt(g_CoreConfig, "SaveStateFormat") != 0);
     savestates_select_slot(ConfigGetParamInt(g_CoreConfig, "CurrentStateSlot"));
     no_compiled_jump = ConfigGetParamBool(g_CoreConfig, "NoCompiledJump");
     //We disable any randomness for netplay
     randomize_interrupt = !netplay_is_init() ? ConfigGetParamBool(g_CoreConfig, "RandomizeInterrupt") : 0;
     count_per_op = ConfigGetParamInt(g_CoreConfig, "CountPerOp");
     count_per_op_denom_pot = ConfigGetParamInt(g_CoreConfig, "CountPerOpDenomPot");
+    //Benchmark runs are not meaningful over netplay
+    benchmark_vis = !netplay_is_init() ? ConfigGetParamInt(g_CoreConfig, "BenchmarkVIs") : 0;
+    benchmark_mcycles = !netplay_is_init() ? ConfigGetParamInt(g_CoreConfig, "BenchmarkCycles") : 0;
 
     if (ROM_SETTINGS.disableextramem)
         disable_extra_mem = ROM_SETTINGS.disableextramem;
@@ -1705,6 +1822,18 @@ m64p_error main_run(void)
     /* open GB cam video device */
     igbcam_backend->open(gbcam_backend, M64282FP_SENSOR_W, M64282FP_SENSOR_H);
 
+    /* in-game saves are written in the background, SaveFlushDelay ms after they change */
+    int save_flush_delay = ConfigGetParamInt(g_CoreConfig, "SaveFlushDelay");
+    if (save_flush_delay > 0) {
+        file_storage_deferred_set_delay((unsigned int)save_flush_delay);
+        l_isave_storage = &g_ifile_storage_deferred;
+        l_isave_substorage = &g_isubfile_storage_deferred;
+    }
+    else {
+        l_isave_storage = &g_ifile_storage;
+        l_isave_substorage = &g_isubfile_storage;
+    }
+
     /* open storage files, provide default content if not present */
     open_mpk_file(&mpk);
     open_eep_file(&eep);
@@ -1825,7 +1954,7 @@ m64p_error main_run(void)
                     mpk_storages[i].size = MEMPAK_SIZE;
                     mpk_storages[i].filename = (void*)&mpk; /* OK for isubfile_storage */
 
-                    init_mempak(&g_dev.mempaks[i], &mpk_storages[i], &g_isubfile_storage);
+                    init_mempak(&g_dev.mempaks[i], &mpk_storages[i], l_isave_substorage);
                     l_paks[i][k] = &g_dev.mempaks[i];
 
                     if (Controls[i].Plugin == PLUGIN_MEMPAK) {
@@ -1912,10 +2041,10 @@ m64p_error main_run(void)
                 NULL, &g_iclock_ctime_plus_delta,
                 g_rom_size,
                 eeprom_type,
-                &eep, &g_ifile_storage,
+                &eep, l_isave_storage,
                 flashram_type,
-                &fla, &g_ifile_storage,
-                &sra, &g_ifile_storage,
+                &fla, l_isave_storage,
+                &sra, l_isave_storage,
                 NULL, dd_rtc_iclock,
                 dd_rom_size,
                 &dd_disk, dd_idisk);
@@ -1970,7 +2099,100 @@ m64p_error main_run(void)
 
     poweron_device(&g_dev);
     pif_bootrom_hle_execute(&g_dev.r4300);
+
+#ifdef NEW_DYNAREC
+    if (ConfigGetParamBool(g_CoreConfig, "DynarecCodeCache"))
+    {
+        char* cache_dir = formatstr("%sdynarec%c", ConfigGetUserCachePath(), OSAL_DIR_SEPARATORS[0]);
+        if (cache_dir != NULL)
+        {
+            osal_mkdirp(cache_dir, 0700);
+            char* cache_path = formatstr("%s%s.ndc", cache_dir, ROM_SETTINGS.MD5);
+            new_dynarec_set_code_cache_path(cache_path);
+            free(cache_path);
+            free(cache_dir);
+        }
+    }
+    int tier_threshold = ConfigGetParamInt(g_CoreConfig, "DynarecTierThreshold");
+    new_dynarec_set_tier_threshold((tier_threshold > 0) ? (unsigned int)tier_threshold : 0);
+#elif defined(DYNAREC)
+    g_dev.r4300.recomp.code_arena.dual_view = ConfigGetParamBool(g_CoreConfig, "DynarecDualMapping");
+#endif
+
+    //Threaded tasks read RDRAM while the CPU runs, which would desync netplay clients
+    int async_gfx_task = !netplay_is_init() ? ConfigGetParamInt(g_CoreConfig, "AsyncGfxTask") : 0;
+    if (async_gfx_task < 0)
+        async_gfx_task = (int)ROM_PARAMS.asyncgfxtask;
+    if (async_gfx_task > 0 && rsp_thread_start() == 0)
+    {
+        g_dev.sp.async_gfx_delay = (uint32_t)async_gfx_task;
+        /* SP memory accesses must reach the handlers, which wait for the task */
+        unmap_direct_range(&g_dev.mem, MM_RSP_MEM, MM_RSP_MEM + 0xffff);
+    }
+
+    saved_speed_limit = l_MainSpeedLimit;
+    if (benchmark_vis != 0 || benchmark_mcycles != 0)
+    {
+        l_MainSpeedLimit = 0;
+        benchmark_start(benchmark_vis, (uint64_t)benchmark_mcycles * 1000000,
+            ConfigGetParamBool(g_CoreConfig, "BenchmarkRender"),
+            r4300_cp0_regs(&g_dev.r4300.cp0)[CP0_COUNT_REG]);
+    }
+
+    pacer_init();
+
+    //Rewinding would desync netplay clients
+    int rewind_size = !netplay_is_init() ? ConfigGetParamInt(g_CoreConfig, "RewindBufferSize") : 0;
+    int rewind_interval = ConfigGetParamInt(g_CoreConfig, "RewindInterval");
+    if (rewind_size > 0)
+        rewind_init((size_t)rewind_size << 20, (rewind_interval > 0) ? (unsigned int)rewind_interval : 1);
+
+    ScreenshotStart();
+
+    //Profiler events would desync netplay clients
+    int guest_profiler_interval = !netplay_is_init() ? ConfigGetParamInt(g_CoreConfig, "GuestProfilerInterval") : 0;
+    if (guest_profiler_interval > 0
+     && guest_profiler_start((unsigned int)guest_profiler_interval, ConfigGetParamString(g_CoreConfig, "GuestProfilerSymbols")) == 0)
+        add_interrupt_event(&g_dev.r4300.cp0, PROFILE_EVT, g_guest_profiler_interval);
+
+    int perf_jit_mode = ConfigGetParamInt(g_CoreConfig, "PerfJitSymbols");
+    if (emumode == EMUMODE_DYNAREC && perf_jit_mode > PERF_JIT_DISABLED && perf_jit_mode <= PERF_JIT_DUMP)
+        perf_jit_open((enum perf_jit_mode)perf_jit_mode);
+
+    file_storage_deferred_set_emulating(1);
     run_device(&g_dev);
+    file_storage_deferred_set_emulating(0);
+
+    rsp_thread_stop();
+    rsp_thread_report();
+    report_framebuffer_callbacks(&g_dev.dp.fb, (unsigned int)l_CurrentFrame);
+    g_dev.sp.async_gfx_delay = 0;
+
+    perf_jit_close();
+
+    /* make sure in-game saves are on disk before returning to the front-end */
+    file_storage_flush_deferred(1);
+
+    ScreenshotStop();
+    rewind_deinit();
+
+    if (g_guest_profiler_interval != 0)
+    {
+        guest_profiler_stop();
+        write_guest_profiler_report();
+    }
+
+#ifdef NEW_DYNAREC
+    new_dynarec_set_code_cache_path(NULL);
+#endif
+
+    if (g_benchmark.enabled)
+    {
+        benchmark_stop();
+        benchmark_write_report(ConfigGetParamString(g_CoreConfig, "BenchmarkReportPath"),
+            ROM_SETTINGS.goodname, ROM_SETTINGS.MD5, g_dev.r4300.emumode);
+        l_MainSpeedLimit = saved_speed_limit;
+    }
 
     /* now begin to shut down */
 #ifdef WITH_LIRC
@@ -2062,6 +2284,7 @@ void main_stop(void)
         osd_delete_message(l_msgFF);
         l_msgFF = NULL;
     }
+    l_SkipRender = 0;
     if(l_msgVol)
     {
         osd_delete_message(l_msgVol);
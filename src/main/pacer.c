@@ -0,0 +1,186 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - pacer.c                                                 *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "pacer.h"
+
+#include <SDL.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+
+/* remaining time below which the pacer spins instead of sleeping */
+#define PACER_SPIN_NS INT64_C(2000000)
+
+/* resynchronize when this many frames late (e.g. after a long stall) */
+#define PACER_MAX_LATE_FRAMES 4
+
+static struct
+{
+    int64_t deadline;
+    int64_t last_frame;
+
+    int64_t history[PACER_HISTORY_SIZE];
+    size_t history_count;
+    size_t history_next;
+} l_pacer;
+
+/* guards the history, which the front-end reads through pacer_get_stat */
+static SDL_mutex* l_pacer_lock = NULL;
+
+#if defined(WIN32) && !defined(__MINGW32__)
+  #include <windows.h>
+
+  static int64_t get_time_ns(void)
+  {
+      static LARGE_INTEGER freq = { 0 };
+      LARGE_INTEGER counter;
+      if (freq.QuadPart == 0)
+          QueryPerformanceFrequency(&freq);
+      QueryPerformanceCounter(&counter);
+      return (int64_t)((double)counter.QuadPart * 1000000000.0 / (double)freq.QuadPart);
+  }
+
+#else  /* Not WIN32 */
+  #include <time.h>
+
+  static int64_t get_time_ns(void)
+  {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+#endif
+
+int64_t pacer_time_ns(void)
+{
+    return get_time_ns();
+}
+
+void pacer_startup(void)
+{
+    l_pacer_lock = SDL_CreateMutex();
+    if (l_pacer_lock == NULL) {
+        DebugMessage(M64MSG_ERROR, "Could not create frame pacer lock");
+    }
+}
+
+void pacer_shutdown(void)
+{
+    SDL_DestroyMutex(l_pacer_lock);
+    l_pacer_lock = NULL;
+}
+
+void pacer_init(void)
+{
+    SDL_LockMutex(l_pacer_lock);
+    memset(&l_pacer, 0, sizeof(l_pacer));
+    SDL_UnlockMutex(l_pacer_lock);
+}
+
+void pacer_reset(void)
+{
+    l_pacer.deadline = 0;
+    l_pacer.last_frame = 0;
+}
+
+static void pacer_record(int64_t now)
+{
+    if (l_pacer.last_frame != 0)
+    {
+        SDL_LockMutex(l_pacer_lock);
+        l_pacer.history[l_pacer.history_next] = now - l_pacer.last_frame;
+        l_pacer.history_next = (l_pacer.history_next + 1) % PACER_HISTORY_SIZE;
+        if (l_pacer.history_count < PACER_HISTORY_SIZE)
+            ++l_pacer.history_count;
+        SDL_UnlockMutex(l_pacer_lock);
+    }
+
+    l_pacer.last_frame = now;
+}
+
+void pacer_wait(int64_t frame_ns, int limit)
+{
+    int64_t now = get_time_ns();
+
+    if (!limit || l_pacer.deadline == 0)
+    {
+        l_pacer.deadline = now;
+        pacer_record(now);
+        return;
+    }
+
+    l_pacer.deadline += frame_ns;
+
+    /* drift correction: don't try to catch up on long stalls,
+     * and don't wait for a deadline set by a previous (slower) speed */
+    if (now - l_pacer.deadline > PACER_MAX_LATE_FRAMES * frame_ns
+     || l_pacer.deadline - now > frame_ns)
+    {
+        l_pacer.deadline = now;
+    }
+
+    while (l_pacer.deadline - now > PACER_SPIN_NS)
+    {
+        SDL_Delay((Uint32)((l_pacer.deadline - now - PACER_SPIN_NS) / 1000000) + 1);
+        now = get_time_ns();
+    }
+
+    while (now < l_pacer.deadline)
+        now = get_time_ns();
+
+    pacer_record(now);
+}
+
+static int compare_int64(const void* a, const void* b)
+{
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+int pacer_get_stat(enum pacer_stat stat)
+{
+    int64_t sorted[PACER_HISTORY_SIZE];
+    size_t count;
+    size_t index;
+
+    SDL_LockMutex(l_pacer_lock);
+    count = l_pacer.history_count;
+    memcpy(sorted, l_pacer.history, count * sizeof(sorted[0]));
+    SDL_UnlockMutex(l_pacer_lock);
+
+    if (count == 0)
+        return 0;
+
+    qsort(sorted, count, sizeof(sorted[0]), compare_int64);
+
+    switch (stat)
+    {
+    case PACER_STAT_P50: index = (count - 1) / 2; break;
+    case PACER_STAT_P99: index = (count - 1) * 99 / 100; break;
+    default:             index = count - 1; break;
+    }
+
+    return (int)(sorted[index] / 1000);
+}
@@ -0,0 +1,61 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - pacer.h                                                 *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_PACER_H
+#define M64P_MAIN_PACER_H
+
+#include <stdint.h>
+
+/* Frame pacer: frames are scheduled on absolute deadlines of a monotonic
+ * nanosecond clock, so that sleep overshoot on one frame is recovered on
+ * the next ones instead of accumulating. Waits sleep until shortly before
+ * the deadline and spin for the remainder. */
+
+enum { PACER_HISTORY_SIZE = 1024 };
+
+enum pacer_stat
+{
+    PACER_STAT_P50,
+    PACER_STAT_P99,
+    PACER_STAT_MAX
+};
+
+/* current time of the pacer's monotonic clock, in nanoseconds */
+int64_t pacer_time_ns(void);
+
+/* create and destroy the lock guarding the history, at CoreStartup/CoreShutdown */
+void pacer_startup(void);
+void pacer_shutdown(void);
+
+/* clear deadline and frame time history, at emulation start */
+void pacer_init(void);
+/* resynchronize the next deadline, after a pause */
+void pacer_reset(void);
+
+/* Wait for the next frame deadline, frame_ns after the previous one.
+ * When limit is 0, frame times are only recorded. */
+void pacer_wait(int64_t frame_ns, int limit);
+
+/* Frame time statistics over the last PACER_HISTORY_SIZE frames, in microseconds */
+int pacer_get_stat(enum pacer_stat stat);
+
+#endif
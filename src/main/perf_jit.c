@@ -0,0 +1,265 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - perf_jit.c                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "perf_jit.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+
+enum perf_jit_mode g_perf_jit_mode = PERF_JIT_DISABLED;
+
+#if defined(__linux__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <time.h>
+  #include <unistd.h>
+
+/* see tools/perf/Documentation/jitdump-specification.txt in the Linux sources */
+enum
+{
+    JITDUMP_MAGIC = 0x4A695444,
+    JITDUMP_VERSION = 1,
+    JIT_CODE_LOAD = 0,
+    JIT_CODE_CLOSE = 3
+};
+
+struct jitdump_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+struct jitdump_record_header
+{
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+};
+
+struct jitdump_code_load
+{
+    struct jitdump_record_header header;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+    /* followed by the NUL terminated name and the code bytes */
+};
+
+#if defined(__x86_64__)
+  #define JITDUMP_ELF_MACH 62   /* EM_X86_64 */
+#elif defined(__i386__)
+  #define JITDUMP_ELF_MACH 3    /* EM_386 */
+#elif defined(__aarch64__)
+  #define JITDUMP_ELF_MACH 183  /* EM_AARCH64 */
+#elif defined(__arm__)
+  #define JITDUMP_ELF_MACH 40   /* EM_ARM */
+#else
+  #define JITDUMP_ELF_MACH 0
+#endif
+
+static FILE* l_file = NULL;
+static void* l_marker = NULL;
+static size_t l_marker_size = 0;
+static uint64_t l_code_index = 0;
+
+/* perf has to be told to use the same clock with "perf record -k mono" */
+static uint64_t jitdump_timestamp(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int open_perf_map(void)
+{
+    char path[64];
+
+    snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+    l_file = fopen(path, "w");
+    if (l_file == NULL) {
+        DebugMessage(M64MSG_ERROR, "Couldn't open perf map file %s", path);
+        return -1;
+    }
+
+    DebugMessage(M64MSG_INFO, "Writing recompiled code symbols to %s", path);
+    return 0;
+}
+
+static int open_jitdump(void)
+{
+    struct jitdump_header header;
+    char path[64];
+    int fd;
+
+    snprintf(path, sizeof(path), "/tmp/jit-%d.dump", (int)getpid());
+    fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0666);
+    if (fd < 0) {
+        DebugMessage(M64MSG_ERROR, "Couldn't open jitdump file %s", path);
+        return -1;
+    }
+
+    /* perf record finds the dump through an executable mapping of it */
+    l_marker_size = (size_t)sysconf(_SC_PAGESIZE);
+    l_marker = mmap(NULL, l_marker_size, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+    if (l_marker == MAP_FAILED) {
+        DebugMessage(M64MSG_ERROR, "Couldn't map jitdump file %s", path);
+        l_marker = NULL;
+        close(fd);
+        return -1;
+    }
+
+    l_file = fdopen(fd, "wb");
+    if (l_file == NULL) {
+        munmap(l_marker, l_marker_size);
+        l_marker = NULL;
+        close(fd);
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = JITDUMP_MAGIC;
+    header.version = JITDUMP_VERSION;
+    header.total_size = sizeof(header);
+    header.elf_mach = JITDUMP_ELF_MACH;
+    header.pid = (uint32_t)getpid();
+    header.timestamp = jitdump_timestamp();
+    fwrite(&header, sizeof(header), 1, l_file);
+
+    l_code_index = 0;
+    DebugMessage(M64MSG_INFO, "Writing recompiled code to %s", path);
+    return 0;
+}
+
+int perf_jit_open(enum perf_jit_mode mode)
+{
+    int err = 0;
+
+    perf_jit_close();
+
+    switch (mode)
+    {
+    case PERF_JIT_MAP:
+        err = open_perf_map();
+        break;
+    case PERF_JIT_DUMP:
+        err = open_jitdump();
+        break;
+    default:
+        break;
+    }
+
+    g_perf_jit_mode = (err == 0) ? mode : PERF_JIT_DISABLED;
+    return err;
+}
+
+void perf_jit_close(void)
+{
+    if (l_file != NULL) {
+        if (g_perf_jit_mode == PERF_JIT_DUMP) {
+            struct jitdump_record_header record;
+            record.id = JIT_CODE_CLOSE;
+            record.total_size = sizeof(record);
+            record.timestamp = jitdump_timestamp();
+            fwrite(&record, sizeof(record), 1, l_file);
+        }
+        fclose(l_file);
+        l_file = NULL;
+    }
+
+    if (l_marker != NULL) {
+        munmap(l_marker, l_marker_size);
+        l_marker = NULL;
+    }
+
+    g_perf_jit_mode = PERF_JIT_DISABLED;
+}
+
+void perf_jit_code_load(const void* code, size_t size, const char* kind, uint32_t guest_start, uint32_t guest_end)
+{
+    char name[64];
+
+    if (l_file == NULL || size == 0) {
+        return;
+    }
+
+    snprintf(name, sizeof(name), "%s %08X-%08X", kind, guest_start, guest_end);
+
+    if (g_perf_jit_mode == PERF_JIT_MAP) {
+        fprintf(l_file, "%lx %zx %s\n", (unsigned long)(uintptr_t)code, size, name);
+    }
+    else {
+        struct jitdump_code_load record;
+        size_t name_size = strlen(name) + 1;
+
+        record.header.id = JIT_CODE_LOAD;
+        record.header.total_size = (uint32_t)(sizeof(record) + name_size + size);
+        record.header.timestamp = jitdump_timestamp();
+        record.pid = (uint32_t)getpid();
+        record.tid = (uint32_t)syscall(SYS_gettid);
+        record.vma = (uint64_t)(uintptr_t)code;
+        record.code_addr = (uint64_t)(uintptr_t)code;
+        record.code_size = size;
+        record.code_index = l_code_index++;
+
+        fwrite(&record, sizeof(record), 1, l_file);
+        fwrite(name, 1, name_size, l_file);
+        fwrite(code, 1, size, l_file);
+    }
+}
+
+#else  /* Not linux */
+
+int perf_jit_open(enum perf_jit_mode mode)
+{
+    if (mode != PERF_JIT_DISABLED) {
+        DebugMessage(M64MSG_WARNING, "perf symbols for recompiled code are only supported on Linux");
+    }
+    g_perf_jit_mode = PERF_JIT_DISABLED;
+    return (mode == PERF_JIT_DISABLED) ? 0 : -1;
+}
+
+void perf_jit_close(void)
+{
+}
+
+void perf_jit_code_load(const void* code, size_t size, const char* kind, uint32_t guest_start, uint32_t guest_end)
+{
+    (void)code;
+    (void)size;
+    (void)kind;
+    (void)guest_start;
+    (void)guest_end;
+}
+
+#endif
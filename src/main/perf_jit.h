@@ -0,0 +1,56 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - perf_jit.h                                              *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_PERF_JIT_H
+#define M64P_MAIN_PERF_JIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "osal/preproc.h"
+
+/* Symbols of the recompiled code for the Linux perf tool.
+ * PERF_JIT_MAP appends "<host address> <size> <name>" lines to /tmp/perf-<pid>.map,
+ * which perf reads when reporting. PERF_JIT_DUMP writes /tmp/jit-<pid>.dump in the
+ * jitdump format, where each record is timestamped so that code written over
+ * invalidated or flushed blocks is attributed correctly. */
+enum perf_jit_mode
+{
+    PERF_JIT_DISABLED,
+    PERF_JIT_MAP,
+    PERF_JIT_DUMP
+};
+
+extern enum perf_jit_mode g_perf_jit_mode;
+
+int perf_jit_open(enum perf_jit_mode mode);
+void perf_jit_close(void);
+
+/* Records size bytes of host code at code, which implement the guest
+ * instructions in [guest_start, guest_end). */
+void perf_jit_code_load(const void* code, size_t size, const char* kind, uint32_t guest_start, uint32_t guest_end);
+
+static osal_inline int perf_jit_enabled(void)
+{
+    return g_perf_jit_mode != PERF_JIT_DISABLED;
+}
+
+#endif
@@ -0,0 +1,328 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rewind.c                                                *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#include "rewind.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "main/main.h"
+#include "main/savestates.h"
+
+enum { REWIND_PAGE_SIZE = 0x1000 };
+enum { REWIND_PAGES_COUNT = (SAVESTATE_M64P_SIZE + REWIND_PAGE_SIZE - 1) / REWIND_PAGE_SIZE };
+
+/* pages lying entirely within the TLB lookup tables of the savestate */
+enum { REWIND_LUT_FIRST_PAGE = (SAVESTATE_M64P_TLB_LUT_OFFSET + REWIND_PAGE_SIZE - 1) / REWIND_PAGE_SIZE };
+enum { REWIND_LUT_END_PAGE = (SAVESTATE_M64P_TLB_LUT_OFFSET + SAVESTATE_M64P_TLB_LUT_SIZE) / REWIND_PAGE_SIZE };
+
+/* every this many snapshots, the whole state is serialized and compared */
+enum { REWIND_KEYFRAME_INTERVAL = 64 };
+
+struct rewind_record
+{
+    size_t pages_count;
+    uint32_t* pages;
+    unsigned char* data;
+};
+
+static struct
+{
+    int enabled;
+    size_t budget;
+    size_t used;
+    unsigned int interval;
+    unsigned int vi_counter;
+    unsigned int keyframe_counter;
+    int have_current;
+
+    /* TLB lookup tables generation held by current and scratch */
+    uint32_t current_lut;
+    uint32_t scratch_lut;
+    int scratch_valid;
+
+    volatile int save_due;
+    volatile unsigned int load_count;
+
+    /* most recent full snapshot and serialization buffer, page rounded */
+    unsigned char* current;
+    unsigned char* scratch;
+    uint32_t* changed;
+
+    /* ring of undo records, oldest at first */
+    struct rewind_record* records;
+    size_t capacity;
+    size_t first;
+    volatile size_t count;
+} l_rewind;
+
+static size_t record_size(const struct rewind_record* record)
+{
+    return sizeof(*record) + record->pages_count * (REWIND_PAGE_SIZE + sizeof(uint32_t));
+}
+
+static void free_record(struct rewind_record* record)
+{
+    l_rewind.used -= record_size(record);
+    free(record->pages);
+    free(record->data);
+    memset(record, 0, sizeof(*record));
+}
+
+static void drop_oldest(void)
+{
+    free_record(&l_rewind.records[l_rewind.first]);
+    l_rewind.first = (l_rewind.first + 1) % l_rewind.capacity;
+    --l_rewind.count;
+}
+
+static void drop_all(void)
+{
+    while (l_rewind.count > 0) {
+        drop_oldest();
+    }
+    l_rewind.first = 0;
+}
+
+int rewind_init(size_t budget, unsigned int interval)
+{
+    size_t buffer_size = (size_t)REWIND_PAGES_COUNT * REWIND_PAGE_SIZE;
+
+    memset(&l_rewind, 0, sizeof(l_rewind));
+
+    if (budget == 0) {
+        return 0;
+    }
+
+    /* every record holds at least one page, which bounds the ring size */
+    l_rewind.capacity = budget / REWIND_PAGE_SIZE + 1;
+    l_rewind.budget = budget;
+    l_rewind.interval = (interval == 0) ? 1 : interval;
+
+    l_rewind.current = calloc(1, buffer_size);
+    l_rewind.scratch = calloc(1, buffer_size);
+    l_rewind.changed = malloc(REWIND_PAGES_COUNT * sizeof(uint32_t));
+    l_rewind.records = calloc(l_rewind.capacity, sizeof(struct rewind_record));
+
+    if (l_rewind.current == NULL || l_rewind.scratch == NULL
+     || l_rewind.changed == NULL || l_rewind.records == NULL) {
+        DebugMessage(M64MSG_ERROR, "Insufficient memory for rewind buffer");
+        rewind_deinit();
+        return -1;
+    }
+
+    l_rewind.enabled = 1;
+    DebugMessage(M64MSG_VERBOSE, "Rewind enabled: %u MB buffer, snapshot every %u VI",
+        (unsigned int)(budget >> 20), l_rewind.interval);
+
+    return 0;
+}
+
+void rewind_deinit(void)
+{
+    if (l_rewind.records != NULL) {
+        drop_all();
+    }
+
+    free(l_rewind.records);
+    free(l_rewind.changed);
+    free(l_rewind.scratch);
+    free(l_rewind.current);
+
+    memset(&l_rewind, 0, sizeof(l_rewind));
+}
+
+void rewind_new_vi(void)
+{
+    if (!l_rewind.enabled) {
+        return;
+    }
+
+    if (++l_rewind.vi_counter >= l_rewind.interval) {
+        l_rewind.vi_counter = 0;
+        l_rewind.save_due = 1;
+    }
+}
+
+int rewind_step_back(unsigned int count)
+{
+    if (!l_rewind.enabled || count == 0) {
+        return 0;
+    }
+
+    l_rewind.load_count = count;
+    return 1;
+}
+
+unsigned int rewind_get_available(void)
+{
+    return (unsigned int)l_rewind.count;
+}
+
+int rewind_load_pending(void)
+{
+    return l_rewind.load_count != 0;
+}
+
+int rewind_save_pending(void)
+{
+    return l_rewind.save_due;
+}
+
+void rewind_save(void)
+{
+    struct rewind_record* record;
+    unsigned char* tmp;
+    size_t i, n = 0;
+    uint32_t lut_generation = g_dev.r4300.cp0.tlb.lut_generation;
+    int keyframe, skip_lut;
+
+    l_rewind.save_due = 0;
+
+    keyframe = (l_rewind.keyframe_counter == 0);
+    if (++l_rewind.keyframe_counter >= REWIND_KEYFRAME_INTERVAL) {
+        l_rewind.keyframe_counter = 0;
+    }
+
+    /* the 8MiB of TLB lookup tables only change on TLB writes,
+     * so they are only serialized and compared when needed */
+    savestates_save_m64p_mem(&g_dev, l_rewind.scratch,
+        keyframe || !l_rewind.scratch_valid || l_rewind.scratch_lut != lut_generation);
+    l_rewind.scratch_valid = 1;
+    l_rewind.scratch_lut = lut_generation;
+
+    if (!l_rewind.have_current) {
+        l_rewind.have_current = 1;
+        l_rewind.scratch_valid = 0;
+        goto swap;
+    }
+
+    skip_lut = !keyframe && l_rewind.current_lut == lut_generation;
+
+    /* find pages which changed since the previous snapshot */
+    for (i = 0; i < REWIND_PAGES_COUNT; ++i) {
+        size_t offset = i * REWIND_PAGE_SIZE;
+        if (skip_lut && i == REWIND_LUT_FIRST_PAGE) {
+            i = REWIND_LUT_END_PAGE - 1;
+            continue;
+        }
+        if (memcmp(l_rewind.current + offset, l_rewind.scratch + offset, REWIND_PAGE_SIZE) != 0) {
+            l_rewind.changed[n++] = (uint32_t)i;
+        }
+    }
+
+    if (n == 0) {
+        return;
+    }
+
+    if (l_rewind.count == l_rewind.capacity) {
+        drop_oldest();
+    }
+
+    record = &l_rewind.records[(l_rewind.first + l_rewind.count) % l_rewind.capacity];
+    record->pages = malloc(n * sizeof(uint32_t));
+    record->data = malloc(n * REWIND_PAGE_SIZE);
+
+    if (record->pages == NULL || record->data == NULL) {
+        DebugMessage(M64MSG_WARNING, "Insufficient memory for rewind snapshot, history dropped");
+        free(record->pages);
+        free(record->data);
+        memset(record, 0, sizeof(*record));
+        drop_all();
+        goto swap;
+    }
+
+    /* keep the previous page contents to undo this snapshot */
+    record->pages_count = n;
+    memcpy(record->pages, l_rewind.changed, n * sizeof(uint32_t));
+    for (i = 0; i < n; ++i) {
+        memcpy(record->data + i * REWIND_PAGE_SIZE,
+               l_rewind.current + (size_t)l_rewind.changed[i] * REWIND_PAGE_SIZE,
+               REWIND_PAGE_SIZE);
+    }
+
+    l_rewind.used += record_size(record);
+    ++l_rewind.count;
+
+    while (l_rewind.used > l_rewind.budget && l_rewind.count > 1) {
+        drop_oldest();
+    }
+
+swap:
+    tmp = l_rewind.current;
+    l_rewind.current = l_rewind.scratch;
+    l_rewind.scratch = tmp;
+    l_rewind.scratch_lut = l_rewind.current_lut;
+    l_rewind.current_lut = lut_generation;
+}
+
+void rewind_load(void)
+{
+    unsigned int count = l_rewind.load_count;
+    unsigned int i;
+    size_t j;
+
+    l_rewind.load_count = 0;
+
+    if (!l_rewind.have_current) {
+        return;
+    }
+
+    if (count > l_rewind.count) {
+        count = (unsigned int)l_rewind.count;
+    }
+
+    /* undo snapshots from the most recent one */
+    for (i = 0; i < count; ++i) {
+        struct rewind_record* record = &l_rewind.records[(l_rewind.first + l_rewind.count - 1) % l_rewind.capacity];
+
+        for (j = 0; j < record->pages_count; ++j) {
+            memcpy(l_rewind.current + (size_t)record->pages[j] * REWIND_PAGE_SIZE,
+                   record->data + j * REWIND_PAGE_SIZE,
+                   REWIND_PAGE_SIZE);
+        }
+
+        free_record(record);
+        --l_rewind.count;
+    }
+
+    /* loading may modify the buffer, so keep current intact */
+    memcpy(l_rewind.scratch, l_rewind.current, SAVESTATE_M64P_SIZE);
+    l_rewind.scratch_valid = 0;
+    l_rewind.vi_counter = 0;
+    l_rewind.save_due = 0;
+
+    if (!savestates_load_m64p_mem(&g_dev, l_rewind.scratch)) {
+        DebugMessage(M64MSG_WARNING, "Could not restore rewind snapshot, history dropped");
+        drop_all();
+        l_rewind.have_current = 0;
+        return;
+    }
+
+    /* the lookup tables were just loaded from current */
+    l_rewind.current_lut = g_dev.r4300.cp0.tlb.lut_generation;
+
+    DebugMessage(M64MSG_VERBOSE, "Rewound %u snapshots, %u available", count, (unsigned int)l_rewind.count);
+}
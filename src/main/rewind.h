@@ -0,0 +1,51 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rewind.h                                                *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_MAIN_REWIND_H
+#define M64P_MAIN_REWIND_H
+
+#include <stddef.h>
+
+/* Rewind keeps an in-memory history of savestates taken every few VIs.
+ * Only the 4KiB pages which differ from the following snapshot are kept,
+ * so that the history holds undo records applied backward from the most
+ * recent full snapshot. Oldest records are dropped to stay within budget.
+ * The TLB lookup tables are only compared after a TLB write, except on
+ * periodic keyframes which compare the whole savestate. */
+
+int rewind_init(size_t budget, unsigned int interval);
+void rewind_deinit(void);
+
+/* called on each VI, arms a snapshot every interval VIs */
+void rewind_new_vi(void);
+
+/* request to go back count snapshots, processed at the next safe point */
+int rewind_step_back(unsigned int count);
+unsigned int rewind_get_available(void);
+
+/* safe point processing (see gen_interrupt) */
+int rewind_load_pending(void);
+int rewind_save_pending(void);
+void rewind_load(void);
+void rewind_save(void);
+
+#endif
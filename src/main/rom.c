@@ -40,12 +40,27 @@
 #include "device/device.h"
 #include "main.h"
 #include "md5.h"
+#include "workqueue.h"
 #include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
 #include "rom.h"
 #include "util.h"
 
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define ROM_SWAP_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define ROM_SWAP_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #include <arm_neon.h>
+  #define ROM_SWAP_NEON
+#endif
+
 #define CHUNKSIZE 1024*128 /* Read files 128KB at a time. */
 
 /* Number of cpu cycles per instruction */
@@ -56,8 +71,10 @@ enum { DEFAULT_DISABLE_EXTRA_MEM = 0 };
 enum { DEFAULT_SI_DMA_DURATION = 0x900 };
 /* Default AI DMA modifier */
 enum { DEFAULT_AI_DMA_MODIFIER = 100 };
+enum { DEFAULT_ASYNC_GFX_TASK = 0 };
 
 static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5);
+static void romdatabase_free_lists(void);
 
 static _romdatabase g_romdatabase;
 
@@ -87,84 +104,479 @@ static int is_valid_rom(const unsigned char *buffer)
         return 0;
 }
 
-/* Copies the source block of memory to the destination block of memory while
- * switching the endianness of .v64 and .n64 images to the .z64 format, which
- * is native to the Nintendo 64. The data extraction routines and MD5 hashing
- * function may only act on the .z64 big-endian format.
- *
- * IN: src: The source block of memory. This must be a valid Nintendo 64 ROM
- *          image of 'len' bytes.
- *     len: The length of the source and destination, in bytes.
- * OUT: dst: The destination block of memory. This must be a valid buffer for
- *           at least 'len' bytes.
- *      imagetype: A pointer to a byte that gets updated with the value of
- *                 V64IMAGE, N64IMAGE or Z64IMAGE according to the format of
- *                 the source block. The value is undefined if 'src' does not
- *                 represent a valid Nintendo 64 ROM image.
- */
-static void swap_copy_rom(void* dst, const void* src, size_t len, unsigned char* imagetype)
-{
-    if (memcmp(src, V64_SIGNATURE, sizeof(V64_SIGNATURE)) == 0)
-    {
-        size_t i;
-        const uint16_t* src16 = (const uint16_t*) src;
-        uint16_t* dst16 = (uint16_t*) dst;
-
-        *imagetype = V64IMAGE;
-        /* .v64 images have byte-swapped half-words (16-bit). */
-        for (i = 0; i < len; i += 2)
+/* Byte order conversions applied to each 32-bit word of an image */
+enum rom_swap_op
+{
+    ROM_SWAP_NONE,
+    ROM_SWAP_BYTES16,       /* swap the bytes of each half-word */
+    ROM_SWAP_HALFWORDS32,   /* swap the half-words of each word */
+    ROM_SWAP_BYTES32        /* reverse the bytes of each word */
+};
+
+/* Conversion from an image format to N64 native (big endian) byte order */
+static enum rom_swap_op rom_swap_to_z64(unsigned char imagetype)
+{
+    switch (imagetype)
+    {
+    case V64IMAGE: return ROM_SWAP_BYTES16;
+    case N64IMAGE: return ROM_SWAP_BYTES32;
+    default:       return ROM_SWAP_NONE;
+    }
+}
+
+/* Conversion from an image format to the order used in memory while emulating,
+ * where each ROM word is stored in host byte order */
+static enum rom_swap_op rom_swap_to_host(unsigned char imagetype)
+{
+#if defined(M64P_BIG_ENDIAN)
+    return rom_swap_to_z64(imagetype);
+#else
+    switch (imagetype)
+    {
+    case V64IMAGE: return ROM_SWAP_HALFWORDS32;
+    case N64IMAGE: return ROM_SWAP_NONE;
+    default:       return ROM_SWAP_BYTES32;
+    }
+#endif
+}
+
+static osal_inline uint32_t rom_swap_word(uint32_t w, enum rom_swap_op op)
+{
+    switch (op)
+    {
+    case ROM_SWAP_BYTES16:     return ((w & 0x00ff00ff) << 8) | ((w >> 8) & 0x00ff00ff);
+    case ROM_SWAP_HALFWORDS32: return (w << 16) | (w >> 16);
+    case ROM_SWAP_BYTES32:     return m64p_swap32(w);
+    default:                   return w;
+    }
+}
+
+/* Copies count 32-bit words from src to dst while applying op.
+ * Neither buffer needs to be aligned. */
+static void swap_copy_words(void* dst, const void* src, size_t count, enum rom_swap_op op)
+{
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    size_t i = 0;
+    uint32_t w;
+
+    if (op == ROM_SWAP_NONE)
+    {
+        memcpy(dst, src, count * 4);
+        return;
+    }
+
+#if defined(ROM_SWAP_AVX2)
+    {
+        const __m256i mask = (op == ROM_SWAP_BYTES16)
+            ? _mm256_setr_epi8(1,0,3,2, 5,4,7,6, 9,8,11,10, 13,12,15,14, 1,0,3,2, 5,4,7,6, 9,8,11,10, 13,12,15,14)
+            : (op == ROM_SWAP_HALFWORDS32)
+            ? _mm256_setr_epi8(2,3,0,1, 6,7,4,5, 10,11,8,9, 14,15,12,13, 2,3,0,1, 6,7,4,5, 10,11,8,9, 14,15,12,13)
+            : _mm256_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12, 3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+
+        for (; i + 8 <= count; i += 8)
         {
-            *dst16++ = m64p_swap16(*src16++);
+            __m256i v = _mm256_loadu_si256((const __m256i*)(s + i * 4));
+            _mm256_storeu_si256((__m256i*)(d + i * 4), _mm256_shuffle_epi8(v, mask));
         }
     }
-    else if (memcmp(src, N64_SIGNATURE, sizeof(N64_SIGNATURE)) == 0)
+#elif defined(ROM_SWAP_SSE2)
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i * 4));
+        if (op != ROM_SWAP_HALFWORDS32)
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        if (op != ROM_SWAP_BYTES16)
+        {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        _mm_storeu_si128((__m128i*)(d + i * 4), v);
+    }
+#elif defined(ROM_SWAP_NEON)
+    for (; i + 4 <= count; i += 4)
+    {
+        uint8x16_t v = vld1q_u8(s + i * 4);
+        if (op == ROM_SWAP_BYTES16)
+            v = vrev16q_u8(v);
+        else if (op == ROM_SWAP_HALFWORDS32)
+            v = vreinterpretq_u8_u16(vrev32q_u16(vreinterpretq_u16_u8(v)));
+        else
+            v = vrev32q_u8(v);
+        vst1q_u8(d + i * 4, v);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        memcpy(&w, s + i * 4, 4);
+        w = rom_swap_word(w, op);
+        memcpy(d + i * 4, &w, 4);
+    }
+}
+
+/* Images are hashed in fixed size chunks, so that the chunks can be converted
+ * and hashed in parallel while giving the same hash on every run. */
+enum { ROM_LOAD_CHUNK_SIZE = 0x100000 };
+
+struct rom_load
+{
+    uint8_t* dst;
+    const uint8_t* src;
+    size_t len;
+    enum rom_swap_op op;
+    uint64_t* chunk_hashes;
+};
+
+static void rom_load_chunk(size_t index, void* opaque)
+{
+    struct rom_load* load = (struct rom_load*)opaque;
+    size_t offset = index * ROM_LOAD_CHUNK_SIZE;
+    size_t len = load->len - offset;
+
+    if (len > ROM_LOAD_CHUNK_SIZE)
+        len = ROM_LOAD_CHUNK_SIZE;
+
+    load->chunk_hashes[index] = XXH3_64bits(load->src + offset, len);
+    if (load->dst != NULL)
+        swap_copy_words(load->dst + offset, load->src + offset, len / 4, load->op);
+}
+
+/* Copies the ROM image to dst in host word order and returns an XXH3 based hash of the
+ * original image. Trailing bytes which don't fill a whole word are stored in N64 byte order.
+ * If dst is NULL, the image is only hashed. */
+static uint64_t load_rom_image(uint8_t* dst, const uint8_t* src, size_t len, unsigned char imagetype)
+{
+    struct rom_load load;
+    size_t chunks = (len + ROM_LOAD_CHUNK_SIZE - 1) / ROM_LOAD_CHUNK_SIZE;
+    size_t i, tail = len & ~(size_t)3;
+    uint64_t hash;
+
+    load.dst = dst;
+    load.src = src;
+    load.len = len;
+    load.op = rom_swap_to_host(imagetype);
+    load.chunk_hashes = (uint64_t*)malloc(chunks * sizeof(uint64_t));
+
+    if (load.chunk_hashes == NULL)
+    {
+        if (dst != NULL)
+            swap_copy_words(dst, src, len / 4, load.op);
+        hash = XXH3_64bits(src, len);
+    }
+    else
     {
-        size_t i;
-        const uint32_t* src32 = (const uint32_t*) src;
-        uint32_t* dst32 = (uint32_t*) dst;
+        workqueue_run_parallel(chunks, rom_load_chunk, &load);
+        hash = XXH3_64bits(load.chunk_hashes, chunks * sizeof(uint64_t));
+        free(load.chunk_hashes);
+    }
+
+    for (i = tail; i < len && dst != NULL; ++i)
+    {
+        size_t j = (imagetype == V64IMAGE) ? (i ^ 1) : (imagetype == N64IMAGE) ? (i ^ 3) : i;
+        dst[i] = (j < len) ? src[j] : 0;
+    }
+
+    return hash;
+}
+
+/* Computes the MD5 of the image in N64 byte order, which is how ROMs are
+ * identified in the ROM database */
+static void rom_md5(md5_byte_t* digest, const uint8_t* src, size_t len, unsigned char imagetype)
+{
+    enum rom_swap_op op = rom_swap_to_z64(imagetype);
+    md5_state_t state;
+    uint8_t* buffer = NULL;
+    size_t offset, n;
+
+    if (op != ROM_SWAP_NONE)
+        buffer = (uint8_t*)malloc(CHUNKSIZE);
 
-        *imagetype = N64IMAGE;
-        /* .n64 images have byte-swapped words (32-bit). */
-        for (i = 0; i < len; i += 4)
+    md5_init(&state);
+    if (buffer == NULL)
+    {
+        md5_append(&state, (const md5_byte_t*)src, len);
+    }
+    else
+    {
+        for (offset = 0; offset < len; offset += n)
         {
-            *dst32++ = m64p_swap32(*src32++);
+            n = (len - offset < CHUNKSIZE) ? len - offset : CHUNKSIZE;
+            swap_copy_words(buffer, src + offset, n / 4, op);
+            memcpy(buffer + (n & ~(size_t)3), src + offset + (n & ~(size_t)3), n & 3);
+            md5_append(&state, (const md5_byte_t*)buffer, n);
         }
+        free(buffer);
     }
-    else {
-        *imagetype = Z64IMAGE;
-        memcpy(dst, src, len);
+    md5_finish(&state, digest);
+}
+
+/* MD5 cache: an append-only list of (image size, image hash) -> MD5 records
+ * in ${UserCachePath}/rommd5.cache */
+#define ROM_MD5_CACHE_FILENAME "rommd5.cache"
+
+struct rom_md5_record
+{
+    uint64_t size;
+    uint64_t hash;
+    md5_byte_t md5[16];
+    uint64_t check;     /* XXH3 of the fields above */
+};
+
+static uint64_t rom_md5_record_check(const struct rom_md5_record* record)
+{
+    return XXH3_64bits(record, offsetof(struct rom_md5_record, check));
+}
+
+static char* rom_md5_cache_path(void)
+{
+    const char* cache_dir = ConfigGetUserCachePath();
+
+    if (cache_dir == NULL)
+        return NULL;
+
+    return formatstr("%s%s", cache_dir, ROM_MD5_CACHE_FILENAME);
+}
+
+static int rom_md5_cache_lookup(uint64_t size, uint64_t hash, md5_byte_t* md5)
+{
+    struct rom_md5_record record;
+    char* path = rom_md5_cache_path();
+    FILE* f;
+    int found = 0;
+
+    if (path == NULL)
+        return 0;
+
+    f = osal_file_open(path, "rb");
+    free(path);
+    if (f == NULL)
+        return 0;
+
+    /* keep looking after a match: a later record supersedes an earlier one */
+    while (fread(&record, sizeof(record), 1, f) == 1)
+    {
+        if (record.size == size && record.hash == hash && record.check == rom_md5_record_check(&record))
+        {
+            memcpy(md5, record.md5, 16);
+            found = 1;
+        }
+    }
+
+    fclose(f);
+    return found;
+}
+
+static void rom_md5_cache_store(uint64_t size, uint64_t hash, const md5_byte_t* md5)
+{
+    struct rom_md5_record record;
+    char* path = rom_md5_cache_path();
+    FILE* f;
+
+    if (path == NULL)
+        return;
+
+    memset(&record, 0, sizeof(record));
+    record.size = size;
+    record.hash = hash;
+    memcpy(record.md5, md5, 16);
+    record.check = rom_md5_record_check(&record);
+
+    f = osal_file_open(path, "ab");
+    if (f == NULL)
+    {
+        DebugMessage(M64MSG_WARNING, "Couldn't open ROM MD5 cache '%s'", path);
+        free(path);
+        return;
     }
+
+    if (fwrite(&record, sizeof(record), 1, f) != 1)
+        DebugMessage(M64MSG_WARNING, "Couldn't write ROM MD5 cache '%s'", path);
+
+    fclose(f);
+    free(path);
 }
 
+/* ROM image cache: ${UserCachePath}/rom/<hash>-<size>.<host order> files hold ROMs in
+ * the word order used while emulating. They are mapped copy-on-write over the cartridge
+ * memory, so that instances running the same ROM share its pages through the page cache.
+ * Windows can't map files over already allocated memory, so it always uses a private copy. */
+#if !defined(WIN32)
+
+#if defined(M64P_BIG_ENDIAN)
+  #define ROM_IMAGE_CACHE_ORDER "be"
+#else
+  #define ROM_IMAGE_CACHE_ORDER "le"
+#endif
+
+/* cartridge memory currently backed by a cached image */
+static uint8_t* l_rom_mapped = NULL;
+static size_t l_rom_mapped_size = 0;
+
+static void unmap_rom_image(void)
+{
+    if (l_rom_mapped == NULL)
+        return;
+
+    osal_file_unmap_at(l_rom_mapped, l_rom_mapped_size);
+    l_rom_mapped = NULL;
+    l_rom_mapped_size = 0;
+}
+
+static int map_rom_image(uint8_t* dst, const char* path, size_t len, const uint8_t* header)
+{
+    if (osal_file_map_at(path, dst, len) != 0)
+        return 0;
+
+    l_rom_mapped = dst;
+    l_rom_mapped_size = len;
+
+    if (memcmp(dst, header, sizeof(m64p_rom_header)) != 0)
+    {
+        DebugMessage(M64MSG_WARNING, "Ignoring mismatched cached ROM image '%s'", path);
+        unmap_rom_image();
+        return 0;
+    }
+
+    DebugMessage(M64MSG_VERBOSE, "Mapped cached ROM image '%s'", path);
+    return 1;
+}
+
+static int store_rom_image(const char* path, const uint8_t* data, size_t len)
+{
+    /* written under a per-process name, then renamed, so that the file
+     * never changes once it is visible (and possibly mapped) */
+    char* tmp_path = formatstr("%s.%ld.tmp", path, (long)getpid());
+    FILE* f;
+    int ok;
+
+    if (tmp_path == NULL)
+        return 0;
+
+    f = osal_file_open(tmp_path, "wb");
+    if (f == NULL)
+    {
+        DebugMessage(M64MSG_WARNING, "Couldn't open ROM image cache file '%s'", tmp_path);
+        free(tmp_path);
+        return 0;
+    }
+
+    ok = (fwrite(data, 1, len, f) == len);
+    ok = (fclose(f) == 0) && ok;
+    ok = ok && (rename(tmp_path, path) == 0);
+    if (!ok)
+    {
+        DebugMessage(M64MSG_WARNING, "Couldn't write ROM image cache file '%s'", path);
+        remove(tmp_path);
+    }
+
+    free(tmp_path);
+    return ok;
+}
+
+/* Same as load_rom_image, but backs dst with a mapping of the cached image when possible,
+ * creating the cache file on first use */
+static uint64_t load_cached_rom_image(uint8_t* dst, const uint8_t* src, size_t len, unsigned char imagetype)
+{
+    uint8_t header[sizeof(m64p_rom_header)];
+    const char* cache_dir = ConfigGetUserCachePath();
+    char* dir;
+    char* path;
+    uint64_t hash;
+
+    /* cartridge memory is only page aligned in the full memory base layout;
+     * 64KB covers the page size of every supported host */
+    if (cache_dir == NULL || ((uintptr_t)dst & 0xffff) != 0)
+        return load_rom_image(dst, src, len, imagetype);
+
+    hash = load_rom_image(NULL, src, len, imagetype);
+    swap_copy_words(header, src, sizeof(header) / 4, rom_swap_to_host(imagetype));
+
+    dir = formatstr("%srom%c", cache_dir, OSAL_DIR_SEPARATORS[0]);
+    path = (dir == NULL) ? NULL
+        : formatstr("%s%016" PRIx64 "-%08x." ROM_IMAGE_CACHE_ORDER, dir, hash, (unsigned int)len);
+    if (path == NULL)
+    {
+        free(dir);
+        load_rom_image(dst, src, len, imagetype);
+        return hash;
+    }
+
+    if (!map_rom_image(dst, path, len, header))
+    {
+        load_rom_image(dst, src, len, imagetype);
+
+        /* once stored, map the file to release the private copy */
+        if (osal_mkdirp(dir, 0700) == 0
+         && store_rom_image(path, dst, len)
+         && !map_rom_image(dst, path, len, header))
+        {
+            /* a failed mapping may have discarded the copy */
+            load_rom_image(dst, src, len, imagetype);
+        }
+    }
+
+    free(path);
+    free(dir);
+    return hash;
+}
+
+#else
+
+static void unmap_rom_image(void)
+{
+}
+
+#endif
+
 m64p_error open_rom(const unsigned char* romimage, unsigned int size)
 {
-    md5_state_t state;
     md5_byte_t digest[16];
     romdatabase_entry* entry;
     char buffer[256];
     unsigned char imagetype;
+    uint64_t hash;
     int i;
 
     /* check input requirements */
-    if (romimage == NULL || !is_valid_rom(romimage))
+    if (romimage == NULL || size < sizeof(m64p_rom_header) || !is_valid_rom(romimage))
     {
         DebugMessage(M64MSG_ERROR, "open_rom(): not a valid ROM image");
         return M64ERR_INPUT_INVALID;
     }
 
-    /* Clear Byte-swapped flag, since ROM is now deleted. */
-    g_RomWordsLittleEndian = 0;
-    /* allocate new buffer for ROM and copy into this buffer */
+    if (memcmp(romimage, V64_SIGNATURE, sizeof(V64_SIGNATURE)) == 0)
+        imagetype = V64IMAGE;
+    else if (memcmp(romimage, N64_SIGNATURE, sizeof(N64_SIGNATURE)) == 0)
+        imagetype = N64IMAGE;
+    else
+        imagetype = Z64IMAGE;
+
+    /* copy the ROM into the cartridge memory, directly in the word order
+     * used while emulating, and hash it at the same time */
+    unmap_rom_image();
     g_rom_size = size;
-    swap_copy_rom((uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM), romimage, size, &imagetype);
-    /* ROM is now in N64 native (big endian) byte order */
+#if !defined(WIN32)
+    if (ConfigGetParamBool(g_CoreConfig, "RomImageCache"))
+        hash = load_cached_rom_image((uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM), romimage, size, imagetype);
+    else
+#endif
+        hash = load_rom_image((uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM), romimage, size, imagetype);
+#if defined(M64P_BIG_ENDIAN)
+    g_RomWordsLittleEndian = 0;
+#else
+    g_RomWordsLittleEndian = 1;
+#endif
 
-    memcpy(&ROM_HEADER, (uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM), sizeof(m64p_rom_header));
+    /* the header is kept in N64 native (big endian) byte order */
+    swap_copy_words(&ROM_HEADER, romimage, sizeof(m64p_rom_header) / 4, rom_swap_to_z64(imagetype));
 
-    /* Calculate MD5 hash  */
-    md5_init(&state);
-    md5_append(&state, (const md5_byte_t*)((uint8_t*)mem_base_u32(g_mem_base, MM_CART_ROM)), g_rom_size);
-    md5_finish(&state, digest);
+    /* The MD5 hash is only computed the first time a given image is loaded */
+    if (!rom_md5_cache_lookup(size, hash, digest))
+    {
+        rom_md5(digest, romimage, size, imagetype);
+        rom_md5_cache_store(size, hash, digest);
+    }
     for ( i = 0; i < 16; ++i )
         sprintf(buffer+i*2, "%02X", digest[i]);
     buffer[32] = '\0';
@@ -196,6 +608,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
         ROM_SETTINGS.sidmaduration = entry->sidmaduration;
         ROM_SETTINGS.aidmamodifier = entry->aidmamodifier;
         ROM_PARAMS.cheats = entry->cheats;
+        ROM_PARAMS.asyncgfxtask = entry->asyncgfxtask;
     }
     else
     {
@@ -212,6 +625,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
         ROM_SETTINGS.sidmaduration = DEFAULT_SI_DMA_DURATION;
         ROM_SETTINGS.aidmamodifier = DEFAULT_AI_DMA_MODIFIER;
         ROM_PARAMS.cheats = NULL;
+        ROM_PARAMS.asyncgfxtask = DEFAULT_ASYNC_GFX_TASK;
 
         /* check if ROM has the Advanced Homebrew ROM Header (see https://n64brew.dev/wiki/ROM_Header) */
         if (ROM_HEADER.Cartridge_ID == 0x4445)
@@ -253,6 +667,7 @@ m64p_error close_rom(void)
 {
     /* Clear Byte-swapped flag, since ROM is now deleted. */
     g_RomWordsLittleEndian = 0;
+    unmap_rom_image();
     DebugMessage(M64MSG_STATUS, "Rom closed.");
 
     return M64ERR_SUCCESS;
@@ -287,8 +702,11 @@ m64p_error open_disk(void)
         goto no_disk;
     }
 
-    /* Try loading regular disk file */
-    if (open_rom_file_storage(fstorage, dd_disk_filename) != file_ok) {
+    /* Try loading regular disk file, mapping full size dumps which are used as is */
+    int opened = (dd_size == MAME_FORMAT_DUMP_SIZE || dd_size == SDK_FORMAT_DUMP_SIZE)
+        ? open_mapped_file_storage(fstorage, dd_disk_filename)
+        : open_rom_file_storage(fstorage, dd_disk_filename);
+    if (opened != file_ok) {
         goto free_fstorage;
     }
 
@@ -333,6 +751,7 @@ m64p_error open_disk(void)
         ROM_SETTINGS.sidmaduration = entry->sidmaduration;
         ROM_SETTINGS.aidmamodifier = entry->aidmamodifier;
         ROM_PARAMS.cheats = entry->cheats;
+        ROM_PARAMS.asyncgfxtask = entry->asyncgfxtask;
     }
     else
     {
@@ -350,6 +769,7 @@ m64p_error open_disk(void)
         ROM_SETTINGS.sidmaduration = DEFAULT_SI_DMA_DURATION;
         ROM_SETTINGS.aidmamodifier = DEFAULT_AI_DMA_MODIFIER;
         ROM_PARAMS.cheats = NULL;
+        ROM_PARAMS.asyncgfxtask = DEFAULT_ASYNC_GFX_TASK;
     }
 
     /* set system type */
@@ -553,6 +973,12 @@ static size_t romdatabase_resolve_round(void)
             entry->entry.set_flags |= ROMDATABASE_ENTRY_AIDMAMODIFIER;
         }
 
+        if (!isset_bitmask(entry->entry.set_flags, ROMDATABASE_ENTRY_ASYNCGFXTASK) &&
+            isset_bitmask(ref->set_flags, ROMDATABASE_ENTRY_ASYNCGFXTASK)) {
+            entry->entry.asyncgfxtask = ref->asyncgfxtask;
+            entry->entry.set_flags |= ROMDATABASE_ENTRY_ASYNCGFXTASK;
+        }
+
         free(entry->entry.refmd5);
         entry->entry.refmd5 = NULL;
     }
@@ -575,9 +1001,418 @@ static void romdatabase_resolve(void)
     } while (skipped > 0);
 }
 
+/********************************************************************************************/
+/* Binary ROM database cache */
+
+/* The cache holds the resolved database in a position independent image, so that it can
+ * be mapped as is: a header, two open addressing hash tables (MD5 and CRC) of entry
+ * indices + 1, the fixed size entries and a pool of NUL terminated strings.
+ * It is keyed on a hash of the whole ini file and rebuilt whenever that file changes. */
+
+#define ROMDB_CACHE_FILENAME "romdatabase.cache"
+static const char romdb_cache_magic[8] = "M64PRDB";
+enum { ROMDB_CACHE_VERSION = 2 };
+enum { ROMDB_CACHE_ENDIAN = 0x01020304 };
+
+struct romdb_cache_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t ini_hash;
+    uint64_t ini_size;
+    uint32_t entry_count;
+    uint32_t md5_slots;     /* power of two */
+    uint32_t crc_slots;     /* power of two */
+    uint32_t strings_size;
+    /* offsets from the start of the image */
+    uint32_t md5_index;
+    uint32_t crc_index;
+    uint32_t entries;
+    uint32_t strings;
+    uint32_t image_size;
+    uint32_t reserved;
+};
+
+struct romdb_cache_entry
+{
+    md5_byte_t md5[16];
+    uint32_t goodname;      /* offset in the string pool + 1, 0 if NULL */
+    uint32_t cheats;        /* offset in the string pool + 1, 0 if NULL */
+    uint32_t crc1;
+    uint32_t crc2;
+    uint32_t sidmaduration;
+    uint32_t aidmamodifier;
+    uint32_t asyncgfxtask;
+    uint32_t set_flags;
+    uint8_t status;
+    uint8_t savetype;
+    uint8_t players;
+    uint8_t rumble;
+    uint8_t countperop;
+    uint8_t disableextramem;
+    uint8_t transferpak;
+    uint8_t mempak;
+    uint8_t biopak;
+    uint8_t padding[3];
+};
+
+static uint32_t romdb_md5_hash(const md5_byte_t* md5)
+{
+    return (uint32_t)md5[0] | ((uint32_t)md5[1] << 8) | ((uint32_t)md5[2] << 16) | ((uint32_t)md5[3] << 24);
+}
+
+static uint32_t romdb_crc_hash(uint32_t crc1, uint32_t crc2)
+{
+    return crc1 ^ (crc2 * 0x9e3779b1u);
+}
+
+static const struct romdb_cache_header* romdb_header(void)
+{
+    return (const struct romdb_cache_header*)g_romdatabase.image;
+}
+
+static const uint32_t* romdb_md5_index(void)
+{
+    return (const uint32_t*)(g_romdatabase.image + romdb_header()->md5_index);
+}
+
+static const uint32_t* romdb_crc_index(void)
+{
+    return (const uint32_t*)(g_romdatabase.image + romdb_header()->crc_index);
+}
+
+static const struct romdb_cache_entry* romdb_cache_entries(void)
+{
+    return (const struct romdb_cache_entry*)(g_romdatabase.image + romdb_header()->entries);
+}
+
+static char* romdb_string(uint32_t ref)
+{
+    const struct romdb_cache_header* header = romdb_header();
+
+    if (ref == 0 || ref > header->strings_size)
+        return NULL;
+
+    return (char*)(g_romdatabase.image + header->strings + ref - 1);
+}
+
+static uint32_t romdb_add_string(char* strings, uint32_t* strings_used, const char* s)
+{
+    uint32_t ref;
+    size_t len;
+
+    if (s == NULL)
+        return 0;
+
+    len = strlen(s) + 1;
+    ref = *strings_used + 1;
+    memcpy(strings + *strings_used, s, len);
+    *strings_used += (uint32_t)len;
+
+    return ref;
+}
+
+static uint32_t romdb_slots_for(uint32_t count)
+{
+    uint32_t slots = 16;
+
+    /* keep the load factor at or below 1/2 */
+    while (slots < 2 * count)
+        slots <<= 1;
+
+    return slots;
+}
+
+/* Build the image from the parsed (and resolved) entry list */
+static unsigned char* romdatabase_build_image(uint64_t ini_hash, uint64_t ini_size, size_t* image_size)
+{
+    romdatabase_search* search;
+    struct romdb_cache_header* header;
+    struct romdb_cache_entry* entries;
+    uint32_t *md5_index, *crc_index;
+    unsigned char* image;
+    char* strings;
+    uint32_t count = 0, strings_used = 0, slot;
+    size_t strings_size = 0, size;
+    int i;
+
+    for (search = g_romdatabase.list; search != NULL; search = search->next_entry)
+    {
+        search->index = count++;
+        if (search->entry.goodname != NULL)
+            strings_size += strlen(search->entry.goodname) + 1;
+        if (search->entry.cheats != NULL)
+            strings_size += strlen(search->entry.cheats) + 1;
+    }
+
+    size = sizeof(*header)
+         + 2 * (size_t)romdb_slots_for(count) * sizeof(uint32_t)
+         + (size_t)count * sizeof(*entries)
+         + strings_size;
+    if (size > UINT32_MAX)
+        return NULL;
+
+    image = calloc(1, size);
+    if (image == NULL)
+        return NULL;
+
+    header = (struct romdb_cache_header*)image;
+    memcpy(header->magic, romdb_cache_magic, sizeof(header->magic));
+    header->version = ROMDB_CACHE_VERSION;
+    header->endian = ROMDB_CACHE_ENDIAN;
+    header->ini_hash = ini_hash;
+    header->ini_size = ini_size;
+    header->entry_count = count;
+    header->md5_slots = romdb_slots_for(count);
+    header->crc_slots = romdb_slots_for(count);
+    header->strings_size = (uint32_t)strings_size;
+    header->md5_index = sizeof(*header);
+    header->crc_index = header->md5_index + header->md5_slots * sizeof(uint32_t);
+    header->entries = header->crc_index + header->crc_slots * sizeof(uint32_t);
+    header->strings = header->entries + count * sizeof(*entries);
+    header->image_size = (uint32_t)size;
+
+    md5_index = (uint32_t*)(image + header->md5_index);
+    crc_index = (uint32_t*)(image + header->crc_index);
+    entries = (struct romdb_cache_entry*)(image + header->entries);
+    strings = (char*)(image + header->strings);
+
+    for (search = g_romdatabase.list; search != NULL; search = search->next_entry)
+    {
+        const romdatabase_entry* src = &search->entry;
+        struct romdb_cache_entry* dst = &entries[search->index];
+
+        memcpy(dst->md5, src->md5, 16);
+        dst->goodname = romdb_add_string(strings, &strings_used, src->goodname);
+        dst->cheats = romdb_add_string(strings, &strings_used, src->cheats);
+        dst->crc1 = src->crc1;
+        dst->crc2 = src->crc2;
+        dst->sidmaduration = src->sidmaduration;
+        dst->aidmamodifier = src->aidmamodifier;
+        dst->asyncgfxtask = src->asyncgfxtask;
+        dst->set_flags = src->set_flags;
+        dst->status = src->status;
+        dst->savetype = src->savetype;
+        dst->players = src->players;
+        dst->rumble = src->rumble;
+        dst->countperop = src->countperop;
+        dst->disableextramem = src->disableextramem;
+        dst->transferpak = src->transferpak;
+        dst->mempak = src->mempak;
+        dst->biopak = src->biopak;
+
+        /* later sections replace earlier ones with the same MD5, as with the ini lists */
+        slot = romdb_md5_hash(src->md5) & (header->md5_slots - 1);
+        while (md5_index[slot] != 0 && memcmp(entries[md5_index[slot] - 1].md5, src->md5, 16) != 0)
+            slot = (slot + 1) & (header->md5_slots - 1);
+        md5_index[slot] = search->index + 1;
+    }
+
+    /* only entries with their own CRC line are indexed by CRC */
+    for (i = 0; i < 256; ++i)
+    {
+        for (search = g_romdatabase.crc_lists[i]; search != NULL; search = search->next_crc)
+        {
+            slot = romdb_crc_hash(search->entry.crc1, search->entry.crc2) & (header->crc_slots - 1);
+            while (crc_index[slot] != 0)
+                slot = (slot + 1) & (header->crc_slots - 1);
+            crc_index[slot] = search->index + 1;
+        }
+    }
+
+    *image_size = size;
+    return image;
+}
+
+static int romdatabase_check_image(const unsigned char* image, size_t size, uint64_t ini_hash, uint64_t ini_size)
+{
+    const struct romdb_cache_header* header = (const struct romdb_cache_header*)image;
+    uint64_t entries_end;
+
+    if (size < sizeof(*header)
+     || memcmp(header->magic, romdb_cache_magic, sizeof(header->magic)) != 0
+     || header->version != ROMDB_CACHE_VERSION
+     || header->endian != ROMDB_CACHE_ENDIAN
+     || header->ini_hash != ini_hash
+     || header->ini_size != ini_size
+     || header->image_size != size)
+        return 0;
+
+    if (header->md5_slots == 0 || (header->md5_slots & (header->md5_slots - 1)) != 0
+     || header->crc_slots == 0 || (header->crc_slots & (header->crc_slots - 1)) != 0
+     || header->md5_slots <= header->entry_count || header->crc_slots <= header->entry_count)
+        return 0;
+
+    entries_end = (uint64_t)header->entries + (uint64_t)header->entry_count * sizeof(struct romdb_cache_entry);
+    if (header->md5_index != sizeof(*header)
+     || (uint64_t)header->crc_index != (uint64_t)header->md5_index + (uint64_t)header->md5_slots * sizeof(uint32_t)
+     || (uint64_t)header->entries != (uint64_t)header->crc_index + (uint64_t)header->crc_slots * sizeof(uint32_t)
+     || (uint64_t)header->strings != entries_end
+     || (uint64_t)header->strings + header->strings_size != size)
+        return 0;
+
+    /* every string must be terminated within the pool */
+    if (header->strings_size != 0 && image[size - 1] != '\0')
+        return 0;
+
+    return 1;
+}
+
+static int romdatabase_use_image(unsigned char* image, size_t size, int mapped)
+{
+    uint32_t count = ((const struct romdb_cache_header*)image)->entry_count;
+
+    g_romdatabase.entries = calloc(count ? count : 1, sizeof(romdatabase_entry));
+    g_romdatabase.entries_loaded = calloc(count ? count : 1, 1);
+    if (g_romdatabase.entries == NULL || g_romdatabase.entries_loaded == NULL)
+    {
+        free(g_romdatabase.entries);
+        free(g_romdatabase.entries_loaded);
+        g_romdatabase.entries = NULL;
+        g_romdatabase.entries_loaded = NULL;
+        return 0;
+    }
+
+    g_romdatabase.image = image;
+    g_romdatabase.image_size = size;
+    g_romdatabase.image_mapped = mapped;
+    return 1;
+}
+
+static void romdatabase_release_image(void)
+{
+    if (g_romdatabase.image_mapped)
+        osal_file_unmap(g_romdatabase.image, g_romdatabase.image_size);
+    else
+        free(g_romdatabase.image);
+
+    free(g_romdatabase.entries);
+    free(g_romdatabase.entries_loaded);
+
+    g_romdatabase.image = NULL;
+    g_romdatabase.image_size = 0;
+    g_romdatabase.image_mapped = 0;
+    g_romdatabase.entries = NULL;
+    g_romdatabase.entries_loaded = NULL;
+}
+
+static int romdatabase_load_cache(const char* cache_path, uint64_t ini_hash, uint64_t ini_size)
+{
+    size_t size = 0;
+    unsigned char* image = osal_file_map(cache_path, &size);
+
+    if (image == NULL)
+        return 0;
+
+    if (!romdatabase_check_image(image, size, ini_hash, ini_size) || !romdatabase_use_image(image, size, 1))
+    {
+        osal_file_unmap(image, size);
+        return 0;
+    }
+
+    return 1;
+}
+
+static void romdatabase_save_cache(const char* cache_path, const unsigned char* image, size_t size)
+{
+    FILE* f;
+    char* tmp_path = formatstr("%s.tmp", cache_path);
+
+    if (tmp_path == NULL)
+        return;
+
+    f = osal_file_open(tmp_path, "wb");
+    if (f == NULL)
+    {
+        DebugMessage(M64MSG_WARNING, "Couldn't create ROM database cache '%s'", tmp_path);
+        free(tmp_path);
+        return;
+    }
+
+    if (fwrite(image, 1, size, f) != size)
+    {
+        DebugMessage(M64MSG_WARNING, "Couldn't write ROM database cache '%s'", tmp_path);
+        fclose(f);
+        remove(tmp_path);
+        free(tmp_path);
+        return;
+    }
+    fclose(f);
+
+    /* replace the old cache atomically, so that concurrent core instances never see a partial file */
+    if (rename(tmp_path, cache_path) != 0)
+    {
+        remove(cache_path);
+        if (rename(tmp_path, cache_path) != 0)
+            remove(tmp_path);
+    }
+
+    free(tmp_path);
+}
+
+static romdatabase_entry* romdatabase_get_entry(uint32_t index)
+{
+    romdatabase_entry* entry = &g_romdatabase.entries[index];
+
+    if (!g_romdatabase.entries_loaded[index])
+    {
+        const struct romdb_cache_entry* src = &romdb_cache_entries()[index];
+
+        memcpy(entry->md5, src->md5, 16);
+        entry->goodname = romdb_string(src->goodname);
+        entry->refmd5 = NULL;
+        entry->cheats = romdb_string(src->cheats);
+        entry->crc1 = src->crc1;
+        entry->crc2 = src->crc2;
+        entry->status = src->status;
+        entry->savetype = src->savetype;
+        entry->players = src->players;
+        entry->rumble = src->rumble;
+        entry->countperop = src->countperop;
+        entry->disableextramem = src->disableextramem;
+        entry->transferpak = src->transferpak;
+        entry->mempak = src->mempak;
+        entry->biopak = src->biopak;
+        entry->sidmaduration = src->sidmaduration;
+        entry->aidmamodifier = src->aidmamodifier;
+        entry->asyncgfxtask = src->asyncgfxtask;
+        entry->set_flags = src->set_flags;
+
+        g_romdatabase.entries_loaded[index] = 1;
+    }
+
+    return entry;
+}
+
 /********************************************************************************************/
 /* INI Rom database functions */
 
+/* Hash the whole ini file, which is much cheaper than parsing it */
+static int romdatabase_hash_file(FILE* fPtr, uint64_t* hash, uint64_t* size)
+{
+    XXH3_state_t* state = XXH3_createState();
+    char* buffer = malloc(CHUNKSIZE);
+    size_t len;
+    int ok = (state != NULL && buffer != NULL && XXH3_64bits_reset(state) == XXH_OK);
+
+    *size = 0;
+    while (ok && (len = fread(buffer, 1, CHUNKSIZE, fPtr)) > 0)
+    {
+        XXH3_64bits_update(state, buffer, len);
+        *size += len;
+    }
+    ok = ok && !ferror(fPtr);
+
+    if (ok)
+        *hash = XXH3_64bits_digest(state);
+
+    free(buffer);
+    XXH3_freeState(state);
+    rewind(fPtr);
+    return ok;
+}
+
 void romdatabase_open(void)
 {
     FILE *fPtr;
@@ -587,6 +1422,12 @@ void romdatabase_open(void)
 
     int counter, value, lineno;
     unsigned char index;
+    uint64_t ini_hash = 0, ini_size = 0;
+    int have_hash;
+    char *cache_path = NULL;
+    const char *cache_dir;
+    unsigned char *image;
+    size_t image_size;
     const char *pathname = ConfigGetSharedDataFilepath("mupen64plus.ini");
 
     if(g_romdatabase.have_database)
@@ -602,12 +1443,28 @@ void romdatabase_open(void)
     g_romdatabase.have_database = 1;
 
     /* Clear premade indices. */
-    for(counter = 0; counter < 255; ++counter)
+    for(counter = 0; counter < 256; ++counter)
         g_romdatabase.crc_lists[counter] = NULL;
-    for(counter = 0; counter < 255; ++counter)
+    for(counter = 0; counter < 256; ++counter)
         g_romdatabase.md5_lists[counter] = NULL;
     g_romdatabase.list = NULL;
 
+    /* Use the binary cache if it was built from the same ini file */
+    have_hash = romdatabase_hash_file(fPtr, &ini_hash, &ini_size);
+    cache_dir = ConfigGetUserCachePath();
+    if (have_hash && cache_dir != NULL)
+    {
+        cache_path = formatstr("%s%s", cache_dir, ROMDB_CACHE_FILENAME);
+        if (cache_path != NULL && romdatabase_load_cache(cache_path, ini_hash, ini_size))
+        {
+            DebugMessage(M64MSG_VERBOSE, "ROM Database: loaded %u entries from cache '%s'",
+                         romdb_header()->entry_count, cache_path);
+            free(cache_path);
+            fclose(fPtr);
+            return;
+        }
+    }
+
     next_search = &g_romdatabase.list;
 
     /* Parse ROM database file */
@@ -650,6 +1507,7 @@ void romdatabase_open(void)
             search->entry.biopak = 0;
             search->entry.sidmaduration = DEFAULT_SI_DMA_DURATION;
             search->entry.aidmamodifier = DEFAULT_AI_DMA_MODIFIER;
+            search->entry.asyncgfxtask = DEFAULT_ASYNC_GFX_TASK;
             search->entry.set_flags = ROMDATABASE_ENTRY_NONE;
 
             search->next_entry = NULL;
@@ -855,6 +1713,15 @@ void romdatabase_open(void)
                     DebugMessage(M64MSG_WARNING, "ROM Database: Invalid AiDmaModifier on line %i", lineno);
                 }
             }
+            else if(!strcmp(l.name, "AsyncGfxTask"))
+            {
+                if (string_to_int(l.value, &value) && value >= 0 && value <= 0x100000) {
+                    search->entry.asyncgfxtask = value;
+                    search->entry.set_flags |= ROMDATABASE_ENTRY_ASYNCGFXTASK;
+                } else {
+                    DebugMessage(M64MSG_WARNING, "ROM Database: Invalid AsyncGfxTask on line %i", lineno);
+                }
+            }
             else
             {
                 DebugMessage(M64MSG_WARNING, "ROM Database: Unknown property on line %i", lineno);
@@ -867,6 +1734,21 @@ void romdatabase_open(void)
 
     fclose(fPtr);
     romdatabase_resolve();
+
+    /* Switch to the compiled image and cache it for the next startup */
+    image = romdatabase_build_image(ini_hash, ini_size, &image_size);
+    if (image != NULL)
+    {
+        if (have_hash && cache_path != NULL)
+            romdatabase_save_cache(cache_path, image, image_size);
+
+        if (romdatabase_use_image(image, image_size, 0))
+            romdatabase_free_lists();
+        else
+            free(image);
+    }
+
+    free(cache_path);
 }
 
 void romdatabase_close(void)
@@ -874,6 +1756,16 @@ void romdatabase_close(void)
     if (!g_romdatabase.have_database)
         return;
 
+    romdatabase_free_lists();
+    romdatabase_release_image();
+
+    g_romdatabase.have_database = 0;
+}
+
+static void romdatabase_free_lists(void)
+{
+    int i;
+
     while (g_romdatabase.list != NULL)
         {
         romdatabase_search* search = g_romdatabase.list->next_entry;
@@ -886,7 +1778,11 @@ void romdatabase_close(void)
         g_romdatabase.list = search;
         }
 
-    g_romdatabase.have_database = 0;
+    for (i = 0; i < 256; ++i)
+    {
+        g_romdatabase.crc_lists[i] = NULL;
+        g_romdatabase.md5_lists[i] = NULL;
+    }
 }
 
 static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5)
@@ -896,6 +1792,26 @@ static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5)
     if(!g_romdatabase.have_database)
         return NULL;
 
+    if (g_romdatabase.image != NULL)
+    {
+        const struct romdb_cache_header* header = romdb_header();
+        const uint32_t* md5_index = romdb_md5_index();
+        uint32_t slot = romdb_md5_hash(md5) & (header->md5_slots - 1);
+        uint32_t probes, ref;
+
+        for (probes = 0; probes < header->md5_slots; ++probes)
+        {
+            ref = md5_index[slot];
+            if (ref == 0 || ref > header->entry_count)
+                return NULL;
+            if (memcmp(romdb_cache_entries()[ref - 1].md5, md5, 16) == 0)
+                return romdatabase_get_entry(ref - 1);
+            slot = (slot + 1) & (header->md5_slots - 1);
+        }
+
+        return NULL;
+    }
+
     search = g_romdatabase.md5_lists[md5[0]];
 
     while (search != NULL && memcmp(search->entry.md5, md5, 16) != 0)
@@ -915,11 +1831,35 @@ romdatabase_entry* ini_search_by_crc(unsigned int crc1, unsigned int crc2)
     if(!g_romdatabase.have_database) 
         return NULL;
 
-    search = g_romdatabase.crc_lists[((crc1 >> 24) & 0xff)];
-
     // because CRCs can be ambiguous (there can be multiple database entries with the same CRC),
     // we will prefer MD5 hashes instead. If the given CRC matches more than one entry in the
     // database, we will return no match.
+    if (g_romdatabase.image != NULL)
+    {
+        const struct romdb_cache_header* header = romdb_header();
+        const uint32_t* crc_index = romdb_crc_index();
+        uint32_t slot = romdb_crc_hash(crc1, crc2) & (header->crc_slots - 1);
+        uint32_t probes, ref, found = 0;
+
+        for (probes = 0; probes < header->crc_slots; ++probes)
+        {
+            ref = crc_index[slot];
+            if (ref == 0 || ref > header->entry_count)
+                break;
+            if (romdb_cache_entries()[ref - 1].crc1 == crc1 && romdb_cache_entries()[ref - 1].crc2 == crc2)
+            {
+                if (found != 0)
+                    return NULL;
+                found = ref;
+            }
+            slot = (slot + 1) & (header->crc_slots - 1);
+        }
+
+        return (found != 0) ? romdatabase_get_entry(found - 1) : NULL;
+    }
+
+    search = g_romdatabase.crc_lists[((crc1 >> 24) & 0xff)];
+
     while (search != NULL)
     {
         if (search->entry.crc1 == crc1 && search->entry.crc2 == crc2)
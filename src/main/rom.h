@@ -51,6 +51,7 @@ typedef struct _rom_params
    char *cheats;
    m64p_system_type systemtype;
    char headername[21];  /* ROM Name as in the header, removing trailing whitespace */
+   unsigned int asyncgfxtask; /* SP_INT delay of threaded graphics tasks, 0 to run them inline */
 } rom_params;
 
 extern m64p_rom_header   ROM_HEADER;
@@ -117,6 +118,7 @@ typedef struct
    unsigned char biopak; /* 0 - No, 1 - Yes boolean for biopak support. */
    unsigned int sidmaduration;
    unsigned int aidmamodifier;
+   unsigned int asyncgfxtask;
    uint32_t set_flags;
 } romdatabase_entry;
 
@@ -135,6 +137,7 @@ typedef struct
 #define ROMDATABASE_ENTRY_BIOPAK        BIT(11)
 #define ROMDATABASE_ENTRY_SIDMADURATION BIT(12)
 #define ROMDATABASE_ENTRY_AIDMAMODIFIER BIT(13)
+#define ROMDATABASE_ENTRY_ASYNCGFXTASK  BIT(14)
 
 typedef struct _romdatabase_search
 {
@@ -142,14 +145,23 @@ typedef struct _romdatabase_search
     struct _romdatabase_search* next_entry;
     struct _romdatabase_search* next_crc;
     struct _romdatabase_search* next_md5;
+    unsigned int index;
 } romdatabase_search;
 
 typedef struct
 {
     int have_database;
+    /* only used while the ini file is parsed, or if the image can't be built */
     romdatabase_search* crc_lists[256];
     romdatabase_search* md5_lists[256];
     romdatabase_search* list;
+    /* compiled database, mapped from the cache file or built from the ini file.
+     * Entries are expanded from the image on first lookup. */
+    unsigned char* image;
+    size_t image_size;
+    int image_mapped;
+    romdatabase_entry* entries;
+    unsigned char* entries_loaded;
 } _romdatabase;
 
 void romdatabase_open(void);
@@ -0,0 +1,222 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rsp_thread.c                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "rsp_thread.h"
+
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "api/callbacks.h"
+#include "api/m64p_types.h"
+#include "main/benchmark.h"
+
+int g_rsp_thread_busy;
+
+static struct
+{
+    SDL_Thread* thread;
+    SDL_mutex* lock;
+    SDL_cond* work_avail;
+    SDL_cond* work_done;
+
+    /* protected by lock */
+    void (*run)(void*);
+    void* opaque;
+    int pending;
+    int quit;
+    long long int task_ns;
+
+    /* emulation thread only */
+    void (*finish)(void*);
+    uint64_t tasks;
+    uint64_t stalls;
+    long long int total_task_ns;
+    long long int total_wait_ns;
+} l_rsp_thread;
+
+static int rsp_thread_main(void* data)
+{
+    (void)data;
+
+    SDL_LockMutex(l_rsp_thread.lock);
+    for (;;)
+    {
+        while (!l_rsp_thread.pending && !l_rsp_thread.quit) {
+            SDL_CondWait(l_rsp_thread.work_avail, l_rsp_thread.lock);
+        }
+        if (l_rsp_thread.quit) {
+            break;
+        }
+        SDL_UnlockMutex(l_rsp_thread.lock);
+
+        long long int start = benchmark_clock_ns();
+        l_rsp_thread.run(l_rsp_thread.opaque);
+        long long int end = benchmark_clock_ns();
+
+        SDL_LockMutex(l_rsp_thread.lock);
+        l_rsp_thread.task_ns = end - start;
+        l_rsp_thread.pending = 0;
+        SDL_CondSignal(l_rsp_thread.work_done);
+    }
+    SDL_UnlockMutex(l_rsp_thread.lock);
+
+    return 0;
+}
+
+int rsp_thread_start(void)
+{
+    if (l_rsp_thread.thread != NULL) {
+        return 0;
+    }
+
+    memset(&l_rsp_thread, 0, sizeof(l_rsp_thread));
+    g_rsp_thread_busy = 0;
+
+    l_rsp_thread.lock = SDL_CreateMutex();
+    l_rsp_thread.work_avail = SDL_CreateCond();
+    l_rsp_thread.work_done = SDL_CreateCond();
+    if (l_rsp_thread.lock == NULL || l_rsp_thread.work_avail == NULL || l_rsp_thread.work_done == NULL) {
+        goto fail;
+    }
+
+#if SDL_VERSION_ATLEAST(2,0,0)
+    l_rsp_thread.thread = SDL_CreateThread(rsp_thread_main, "m64prsp", NULL);
+#else
+    l_rsp_thread.thread = SDL_CreateThread(rsp_thread_main, NULL);
+#endif
+    if (l_rsp_thread.thread == NULL) {
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    DebugMessage(M64MSG_WARNING, "Couldn't start the RSP thread, running graphics tasks inline");
+    if (l_rsp_thread.work_done != NULL) SDL_DestroyCond(l_rsp_thread.work_done);
+    if (l_rsp_thread.work_avail != NULL) SDL_DestroyCond(l_rsp_thread.work_avail);
+    if (l_rsp_thread.lock != NULL) SDL_DestroyMutex(l_rsp_thread.lock);
+    memset(&l_rsp_thread, 0, sizeof(l_rsp_thread));
+    return -1;
+}
+
+void rsp_thread_stop(void)
+{
+    if (l_rsp_thread.thread == NULL) {
+        return;
+    }
+
+    rsp_thread_sync();
+
+    SDL_LockMutex(l_rsp_thread.lock);
+    l_rsp_thread.quit = 1;
+    SDL_CondSignal(l_rsp_thread.work_avail);
+    SDL_UnlockMutex(l_rsp_thread.lock);
+
+    SDL_WaitThread(l_rsp_thread.thread, NULL);
+    SDL_DestroyCond(l_rsp_thread.work_done);
+    SDL_DestroyCond(l_rsp_thread.work_avail);
+    SDL_DestroyMutex(l_rsp_thread.lock);
+    l_rsp_thread.thread = NULL;
+}
+
+void rsp_thread_run(void (*run)(void*), void (*finish)(void*), void* opaque)
+{
+    rsp_thread_sync();
+
+    /* without a worker, behave like a synchronous task */
+    if (l_rsp_thread.thread == NULL) {
+        run(opaque);
+        finish(opaque);
+        return;
+    }
+
+    l_rsp_thread.finish = finish;
+    ++l_rsp_thread.tasks;
+    g_rsp_thread_busy = 1;
+
+    SDL_LockMutex(l_rsp_thread.lock);
+    l_rsp_thread.run = run;
+    l_rsp_thread.opaque = opaque;
+    l_rsp_thread.pending = 1;
+    SDL_CondSignal(l_rsp_thread.work_avail);
+    SDL_UnlockMutex(l_rsp_thread.lock);
+}
+
+void rsp_thread_wait(void)
+{
+    void* opaque;
+
+    if (!g_rsp_thread_busy) {
+        return;
+    }
+
+    /* the stall replaces the time the task would have taken inline */
+    benchmark_section_start(BENCHMARK_SECTION_RSP);
+
+    long long int start = benchmark_clock_ns();
+    SDL_LockMutex(l_rsp_thread.lock);
+    if (l_rsp_thread.pending) {
+        ++l_rsp_thread.stalls;
+        while (l_rsp_thread.pending) {
+            SDL_CondWait(l_rsp_thread.work_done, l_rsp_thread.lock);
+        }
+    }
+    l_rsp_thread.total_task_ns += l_rsp_thread.task_ns;
+    opaque = l_rsp_thread.opaque;
+    SDL_UnlockMutex(l_rsp_thread.lock);
+    l_rsp_thread.total_wait_ns += benchmark_clock_ns() - start;
+
+    /* clear first, the finish callback goes through synchronized paths */
+    g_rsp_thread_busy = 0;
+    l_rsp_thread.finish(opaque);
+
+    benchmark_section_end(BENCHMARK_SECTION_RSP);
+}
+
+void rsp_thread_report(void)
+{
+    long long int overlap_ns;
+
+    if (l_rsp_thread.tasks == 0) {
+        return;
+    }
+
+    overlap_ns = l_rsp_thread.total_task_ns - l_rsp_thread.total_wait_ns;
+    if (overlap_ns < 0) {
+        overlap_ns = 0;
+    }
+
+    DebugMessage(M64MSG_INFO, "RSP thread: %" PRIu64 " tasks, %" PRIu64 " stalls, %.3f ms of tasks, %.3f ms waited (%.1f%% overlapped)",
+        l_rsp_thread.tasks, l_rsp_thread.stalls,
+        (double)l_rsp_thread.total_task_ns / 1000000.0,
+        (double)l_rsp_thread.total_wait_ns / 1000000.0,
+        (l_rsp_thread.total_task_ns > 0) ? 100.0 * (double)overlap_ns / (double)l_rsp_thread.total_task_ns : 0.0);
+
+    if (g_benchmark.enabled) {
+        benchmark_set_counter("rsp_thread_tasks", l_rsp_thread.tasks);
+        benchmark_set_counter("rsp_thread_stalls", l_rsp_thread.stalls);
+        benchmark_set_counter("rsp_thread_task_us", (uint64_t)(l_rsp_thread.total_task_ns / 1000));
+        benchmark_set_counter("rsp_thread_overlap_us", (uint64_t)(overlap_ns / 1000));
+    }
+}
@@ -0,0 +1,57 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rsp_thread.h                                            *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_MAIN_RSP_THREAD_H
+#define M64P_MAIN_RSP_THREAD_H
+
+#include "osal/preproc.h"
+
+/* Worker thread running RSP tasks while the emulated CPU keeps going.
+ *
+ * Only one task is in flight at a time. Once it is dispatched, the emulation
+ * thread must call rsp_thread_sync() before touching any state the task may
+ * use (RCP registers, SP memory, framebuffers, plugin calls). The finish
+ * callback then runs on the emulation thread, after the task completed. */
+
+/* set while a task is dispatched and its finish callback has not run yet,
+ * only accessed from the emulation thread */
+extern int g_rsp_thread_busy;
+
+int rsp_thread_start(void);
+void rsp_thread_stop(void);
+
+/* hand run(opaque) to the worker, finish(opaque) is called by the next sync */
+void rsp_thread_run(void (*run)(void*), void (*finish)(void*), void* opaque);
+
+/* block until the dispatched task completed and call its finish callback */
+void rsp_thread_wait(void);
+
+/* log how much of the task time was overlapped with emulation */
+void rsp_thread_report(void);
+
+static osal_inline void rsp_thread_sync(void)
+{
+    if (g_rsp_thread_busy) {
+        rsp_thread_wait();
+    }
+}
+
+#endif
@@ -59,6 +59,7 @@ enum { DD_DISK_ID_OFFSET = 0x43670 };
 
 static const char* savestate_magic = "M64+SAVE";
 static const int savestate_latest_version = 0x00010900;  /* 1.9 */
+static const char* savestate_chunked_magic = "M64+CHNK";
 static const unsigned char pj64_magic[4] = { 0xC8, 0xA6, 0xD8, 0x23 };
 
 static savestates_job job = savestates_job_nothing;
@@ -67,6 +68,7 @@ static char *fname = NULL;
 
 static unsigned int slot = 0;
 static int autoinc_save_slot = 0;
+static int chunked_format = 1;
 
 static SDL_mutex *savestates_lock;
 
@@ -74,9 +76,41 @@ struct savestate_work {
     char *filepath;
     char *data;
     size_t size;
+    int chunked;
     struct work_struct work;
 };
 
+/* Chunked container: the uncompressed Mupen64Plus savestate is split in
+ * chunks which are compressed independently, so that they can be
+ * processed in parallel on the workqueue.
+ *
+ *   0  "M64+CHNK"
+ *   8  container version (big endian)
+ *  12  codec (big endian)
+ *  16  uncompressed size (big endian)
+ *  20  chunk size (big endian)
+ *  24  chunk count (big endian)
+ *  28  compressed size of each chunk (big endian)
+ *      compressed chunks
+ */
+enum {
+    SAVESTATE_CHUNKED_VERSION = 1,
+    SAVESTATE_CHUNKED_HEADER_SIZE = 28,
+    SAVESTATE_CHUNK_SIZE = 0x100000
+};
+
+enum { SAVESTATE_CODEC_ZLIB = 1 };
+
+struct savestate_chunks {
+    unsigned char *data;
+    size_t size;
+    size_t chunk_size;
+    size_t count;
+    unsigned char **packed;
+    uLongf *packed_size;
+    int error;
+};
+
 /* Returns the malloc'd full path of the currently selected savestate. */
 static char *savestates_generate_path(savestates_type type)
 {
@@ -138,6 +172,11 @@ void savestates_set_autoinc_slot(int b)
     autoinc_save_slot = b;
 }
 
+void savestates_set_chunked_format(int b)
+{
+    chunked_format = b;
+}
+
 void savestates_inc_slot(void)
 {
     if(++slot>9)
@@ -185,126 +224,18 @@ static void savestates_clear_job(void)
 #define PUTDATA(buff, type, value) \
     do { type x = value; PUTARRAY(&x, buff, type, 1); } while(0)
 
-static int savestates_load_m64p(struct device* dev, char *filepath)
+/* Parse an uncompressed Mupen64Plus savestate into the device.
+ * Buffers are converted to host endianness in place. */
+static void savestates_parse_m64p(struct device* dev, unsigned int version,
+                                  unsigned char* savestateData, char* queue,
+                                  unsigned char* using_tlb_data, unsigned char* data_0001_0200)
 {
-    unsigned char header[44];
-    gzFile f;
-    unsigned int version;
     int i;
     uint32_t FCR31;
-
-    size_t savestateSize;
-    unsigned char *savestateData, *curr;
-    char queue[1024];
-    unsigned char using_tlb_data[4];
-    unsigned char data_0001_0200[4096]; // 4k for extra state from v1.2
+    unsigned char* curr = savestateData;
 
     uint32_t* cp0_regs = r4300_cp0_regs(&dev->r4300.cp0);
 
-    SDL_LockMutex(savestates_lock);
-
-    f = osal_gzopen(filepath, "rb");
-    if(f==NULL)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not open state file: %s", filepath);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-
-    /* Read and check Mupen64Plus magic number. */
-    if (gzread(f, header, 44) != 44)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read header from state file %s", filepath);
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-    curr = header;
-
-    if(strncmp((char *)curr, savestate_magic, 8)!=0)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State file: %s is not a valid Mupen64plus savestate.", filepath);
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-    curr += 8;
-
-    version = *curr++;
-    version = (version << 8) | *curr++;
-    version = (version << 8) | *curr++;
-    version = (version << 8) | *curr++;
-    if((version >> 16) != (savestate_latest_version >> 16))
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State version (%08x) isn't compatible. Please update Mupen64Plus.", version);
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-
-    if(memcmp((char *)curr, ROM_SETTINGS.MD5, 32))
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State ROM MD5 does not match current ROM.");
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-    curr += 32;
-
-    /* Read the rest of the savestate */
-    savestateSize = 16788244;
-    savestateData = curr = (unsigned char *)malloc(savestateSize);
-    if (savestateData == NULL)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to load state.");
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-    if (version == 0x00010000) /* original savestate version */
-    {
-        if (gzread(f, savestateData, savestateSize) != (int)savestateSize ||
-            (gzread(f, queue, sizeof(queue)) % 4) != 0)
-        {
-            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate 1.0 data from %s", filepath);
-            free(savestateData);
-            gzclose(f);
-            SDL_UnlockMutex(savestates_lock);
-            return 0;
-        }
-    }
-    else if (version == 0x00010100) // saves entire eventqueue plus 4-byte using_tlb flags
-    {
-        if (gzread(f, savestateData, savestateSize) != (int)savestateSize ||
-            gzread(f, queue, sizeof(queue)) != sizeof(queue) ||
-            gzread(f, using_tlb_data, sizeof(using_tlb_data)) != sizeof(using_tlb_data))
-        {
-            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate 1.1 data from %s", filepath);
-            free(savestateData);
-            gzclose(f);
-            SDL_UnlockMutex(savestates_lock);
-            return 0;
-        }
-    }
-    else // version >= 0x00010200  saves entire eventqueue, 4-byte using_tlb flags and extra state
-    {
-        if (gzread(f, savestateData, savestateSize) != (int)savestateSize ||
-            gzread(f, queue, sizeof(queue)) != sizeof(queue) ||
-            gzread(f, using_tlb_data, sizeof(using_tlb_data)) != sizeof(using_tlb_data) ||
-            gzread(f, data_0001_0200, sizeof(data_0001_0200)) != sizeof(data_0001_0200))
-        {
-            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate 1.2+ data from %s", filepath);
-            free(savestateData);
-            gzclose(f);
-            SDL_UnlockMutex(savestates_lock);
-            return 0;
-        }
-    }
-
-    gzclose(f);
-    SDL_UnlockMutex(savestates_lock);
-
-    // Parse savestate
     dev->rdram.regs[0][RDRAM_CONFIG_REG]       = GETDATA(curr, uint32_t);
     dev->rdram.regs[0][RDRAM_DEVICE_ID_REG]    = GETDATA(curr, uint32_t);
     dev->rdram.regs[0][RDRAM_DELAY_REG]        = GETDATA(curr, uint32_t);
@@ -430,6 +361,7 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
 
     COPYARRAY(dev->r4300.cp0.tlb.LUT_r, curr, uint32_t, 0x100000);
     COPYARRAY(dev->r4300.cp0.tlb.LUT_w, curr, uint32_t, 0x100000);
+    ++dev->r4300.cp0.tlb.lut_generation;
 
     *r4300_llbit(&dev->r4300) = GETDATA(curr, uint32_t);
     COPYARRAY(r4300_regs(&dev->r4300), curr, int64_t, 32);
@@ -953,6 +885,316 @@ static int savestates_load_m64p(struct device* dev, char *filepath)
     dev->r4300.cp0.interrupt_unsafe_state = 0;
 
     *r4300_cp0_last_addr(&dev->r4300.cp0) = *r4300_pc(&dev->r4300);
+}
+
+static void put_be32(unsigned char *buff, uint32_t value)
+{
+    buff[0] = (unsigned char)(value >> 24);
+    buff[1] = (unsigned char)(value >> 16);
+    buff[2] = (unsigned char)(value >> 8);
+    buff[3] = (unsigned char)value;
+}
+
+static uint32_t get_be32(const unsigned char *buff)
+{
+    return ((uint32_t)buff[0] << 24) | ((uint32_t)buff[1] << 16)
+         | ((uint32_t)buff[2] << 8) | (uint32_t)buff[3];
+}
+
+/* Check magic, version and ROM of the 44-byte Mupen64Plus savestate header */
+static int savestates_check_header_m64p(const unsigned char *header, const char *filepath, unsigned int *version)
+{
+    const unsigned char *curr = header;
+
+    if(strncmp((const char *)curr, savestate_magic, 8)!=0)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State file: %s is not a valid Mupen64plus savestate.", filepath);
+        return 0;
+    }
+    curr += 8;
+
+    *version = get_be32(curr);
+    curr += 4;
+    if((*version >> 16) != (savestate_latest_version >> 16))
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State version (%08x) isn't compatible. Please update Mupen64Plus.", *version);
+        return 0;
+    }
+
+    if(memcmp((const char *)curr, ROM_SETTINGS.MD5, 32))
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State ROM MD5 does not match current ROM.");
+        return 0;
+    }
+
+    return 1;
+}
+
+static size_t savestates_chunk_length(const struct savestate_chunks *chunks, size_t index)
+{
+    size_t offset = index * chunks->chunk_size;
+
+    return (chunks->size - offset < chunks->chunk_size)
+        ? chunks->size - offset
+        : chunks->chunk_size;
+}
+
+static void savestates_inflate_chunk(size_t index, void *opaque)
+{
+    struct savestate_chunks *chunks = (struct savestate_chunks *)opaque;
+    uLongf length = (uLongf)savestates_chunk_length(chunks, index);
+    uLongf expected = length;
+
+    if (uncompress(chunks->data + index * chunks->chunk_size, &length,
+                   chunks->packed[index], chunks->packed_size[index]) != Z_OK
+        || length != expected)
+    {
+        chunks->error = 1;
+    }
+}
+
+static void savestates_deflate_chunk(size_t index, void *opaque)
+{
+    struct savestate_chunks *chunks = (struct savestate_chunks *)opaque;
+    uLong length = (uLong)savestates_chunk_length(chunks, index);
+    uLongf packed_size = compressBound(length);
+
+    chunks->packed[index] = (unsigned char *)malloc(packed_size);
+    if (chunks->packed[index] == NULL ||
+        compress2(chunks->packed[index], &packed_size,
+                  chunks->data + index * chunks->chunk_size, length, Z_BEST_SPEED) != Z_OK)
+    {
+        chunks->error = 1;
+        return;
+    }
+
+    chunks->packed_size[index] = packed_size;
+}
+
+static int savestates_is_chunked(const char *filepath)
+{
+    char magic[8];
+    int chunked = 0;
+    FILE *f = osal_file_open(filepath, "rb");
+
+    if (f != NULL)
+    {
+        chunked = fread(magic, 1, 8, f) == 8 && memcmp(magic, savestate_chunked_magic, 8) == 0;
+        fclose(f);
+    }
+
+    return chunked;
+}
+
+static int savestates_load_m64p_chunked(struct device* dev, char *filepath)
+{
+    unsigned char header[SAVESTATE_CHUNKED_HEADER_SIZE];
+    unsigned char *sizes = NULL, *packed = NULL, *curr;
+    struct savestate_chunks chunks;
+    size_t i, packed_total = 0;
+    unsigned int version;
+    int ret = 0;
+    FILE *f;
+
+    memset(&chunks, 0, sizeof(chunks));
+
+    SDL_LockMutex(savestates_lock);
+
+    f = osal_file_open(filepath, "rb");
+    if (f == NULL)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not open state file: %s", filepath);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+
+    if (fread(header, 1, sizeof(header), f) != sizeof(header))
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read header from state file %s", filepath);
+        goto fail_file;
+    }
+
+    chunks.size = get_be32(header + 16);
+    chunks.chunk_size = get_be32(header + 20);
+    chunks.count = get_be32(header + 24);
+
+    if (get_be32(header + 8) != SAVESTATE_CHUNKED_VERSION
+        || get_be32(header + 12) != SAVESTATE_CODEC_ZLIB
+        || chunks.size != SAVESTATE_M64P_SIZE
+        || chunks.chunk_size == 0
+        || chunks.count != (chunks.size + chunks.chunk_size - 1) / chunks.chunk_size)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State file %s uses an unsupported container. Please update Mupen64Plus.", filepath);
+        goto fail_file;
+    }
+
+    sizes = (unsigned char *)malloc(chunks.count * 4);
+    chunks.packed = (unsigned char **)malloc(chunks.count * sizeof(*chunks.packed));
+    chunks.packed_size = (uLongf *)malloc(chunks.count * sizeof(*chunks.packed_size));
+    chunks.data = (unsigned char *)malloc(chunks.size);
+    if (sizes == NULL || chunks.packed == NULL || chunks.packed_size == NULL || chunks.data == NULL)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to load state.");
+        goto fail_file;
+    }
+
+    if (fread(sizes, 4, chunks.count, f) != chunks.count)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate data from %s", filepath);
+        goto fail_file;
+    }
+
+    for (i = 0; i < chunks.count; ++i)
+    {
+        chunks.packed_size[i] = get_be32(sizes + 4 * i);
+        packed_total += chunks.packed_size[i];
+    }
+
+    packed = (unsigned char *)malloc(packed_total);
+    if (packed == NULL)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to load state.");
+        goto fail_file;
+    }
+
+    if (fread(packed, 1, packed_total, f) != packed_total)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate data from %s", filepath);
+        goto fail_file;
+    }
+
+    fclose(f);
+    SDL_UnlockMutex(savestates_lock);
+
+    for (i = 0, curr = packed; i < chunks.count; curr += chunks.packed_size[i], ++i)
+        chunks.packed[i] = curr;
+
+    workqueue_run_parallel(chunks.count, savestates_inflate_chunk, &chunks);
+
+    if (chunks.error)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not decompress Mupen64Plus savestate data from %s", filepath);
+    }
+    else if (savestates_check_header_m64p(chunks.data, filepath, &version))
+    {
+        curr = chunks.data + 44;
+        savestates_parse_m64p(dev, version, curr, (char *)curr + 16788244,
+                              curr + 16788244 + 1024, curr + 16788244 + 1024 + 4);
+
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State loaded from: %s", namefrompath(filepath));
+        ret = 1;
+    }
+
+    goto done;
+
+fail_file:
+    fclose(f);
+    SDL_UnlockMutex(savestates_lock);
+done:
+    free(packed);
+    free(chunks.data);
+    free(chunks.packed_size);
+    free(chunks.packed);
+    free(sizes);
+    return ret;
+}
+
+static int savestates_load_m64p(struct device* dev, char *filepath)
+{
+    unsigned char header[44];
+    gzFile f;
+    unsigned int version;
+
+    size_t savestateSize;
+    unsigned char *savestateData;
+    char queue[1024];
+    unsigned char using_tlb_data[4];
+    unsigned char data_0001_0200[4096]; // 4k for extra state from v1.2
+
+    if (savestates_is_chunked(filepath))
+        return savestates_load_m64p_chunked(dev, filepath);
+
+    SDL_LockMutex(savestates_lock);
+
+    f = osal_gzopen(filepath, "rb");
+    if(f==NULL)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not open state file: %s", filepath);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+
+    /* Read and check Mupen64Plus magic number. */
+    if (gzread(f, header, 44) != 44)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read header from state file %s", filepath);
+        gzclose(f);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+
+    if (!savestates_check_header_m64p(header, filepath, &version))
+    {
+        gzclose(f);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+
+    /* Read the rest of the savestate */
+    savestateSize = 16788244;
+    savestateData = (unsigned char *)malloc(savestateSize);
+    if (savestateData == NULL)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to load state.");
+        gzclose(f);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+    if (version == 0x00010000) /* original savestate version */
+    {
+        if (gzread(f, savestateData, savestateSize) != (int)savestateSize ||
+            (gzread(f, queue, sizeof(queue)) % 4) != 0)
+        {
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate 1.0 data from %s", filepath);
+            free(savestateData);
+            gzclose(f);
+            SDL_UnlockMutex(savestates_lock);
+            return 0;
+        }
+    }
+    else if (version == 0x00010100) // saves entire eventqueue plus 4-byte using_tlb flags
+    {
+        if (gzread(f, savestateData, savestateSize) != (int)savestateSize ||
+            gzread(f, queue, sizeof(queue)) != sizeof(queue) ||
+            gzread(f, using_tlb_data, sizeof(using_tlb_data)) != sizeof(using_tlb_data))
+        {
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate 1.1 data from %s", filepath);
+            free(savestateData);
+            gzclose(f);
+            SDL_UnlockMutex(savestates_lock);
+            return 0;
+        }
+    }
+    else // version >= 0x00010200  saves entire eventqueue, 4-byte using_tlb flags and extra state
+    {
+        if (gzread(f, savestateData, savestateSize) != (int)savestateSize ||
+            gzread(f, queue, sizeof(queue)) != sizeof(queue) ||
+            gzread(f, using_tlb_data, sizeof(using_tlb_data)) != sizeof(using_tlb_data) ||
+            gzread(f, data_0001_0200, sizeof(data_0001_0200)) != sizeof(data_0001_0200))
+        {
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate 1.2+ data from %s", filepath);
+            free(savestateData);
+            gzclose(f);
+            SDL_UnlockMutex(savestates_lock);
+            return 0;
+        }
+    }
+
+    gzclose(f);
+    SDL_UnlockMutex(savestates_lock);
+
+    // Parse savestate
+    savestates_parse_m64p(dev, version, savestateData, queue, using_tlb_data, data_0001_0200);
 
     free(savestateData);
     main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State loaded from: %s", namefrompath(filepath));
@@ -1183,6 +1425,7 @@ static int savestates_load_pj64(struct device* dev,
     // tlb
     memset(dev->r4300.cp0.tlb.LUT_r, 0, 0x400000);
     memset(dev->r4300.cp0.tlb.LUT_w, 0, 0x400000);
+    ++dev->r4300.cp0.tlb.lut_generation;
     for (i=0; i < 32; i++)
     {
         unsigned int MyPageMask, MyEntryHi, MyEntryLo0, MyEntryLo1;
@@ -1387,6 +1630,8 @@ static savestates_type savestates_detect_type(char *filepath)
 
     if (magic[0] == 0x1f && magic[1] == 0x8b) // GZIP header
         return savestates_type_m64p;
+    else if (memcmp(magic, savestate_chunked_magic, 4) == 0) // Chunked M64P header
+        return savestates_type_m64p;
     else if (memcmp(magic, "PK\x03\x04", 4) == 0) // ZIP header
         return savestates_type_pj64_zip;
     else if (memcmp(magic, pj64_magic, 4) == 0) // PJ64 header
@@ -1478,6 +1723,78 @@ int savestates_load(void)
     return ret;
 }
 
+static int savestates_write_m64p_chunked(const struct savestate_work *save)
+{
+    unsigned char header[SAVESTATE_CHUNKED_HEADER_SIZE];
+    unsigned char *sizes;
+    struct savestate_chunks chunks;
+    size_t i;
+    int ret = 0;
+    FILE *f;
+
+    memset(&chunks, 0, sizeof(chunks));
+    chunks.data = (unsigned char *)save->data;
+    chunks.size = save->size;
+    chunks.chunk_size = SAVESTATE_CHUNK_SIZE;
+    chunks.count = (chunks.size + chunks.chunk_size - 1) / chunks.chunk_size;
+
+    sizes = (unsigned char *)malloc(chunks.count * 4);
+    chunks.packed = (unsigned char **)calloc(chunks.count, sizeof(*chunks.packed));
+    chunks.packed_size = (uLongf *)calloc(chunks.count, sizeof(*chunks.packed_size));
+    if (sizes == NULL || chunks.packed == NULL || chunks.packed_size == NULL)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to save state.");
+        goto done;
+    }
+
+    workqueue_run_parallel(chunks.count, savestates_deflate_chunk, &chunks);
+
+    if (chunks.error)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not compress state data for: %s", save->filepath);
+        goto done;
+    }
+
+    memcpy(header, savestate_chunked_magic, 8);
+    put_be32(header + 8, SAVESTATE_CHUNKED_VERSION);
+    put_be32(header + 12, SAVESTATE_CODEC_ZLIB);
+    put_be32(header + 16, (uint32_t)chunks.size);
+    put_be32(header + 20, (uint32_t)chunks.chunk_size);
+    put_be32(header + 24, (uint32_t)chunks.count);
+
+    for (i = 0; i < chunks.count; ++i)
+        put_be32(sizes + 4 * i, (uint32_t)chunks.packed_size[i]);
+
+    f = osal_file_open(save->filepath, "wb");
+    if (f == NULL)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not open state file: %s", save->filepath);
+        goto done;
+    }
+
+    ret = fwrite(header, 1, sizeof(header), f) == sizeof(header)
+       && fwrite(sizes, 4, chunks.count, f) == chunks.count;
+    for (i = 0; ret && i < chunks.count; ++i)
+        ret = fwrite(chunks.packed[i], 1, chunks.packed_size[i], f) == chunks.packed_size[i];
+
+    if (fclose(f) != 0)
+        ret = 0;
+
+    if (!ret)
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not write data to state file: %s", save->filepath);
+
+done:
+    if (chunks.packed != NULL)
+    {
+        for (i = 0; i < chunks.count; ++i)
+            free(chunks.packed[i]);
+    }
+    free(chunks.packed_size);
+    free(chunks.packed);
+    free(sizes);
+    return ret;
+}
+
 static void savestates_save_m64p_work(struct work_struct *work)
 {
     gzFile f;
@@ -1486,6 +1803,19 @@ static void savestates_save_m64p_work(struct work_struct *work)
 
     SDL_LockMutex(savestates_lock);
 
+    if (save->chunked)
+    {
+        if (savestates_write_m64p_chunked(save))
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Saved state to: %s", namefrompath(save->filepath));
+
+        free(save->data);
+        free(save->filepath);
+        free(save);
+
+        SDL_UnlockMutex(savestates_lock);
+        return;
+    }
+
     // Write the state to a GZIP file
     f = osal_gzopen(save->filepath, "wb");
 
@@ -1514,44 +1844,24 @@ static void savestates_save_m64p_work(struct work_struct *work)
     SDL_UnlockMutex(savestates_lock);
 }
 
-static int savestates_save_m64p(const struct device* dev, char *filepath)
+/* Serialize the device into an uncompressed Mupen64Plus savestate
+ * of SAVESTATE_M64P_SIZE bytes. Without tlb_lut, data already holds a
+ * snapshot written here, so padding is cleared and the lookup tables kept. */
+static void savestates_write_m64p(const struct device* dev, char* data, int tlb_lut)
 {
     unsigned char outbuf[4];
     int i;
 
     char queue[1024];
-
-    struct savestate_work *save;
-    char *curr;
+    char *curr = data;
 
     /* OK to cast away const qualifier */
     const uint32_t* cp0_regs = r4300_cp0_regs((struct cp0*)&dev->r4300.cp0);
 
-    save = malloc(sizeof(*save));
-    if (!save) {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to save state.");
-        return 0;
-    }
-
-    save->filepath = strdup(filepath);
-
-    if(autoinc_save_slot)
-        savestates_inc_slot();
-
     save_eventqueue_infos(&dev->r4300.cp0, queue);
 
-    // Allocate memory for the save state data
-    save->size = 16788288 + sizeof(queue) + 4 + 4096;
-    save->data = curr = malloc(save->size);
-    if (save->data == NULL)
-    {
-        free(save->filepath);
-        free(save);
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to save state.");
-        return 0;
-    }
-
-    memset(save->data, 0, save->size);
+    if (tlb_lut)
+        memset(data, 0, SAVESTATE_M64P_SIZE);
 
     // Write the save state data to memory
     PUTARRAY(savestate_magic, curr, unsigned char, 8);
@@ -1711,8 +2021,15 @@ static int savestates_save_m64p(const struct device* dev, char *filepath)
     PUTDATA(curr, int32_t, dev->cart.use_flashram);
     curr += 4+8+4+4; // Here used to be flashram state
 
-    PUTARRAY(dev->r4300.cp0.tlb.LUT_r, curr, uint32_t, 0x100000);
-    PUTARRAY(dev->r4300.cp0.tlb.LUT_w, curr, uint32_t, 0x100000);
+    if (tlb_lut)
+    {
+        PUTARRAY(dev->r4300.cp0.tlb.LUT_r, curr, uint32_t, 0x100000);
+        PUTARRAY(dev->r4300.cp0.tlb.LUT_w, curr, uint32_t, 0x100000);
+    }
+    else
+    {
+        curr += SAVESTATE_M64P_TLB_LUT_SIZE;
+    }
 
     /* OK to cast away const qualifier */
     PUTDATA(curr, uint32_t, *r4300_llbit((struct r4300_core*)&dev->r4300));
@@ -1909,6 +2226,36 @@ static int savestates_save_m64p(const struct device* dev, char *filepath)
     /* cp0 and cp2 latch (since 1.9) */
     PUTDATA(curr, uint64_t, *r4300_cp0_latch((struct cp0*)&dev->r4300.cp0));
     PUTDATA(curr, uint64_t, *r4300_cp2_latch((struct cp2*)&dev->r4300.cp2));
+}
+
+static int savestates_save_m64p(const struct device* dev, char *filepath)
+{
+    struct savestate_work *save;
+
+    save = malloc(sizeof(*save));
+    if (!save) {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to save state.");
+        return 0;
+    }
+
+    save->filepath = strdup(filepath);
+    save->chunked = chunked_format;
+
+    if(autoinc_save_slot)
+        savestates_inc_slot();
+
+    // Allocate memory for the save state data
+    save->size = SAVESTATE_M64P_SIZE;
+    save->data = malloc(save->size);
+    if (save->data == NULL)
+    {
+        free(save->filepath);
+        free(save);
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to save state.");
+        return 0;
+    }
+
+    savestates_write_m64p(dev, save->data, 1);
 
     init_work(&save->work, savestates_save_m64p_work);
     queue_work(&save->work);
@@ -1916,6 +2263,28 @@ static int savestates_save_m64p(const struct device* dev, char *filepath)
     return 1;
 }
 
+void savestates_save_m64p_mem(const struct device* dev, void* data, int tlb_lut)
+{
+    savestates_write_m64p(dev, (char*)data, tlb_lut);
+}
+
+/* data is modified in place (endianness conversion) */
+int savestates_load_m64p_mem(struct device* dev, void* data)
+{
+    unsigned char* curr = (unsigned char*)data;
+    unsigned int version;
+
+    if (!savestates_check_header_m64p(curr, "memory", &version)) {
+        return 0;
+    }
+
+    curr += 44;
+
+    savestates_parse_m64p(dev, version, curr, (char*)curr + 16788244,
+                          curr + 16788244 + 1024, curr + 16788244 + 1024 + 4);
+    return 1;
+}
+
 static int savestates_save_pj64(const struct device* dev,
                                 char *filepath, void *handle,
                                 int (*write_func)(void *, const void *, size_t))
@@ -40,6 +40,15 @@ typedef enum _savestates_type
     savestates_type_pj64_unc
 } savestates_type;
 
+struct device;
+
+/* Size of an uncompressed Mupen64Plus savestate */
+enum { SAVESTATE_M64P_SIZE = 16788288 + 1024 + 4 + 4096 };
+
+/* Location of the TLB lookup tables inside an uncompressed savestate */
+enum { SAVESTATE_M64P_TLB_LUT_OFFSET = 8397332 };
+enum { SAVESTATE_M64P_TLB_LUT_SIZE = 2 * 0x100000 * 4 };
+
 savestates_job savestates_get_job(void);
 void savestates_set_job(savestates_job j, savestates_type t, const char *fn);
 void savestates_init(void);
@@ -51,7 +60,15 @@ int savestates_save(void);
 void savestates_select_slot(unsigned int s);
 unsigned int savestates_get_slot(void);
 void savestates_set_autoinc_slot(int b);
+void savestates_set_chunked_format(int b);
 void savestates_inc_slot(void);
 
+/* Uncompressed in-memory savestates, must be called at a safe point
+ * of the emulation thread (see gen_interrupt).
+ * If tlb_lut is 0, data must hold a snapshot previously written by
+ * savestates_save_m64p_mem and its TLB lookup tables are left untouched. */
+void savestates_save_m64p_mem(const struct device* dev, void* data, int tlb_lut);
+int savestates_load_m64p_mem(struct device* dev, void* data);
+
 #endif /* __SAVESTAVES_H__ */
 
@@ -34,7 +34,9 @@
 #include "api/m64p_types.h"
 #include "main/main.h"
 #include "main/rom.h"
+#include "main/screenshot.h"
 #include "main/util.h"
+#include "main/workqueue.h"
 #include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
@@ -71,7 +73,7 @@ static void user_flush_data(png_structp png_write)
 * Other Local (static) functions
 */
 
-static int SaveRGBBufferToFile(const char *filename, const unsigned char *buf, int width, int height, int pitch)
+static int SaveRGBBufferToFile(const char *filename, const unsigned char *buf, int width, int height, int pitch, int level)
 {
     int i;
 
@@ -108,6 +110,10 @@ static int SaveRGBBufferToFile(const char *filename, const unsigned char *buf, i
     // set the info
     png_set_IHDR(png_write, png_info, width, height, 8, PNG_COLOR_TYPE_RGB,
                  PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    // row filtering only pays off when the rows are actually compressed
+    png_set_compression_level(png_write, level);
+    if (level == 0)
+        png_set_filter(png_write, 0, PNG_FILTER_NONE);
     // allocate row pointers and scale each row to 24-bit color
     png_byte **row_pointers;
     row_pointers = (png_byte **) malloc(height * sizeof(png_bytep));
@@ -128,14 +134,190 @@ static int SaveRGBBufferToFile(const char *filename, const unsigned char *buf, i
     return 0;
 }
 
+/*********************************************************************************************************
+* Capture buffers, encoded to PNG on the workqueue threads
+*/
+
+#define SCREENSHOT_BUFFERS 4
+
+enum screenshot_state
+{
+    SHOT_FREE,
+    SHOT_PENDING,
+    SHOT_DONE
+};
+
+struct screenshot_job
+{
+    struct work_struct work;
+    enum screenshot_state state;
+    int dump;
+    int frame;
+    int width;
+    int height;
+    int level;
+    int result;
+    char *filename;
+    unsigned char *pixels;
+    size_t capacity;
+};
+
+static struct screenshot_job l_Jobs[SCREENSHOT_BUFFERS];
+static SDL_mutex *l_JobsLock = NULL;
+static SDL_cond *l_JobDone = NULL;
+static volatile int l_JobsToReport = 0;
+
+static int l_Compression = 6;
+static int l_DumpInterval = 0;
+static int l_NextDumpFrame = 0;
+static unsigned int l_DumpsDropped = 0;
+
+static char *l_ShotPrefix = NULL;
 static int CurrentShotIndex;
+static int ShotIndexProbed;
 
-static char *GetNextScreenshotPath(void)
+static void screenshot_work(struct work_struct *work)
+{
+    struct screenshot_job *job = container_of(work, struct screenshot_job, work);
+    int result = SaveRGBBufferToFile(job->filename, job->pixels, job->width, job->height, job->width * 3, job->level);
+
+    SDL_LockMutex(l_JobsLock);
+    job->result = result;
+    job->state = SHOT_DONE;
+    ++l_JobsToReport;
+    SDL_CondBroadcast(l_JobDone);
+    SDL_UnlockMutex(l_JobsLock);
+}
+
+static struct screenshot_job *find_job(enum screenshot_state state)
+{
+    int i;
+
+    for (i = 0; i < SCREENSHOT_BUFFERS; i++)
+    {
+        if (l_Jobs[i].state == state)
+            return &l_Jobs[i];
+    }
+
+    return NULL;
+}
+
+/* Notifications are sent from the emulation thread, in the same way
+ * as when the screenshots were written synchronously */
+static void report_finished_jobs(void)
+{
+    struct screenshot_job *job;
+
+    while (l_JobsToReport != 0)
+    {
+        SDL_LockMutex(l_JobsLock);
+        job = find_job(SHOT_DONE);
+        if (job != NULL)
+        {
+            job->state = SHOT_FREE;
+            --l_JobsToReport;
+        }
+        SDL_UnlockMutex(l_JobsLock);
+
+        if (job == NULL)
+            break;
+
+        if (job->dump)
+        {
+            if (job->result != 0)
+                DebugMessage(M64MSG_WARNING, "Couldn't write frame dump '%s'", job->filename);
+        }
+        else if (job->result != 0)
+        {
+            StateChanged(M64CORE_SCREENSHOT_CAPTURED, 0);
+        }
+        else
+        {
+            // print message -- this allows developers to capture frames and use them in the regression test
+            main_message(M64MSG_INFO, OSD_BOTTOM_LEFT, "Captured screenshot for frame %i.", job->frame);
+            StateChanged(M64CORE_SCREENSHOT_CAPTURED, 1);
+        }
+
+        free(job->filename);
+        job->filename = NULL;
+    }
+}
+
+/* Only the emulation thread hands out and releases buffers, so a buffer found free stays free
+ * until it is queued. When wait is set, block until an encoder releases a buffer. */
+static struct screenshot_job *get_free_job(int wait)
+{
+    struct screenshot_job *job;
+
+    for (;;)
+    {
+        report_finished_jobs();
+
+        SDL_LockMutex(l_JobsLock);
+        job = find_job(SHOT_FREE);
+        if (job == NULL && wait)
+        {
+            while (find_job(SHOT_DONE) == NULL)
+                SDL_CondWait(l_JobDone, l_JobsLock);
+        }
+        SDL_UnlockMutex(l_JobsLock);
+
+        if (job != NULL || !wait)
+            return job;
+    }
+}
+
+/* Read the current frame from the video plugin and queue it for encoding. Takes ownership of filename. */
+static int capture_frame(struct screenshot_job *job, char *filename, int iFrameNumber, int dump)
+{
+    int width = 640;
+    int height = 480;
+    size_t size;
+
+    // get the width and height
+    gfx.readScreen(NULL, &width, &height, 0);
+    size = (size_t)width * height * 3;
+
+    if (size > job->capacity)
+    {
+        unsigned char *pixels = (unsigned char *) realloc(job->pixels, size);
+        if (pixels == NULL)
+        {
+            free(filename);
+            return 0;
+        }
+        job->pixels = pixels;
+        job->capacity = size;
+    }
+
+    // grab the back image from OpenGL by calling the video plugin
+    gfx.readScreen(job->pixels, &width, &height, 0);
+
+    job->dump = dump;
+    job->frame = iFrameNumber;
+    job->width = width;
+    job->height = height;
+    job->level = l_Compression;
+    job->filename = filename;
+    job->state = SHOT_PENDING;
+
+    init_work(&job->work, screenshot_work);
+    queue_work(&job->work);
+
+    return 1;
+}
+
+/* Returns the output path without the "-###.png" suffix. It only depends on the
+ * ROM and the configuration, so it is built once for each emulation run. */
+static const char *GetScreenshotPrefix(void)
 {
     char *ScreenshotPath;
     char ScreenshotFileName[60 + 8 + 1];
     char *pch;
 
+    if (l_ShotPrefix != NULL)
+        return l_ShotPrefix;
+
     // if there are any characters in the ROM header name with the highest bit set,
     // we assume it's encoded in Shift-JIS character set, and translate it to UTF-8
     const unsigned char *pccNameChar = (unsigned char *) ROM_PARAMS.headername;
@@ -163,8 +345,6 @@ static char *GetNextScreenshotPath(void)
         }
     }
 
-    strcat(ScreenshotFileName, "-###.png");
-    
     // add the base path to the screenshot file name
     const char *SshotDir = ConfigGetParamString(g_CoreConfig, "ScreenshotPath");
     if (SshotDir == NULL || *SshotDir == '\0')
@@ -184,9 +364,27 @@ static char *GetNextScreenshotPath(void)
             return NULL;
     }
 
-    // patch the number part of the name (the '###' part) until we find a free spot
+    l_ShotPrefix = ScreenshotPath;
+    return l_ShotPrefix;
+}
+
+static char *GetNextScreenshotPath(void)
+{
+    const char *ScreenshotPrefix = GetScreenshotPrefix();
+    char *ScreenshotPath;
+
+    if (ScreenshotPrefix == NULL)
+        return NULL;
+
+    ScreenshotPath = formatstr("%s-###.png", ScreenshotPrefix);
+    if (ScreenshotPath == NULL)
+        return NULL;
+
+    // patch the number part of the name (the '###' part) until we find a free spot.
+    // This is only done for the first screenshot: the following ones may still be in
+    // the encoder queue, so the next index is remembered instead.
     char *NumberPtr = ScreenshotPath + strlen(ScreenshotPath) - 7;
-    for (; CurrentShotIndex < 1000; CurrentShotIndex++)
+    for (; !ShotIndexProbed && CurrentShotIndex < 1000; CurrentShotIndex++)
     {
         sprintf(NumberPtr, "%03i.png", CurrentShotIndex);
         FILE *pFile = osal_file_open(ScreenshotPath, "r");
@@ -194,6 +392,7 @@ static char *GetNextScreenshotPath(void)
             break;
         fclose(pFile);
     }
+    ShotIndexProbed = 1;
 
     if (CurrentShotIndex >= 1000)
     {
@@ -201,6 +400,7 @@ static char *GetNextScreenshotPath(void)
         free(ScreenshotPath);
         return NULL;
     }
+    sprintf(NumberPtr, "%03i.png", CurrentShotIndex);
     CurrentShotIndex++;
 
     return ScreenshotPath;
@@ -213,51 +413,135 @@ static char *GetNextScreenshotPath(void)
 void ScreenshotRomOpen(void)
 {
     CurrentShotIndex = 0;
+    ShotIndexProbed = 0;
+    free(l_ShotPrefix);
+    l_ShotPrefix = NULL;
+}
+
+int ScreenshotStart(void)
+{
+    l_Compression = ConfigGetParamInt(g_CoreConfig, "ScreenshotCompression");
+    if (l_Compression < 0 || l_Compression > 9)
+        l_Compression = 6;
+    l_DumpInterval = ConfigGetParamInt(g_CoreConfig, "FrameDumpInterval");
+    if (l_DumpInterval < 0)
+        l_DumpInterval = 0;
+    l_NextDumpFrame = 0;
+    l_DumpsDropped = 0;
+
+    // the ScreenshotPath parameter may have changed since the last run
+    free(l_ShotPrefix);
+    l_ShotPrefix = NULL;
+
+    memset(l_Jobs, 0, sizeof(l_Jobs));
+    l_JobsToReport = 0;
+    l_JobsLock = SDL_CreateMutex();
+    l_JobDone = SDL_CreateCond();
+    if (l_JobsLock == NULL || l_JobDone == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Couldn't create screenshot synchronization primitives");
+        ScreenshotStop();
+        return 0;
+    }
+
+    if (l_DumpInterval > 0)
+        DebugMessage(M64MSG_INFO, "Frame dump: writing every %i frame(s) to '%s-frame######.png'", l_DumpInterval, GetScreenshotPrefix());
+
+    return 1;
+}
+
+void ScreenshotStop(void)
+{
+    int i;
+
+    if (l_JobsLock != NULL && l_JobDone != NULL)
+    {
+        // wait for the encoders to finish
+        SDL_LockMutex(l_JobsLock);
+        while (find_job(SHOT_PENDING) != NULL)
+            SDL_CondWait(l_JobDone, l_JobsLock);
+        SDL_UnlockMutex(l_JobsLock);
+
+        report_finished_jobs();
+    }
+
+    if (l_DumpsDropped != 0)
+        DebugMessage(M64MSG_WARNING, "Frame dump: dropped %u frame(s) because the encoders could not keep up", l_DumpsDropped);
+
+    for (i = 0; i < SCREENSHOT_BUFFERS; i++)
+    {
+        free(l_Jobs[i].pixels);
+        free(l_Jobs[i].filename);
+    }
+    memset(l_Jobs, 0, sizeof(l_Jobs));
+
+    if (l_JobDone != NULL)
+        SDL_DestroyCond(l_JobDone);
+    if (l_JobsLock != NULL)
+        SDL_DestroyMutex(l_JobsLock);
+    l_JobDone = NULL;
+    l_JobsLock = NULL;
 }
 
 void TakeScreenshot(int iFrameNumber)
 {
+    struct screenshot_job *job;
     char *filename;
 
-    // look for an unused screenshot filename
-    filename = GetNextScreenshotPath();
-    if (filename == NULL)
+    if (l_JobsLock == NULL)
     {
         StateChanged(M64CORE_SCREENSHOT_CAPTURED, 0);
         return;
     }
 
-    // get the width and height
-    int width = 640;
-    int height = 480;
-    gfx.readScreen(NULL, &width, &height, 0);
-
-    // allocate memory for the image
-    unsigned char *pucFrame = (unsigned char *) malloc(width * height * 3);
-    if (pucFrame == NULL)
+    // look for an unused screenshot filename
+    filename = GetNextScreenshotPath();
+    if (filename == NULL)
     {
         StateChanged(M64CORE_SCREENSHOT_CAPTURED, 0);
-        free(filename);
         return;
     }
 
-    // grab the back image from OpenGL by calling the video plugin
-    gfx.readScreen(pucFrame, &width, &height, 0);
-
-    // write the image to a PNG
-    int rval = SaveRGBBufferToFile(filename, pucFrame, width, height, width * 3);
-    // free the memory
-    free(pucFrame);
-    free(filename);
-    // print message -- this allows developers to capture frames and use them in the regression test
-    if (rval != 0)
-    {
+    // user screenshots are never dropped, even if it means waiting for an encoder
+    job = get_free_job(1);
+    if (!capture_frame(job, filename, iFrameNumber, 0))
         StateChanged(M64CORE_SCREENSHOT_CAPTURED, 0);
-    }
-    else
+}
+
+void DumpFrame(int iFrameNumber)
+{
+    struct screenshot_job *job;
+    const char *prefix;
+    char *filename;
+
+    if (l_JobsToReport != 0)
+        report_finished_jobs();
+
+    if (l_DumpInterval <= 0 || l_JobsLock == NULL || iFrameNumber < l_NextDumpFrame)
+        return;
+    l_NextDumpFrame = iFrameNumber + l_DumpInterval;
+
+    // frames are dropped rather than stalling emulation when the encoders fall behind
+    job = get_free_job(0);
+    if (job == NULL)
     {
-        main_message(M64MSG_INFO, OSD_BOTTOM_LEFT, "Captured screenshot for frame %i.", iFrameNumber);
-        StateChanged(M64CORE_SCREENSHOT_CAPTURED, 1);
+        if (l_DumpsDropped++ == 0)
+            DebugMessage(M64MSG_WARNING, "Frame dump: encoders are falling behind, dropping frames");
+        return;
     }
+
+    prefix = GetScreenshotPrefix();
+    if (prefix == NULL)
+        return;
+    filename = formatstr("%s-frame%06i.png", prefix, iFrameNumber);
+    if (filename == NULL)
+        return;
+
+    if (!capture_frame(job, filename, iFrameNumber, 1))
+        DebugMessage(M64MSG_WARNING, "Couldn't capture frame %i for frame dump", iFrameNumber);
 }
 
+int FrameDumpDue(int iFrameNumber)
+{
+    return l_DumpInterval > 0 && l_JobsLock != NULL && iFrameNumber + 1 >= l_NextDumpFrame;
+}
@@ -23,6 +23,12 @@
 #define M64P_MAIN_SCREENSHOT_H
 
 void ScreenshotRomOpen(void);
+int ScreenshotStart(void);
+void ScreenshotStop(void);
 void TakeScreenshot(int iFrameNumber);
+/* Captures the rendered frame when frame dumping is enabled and it is due */
+void DumpFrame(int iFrameNumber);
+/* Whether frame dumping is enabled and a frame is due at or after iFrameNumber */
+int FrameDumpDue(int iFrameNumber);
 
 #endif
@@ -115,6 +115,47 @@ file_status_t write_chunk_to_file(const char *filename, const void *data, size_t
     return file_ok;
 }
 
+file_status_t replace_file(const char *filename, const void *data, size_t size)
+{
+    char *tmp_filename = formatstr("%s.tmp", filename);
+    file_status_t err = file_ok;
+    FILE *f;
+
+    if (tmp_filename == NULL)
+    {
+        return file_open_error;
+    }
+
+    if ((f = osal_file_open(tmp_filename, "wb")) == NULL)
+    {
+        free(tmp_filename);
+        return file_open_error;
+    }
+
+    if (fwrite(data, 1, size, f) != size || osal_file_sync(f) != 0)
+    {
+        err = file_write_error;
+    }
+
+    if (fclose(f) != 0)
+    {
+        err = file_write_error;
+    }
+
+    if (err == file_ok && osal_file_replace(tmp_filename, filename) != 0)
+    {
+        err = file_write_error;
+    }
+
+    if (err != file_ok)
+    {
+        remove(tmp_filename);
+    }
+
+    free(tmp_filename);
+    return err;
+}
+
 
 file_status_t load_file(const char* filename, void** buffer, size_t* size)
 {
@@ -67,6 +67,13 @@ file_status_t write_to_file(const char *filename, const void *data, size_t size)
  */
 file_status_t write_chunk_to_file(const char *filename, const void *data, size_t size, size_t offset);
 
+/** replace_file
+ *    writes the specified number of bytes to a temporary file, commits it to disk,
+ *    then renames it over filename, so that a crash never leaves a partial file.
+ *    returns zero on success, nonzero on failure
+ */
+file_status_t replace_file(const char *filename, const void *data, size_t size);
+
 /** load_file
  *    load the file content into a newly allocated buffer.
  *    returns zero on success, nonzero on failure
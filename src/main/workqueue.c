@@ -31,11 +31,20 @@
 #include "api/m64p_types.h"
 #include "main/list.h"
 
+/* Work queued with queue_work() runs in order on a single thread.
+ * workqueue_run_parallel() uses its own helper threads, so that
+ * parallel jobs never delay or reorder the queued work. */
 #define WORKQUEUE_THREADS 1
+#define WORKQUEUE_PARALLEL_THREADS 3
 
-struct workqueue_mgmt_globals {
+struct workqueue_queue {
     struct list_head work_queue;
     struct list_head thread_queue;
+};
+
+struct workqueue_mgmt_globals {
+    struct workqueue_queue queued;
+    struct workqueue_queue parallel;
     struct list_head thread_list;
     SDL_mutex *lock;
 };
@@ -43,10 +52,27 @@ struct workqueue_mgmt_globals {
 struct workqueue_thread {
     SDL_Thread *thread;
     SDL_cond *work_avail;
+    struct workqueue_queue *queue;
     struct list_head list;
     struct list_head list_mgmt;
 };
 
+struct workqueue_parallel {
+    work_index_func_t func;
+    void *opaque;
+    size_t count;
+    size_t next;
+    size_t done;
+    int refs;
+    SDL_mutex *lock;
+    SDL_cond *finished;
+};
+
+struct workqueue_parallel_work {
+    struct workqueue_parallel *parallel;
+    struct work_struct work;
+};
+
 static struct workqueue_mgmt_globals workqueue_mgmt;
 
 static void workqueue_dismiss(struct work_struct *work)
@@ -61,12 +87,12 @@ static struct work_struct *workqueue_get_work(struct workqueue_thread *thread)
     for (;;) {
         SDL_LockMutex(workqueue_mgmt.lock);
         list_del_init(&thread->list);
-        if (!list_empty(&workqueue_mgmt.work_queue)) {
+        if (!list_empty(&thread->queue->work_queue)) {
             found = 1;
-            work = list_first_entry(&workqueue_mgmt.work_queue, struct work_struct, list);
+            work = list_first_entry(&thread->queue->work_queue, struct work_struct, list);
             list_del_init(&work->list);
         } else {
-            list_add(&thread->list, &workqueue_mgmt.thread_queue);
+            list_add(&thread->list, &thread->queue->thread_queue);
 	        SDL_CondWait(thread->work_avail, workqueue_mgmt.lock);
         }
         SDL_UnlockMutex(workqueue_mgmt.lock);
@@ -96,14 +122,31 @@ static int workqueue_thread_handler(void *data)
     return 0;
 }
 
+static void workqueue_add(struct workqueue_queue *queue, struct work_struct *work)
+{
+    struct workqueue_thread *thread;
+
+    SDL_LockMutex(workqueue_mgmt.lock);
+    list_add_tail(&work->list, &queue->work_queue);
+    if (!list_empty(&queue->thread_queue)) {
+        thread = list_first_entry(&queue->thread_queue, struct workqueue_thread, list);
+        list_del_init(&thread->list);
+
+        SDL_CondSignal(thread->work_avail);
+    }
+    SDL_UnlockMutex(workqueue_mgmt.lock);
+}
+
 int workqueue_init(void)
 {
     size_t i;
     struct workqueue_thread *thread;
 
     memset(&workqueue_mgmt, 0, sizeof(workqueue_mgmt));
-    INIT_LIST_HEAD(&workqueue_mgmt.work_queue);
-    INIT_LIST_HEAD(&workqueue_mgmt.thread_queue);
+    INIT_LIST_HEAD(&workqueue_mgmt.queued.work_queue);
+    INIT_LIST_HEAD(&workqueue_mgmt.queued.thread_queue);
+    INIT_LIST_HEAD(&workqueue_mgmt.parallel.work_queue);
+    INIT_LIST_HEAD(&workqueue_mgmt.parallel.thread_queue);
     INIT_LIST_HEAD(&workqueue_mgmt.thread_list);
 
     workqueue_mgmt.lock = SDL_CreateMutex();
@@ -113,7 +156,7 @@ int workqueue_init(void)
     }
 
     SDL_LockMutex(workqueue_mgmt.lock);
-    for (i = 0; i < WORKQUEUE_THREADS; i++) {
+    for (i = 0; i < WORKQUEUE_THREADS + WORKQUEUE_PARALLEL_THREADS; i++) {
         thread = malloc(sizeof(*thread));
         if (!thread) {
             DebugMessage(M64MSG_ERROR, "Could not create workqueue thread management data");
@@ -122,6 +165,7 @@ int workqueue_init(void)
         }
 
         memset(thread, 0, sizeof(*thread));
+        thread->queue = (i < WORKQUEUE_THREADS) ? &workqueue_mgmt.queued : &workqueue_mgmt.parallel;
         list_add(&thread->list_mgmt, &workqueue_mgmt.thread_list);
         INIT_LIST_HEAD(&thread->list);
         thread->work_avail = SDL_CreateCond();
@@ -154,10 +198,10 @@ void workqueue_shutdown(void)
     struct work_struct *work;
     struct workqueue_thread *thread, *safe;
 
-    for (i = 0; i < WORKQUEUE_THREADS; i++) {
+    for (i = 0; i < WORKQUEUE_THREADS + WORKQUEUE_PARALLEL_THREADS; i++) {
         work = malloc(sizeof(*work));
         init_work(work, workqueue_dismiss);
-        queue_work(work);
+        workqueue_add((i < WORKQUEUE_THREADS) ? &workqueue_mgmt.queued : &workqueue_mgmt.parallel, work);
     }
 
     list_for_each_entry_safe_t(thread, safe, &workqueue_mgmt.thread_list, struct workqueue_thread, list_mgmt) {
@@ -167,7 +211,7 @@ void workqueue_shutdown(void)
         free(thread);
     }
 
-    if (!list_empty(&workqueue_mgmt.work_queue))
+    if (!list_empty(&workqueue_mgmt.queued.work_queue))
         DebugMessage(M64MSG_WARNING, "Stopped workqueue with work still pending");
 
     SDL_DestroyMutex(workqueue_mgmt.lock);
@@ -175,17 +219,108 @@ void workqueue_shutdown(void)
 
 int queue_work(struct work_struct *work)
 {
-    struct workqueue_thread *thread;
+    workqueue_add(&workqueue_mgmt.queued, work);
+    return 0;
+}
 
-    SDL_LockMutex(workqueue_mgmt.lock);
-    list_add_tail(&work->list, &workqueue_mgmt.work_queue);
-    if (!list_empty(&workqueue_mgmt.thread_queue)) {
-        thread = list_first_entry(&workqueue_mgmt.thread_queue, struct workqueue_thread, list);
-        list_del_init(&thread->list);
+/* Process indices until none is left. Returns with parallel->lock held. */
+static void workqueue_parallel_process(struct workqueue_parallel *parallel)
+{
+    size_t index;
 
-        SDL_CondSignal(thread->work_avail);
+    SDL_LockMutex(parallel->lock);
+    while (parallel->next < parallel->count) {
+        index = parallel->next++;
+        SDL_UnlockMutex(parallel->lock);
+
+        parallel->func(index, parallel->opaque);
+
+        SDL_LockMutex(parallel->lock);
+        if (++parallel->done == parallel->count)
+            SDL_CondSignal(parallel->finished);
     }
-    SDL_UnlockMutex(workqueue_mgmt.lock);
+}
 
-    return 0;
+/* Must be called with parallel->lock held */
+static void workqueue_parallel_put(struct workqueue_parallel *parallel)
+{
+    int refs = --parallel->refs;
+
+    SDL_UnlockMutex(parallel->lock);
+
+    if (refs == 0) {
+        SDL_DestroyCond(parallel->finished);
+        SDL_DestroyMutex(parallel->lock);
+        free(parallel);
+    }
+}
+
+static void workqueue_parallel_handler(struct work_struct *work)
+{
+    struct workqueue_parallel_work *parallel_work = container_of(work, struct workqueue_parallel_work, work);
+    struct workqueue_parallel *parallel = parallel_work->parallel;
+
+    free(parallel_work);
+
+    workqueue_parallel_process(parallel);
+    workqueue_parallel_put(parallel);
+}
+
+void workqueue_run_parallel(size_t count, work_index_func_t func, void *opaque)
+{
+    size_t i;
+    struct workqueue_parallel *parallel;
+    struct workqueue_parallel_work *parallel_work;
+
+    if (count == 0)
+        return;
+
+    parallel = malloc(sizeof(*parallel));
+    if (parallel != NULL) {
+        memset(parallel, 0, sizeof(*parallel));
+        parallel->lock = SDL_CreateMutex();
+        parallel->finished = SDL_CreateCond();
+    }
+
+    if (parallel == NULL || !parallel->lock || !parallel->finished || count == 1) {
+        if (parallel != NULL) {
+            if (parallel->finished)
+                SDL_DestroyCond(parallel->finished);
+            if (parallel->lock)
+                SDL_DestroyMutex(parallel->lock);
+            free(parallel);
+        }
+
+        for (i = 0; i < count; ++i)
+            func(i, opaque);
+        return;
+    }
+
+    parallel->func = func;
+    parallel->opaque = opaque;
+    parallel->count = count;
+    parallel->refs = 1;
+
+    /* helpers may be picked up late (e.g. when called from a work item),
+     * so the calling thread processes indices as well and never waits
+     * for a helper to start. */
+    for (i = 0; i < WORKQUEUE_PARALLEL_THREADS && i + 1 < count; i++) {
+        parallel_work = malloc(sizeof(*parallel_work));
+        if (!parallel_work)
+            break;
+
+        parallel_work->parallel = parallel;
+        init_work(&parallel_work->work, workqueue_parallel_handler);
+
+        SDL_LockMutex(parallel->lock);
+        ++parallel->refs;
+        SDL_UnlockMutex(parallel->lock);
+
+        workqueue_add(&workqueue_mgmt.parallel, &parallel_work->work);
+    }
+
+    workqueue_parallel_process(parallel);
+    while (parallel->done < parallel->count)
+        SDL_CondWait(parallel->finished, parallel->lock);
+    workqueue_parallel_put(parallel);
 }
@@ -22,12 +22,15 @@
 #ifndef __WORKQUEUE_H__
 #define __WORKQUEUE_H__
 
+#include <stddef.h>
+
 #include "list.h"
 #include "osal/preproc.h"
 
 struct work_struct;
 
 typedef void (*work_func_t)(struct work_struct *work);
+typedef void (*work_index_func_t)(size_t index, void *opaque);
 struct work_struct {
     work_func_t func;
     struct list_head list;
@@ -45,6 +48,10 @@ int workqueue_init(void);
 void workqueue_shutdown(void);
 int queue_work(struct work_struct *work);
 
+/* Call func for each index in [0, count) on the workqueue threads and
+ * the calling thread, and return once all calls have completed. */
+void workqueue_run_parallel(size_t count, work_index_func_t func, void *opaque);
+
 #else
 
 static osal_inline int workqueue_init(void)
@@ -62,6 +69,14 @@ static osal_inline int queue_work(struct work_struct *work)
     return 0;
 }
 
+static osal_inline void workqueue_run_parallel(size_t count, work_index_func_t func, void *opaque)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i)
+        func(i, opaque);
+}
+
 #endif
 
 #endif
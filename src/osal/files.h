@@ -26,6 +26,7 @@
 #if !defined (OSAL_FILES_H)
 #define OSAL_FILES_H
 
+#include <stdio.h>
 #include <zlib.h>
 
 /* some file-related preprocessor definitions */
@@ -67,5 +68,44 @@ extern const char * osal_get_user_cachepath(void);
 extern FILE * osal_file_open (const char *filename, const char *mode);
 extern gzFile osal_gzopen(const char *filename, const char *mode);
 
+/* Flush the stdio buffers of f and ask the OS to commit its content to disk.
+ * Returns zero on success, nonzero on failure.
+ */
+extern int osal_file_sync(FILE *f);
+
+/* Atomically replace dst with src, even if dst already exists.
+ * Returns zero on success, nonzero on failure.
+ */
+extern int osal_file_replace(const char *src, const char *dst);
+
+/* Map a whole file read-only into memory.
+ * Returns NULL on failure or if the file is empty, otherwise stores the file size in *size.
+ * The mapping must be released with osal_file_unmap().
+ */
+extern void * osal_file_map(const char *filename, size_t *size);
+extern void osal_file_unmap(void *data, size_t size);
+
+/* Same as osal_file_map(), but the pages are writable. Writes are private
+ * to the process and never reach the file (copy-on-write).
+ * The mapping must be released with osal_file_unmap().
+ */
+extern void * osal_file_map_copy(const char *filename, size_t *size);
+
+/* Map a file of exactly size bytes copy-on-write over the page aligned
+ * memory at addr, releasing the pages previously backing that memory.
+ * Returns zero on success, nonzero on failure or if unsupported by the platform.
+ * osal_file_unmap_at() puts back zero-filled private memory at addr.
+ */
+extern int osal_file_map_at(const char *filename, void *addr, size_t size);
+extern void osal_file_unmap_at(void *addr, size_t size);
+
+/* Map size bytes of zero-filled private memory aligned on alignment (a power of two).
+ * Files can be mapped over parts of it with osal_file_map_at().
+ * Returns NULL on failure or if unsupported by the platform.
+ * The mapping must be released with osal_mem_unmap().
+ */
+extern void * osal_mem_map(size_t size, size_t alignment);
+extern void osal_mem_unmap(void *addr, size_t size);
+
 #endif /* OSAL_FILES_H */
 
@@ -23,10 +23,13 @@
  * functions
  */
 
+#include <fcntl.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -241,3 +244,143 @@ gzFile osal_gzopen(const char *filename, const char *mode)
 {
     return gzopen(filename, mode);
 }
+
+int osal_file_sync(FILE *f)
+{
+    if (fflush(f) != 0)
+        return -1;
+
+    return fsync(fileno(f));
+}
+
+int osal_file_replace(const char *src, const char *dst)
+{
+    return rename(src, dst);
+}
+
+void * osal_file_map(const char *filename, size_t *size)
+{
+    struct stat fileinfo;
+    void *data;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &fileinfo) != 0 || fileinfo.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    *size = (size_t)fileinfo.st_size;
+    return data;
+}
+
+void osal_file_unmap(void *data, size_t size)
+{
+    if (data != NULL)
+        munmap(data, size);
+}
+
+void * osal_file_map_copy(const char *filename, size_t *size)
+{
+    struct stat fileinfo;
+    void *data;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &fileinfo) != 0 || fileinfo.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    *size = (size_t)fileinfo.st_size;
+    return data;
+}
+
+int osal_file_map_at(const char *filename, void *addr, size_t size)
+{
+    struct stat fileinfo;
+    long page_size = sysconf(_SC_PAGESIZE);
+    void *data;
+    int fd;
+
+    if (page_size <= 0 || ((size_t)addr % (size_t)page_size) != 0)
+        return -1;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    if (fstat(fd, &fileinfo) != 0 || (unsigned long long)fileinfo.st_size != size)
+    {
+        close(fd);
+        return -1;
+    }
+
+    data = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        /* a failed MAP_FIXED may have discarded the previous pages */
+        osal_file_unmap_at(addr, size);
+        return -1;
+    }
+
+    return 0;
+}
+
+void osal_file_unmap_at(void *addr, size_t size)
+{
+    mmap(addr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_FIXED, -1, 0);
+}
+
+void * osal_mem_map(size_t size, size_t alignment)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t begin, start, end;
+    size_t length;
+    void *data;
+
+    if (page_size <= 0)
+        return NULL;
+    if (alignment < (size_t)page_size)
+        alignment = (size_t)page_size;
+
+    /* over-allocate, then give back what is outside of the aligned range */
+    size = (size + (size_t)page_size - 1) & ~((size_t)page_size - 1);
+    length = size + alignment;
+    data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    begin = (uintptr_t)data;
+    start = (begin + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    end = start + size;
+    if (start != begin)
+        munmap(data, start - begin);
+    if (end != begin + length)
+        munmap((void *)end, begin + length - end);
+
+    return (void *)start;
+}
+
+void osal_mem_unmap(void *addr, size_t size)
+{
+    if (addr != NULL)
+        munmap(addr, size);
+}
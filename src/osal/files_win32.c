@@ -220,3 +220,121 @@ gzFile osal_gzopen(const char *filename, const char *mode)
     MultiByteToWideChar(CP_UTF8, 0, filename, -1, wstr_filename, PATH_MAX);
     return gzopen_w(wstr_filename, mode);
 }
+
+int osal_file_sync(FILE *f)
+{
+    if (fflush(f) != 0)
+        return -1;
+
+    return _commit(_fileno(f));
+}
+
+int osal_file_replace(const char *src, const char *dst)
+{
+    wchar_t wstr_src[PATH_MAX];
+    wchar_t wstr_dst[PATH_MAX];
+    MultiByteToWideChar(CP_UTF8, 0, src, -1, wstr_src, PATH_MAX);
+    MultiByteToWideChar(CP_UTF8, 0, dst, -1, wstr_dst, PATH_MAX);
+
+    return MoveFileExW(wstr_src, wstr_dst, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+}
+
+void * osal_file_map(const char *filename, size_t *size)
+{
+    wchar_t wstr_filename[PATH_MAX];
+    LARGE_INTEGER filesize;
+    HANDLE file, mapping;
+    void *data;
+
+    MultiByteToWideChar(CP_UTF8, 0, filename, -1, wstr_filename, PATH_MAX);
+    file = CreateFileW(wstr_filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    if (!GetFileSizeEx(file, &filesize) || filesize.QuadPart <= 0 || (unsigned long long)filesize.QuadPart > (size_t)-1)
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return NULL;
+
+    /* the view keeps the mapping alive */
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL)
+        return NULL;
+
+    *size = (size_t)filesize.QuadPart;
+    return data;
+}
+
+void osal_file_unmap(void *data, size_t size)
+{
+    (void)size;
+    if (data != NULL)
+        UnmapViewOfFile(data);
+}
+
+void * osal_file_map_copy(const char *filename, size_t *size)
+{
+    wchar_t wstr_filename[PATH_MAX];
+    LARGE_INTEGER filesize;
+    HANDLE file, mapping;
+    void *data;
+
+    MultiByteToWideChar(CP_UTF8, 0, filename, -1, wstr_filename, PATH_MAX);
+    file = CreateFileW(wstr_filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    if (!GetFileSizeEx(file, &filesize) || filesize.QuadPart <= 0 || (unsigned long long)filesize.QuadPart > (size_t)-1)
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    mapping = CreateFileMappingW(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return NULL;
+
+    data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL)
+        return NULL;
+
+    *size = (size_t)filesize.QuadPart;
+    return data;
+}
+
+/* Views can't be placed over memory which is already allocated */
+int osal_file_map_at(const char *filename, void *addr, size_t size)
+{
+    (void)filename;
+    (void)addr;
+    (void)size;
+    return -1;
+}
+
+void osal_file_unmap_at(void *addr, size_t size)
+{
+    (void)addr;
+    (void)size;
+}
+
+void * osal_mem_map(size_t size, size_t alignment)
+{
+    (void)size;
+    (void)alignment;
+    return NULL;
+}
+
+void osal_mem_unmap(void *addr, size_t size)
+{
+    (void)addr;
+    (void)size;
+}
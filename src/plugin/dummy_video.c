@@ -127,4 +127,6 @@ void dummyvideo_ResizeVideoOutput(int width, int height)
 {
 }
 
-
+void dummyvideo_SetFrameSkip(int skip)
+{
+}
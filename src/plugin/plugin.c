@@ -69,6 +69,7 @@ static const gfx_plugin_functions dummy_gfx = {
     dummyvideo_ReadScreen2,
     dummyvideo_SetRenderingCallback,
     dummyvideo_ResizeVideoOutput,
+    dummyvideo_SetFrameSkip,
     dummyvideo_FBRead,
     dummyvideo_FBWrite,
     dummyvideo_FBGetFrameBufferInfo
@@ -193,6 +194,7 @@ static m64p_error plugin_connect_gfx(m64p_dynlib_handle plugin_handle)
 
         /* set function pointers for optional functions */
         gfx.resizeVideoOutput = (ptr_ResizeVideoOutput)osal_dynlib_getproc(plugin_handle, "ResizeVideoOutput");
+        gfx.setFrameSkip = (ptr_SetFrameSkip)osal_dynlib_getproc(plugin_handle, "SetFrameSkip");
 
         /* check the version info */
         (*gfx.getVersion)(&PluginType, &PluginVersion, &APIVersion, NULL, NULL);
@@ -217,6 +219,8 @@ static m64p_error plugin_connect_gfx(m64p_dynlib_handle plugin_handle)
             DebugMessage(M64MSG_WARNING, "Fallback for Video plugin API (%02i.%02i.%02i) < 2.2.0. Resizable video will not work", VERSION_PRINTF_SPLIT(APIVersion));
             gfx.resizeVideoOutput = dummyvideo_ResizeVideoOutput;
         }
+        if (gfx.setFrameSkip == NULL)
+            gfx.setFrameSkip = dummyvideo_SetFrameSkip;
 
         l_GfxAttached = 1;
     }
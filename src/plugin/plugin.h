@@ -58,6 +58,7 @@ typedef struct _gfx_plugin_functions
 	ptr_ReadScreen2      readScreen;
 	ptr_SetRenderingCallback setRenderingCallback;
     ptr_ResizeVideoOutput    resizeVideoOutput;
+    ptr_SetFrameSkip         setFrameSkip;
 
 	/* frame buffer plugin spec extension */
 	ptr_FBRead          fBRead;
@@ -0,0 +1,130 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - bench_breakpoints.c                                     *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/* Measures the cost of debugger breakpoint lookups with 1, 100 and
+ * BREAKPOINTS_MAX_NUMBER breakpoints set.
+ *
+ * gcc -O2 -DDBG -I../src `sdl2-config --cflags` bench_breakpoints.c ../src/debugger/dbg_breakpoints.c -o bench_breakpoints `sdl2-config --libs`
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "api/m64p_types.h"
+#include "debugger/dbg_breakpoints.h"
+#include "debugger/dbg_debugger.h"
+
+/* stubs for the parts of the core used by dbg_breakpoints.c */
+m64p_dbg_runstate g_dbg_runstate = M64P_DBG_RUNSTATE_RUNNING;
+uint32_t breakpointAccessed;
+uint32_t breakpointFlag;
+
+void update_debugger(uint32_t pc) { (void)pc; }
+void debugger_invalidate_code(uint32_t start, uint32_t end) { (void)start; (void)end; }
+void DebugMessage(int level, const char *message, ...) { (void)level; (void)message; }
+void activate_memory_break_read(struct memory* mem, uint32_t address) { (void)mem; (void)address; }
+void deactivate_memory_break_read(struct memory* mem, uint32_t address) { (void)mem; (void)address; }
+void activate_memory_break_write(struct memory* mem, uint32_t address) { (void)mem; (void)address; }
+void deactivate_memory_break_write(struct memory* mem, uint32_t address) { (void)mem; (void)address; }
+
+enum { LOOKUPS = 10000000 };
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void set_breakpoints(int count)
+{
+    int i;
+
+    while (g_NumBreakpoints > 0)
+        remove_breakpoint_by_num(NULL, g_NumBreakpoints - 1);
+
+    srand(1);
+    for (i = 0; i < count; ++i)
+    {
+        m64p_breakpoint bpt;
+        uint32_t address = 0x80000000 | ((uint32_t)rand() << 2 & 0x007ffffc);
+
+        memset(&bpt, 0, sizeof(bpt));
+        bpt.address = address;
+        bpt.flags = M64P_BKP_FLAG_ENABLED;
+
+        switch (i % 3)
+        {
+        case 0:
+            bpt.endaddr = address;
+            bpt.flags |= M64P_BKP_FLAG_EXEC;
+            break;
+        case 1:
+            bpt.endaddr = address + 0x40;
+            bpt.flags |= M64P_BKP_FLAG_READ;
+            break;
+        default:
+            bpt.endaddr = address + 0x100;
+            bpt.flags |= M64P_BKP_FLAG_WRITE;
+            break;
+        }
+
+        add_breakpoint_struct(NULL, &bpt);
+    }
+}
+
+int main(void)
+{
+    static const int counts[] = { 0, 1, 100, BREAKPOINTS_MAX_NUMBER };
+    size_t c;
+    uint32_t i;
+
+    printf("%12s %16s %16s\n", "breakpoints", "exec ns/lookup", "read ns/lookup");
+
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+    {
+        volatile int sink = 0;
+        double start, exec_ns, read_ns;
+
+        set_breakpoints(counts[c]);
+
+        /* straight-line code in RDRAM, as seen by update_debugger */
+        start = now_ns();
+        for (i = 0; i < LOOKUPS; ++i)
+            sink += check_breakpoints(0x80000000 | ((i << 2) & 0x007ffffc));
+        exec_ns = (now_ns() - start) / LOOKUPS;
+
+        /* scattered data accesses, as seen by read_with_bp_checks */
+        start = now_ns();
+        for (i = 0; i < LOOKUPS; ++i)
+            sink += lookup_breakpoint(0x80000000 | ((i * 2654435761u) & 0x007ffffc), 4,
+                                      M64P_BKP_FLAG_ENABLED | M64P_BKP_FLAG_READ);
+        read_ns = (now_ns() - start) / LOOKUPS;
+
+        printf("%12d %16.2f %16.2f\n", counts[c], exec_ns, read_ns);
+    }
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - bench_dma.c                                             *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/* Measures the throughput of DMA copies between byte swizzled memories,
+ * comparing dma_copy with the byte loop it replaces, and checks that both
+ * give the same result.
+ *
+ * gcc -O2 -I../src bench_dma.c ../src/device/memory/dma_copy.c -o bench_dma
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "device/memory/dma_copy.h"
+#include "osal/preproc.h"
+
+enum { MEM_SIZE = 0x100000 };
+enum { BYTES_PER_RUN = 256 * 1024 * 1024 };
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void byte_copy(uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr, size_t length)
+{
+    size_t i;
+
+    for (i = 0; i < length; ++i) {
+        dst[(dst_addr+i)^S8] = src[(src_addr+i)^S8];
+    }
+}
+
+static int check(uint8_t* a, uint8_t* b, const uint8_t* src)
+{
+    uint32_t dst_addr, src_addr;
+    size_t length;
+
+    for (dst_addr = 0; dst_addr < 8; ++dst_addr)
+    for (src_addr = 0; src_addr < 8; ++src_addr)
+    for (length = 0; length < 200; ++length)
+    {
+        memset(a, 0x55, 512);
+        memset(b, 0x55, 512);
+        byte_copy(a, 64 + dst_addr, src, 64 + src_addr, length);
+        dma_copy(b, 64 + dst_addr, src, 64 + src_addr, length);
+
+        if (memcmp(a, b, 512) != 0) {
+            printf("mismatch: dst %u, src %u, length %u\n", (unsigned)dst_addr, (unsigned)src_addr, (unsigned)length);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static double run(void (*copy)(uint8_t*, uint32_t, const uint8_t*, uint32_t, size_t),
+                  uint8_t* dst, uint32_t dst_addr, const uint8_t* src, uint32_t src_addr, size_t length)
+{
+    size_t n = BYTES_PER_RUN / length;
+    size_t i;
+    double start = now_ns();
+
+    for (i = 0; i < n; ++i) {
+        copy(dst, dst_addr + (uint32_t)((i * 4096) & (MEM_SIZE / 2 - 1)), src, src_addr, length);
+    }
+
+    return (double)(n * length) / (now_ns() - start);
+}
+
+int main(void)
+{
+    /* SP DMA rows, audio buffers, and PI transfers from the cart */
+    static const size_t lengths[] = { 8, 64, 0x200, 0x1000, 0x10000 };
+    static const uint32_t offsets[][2] = { { 0, 0 }, { 0, 2 }, { 2, 0 } };
+    uint8_t* src = (uint8_t*)malloc(MEM_SIZE);
+    uint8_t* dst = (uint8_t*)malloc(MEM_SIZE);
+    uint8_t* ref = (uint8_t*)malloc(MEM_SIZE);
+    size_t i, l, o;
+
+    if (src == NULL || dst == NULL || ref == NULL)
+        return 1;
+
+    srand(1);
+    for (i = 0; i < MEM_SIZE; ++i)
+        src[i] = (uint8_t)rand();
+
+    if (!check(ref, dst, src))
+        return 1;
+
+    printf("%8s %10s %14s %14s\n", "length", "dst/src", "byte GB/s", "dma_copy GB/s");
+
+    for (l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l)
+    for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); ++o)
+    {
+        double byte_gbps = run(byte_copy, ref, offsets[o][0], src, offsets[o][1], lengths[l]);
+        double dma_gbps = run(dma_copy, dst, offsets[o][0], src, offsets[o][1], lengths[l]);
+
+        printf("%8zu %7u/%-2u %14.2f %14.2f\n", lengths[l],
+               (unsigned)offsets[o][0], (unsigned)offsets[o][1], byte_gbps, dma_gbps);
+    }
+
+    free(ref);
+    free(dst);
+    free(src);
+    return 0;
+}
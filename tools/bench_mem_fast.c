@@ -0,0 +1,249 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - bench_mem_fast.c                                        *
+ *   Mupen64Plus homepage: https://mupen64plus.org/                        *
+ *   Copyright (C) 2026 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/* Measures interpreter RDRAM and SP memory loads and stores (best of
+ * REPEATS runs, in millions of accesses per second), comparing the
+ * mem_fast_ptr path of r4300_read/write_aligned_word with the region handler
+ * call it bypasses, and checks that both see the same memory.
+ *
+ * gcc -O2 -I../src bench_mem_fast.c ../src/device/memory/memory.c ../src/device/rdram/rdram.c -o bench_mem_fast
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "device/device.h"
+#include "device/memory/memory.h"
+#include "device/rcp/rsp/rsp_core.h"
+#include "device/rdram/rdram.h"
+#include "device/r4300/r4300_core.h"
+
+/* stubs for the parts of the core used by memory.c and rdram.c */
+void DebugMessage(int level, const char *message, ...) { (void)level; (void)message; }
+void* osal_mem_map(size_t size, size_t alignment) { (void)size; (void)alignment; return NULL; }
+void osal_mem_unmap(void* addr, size_t size) { (void)addr; (void)size; }
+void invalidate_r4300_cached_code(struct r4300_core* r4300, uint32_t address, size_t size) { (void)r4300; (void)address; (void)size; }
+int64_t* r4300_regs(struct r4300_core* r4300) { (void)r4300; return NULL; }
+
+enum { DRAM_SIZE = 0x400000 };
+enum { ACCESSES = 32 * 1024 * 1024 };
+enum { REPEATS = 5 };
+
+static uint32_t* l_sp_mem;
+
+static void read_sp_mem(void* opaque, uint32_t address, uint32_t* value)
+{
+    (void)opaque;
+    *value = l_sp_mem[(address & (SP_MEM_SIZE - 1)) >> 2];
+}
+
+static void write_sp_mem(void* opaque, uint32_t address, uint32_t value, uint32_t mask)
+{
+    (void)opaque;
+    masked_write(&l_sp_mem[(address & (SP_MEM_SIZE - 1)) >> 2], value, mask);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* same lookups as r4300_read/write_aligned_word after address translation */
+static uint32_t fast_read(const struct memory* mem, uint32_t address)
+{
+    uint32_t value;
+    const uint32_t* ptr = mem_fast_ptr(mem, address);
+
+    if (ptr != NULL) {
+        return *ptr;
+    }
+
+    mem_read32(mem_get_handler(mem, address), address & ~UINT32_C(3), &value);
+    return value;
+}
+
+static void fast_write(const struct memory* mem, uint32_t address, uint32_t value, uint32_t mask)
+{
+    uint32_t* ptr = mem_fast_ptr(mem, address);
+
+    if (ptr != NULL) {
+        masked_write(ptr, value, mask);
+        return;
+    }
+
+    mem_write32(mem_get_handler(mem, address), address & ~UINT32_C(3), value, mask);
+}
+
+static uint32_t handler_read(const struct memory* mem, uint32_t address)
+{
+    uint32_t value;
+
+    mem_read32(mem_get_handler(mem, address), address & ~UINT32_C(3), &value);
+    return value;
+}
+
+static void handler_write(const struct memory* mem, uint32_t address, uint32_t value, uint32_t mask)
+{
+    mem_write32(mem_get_handler(mem, address), address & ~UINT32_C(3), value, mask);
+}
+
+static double run_reads(uint32_t (*read)(const struct memory*, uint32_t),
+                        const struct memory* mem, const uint32_t* addresses, size_t count, uint32_t* sum)
+{
+    size_t i, r;
+    double best = 0.0;
+
+    for (r = 0; r < REPEATS; ++r) {
+        uint32_t acc = 0;
+        double start = now_ns();
+
+        for (i = 0; i < ACCESSES; ++i) {
+            acc += read(mem, addresses[i & (count - 1)]);
+        }
+
+        start = (double)ACCESSES / (now_ns() - start) * 1e3;
+        if (start > best)
+            best = start;
+        *sum = acc;
+    }
+
+    return best;
+}
+
+static double run_writes(void (*write)(const struct memory*, uint32_t, uint32_t, uint32_t),
+                         const struct memory* mem, const uint32_t* addresses, size_t count)
+{
+    size_t i, r;
+    double best = 0.0;
+
+    for (r = 0; r < REPEATS; ++r) {
+        double start = now_ns();
+
+        for (i = 0; i < ACCESSES; ++i) {
+            write(mem, addresses[i & (count - 1)], (uint32_t)i, (i & 1) ? UINT32_C(0xffffffff) : UINT32_C(0x0000ffff));
+        }
+
+        start = (double)ACCESSES / (now_ns() - start) * 1e3;
+        if (start > best)
+            best = start;
+    }
+
+    return best;
+}
+
+static int check(const struct memory* mem, const uint32_t* addresses, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+        fast_write(mem, addresses[i], (uint32_t)i * 2654435761u, UINT32_C(0xffffffff));
+        if (handler_read(mem, addresses[i]) != fast_read(mem, addresses[i])) {
+            printf("mismatch at %08x\n", (unsigned)addresses[i]);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int main(void)
+{
+    enum { PATTERN = 0x10000 };
+    static const char* names[] = { "RDRAM sequential", "RDRAM random", "SP DMEM/IMEM random" };
+    struct memory* mem = (struct memory*)calloc(1, sizeof(*mem));
+    struct rdram* rdram = (struct rdram*)calloc(1, sizeof(*rdram));
+    uint32_t* dram = (uint32_t*)calloc(1, DRAM_SIZE);
+    uint32_t* addresses = (uint32_t*)malloc(3 * PATTERN * sizeof(*addresses));
+    struct mem_mapping mappings[2];
+    struct mem_handler dbg_handler = { NULL, NULL, NULL };
+    uint32_t sum_fast, sum_handler;
+    size_t i, p;
+
+    l_sp_mem = (uint32_t*)calloc(1, SP_MEM_SIZE);
+
+    if (mem == NULL || rdram == NULL || dram == NULL || addresses == NULL || l_sp_mem == NULL)
+        return 1;
+
+    init_rdram(rdram, dram, DRAM_SIZE, NULL);
+
+    mappings[0].begin = MM_RDRAM_DRAM;
+    mappings[0].end = MM_RDRAM_DRAM + 0x3efffff;
+    mappings[0].type = M64P_MEM_RDRAM;
+    mappings[0].handler.opaque = rdram;
+    mappings[0].handler.read32 = read_rdram_dram;
+    mappings[0].handler.write32 = write_rdram_dram;
+
+    mappings[1].begin = MM_RSP_MEM;
+    mappings[1].end = MM_RSP_MEM + 0xffff;
+    mappings[1].type = M64P_MEM_RSPMEM;
+    mappings[1].handler.opaque = NULL;
+    mappings[1].handler.read32 = read_sp_mem;
+    mappings[1].handler.write32 = write_sp_mem;
+
+    init_memory(mem, mappings, 2, NULL, &dbg_handler);
+    map_direct_range(mem, MM_RDRAM_DRAM, MM_RDRAM_DRAM + DRAM_SIZE - 1,
+                     dram, UINT32_C(0xffffffff), &mappings[0].handler);
+    map_direct_range(mem, MM_RSP_MEM, MM_RSP_MEM + 0xffff,
+                     l_sp_mem, SP_MEM_SIZE - 1, &mappings[1].handler);
+
+    srand(1);
+    for (i = 0; i < PATTERN; ++i) {
+        addresses[i] = MM_RDRAM_DRAM + (uint32_t)(i * 4) % DRAM_SIZE;
+        addresses[PATTERN + i] = MM_RDRAM_DRAM + ((uint32_t)rand() * 4) % DRAM_SIZE;
+        addresses[2 * PATTERN + i] = MM_RSP_MEM + ((uint32_t)rand() * 4) % 0x10000;
+    }
+
+    for (p = 0; p < 3; ++p) {
+        if (!check(mem, addresses + p * PATTERN, PATTERN))
+            return 1;
+    }
+
+    printf("%-20s %14s %14s %14s %14s\n", "pattern",
+           "handler ld M/s", "fast ld M/s", "handler st M/s", "fast st M/s");
+
+    for (p = 0; p < 3; ++p) {
+        const uint32_t* pattern = addresses + p * PATTERN;
+        double handler_ld = run_reads(handler_read, mem, pattern, PATTERN, &sum_handler);
+        double fast_ld = run_reads(fast_read, mem, pattern, PATTERN, &sum_fast);
+        double handler_st = run_writes(handler_write, mem, pattern, PATTERN);
+        double fast_st = run_writes(fast_write, mem, pattern, PATTERN);
+
+        if (sum_handler != sum_fast) {
+            printf("%s: loads disagree\n", names[p]);
+            return 1;
+        }
+
+        printf("%-20s %14.1f %14.1f %14.1f %14.1f\n", names[p], handler_ld, fast_ld, handler_st, fast_st);
+    }
+
+    free(l_sp_mem);
+    free(addresses);
+    free(dram);
+    free(rdram);
+    free(mem);
+    return 0;
+}